@@ -0,0 +1,225 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_capture.c
+	*
+	*	PURPOSE:
+	*	Records every frame received by the CAN handlers and every frame sent by the
+	*	TX scheduler, with its timestamps, controller and mailbox, into a RAM ring
+	*	which can be read out in a binary format or dumped over the serial port.
+	*
+	*	FILE REFERENCES:	can_capture.h, FreeRTOS.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	can_capture_read() returns 0 if the buffer is too small for the header.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_capture.h.
+	*
+	*	NOTES:
+	*	The capture is off after reset. While it is off the handlers only test a flag.
+	*	The test programs on the STK600 are timed from their LED toggles; a capture
+	*	of the same run gives the time of each frame to the CPU cycle instead.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		can_capture_read() copies the records CAN_CAPTURE_READ_CHUNK at a time,
+	*					each chunk in a critical section of its own, instead of the whole
+	*					block in one: the CAN interrupts are now masked for 8 records at most.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_capture_frame() is called by can_mailbox_isr() for each frame read from a
+	*	mailbox and by can_tx_complete_isr() for each frame sent.
+	*	can_capture_read() moves the oldest records into a block in the format given in
+	*	can_capture.h. can_capture_dump() writes blocks to a serial port until the ring
+	*	is empty.
+	*
+ */
+
+#include "can_capture.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+typedef struct {
+	uint32_t ul_cycles;
+	uint32_t ul_id;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	uint16_t us_timestamp;
+	uint8_t uc_info;
+	uint8_t uc_length;
+} can_capture_rec_t;
+
+/* Written by the CAN handlers, read by a task a few records per critical section.
+*  ul_cap_head and ul_cap_tail are free-running, the slot is found with the mask. */
+static can_capture_rec_t can_capture_ring[CAN_CAPTURE_RECORDS];
+static volatile uint32_t ul_cap_head = 0;
+static volatile uint32_t ul_cap_tail = 0;
+static volatile uint32_t ul_cap_lost = 0;
+static volatile uint32_t ul_cap_on = 0;
+
+/* Records copied by can_capture_read() per critical section: the handlers may
+*  overwrite the oldest record at any time, so the tail only moves while they
+*  are masked. */
+#define CAN_CAPTURE_READ_CHUNK		8
+
+/* Block buffer of can_capture_dump(). */
+#define CAN_CAPTURE_DUMP_RECORDS	16
+static uint8_t uc_dump_buf[CAN_CAPTURE_HEADER_SIZE + CAN_CAPTURE_REC_SIZE * CAN_CAPTURE_DUMP_RECORDS];
+
+/************************************************************************/
+/*				HOT PATH                                                */
+/*	Called from the CAN interrupt handlers. uc_dir is 0 for a frame		*/
+/*	received and CAN_CAPTURE_TX for a frame sent.						*/
+/************************************************************************/
+
+void can_capture_frame(const can_frame_t *p_frame, uint8_t uc_dir)
+{
+	can_capture_rec_t *p_rec;
+	uint32_t head = ul_cap_head;
+
+	if (!ul_cap_on)
+		return;
+
+	/* Full: the oldest record makes room. */
+	if (head - ul_cap_tail >= CAN_CAPTURE_RECORDS) {
+		ul_cap_tail++;
+		ul_cap_lost++;
+	}
+
+	p_rec = &can_capture_ring[head & (CAN_CAPTURE_RECORDS - 1)];
+	p_rec->ul_cycles = CAN_DWT_CYCCNT;
+	p_rec->ul_id = p_frame->ul_id;
+	p_rec->ul_datal = p_frame->ul_datal;
+	p_rec->ul_datah = p_frame->ul_datah;
+	p_rec->us_timestamp = p_frame->us_timestamp;
+	p_rec->uc_info = (p_frame->uc_info & ~CAN_CAPTURE_TX) | uc_dir;
+	p_rec->uc_length = p_frame->uc_length;
+
+	ul_cap_head = head + 1;
+}
+
+/************************************************************************/
+/*				START / STOP                                            */
+/*	Starting empties the ring.											*/
+/************************************************************************/
+
+void can_capture_start(void)
+{
+	taskENTER_CRITICAL();
+	ul_cap_tail = ul_cap_head;
+	ul_cap_lost = 0;
+	ul_cap_on = 1;
+	taskEXIT_CRITICAL();
+}
+
+void can_capture_stop(void)
+{
+	ul_cap_on = 0;
+}
+
+/************************************************************************/
+/*				READ A BLOCK                                            */
+/*	Moves as many of the oldest records as fit in puc_buf into one		*/
+/*	block (format in can_capture.h). Returns the number of bytes		*/
+/*	written, CAN_CAPTURE_HEADER_SIZE if the ring was empty.				*/
+/************************************************************************/
+
+static uint8_t *can_capture_put16(uint8_t *p, uint32_t ul_value)
+{
+	*p++ = (uint8_t)ul_value;
+	*p++ = (uint8_t)(ul_value >> 8);
+	return p;
+}
+
+static uint8_t *can_capture_put32(uint8_t *p, uint32_t ul_value)
+{
+	p = can_capture_put16(p, ul_value);
+	return can_capture_put16(p, ul_value >> 16);
+}
+
+uint32_t can_capture_read(uint8_t *puc_buf, uint32_t ul_size)
+{
+	const can_capture_rec_t *p_rec;
+	uint8_t *p;
+	uint32_t ul_room, ul_count = 0, ul_chunk, ul_lost, i;
+
+	if (ul_size < CAN_CAPTURE_HEADER_SIZE)
+		return 0;
+	ul_room = (ul_size - CAN_CAPTURE_HEADER_SIZE) / CAN_CAPTURE_REC_SIZE;
+
+	/* Records overwritten from here on are counted in the next block. */
+	taskENTER_CRITICAL();
+	ul_lost = ul_cap_lost;
+	ul_cap_lost = 0;
+	taskEXIT_CRITICAL();
+
+	p = puc_buf + CAN_CAPTURE_HEADER_SIZE;
+	do {
+		taskENTER_CRITICAL();
+		ul_chunk = ul_cap_head - ul_cap_tail;
+		if (ul_chunk > CAN_CAPTURE_READ_CHUNK)
+			ul_chunk = CAN_CAPTURE_READ_CHUNK;
+		if (ul_chunk > ul_room - ul_count)
+			ul_chunk = ul_room - ul_count;
+		for (i = 0; i < ul_chunk; i++) {
+			p_rec = &can_capture_ring[ul_cap_tail & (CAN_CAPTURE_RECORDS - 1)];
+			p = can_capture_put32(p, p_rec->ul_cycles);
+			p = can_capture_put32(p, p_rec->ul_id);
+			p = can_capture_put32(p, p_rec->ul_datal);
+			p = can_capture_put32(p, p_rec->ul_datah);
+			p = can_capture_put16(p, p_rec->us_timestamp);
+			*p++ = p_rec->uc_info;
+			*p++ = p_rec->uc_length;
+			ul_cap_tail++;
+		}
+		taskEXIT_CRITICAL();
+		ul_count += ul_chunk;
+	} while (ul_chunk && (ul_count < ul_room));
+
+	p = puc_buf;
+	memcpy(p, CAN_CAPTURE_MAGIC, 4);
+	p += 4;
+	*p++ = CAN_CAPTURE_VERSION;
+	*p++ = CAN_CAPTURE_REC_SIZE;
+	p = can_capture_put16(p, ul_count);
+	p = can_capture_put32(p, sysclk_get_cpu_hz());
+	can_capture_put32(p, ul_lost);
+
+	return CAN_CAPTURE_HEADER_SIZE + ul_count * CAN_CAPTURE_REC_SIZE;
+}
+
+/************************************************************************/
+/*				DUMP OVER SERIAL                                        */
+/*	Writes blocks of up to CAN_CAPTURE_DUMP_RECORDS records to xPort	*/
+/*	until the ring is empty, or one ring's worth has been written if	*/
+/*	frames come in faster than the port sends them. Task context;		*/
+/*	blocks while the serial queue is full. Returns the number of		*/
+/*	records written.													*/
+/************************************************************************/
+
+uint32_t can_capture_dump(xComPortHandle xPort)
+{
+	uint32_t ul_bytes, ul_records = 0, i;
+
+	do {
+		ul_bytes = can_capture_read(uc_dump_buf, sizeof(uc_dump_buf));
+		for (i = 0; i < ul_bytes; i++)
+			xSerialPutChar(xPort, (signed char)uc_dump_buf[i], portMAX_DELAY);
+		ul_records += (ul_bytes - CAN_CAPTURE_HEADER_SIZE) / CAN_CAPTURE_REC_SIZE;
+	} while ((ul_bytes > CAN_CAPTURE_HEADER_SIZE) && (ul_records < CAN_CAPTURE_RECORDS));
+
+	return ul_records;
+}
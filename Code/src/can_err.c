@@ -0,0 +1,416 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_err.c
+	*
+	*	PURPOSE:
+	*	Follows the error state of CAN0 and CAN1 from the CAN error interrupts and
+	*	brings a controller back from bus-off without help from the application.
+	*
+	*	FILE REFERENCES:	can_err.h, task.h, timers.h
+	*
+	*	EXTERNAL VARIABLES:		can_err_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_err.h.
+	*
+	*	NOTES:
+	*	While CAN0 is bus-off, send_can_command() keeps queuing frames (it only fails
+	*	once the TX queue is full); they go out when the controller has recovered. No
+	*	application task waits on the recovery: it runs in the timer task.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					The TX hold and the reclaim now apply to whichever controller went
+	*					bus-off, since CAN1 also has TX scheduler mailboxes with the dual bus.
+	*
+	*					WARNING and PASSIVE are now re-checked from the error timer: ERRA and
+	*					WARN are both set in WARNING, so no enabled interrupt saw the return
+	*					to error active.
+	*
+	*					The error timer no longer reads CAN_SR, which clears TOVF and lost the
+	*					time-triggered cycle of CAN1: WARNING and PASSIVE are re-checked from
+	*					the error counters (CAN_ECR) and a recovery which fails is seen by the
+	*					BOFF interrupt.
+	*
+	*					The state update is split out of can_err_isr() (can_err_update()), so
+	*					the error timer no longer runs the ISR path. A timer command which does
+	*					not fit into the timer queue is posted again by the dispatch task
+	*					(can_err_service()) instead of being lost.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_err_init() is called by can_initialize() once the mailboxes are set up and
+	*	enables the error interrupts. can_err_isr() is called by can_mailbox_isr() when
+	*	one of them fires; it updates the state and, on bus-off, holds the TX scheduler
+	*	and starts the back-off timer. prvCANErrTimer() then resets the controller and,
+	*	one check period later, confirms that it has recovered. In WARNING and PASSIVE
+	*	the same timer reads the error counters every CAN_ERR_POLL_TICKS to see the way
+	*	back down.
+	*
+	*	A timer command which finds the timer queue full is posted again by the
+	*	dispatch task, through can_err_service().
+	*
+	*	Only can_err_init() and can_mailbox_isr() read CAN_SR: reading it clears TOVF,
+	*	which starts a time-triggered cycle on CAN1.
+	*
+ */
+
+#include "can_err.h"
+
+#include "task.h"
+#include "timers.h"
+
+volatile can_err_stats_t can_err_stats[2];
+
+/* Mailbox registers kept across a reset. */
+typedef struct {
+	uint32_t ul_mmr;
+	uint32_t ul_mam;
+	uint32_t ul_mid;
+} can_err_mb_save_t;
+
+static TimerHandle_t xCanErrTimer[2] = { NULL, NULL };
+static TickType_t xBusOffTick[2];
+static TickType_t xRecoveredTick[2];
+static volatile uint32_t ul_boff_again[2];		// BOFF interrupt while RECOVERING.
+static volatile TickType_t xErrRepost[2];		// Period of a timer command which failed, 0: none.
+
+static void prvCANErrTimer(TimerHandle_t xTimer);
+
+static Can *can_err_controller(uint8_t uc_ctrl)
+{
+	return (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+}
+
+static uint32_t can_err_state_of(uint32_t ul_sr)
+{
+	if (ul_sr & CAN_SR_BOFF)
+		return CAN_ERR_BUS_OFF;
+	if (ul_sr & CAN_SR_ERRP)
+		return CAN_ERR_PASSIVE;
+	if (ul_sr & CAN_SR_WARN)
+		return CAN_ERR_WARNING;
+	return CAN_ERR_ACTIVE;
+}
+
+/* The error state bits of CAN_SR, from the error counters. */
+static uint32_t can_err_counters(Can *controller)
+{
+	uint32_t ul_tec = can_get_tx_error_cnt(controller), ul_rec = can_get_rx_error_cnt(controller);
+	uint32_t ul_sr;
+
+	ul_sr = ((ul_tec >= 128) || (ul_rec >= 128)) ? CAN_SR_ERRP : CAN_SR_ERRA;
+	if ((ul_tec >= 96) || (ul_rec >= 96))
+		ul_sr |= CAN_SR_WARN;
+	return ul_sr;
+}
+
+/* Enables the error interrupts whose condition is not true in ul_sr. */
+static void can_err_arm(Can *controller, uint32_t ul_sr)
+{
+	uint32_t ul_cond = ul_sr & CAN_ERR_IRQ_MASK;
+
+	can_disable_interrupt(controller, ul_cond);
+	can_enable_interrupt(controller, CAN_ERR_IRQ_MASK & ~ul_cond);
+}
+
+/* Starts the error timer of a controller with xPeriod, from an ISR if
+*  pxHigherPriorityTaskWoken is not NULL. The timer queue may be full (the
+*  timer task runs below the CAN tasks): the command is then left to the
+*  dispatch task, which posts it again (can_err_service()). */
+static void can_err_post(uint8_t uc_ctrl, TickType_t xPeriod, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	BaseType_t xPosted;
+
+	if (!xCanErrTimer[uc_ctrl])
+		return;
+
+	if (pxHigherPriorityTaskWoken)
+		xPosted = xTimerChangePeriodFromISR(xCanErrTimer[uc_ctrl], xPeriod, pxHigherPriorityTaskWoken);
+	else
+		xPosted = xTimerChangePeriod(xCanErrTimer[uc_ctrl], xPeriod, 0);
+
+	if (xPosted == pdPASS) {
+		xErrRepost[uc_ctrl] = 0;
+		return;
+	}
+	xErrRepost[uc_ctrl] = xPeriod;
+	can_err_stats[uc_ctrl].ul_timer_retries++;
+	can_dispatch_wake(pxHigherPriorityTaskWoken);
+}
+
+/************************************************************************/
+/*				INITIALIZE THE ERROR HANDLING                           */
+/************************************************************************/
+
+void can_err_init(void)
+{
+	uint8_t i;
+	uint32_t ul_sr;
+
+	for (i = 0; i < 2; i++) {
+		memset((void *)&can_err_stats[i], 0, sizeof(can_err_stats[i]));
+		can_err_stats[i].ul_backoff = CAN_ERR_BACKOFF_MIN;
+
+		if (!xCanErrTimer[i])
+			xCanErrTimer[i] = xTimerCreate("CANER", CAN_ERR_BACKOFF_MIN, pdFALSE,
+					(void *)(uintptr_t)i, prvCANErrTimer);
+
+		ul_sr = can_get_status(can_err_controller(i));
+		can_err_stats[i].ul_state = can_err_state_of(ul_sr);
+		can_err_arm(can_err_controller(i), ul_sr);
+		xErrRepost[i] = 0;
+		if (can_err_stats[i].ul_state != CAN_ERR_ACTIVE)
+			can_err_post(i, CAN_ERR_POLL_TICKS, NULL);
+	}
+}
+
+/************************************************************************/
+/*				ERROR STATE UPDATE                                      */
+/*	Follows ul_sr (CAN_SR, or the same bits from the error counters)	*/
+/*	and returns the period the error timer has to be started with, 0	*/
+/*	if it is left alone. Called with the CAN interrupts masked: from	*/
+/*	the error interrupt or inside a critical section.					*/
+/************************************************************************/
+
+static TickType_t can_err_update(uint8_t uc_ctrl, uint32_t ul_sr)
+{
+	volatile can_err_stats_t *p_stats = &can_err_stats[uc_ctrl];
+	Can *controller = can_err_controller(uc_ctrl);
+	uint32_t ul_state;
+	TickType_t xNow;
+
+	/* The recovery owns the controller until it is error active again. */
+	if ((p_stats->ul_state == CAN_ERR_BUS_OFF) || (p_stats->ul_state == CAN_ERR_RECOVERING)) {
+		if (ul_sr & CAN_SR_BOFF)
+			ul_boff_again[uc_ctrl] = 1;			// The recovery failed.
+		can_disable_interrupt(controller, CAN_ERR_IRQ_MASK);
+		return 0;
+	}
+
+	ul_state = can_err_state_of(ul_sr);
+	if (ul_state != p_stats->ul_state) {
+		if (ul_state == CAN_ERR_WARNING)
+			p_stats->ul_warnings++;
+		else if (ul_state == CAN_ERR_PASSIVE)
+			p_stats->ul_passive++;
+		else if (ul_state == CAN_ERR_BUS_OFF)
+			p_stats->ul_bus_off++;
+	}
+	p_stats->ul_state = ul_state;
+
+	if (ul_state != CAN_ERR_BUS_OFF) {
+		can_err_arm(controller, ul_sr);
+		/* No interrupt tells WARNING from ACTIVE on the way down (ERRA is set in
+		*  both), so the timer looks again. */
+		return (ul_state != CAN_ERR_ACTIVE) ? CAN_ERR_POLL_TICKS : 0;
+	}
+
+	can_disable_interrupt(controller, CAN_ERR_IRQ_MASK);
+	can_tx_hold(uc_ctrl, 1);
+
+	/* A bus which fails again soon after a recovery gets a longer back-off. */
+	xNow = xTaskGetTickCountFromISR();
+	if (p_stats->ul_recoveries && ((xNow - xRecoveredTick[uc_ctrl]) < CAN_ERR_STABLE_TICKS))
+		p_stats->ul_backoff = (p_stats->ul_backoff * 2 > CAN_ERR_BACKOFF_MAX) ? CAN_ERR_BACKOFF_MAX
+				: p_stats->ul_backoff * 2;
+	else
+		p_stats->ul_backoff = CAN_ERR_BACKOFF_MIN;
+	xBusOffTick[uc_ctrl] = xNow;
+	return p_stats->ul_backoff;
+}
+
+/************************************************************************/
+/*				ERROR INTERRUPT                                         */
+/*	ul_sr is the CAN_SR value already read by can_mailbox_isr(). The	*/
+/*	caller does portEND_SWITCHING_ISR().								*/
+/************************************************************************/
+
+void can_err_isr(uint8_t uc_ctrl, uint32_t ul_sr, BaseType_t *pxHigherPriorityTaskWoken)
+{
+	TickType_t xPeriod = can_err_update(uc_ctrl, ul_sr);
+
+	if (xPeriod)
+		can_err_post(uc_ctrl, xPeriod, pxHigherPriorityTaskWoken);
+}
+
+/************************************************************************/
+/*				RESET A CONTROLLER                                      */
+/*	Timer task context. Takes the unsent frames back into the TX queue,	*/
+/*	then resets the controller and restores every mailbox, the mode		*/
+/*	bits and the interrupt mask as they were.							*/
+/************************************************************************/
+
+static void can_err_reset(uint8_t uc_ctrl)
+{
+	Can *controller = can_err_controller(uc_ctrl);
+	can_err_mb_save_t save[CANMB_NUMBER];
+	uint32_t ul_imr, ul_mr, ul_mot;
+	uint8_t i;
+
+	can_err_stats[uc_ctrl].ul_lost_frames += can_tx_reclaim(uc_ctrl);
+
+	taskENTER_CRITICAL();
+	ul_imr = can_get_interrupt_mask(controller);
+	ul_mr = controller->CAN_MR & (CAN_MR_TTM | CAN_MR_TEOF | CAN_MR_TIMFRZ);
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		save[i].ul_mmr = controller->CAN_MB[i].CAN_MMR;
+		save[i].ul_mam = controller->CAN_MB[i].CAN_MAM;
+		save[i].ul_mid = controller->CAN_MB[i].CAN_MID;
+	}
+	can_disable_interrupt(controller, ul_imr);
+
+	can_disable(controller);
+	can_reset_all_mailbox(controller);
+
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		controller->CAN_MB[i].CAN_MAM = save[i].ul_mam;
+		controller->CAN_MB[i].CAN_MID = save[i].ul_mid;
+		controller->CAN_MB[i].CAN_MMR = save[i].ul_mmr;
+
+		/* Reception mailboxes only accept a frame once MTCR is set. */
+		ul_mot = save[i].ul_mmr & CAN_MMR_MOT_Msk;
+		if ((ul_mot == CAN_MMR_MOT_MB_RX) || (ul_mot == CAN_MMR_MOT_MB_RX_OVERWRITE))
+			controller->CAN_MB[i].CAN_MCR = CAN_MCR_MTCR;
+	}
+	controller->CAN_MR |= ul_mr;
+
+	/* Only BOFF while RECOVERING: it tells the check the reset did not help. */
+	ul_boff_again[uc_ctrl] = 0;
+	can_enable(controller);
+	can_enable_interrupt(controller, (ul_imr & ~CAN_ERR_IRQ_MASK) | CAN_IER_BOFF);
+	can_err_stats[uc_ctrl].ul_resets++;
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				RECOVERY TIMER                                          */
+/*	Runs once per back-off (BUS_OFF: reset the controller), once per	*/
+/*	check period (RECOVERING: confirm the controller left bus-off) and	*/
+/*	every CAN_ERR_POLL_TICKS in WARNING and PASSIVE (read the state		*/
+/*	again, as the error interrupt would). Reads CAN_ECR, never CAN_SR.	*/
+/************************************************************************/
+
+static void prvCANErrTimer(TimerHandle_t xTimer)
+{
+	uint8_t uc_ctrl = (uint8_t)(uintptr_t)pvTimerGetTimerID(xTimer);
+	volatile can_err_stats_t *p_stats = &can_err_stats[uc_ctrl];
+	Can *controller = can_err_controller(uc_ctrl);
+	uint32_t ul_sr, ul_ticks;
+	TickType_t xPeriod;
+
+	if ((p_stats->ul_state == CAN_ERR_WARNING) || (p_stats->ul_state == CAN_ERR_PASSIVE)) {
+		taskENTER_CRITICAL();
+		xPeriod = can_err_update(uc_ctrl, can_err_counters(controller));
+		taskEXIT_CRITICAL();
+		if (xPeriod)
+			can_err_post(uc_ctrl, xPeriod, NULL);
+		return;
+	}
+
+	if (p_stats->ul_state == CAN_ERR_BUS_OFF) {
+		can_err_reset(uc_ctrl);
+		p_stats->ul_state = CAN_ERR_RECOVERING;
+		can_err_post(uc_ctrl, CAN_ERR_CHECK_TICKS, NULL);
+		return;
+	}
+
+	if (p_stats->ul_state != CAN_ERR_RECOVERING)
+		return;
+
+	if (ul_boff_again[uc_ctrl]) {
+		p_stats->ul_backoff = (p_stats->ul_backoff * 2 > CAN_ERR_BACKOFF_MAX) ? CAN_ERR_BACKOFF_MAX
+				: p_stats->ul_backoff * 2;
+		p_stats->ul_state = CAN_ERR_BUS_OFF;
+		can_err_post(uc_ctrl, p_stats->ul_backoff, NULL);
+		return;
+	}
+
+	xRecoveredTick[uc_ctrl] = xTaskGetTickCount();
+	ul_ticks = xRecoveredTick[uc_ctrl] - xBusOffTick[uc_ctrl];
+	p_stats->ul_last_recovery = ul_ticks;
+	if (ul_ticks > p_stats->ul_max_recovery)
+		p_stats->ul_max_recovery = ul_ticks;
+	p_stats->ul_recoveries++;
+
+	taskENTER_CRITICAL();
+	ul_sr = can_err_counters(controller);
+	p_stats->ul_state = can_err_state_of(ul_sr);
+	can_err_arm(controller, ul_sr);
+	taskEXIT_CRITICAL();
+	if (p_stats->ul_state != CAN_ERR_ACTIVE)
+		can_err_post(uc_ctrl, CAN_ERR_POLL_TICKS, NULL);
+
+	can_tx_hold(uc_ctrl, 0);			// Replays the queue.
+}
+
+/************************************************************************/
+/*				POST THE TIMER AGAIN                                    */
+/*	Dispatch task context. Posts the timer commands which did not fit	*/
+/*	into the timer queue. Returns the ticks until it wants to try		*/
+/*	again, portMAX_DELAY if nothing is left.							*/
+/************************************************************************/
+
+TickType_t can_err_service(void)
+{
+	TickType_t xPeriod, xWait = portMAX_DELAY;
+	uint8_t i;
+
+	for (i = 0; i < 2; i++) {
+		taskENTER_CRITICAL();
+		xPeriod = xErrRepost[i];
+		xErrRepost[i] = 0;
+		taskEXIT_CRITICAL();
+		if (!xPeriod)
+			continue;
+
+		can_err_post(i, xPeriod, NULL);
+		if (xErrRepost[i])
+			xWait = 1;						// The timer queue is still full.
+	}
+	return xWait;
+}
+
+/************************************************************************/
+/*				ERROR STATE                                             */
+/************************************************************************/
+
+uint32_t can_err_state(uint8_t uc_ctrl)
+{
+	if (uc_ctrl > CAN_CTRL_1)
+		return CAN_ERR_BUS_OFF;
+	return can_err_stats[uc_ctrl].ul_state;
+}
+
+#if CAN_ERR_FAULT_INJECTION
+/************************************************************************/
+/*				INJECT A BUS-OFF                                        */
+/*	Enters the bus-off path as if the BOFF interrupt had fired. The		*/
+/*	recovery then runs as usual and finds the controller error active.	*/
+/************************************************************************/
+
+void can_err_inject_bus_off(uint8_t uc_ctrl)
+{
+	TickType_t xPeriod;
+
+	if (uc_ctrl > CAN_CTRL_1)
+		return;
+
+	taskENTER_CRITICAL();
+	xPeriod = can_err_update(uc_ctrl, CAN_SR_BOFF);
+	taskEXIT_CRITICAL();
+	if (xPeriod)
+		can_err_post(uc_ctrl, xPeriod, NULL);
+}
+#endif
@@ -0,0 +1,116 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_err.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the CAN error-state machine and bus-off recovery
+	*	in can_err.c.
+	*
+	*	FILE REFERENCES:	can_func.h, FreeRTOS.h
+	*
+	*	EXTERNAL VARIABLES:		can_err_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The recovery runs in the FreeRTOS timer task, so configUSE_TIMERS must be 1.
+	*	can_err_isr() is called from can_mailbox_isr(), which has read CAN_SR, and from
+	*	the error timer with the state bits built from CAN_ECR.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					The error timer reads the state from CAN_ECR instead of CAN_SR.
+	*
+	*					Added can_err_service() and ul_timer_retries. CAN_ERR_FAULT_INJECTION
+	*					can be set from the build.
+	*
+*/
+
+#ifndef CAN_ERR_H
+#define CAN_ERR_H
+
+#include "FreeRTOS.h"
+#include "can_func.h"
+
+/* Set to 1 to build can_err_inject_bus_off(), which takes a controller through the
+*  bus-off recovery without a fault on the bus. */
+#ifndef CAN_ERR_FAULT_INJECTION
+#define CAN_ERR_FAULT_INJECTION		0
+#endif
+
+/*		ERROR STATES
+	ACTIVE, WARNING (TEC or REC >= 96) and PASSIVE (>= 128) follow the controller.
+	BUS_OFF is entered from the BOFF interrupt: the TX scheduler is held (frames are
+	still accepted into the queue) and a recovery is started after the back-off.
+	The recovery takes the frames still in the transmit mailboxes back into the
+	queue, saves the configuration of every mailbox, resets and re-enables the
+	controller and writes the configuration back. The controller is RECOVERING
+	until it is seen error active again, then the TX hold is released and the
+	queue is replayed. If it is still bus-off the back-off is doubled and the
+	reset is repeated.
+
+	Only the conditions which are not true at the moment are enabled as interrupts
+	(the status bits are levels), so each change of state up gives one interrupt.
+	The way down from WARNING gives none (ERRA stays set, WARN only clears), so in
+	WARNING and PASSIVE the error timer reads the error counters every
+	CAN_ERR_POLL_TICKS. It does not read CAN_SR, which would clear TOVF.
+
+	The timer commands go through the timer queue (configTIMER_QUEUE_LENGTH), and
+	the timer task runs below the CAN tasks, so the queue can be full when an error
+	interrupt posts one. A command which fails is kept and posted again by the
+	dispatch task (can_err_service()), every tick until it fits: without it a
+	bus-off would keep the TX hold for good, a WARNING would never come down.
+*/
+#define CAN_ERR_ACTIVE				0
+#define CAN_ERR_WARNING				1
+#define CAN_ERR_PASSIVE				2
+#define CAN_ERR_BUS_OFF				3
+#define CAN_ERR_RECOVERING			4
+
+#define CAN_ERR_IRQ_MASK			( CAN_IER_ERRA | CAN_IER_WARN | CAN_IER_ERRP | CAN_IER_BOFF )
+
+/* Back-off before a reset, in ticks (100 ms). It is doubled, up to the maximum,
+*  when a controller goes bus-off again within CAN_ERR_STABLE_TICKS of a recovery. */
+#define CAN_ERR_BACKOFF_MIN			1
+#define CAN_ERR_BACKOFF_MAX			32
+#define CAN_ERR_STABLE_TICKS		50
+#define CAN_ERR_CHECK_TICKS			1		// From a reset to checking the bus state.
+#define CAN_ERR_POLL_TICKS			5		// State re-read in WARNING and PASSIVE.
+
+typedef struct {
+	uint32_t ul_state;				/**< CAN_ERR_* */
+	uint32_t ul_warnings;			/**< Entries into each state. */
+	uint32_t ul_passive;
+	uint32_t ul_bus_off;
+	uint32_t ul_resets;				/**< Controller resets, including repeated ones. */
+	uint32_t ul_recoveries;			/**< Bus-off events which ended error active. */
+	uint32_t ul_lost_frames;		/**< Frames which could not be put back into the TX queue. */
+	uint32_t ul_last_recovery;		/**< Ticks from bus-off to error active, last recovery. */
+	uint32_t ul_max_recovery;
+	uint32_t ul_backoff;			/**< Current back-off, ticks. */
+	uint32_t ul_timer_retries;		/**< Timer commands left to the dispatch task (queue full). */
+} can_err_stats_t;
+
+extern volatile can_err_stats_t can_err_stats[2];
+
+void can_err_init(void);
+void can_err_isr(uint8_t uc_ctrl, uint32_t ul_sr, BaseType_t *pxHigherPriorityTaskWoken);
+TickType_t can_err_service(void);
+uint32_t can_err_state(uint8_t uc_ctrl);											// API Function.
+#if CAN_ERR_FAULT_INJECTION
+void can_err_inject_bus_off(uint8_t uc_ctrl);										// API Function.
+#endif
+
+#endif /* CAN_ERR_H */
@@ -0,0 +1,303 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_filter.c
+	*
+	*	PURPOSE:		
+	*	Works out the ID/mask settings of the reception mailboxes from the list of IDs
+	*	the OBC subscribes to, so that unwanted frames are refused by the CAN controller
+	*	instead of being read and thrown away in software.
+	*
+	*	FILE REFERENCES:	can_filter.h
+	*
+	*	EXTERNAL VARIABLES:		can_rx_fifo_mask
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: 
+	*	can_filter_plan() returns 0 if the subscription list is empty or too fragmented.
+	*	can_filter_plan_except() also returns 0 if the filters cannot be merged down to the
+	*	mailboxes without accepting an excluded ID.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None.
+	*
+	*	NOTES:	
+	*	The planner runs during initialization and when can_guard.c re-plans a controller
+	*	without a babbling node, from the dispatch task; nothing here is on the RX path.
+	*	
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:			
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and 
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:		
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		can_filter_apply() can give each filter several mailboxes which the RX
+	*					handler drains as a receive FIFO (can_rx_fifo_mask).
+	*
+	*	10/17/2026		Added can_filter_plan_except() and can_filter_subtract(), which plan a
+	*					subscription list without the IDs of some nodes (can_guard.c).
+	*
+	*	DESCRIPTION:	
+	*
+	*	1. Every range is split into the smallest set of aligned power-of-two blocks,
+	*	   each of which is exactly one ID/mask pair. This cover has no false accepts.
+	*	2. While there are more blocks than mailboxes, the two blocks whose common
+	*	   ID/mask pair adds the fewest extra IDs are merged, and any block the merged
+	*	   one already covers is dropped.
+	*	   With exclusions (can_filter_plan_except()), a merge whose ID/mask pair
+	*	   would accept an excluded ID is never made.
+	*	3. The result is checked against all 2048 standard IDs to count the IDs that
+	*	   are accepted but were never subscribed to.
+	*	
+ */
+
+#include "can_filter.h"
+
+uint32_t can_rx_fifo_mask[2];
+
+/* Number of IDs accepted by a mask (2 ^ number of don't-care bits). */
+static uint32_t can_filter_size(uint16_t us_mask)
+{
+	return 1u << (11 - __builtin_popcount(us_mask & CAN_STD_ID_MASK));
+}
+
+static uint32_t can_filter_match(const can_filter_t *p_filter, uint32_t ul_id)
+{
+	return (ul_id & p_filter->us_mask) == p_filter->us_id;
+}
+
+/* 1 if some ID is accepted by p_filter and matches one of the ul_count
+*  ID/mask pairs of p_except. */
+static uint32_t can_filter_excluded(const can_filter_t *p_filter, const can_filter_t *p_except, uint32_t ul_count)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_count; i++) {
+		if (!((p_filter->us_id ^ p_except[i].us_id) & p_filter->us_mask & p_except[i].us_mask))
+			return 1;
+	}
+	return 0;
+}
+
+/************************************************************************/
+/*				SPLIT A RANGE INTO ALIGNED BLOCKS                       */
+/*	Appends the blocks for [first, last] to p_blocks. Returns the new	*/
+/*	block count, or 0 if CAN_FILTER_MAX_BLOCKS would be exceeded.		*/
+/************************************************************************/
+
+static uint32_t can_filter_split(uint32_t ul_first, uint32_t ul_last, can_filter_t *p_blocks, uint32_t ul_n)
+{
+	uint32_t ul_size;
+
+	while (ul_first <= ul_last) {
+		/* Largest block that starts at ul_first and still fits in the range. */
+		ul_size = ul_first ? (ul_first & -ul_first) : CAN_STD_ID_COUNT;
+		while (ul_first + ul_size - 1 > ul_last)
+			ul_size >>= 1;
+
+		if (ul_n >= CAN_FILTER_MAX_BLOCKS)
+			return 0;
+		p_blocks[ul_n].us_id = (uint16_t)ul_first;
+		p_blocks[ul_n].us_mask = (uint16_t)(CAN_STD_ID_MASK & ~(ul_size - 1));
+		ul_n++;
+		ul_first += ul_size;
+	}
+	return ul_n;
+}
+
+/************************************************************************/
+/*				PLAN THE MAILBOX FILTERS                                */
+/*	p_ranges:		IDs the OBC subscribes to.							*/
+/*	ul_max_filters:	Mailboxes available (at most CANMB_NUMBER).			*/
+/*	Fills *p_plan and returns 1, or returns 0 on bad input.				*/
+/************************************************************************/
+
+uint32_t can_filter_plan(const can_id_range_t *p_ranges, uint32_t ul_count, uint32_t ul_max_filters,
+		can_filter_plan_t *p_plan)
+{
+	return can_filter_plan_except(p_ranges, ul_count, NULL, 0, ul_max_filters, p_plan);
+}
+
+/************************************************************************/
+/*				PLAN WITHOUT SOME IDS                                   */
+/*	As can_filter_plan(), but no filter may accept an ID which matches	*/
+/*	one of the ul_except ID/mask pairs of p_except. The ranges must		*/
+/*	not contain such IDs (see can_filter_subtract()). Returns 0 if the	*/
+/*	filters cannot be merged down to ul_max_filters without one.		*/
+/************************************************************************/
+
+uint32_t can_filter_plan_except(const can_id_range_t *p_ranges, uint32_t ul_count, const can_filter_t *p_except,
+		uint32_t ul_except, uint32_t ul_max_filters, can_filter_plan_t *p_plan)
+{
+	can_filter_t blocks[CAN_FILTER_MAX_BLOCKS], merged;
+	uint32_t ul_n = 0, i, j, k, ul_cost, ul_best_cost, ul_best_i = 0, ul_best_j = 0, ul_id;
+	uint32_t ul_accept, ul_want;
+
+	if (!ul_count || !ul_max_filters)
+		return 0;
+	if (ul_max_filters > CANMB_NUMBER)
+		ul_max_filters = CANMB_NUMBER;
+
+	/* 1. Exact cover. */
+	for (i = 0; i < ul_count; i++) {
+		if ((p_ranges[i].us_first > p_ranges[i].us_last) || (p_ranges[i].us_last > CAN_STD_ID_MASK))
+			return 0;
+		ul_n = can_filter_split(p_ranges[i].us_first, p_ranges[i].us_last, blocks, ul_n);
+		if (!ul_n)
+			return 0;
+	}
+	for (i = 0; i < ul_n; i++) {
+		if (can_filter_excluded(&blocks[i], p_except, ul_except))
+			return 0;
+	}
+
+	/* 2. Greedy merge down to the number of mailboxes. */
+	while (ul_n > ul_max_filters) {
+		ul_best_cost = 0xFFFFFFFF;
+		for (i = 0; i < ul_n; i++) {
+			for (j = i + 1; j < ul_n; j++) {
+				merged.us_mask = blocks[i].us_mask & blocks[j].us_mask & ~(blocks[i].us_id ^ blocks[j].us_id);
+				merged.us_id = blocks[i].us_id & merged.us_mask;
+				if (can_filter_excluded(&merged, p_except, ul_except))
+					continue;
+				ul_cost = can_filter_size(merged.us_mask) - can_filter_size(blocks[i].us_mask)
+						- can_filter_size(blocks[j].us_mask);
+				if ((int32_t)ul_cost < 0)
+					ul_cost = 0;	// The two blocks overlapped.
+				if (ul_cost < ul_best_cost) {
+					ul_best_cost = ul_cost;
+					ul_best_i = i;
+					ul_best_j = j;
+				}
+			}
+		}
+		if (ul_best_cost == 0xFFFFFFFF)
+			return 0;		// Every merge would let an excluded ID in.
+
+		merged.us_mask = blocks[ul_best_i].us_mask & blocks[ul_best_j].us_mask
+				& ~(blocks[ul_best_i].us_id ^ blocks[ul_best_j].us_id) & CAN_STD_ID_MASK;
+		merged.us_id = blocks[ul_best_i].us_id & merged.us_mask;
+		blocks[ul_best_i] = merged;
+
+		/* Drop the other half and everything the merged block now covers. */
+		for (i = 0, k = 0; i < ul_n; i++) {
+			if ((i != ul_best_i) && ((blocks[i].us_mask & merged.us_mask) == merged.us_mask)
+					&& ((blocks[i].us_id & merged.us_mask) == merged.us_id))
+				continue;
+			blocks[k++] = blocks[i];
+		}
+		ul_n = k;
+	}
+
+	/* 3. Count what the plan really lets through. */
+	p_plan->uc_count = (uint8_t)ul_n;
+	for (i = 0; i < ul_n; i++)
+		p_plan->filters[i] = blocks[i];
+	p_plan->us_wanted = 0;
+	p_plan->us_accepted = 0;
+	p_plan->us_false_accepts = 0;
+
+	for (ul_id = 0; ul_id < CAN_STD_ID_COUNT; ul_id++) {
+		ul_want = 0;
+		for (i = 0; i < ul_count; i++) {
+			if ((ul_id >= p_ranges[i].us_first) && (ul_id <= p_ranges[i].us_last)) {
+				ul_want = 1;
+				break;
+			}
+		}
+		ul_accept = 0;
+		for (i = 0; i < ul_n; i++) {
+			if (can_filter_match(&blocks[i], ul_id)) {
+				ul_accept = 1;
+				break;
+			}
+		}
+		p_plan->us_wanted += ul_want;
+		p_plan->us_accepted += ul_accept;
+		if (ul_accept && !ul_want)
+			p_plan->us_false_accepts++;
+	}
+
+	return 1;
+}
+
+/************************************************************************/
+/*				REMOVE IDS FROM A SUBSCRIPTION LIST                     */
+/*	Writes to p_out the ranges of p_ranges without the IDs which match	*/
+/*	one of the ul_except ID/mask pairs of p_except. Returns the number	*/
+/*	of ranges written, or 0 if none is left or more than ul_max would	*/
+/*	be needed.															*/
+/************************************************************************/
+
+uint32_t can_filter_subtract(const can_id_range_t *p_ranges, uint32_t ul_count, const can_filter_t *p_except,
+		uint32_t ul_except, can_id_range_t *p_out, uint32_t ul_max)
+{
+	can_filter_t id;
+	uint32_t ul_n = 0, ul_open = 0, ul_id, i;
+
+	id.us_mask = CAN_STD_ID_MASK;
+	for (i = 0; i < ul_count; i++) {
+		for (ul_id = p_ranges[i].us_first; ul_id <= p_ranges[i].us_last; ul_id++) {
+			id.us_id = (uint16_t)ul_id;
+			if (can_filter_excluded(&id, p_except, ul_except)) {
+				ul_open = 0;
+				continue;
+			}
+			if (ul_open && ((uint32_t)p_out[ul_n - 1].us_last + 1u == ul_id)) {
+				p_out[ul_n - 1].us_last = (uint16_t)ul_id;
+				continue;
+			}
+			if (ul_n >= ul_max)
+				return 0;
+			p_out[ul_n].us_first = (uint16_t)ul_id;
+			p_out[ul_n].us_last = (uint16_t)ul_id;
+			ul_n++;
+			ul_open = 1;
+		}
+		ul_open = 0;
+	}
+
+	return ul_n;
+}
+
+/************************************************************************/
+/*				LOAD A PLAN INTO THE MAILBOXES                          */
+/*	Claims uc_depth mailboxes per filter from uc_first_mb on for		*/
+/*	uc_owner, sets them up as reception mailboxes and enables their		*/
+/*	interrupts. With uc_depth > 1 the mailboxes of a filter form a		*/
+/*	receive FIFO (see can_filter.h).									*/
+/*	Returns 0 if any of them could not be claimed.						*/
+/************************************************************************/
+
+uint32_t can_filter_apply(Can *controller, const can_filter_plan_t *p_plan, uint8_t uc_first_mb, uint8_t uc_depth,
+		uint8_t uc_owner)
+{
+	can_mb_conf_t mailbox;
+	uint8_t i, j, uc_mb = uc_first_mb;
+
+	if (!uc_depth || (uc_first_mb + p_plan->uc_count * uc_depth > CANMB_NUMBER))
+		return 0;
+
+	for (i = 0; i < p_plan->uc_count; i++) {
+		for (j = 0; j < uc_depth; j++, uc_mb++) {
+			if (!can_mailbox_claim(controller, uc_mb, uc_owner))
+				return 0;
+			reset_mailbox_conf(&mailbox);
+			mailbox.ul_mb_idx = uc_mb;
+			/* The last mailbox of a FIFO keeps the newest frame when all are full. */
+			mailbox.uc_obj_type = ((uc_depth > 1) && (j == uc_depth - 1)) ? CAN_MB_RX_OVER_WR_MODE : CAN_MB_RX_MODE;
+			mailbox.ul_id_msk = CAN_MID_MIDvA(p_plan->filters[i].us_mask) | CAN_MID_MIDvB_Msk;	// Standard frames only.
+			mailbox.ul_id = CAN_MID_MIDvA(p_plan->filters[i].us_id);
+			can_mailbox_setup(controller, &mailbox, uc_owner);
+
+			if (uc_depth > 1)
+				can_rx_fifo_mask[CAN_CTRL_INDEX(controller)] |= (1u << uc_mb);
+			can_enable_interrupt(controller, (1u << uc_mb));
+		}
+	}
+
+	return 1;
+}
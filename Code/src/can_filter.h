@@ -0,0 +1,104 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_filter.h
+	*
+	*	PURPOSE:		
+	*	Definitions and prototypes for the acceptance filter planner in can_filter.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_rx_plan, can_rx_pdo_plan, can_rx_fifo_mask
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	Standard (11-bit) identifiers only.
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Added receive FIFOs (uc_depth of can_filter_apply()).
+	*
+	*	10/17/2026		Added can_rx_pdo_plan.
+	*
+	*	10/17/2026		Added can_filter_plan_except() and can_filter_subtract().
+	*
+*/
+
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include "can_func.h"
+
+#define CAN_STD_ID_COUNT		2048
+#define CAN_STD_ID_MASK			0x7FF
+
+/* Largest number of ID/mask blocks the planner works with before merging.
+*  A range decomposes into at most 20 aligned blocks. */
+#define CAN_FILTER_MAX_BLOCKS	64
+
+/* Inclusive range of standard IDs, use us_first == us_last for a single ID. */
+typedef struct {
+	uint16_t us_first;
+	uint16_t us_last;
+} can_id_range_t;
+
+/* One mailbox filter: a frame is accepted if (ID & us_mask) == us_id. */
+typedef struct {
+	uint16_t us_id;
+	uint16_t us_mask;
+} can_filter_t;
+
+typedef struct {
+	uint8_t uc_count;					/**< Filters (= mailboxes) used. */
+	can_filter_t filters[CANMB_NUMBER];
+	uint16_t us_wanted;					/**< IDs subscribed to. */
+	uint16_t us_accepted;				/**< IDs the filters let through. */
+	uint16_t us_false_accepts;			/**< Accepted IDs which nobody subscribed to. */
+} can_filter_plan_t;
+
+/* False-accept rate of a plan in parts per thousand of the accepted IDs. */
+#define CAN_FILTER_FALSE_RATE(p_plan)	( ( p_plan )->us_accepted ? \
+		( ( uint32_t )( p_plan )->us_false_accepts * 1000 / ( p_plan )->us_accepted ) : 0 )
+
+/* Plans loaded into the driver's reception mailboxes, indexed by CAN_CTRL_0/1,
+*  and the plan of the process-data mailbox (CAN0_PDO_RX_MB). */
+extern can_filter_plan_t can_rx_plan[2];
+extern can_filter_plan_t can_rx_pdo_plan;
+
+/*		RECEIVE FIFO
+	A single reception mailbox holds one frame: a second frame which passes the
+	same filter before the handler has read the first is lost. can_filter_apply()
+	can instead give every filter uc_depth mailboxes with the same ID and mask.
+	The controller stores a frame in the lowest-numbered of them which is empty,
+	so a burst of up to uc_depth frames is held without loss; the last mailbox is
+	in overwrite mode, so beyond that the newest frame is kept and the loss is
+	flagged (CAN_MAILBOX_RX_OVER). The mailbox numbers say nothing about the
+	order once the lower ones have been emptied and refilled, so the RX handler
+	reads all full FIFO mailboxes of a controller (can_rx_fifo_mask) and passes
+	them on oldest first, by the age of their MTIMESTAMP.
+*/
+
+/* Reception mailboxes of each controller which are part of a FIFO. */
+extern uint32_t can_rx_fifo_mask[2];
+
+uint32_t can_filter_plan(const can_id_range_t *p_ranges, uint32_t ul_count, uint32_t ul_max_filters,
+		can_filter_plan_t *p_plan);
+uint32_t can_filter_plan_except(const can_id_range_t *p_ranges, uint32_t ul_count, const can_filter_t *p_except,
+		uint32_t ul_except, uint32_t ul_max_filters, can_filter_plan_t *p_plan);
+uint32_t can_filter_subtract(const can_id_range_t *p_ranges, uint32_t ul_count, const can_filter_t *p_except,
+		uint32_t ul_except, can_id_range_t *p_out, uint32_t ul_max);
+uint32_t can_filter_apply(Can *controller, const can_filter_plan_t *p_plan, uint8_t uc_first_mb, uint8_t uc_depth,
+		uint8_t uc_owner);
+
+#endif /* CAN_FILTER_H */
@@ -10,7 +10,7 @@
 	*
 	*	FILE REFERENCES:	can_func.h
 	*
-	*	EXTERNAL VARIABLES:		g_ul_recv_status  (= 1 when a message was received)
+	*	EXTERNAL VARIABLES:		can_rx_stats	  (RX ring and ISR timing statistics)
 	*
 	*	EXTERNAL REFERENCES:	Same a File References.
 	*
@@ -18,7 +18,7 @@
 	*
 	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None
 	*
-	*	NOTES:	 READ THE COMMENTS WITHIN SEND_COMMAND()!!!
+	*	NOTES:	 send_can_command() only queues the frame, see the TX SCHEDULER section.
 	*	
 	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:			
 	*	New tasks should be written to use as much of CMSIS as possible. The ASF and 
@@ -45,80 +45,1318 @@
 	*					housekeeping test program. It takes the ID of the node in interest and requests
 	*					housekeeping from it through the CAN0 MB6 (which is in consumer mode).
 	*
+	*	10/17/2026		The CAN handlers no longer decode messages. They copy the ready mailbox into
+	*					the RX ring and wake prvCANDispatchTask, which calls decode_can_msg() at task
+	*					level. The handlers no longer touch can0_mailbox/can1_mailbox either.
+	*
+	*					can_rx_isr() now reads CAN_SR once and services every ready mailbox in
+	*					one interrupt entry instead of stopping at the first MRDY.
+	*
+	*					Added the TX scheduler. send_can_command() and request_housekeeping() now
+	*					queue their frame by priority and return immediately; the TX mailboxes
+	*					(CAN0 MB6-MB7) are refilled from the TX-complete interrupt. can_rx_isr() was renamed to
+	*					can_mailbox_isr() since it now services both directions.
+	*
+	*					Removed the can0_mailbox/can1_mailbox globals together with
+	*					save_can_object() and restore_can_object(). Every function now uses its
+	*					own stack-local can_mb_conf_t, and mailboxes are claimed per owner through
+	*					can_mailbox_claim() before they are configured or written.
+	*
+	*					request_housekeeping() moved to can_hk.c. HK_RETURNED frames are now
+	*					passed to can_hk_reply() so the requesting task gets the data.
+	*
+	*					decode_can_msg() now looks the opcode up in can_dispatch_table instead of
+	*					testing it against every opcode, so each frame runs exactly one handler.
+	*					can_register_handler() lets other modules add opcodes.
+	*
+	*					Dispatch entries carry a mask so that can_register_prefix_handler() can
+	*					claim a whole top byte (used by the transport layer in can_transport.c).
+	*					Added can_tx_pending().
+	*
+	*					The reception mailboxes are now set up from can0_subscriptions and
+	*					can1_subscriptions by the filter planner instead of by hand.
+	*
+	*					Every frame received or sent is now counted by can_stats.c. The RX ring
+	*					and the TX pool carry a cycle stamp so the RX and TX latencies can be
+	*					recorded.
+	*
+	*					Frames now carry the hardware timestamp from MSR.MTIMESTAMP. Transmitted
+	*					frames are handed, with their timestamp, to the hooks registered with
+	*					can_register_tx_hook().
+	*
+	*					The CAN1 timer overflow starts a cycle of the time-triggered schedule
+	*					(can_tt.c) when one is running.
+	*
+	*					Added mailbox-bound handlers (can_register_mb_handler()).
+	*
+	*					The CAN0 subscriptions and the command_out()/command_in() test frames
+	*					now use IDs built with CAN_ID().
+	*
+	*					Added extended frames: send_can_ext() queues a frame with a 29-bit routing
+	*					ID and a per-destination sequence number, CAN0 MB5 receives the extended
+	*					frames addressed to the OBC and decode_can_msg() dispatches them by type.
+	*
+	*					The CAN error interrupts are passed to can_err.c, which drives the bus-off
+	*					recovery. The TX scheduler can be held while CAN0 is bus-off and gives the
+	*					frames stuck in its mailboxes back to the queue (can_tx_reclaim()). The
+	*					dispatch task runs can_err_service(), woken by can_dispatch_wake().
+	*
+	*					command_out() no longer spins on g_ul_recv_status (which was removed):
+	*					it arms a waiter with can_ack_arm() and blocks on it with a timeout until
+	*					the dispatch task sees the COMMAND_OUT reply. command_in(), which runs in
+	*					the dispatch task, only sends its reply and returns. Both return a
+	*					CAN_CMD_* result instead of hanging, claim their mailboxes as
+	*					CAN_OWNER_COMMAND and give them all back on every error and when the
+	*					answer arrives.
+	*
+	*					Added redundant dual-bus operation (can_dual.c, CAN_DUAL_BUS_ENABLE): the
+	*					TX scheduler routes each priority level to CAN0 or CAN1 and fails over
+	*					when a bus degrades; CAN1 then gets the CAN0 reception mailboxes and
+	*					decode_can_msg() drops the copies of frames seen on both buses.
+	*
+	*					Every frame read from a mailbox or sent by the TX scheduler is passed to
+	*					the frame capture (can_capture.c), which records it while it is started.
+	*
+	*					The RX handler and the TX scheduler copy frames to and from the mailboxes
+	*					with can_mb_read_frame() / can_mb_write_frame() instead of going through
+	*					can_mb_conf_t and can_mailbox_read() / can_mailbox_write().
+	*					can_mb_bench() compares the two (CAN_MB_BENCH).
+	*
+	*					The reception mailboxes of each filter can be a receive FIFO
+	*					(CAN0_RX_FIFO_DEPTH, CAN1_RX_FIFO_DEPTH); the RX handler drains FIFO
+	*					mailboxes oldest frame first.
+	*
+	*					Added the adaptive interrupt / polling receive mode (can_poll.c,
+	*					CAN_POLL_ENABLE). can_mailbox_isr() also services the polled reception
+	*					mailboxes, returns the frames it read and can be run from TC0 through
+	*					can_rx_poll().
+	*
+	*					Every frame from a reception mailbox of the driver is charged to its
+	*					source node (can_guard.c). A frame over the node's budget is dropped and
+	*					its mailbox released; over the controller's budget the mailbox is
+	*					isolated, which can_mailbox_isr() then skips until the cooldown ends.
+	*
+	*					can_init_mailboxes() starts the node heartbeat service (can_nmt.c).
+	*
+	*					CAN0 subscribes to the cyclic process-data frames and decode_can_msg()
+	*					hands them to can_pdo_rx() by class, without an opcode (can_pdo.c).
+	*
+	*					Added the CAN0 <-> CAN1 gateway (can_gw.c, CAN_GW_ENABLE): the RX handler
+	*					offers every frame to can_gw_rx_isr() before the dispatch ring, and
+	*					gateway transmit mailboxes are handed to can_gw_tx_done_isr().
+	*
+	*					The route taken by decode_can_msg() comes from can_route() (can_route.h),
+	*					which tools/can_replay.c uses as well.
+	*
+	*					CAN0 mailboxes: MB0-MB1 for the test programs, MB2-MB3 a two-mailbox
+	*					FIFO for the subscriptions, MB4 the process data (planned on their own
+	*					from can0_pdo_subscriptions), MB5 the extended frames and MB6-MB7 the
+	*					TX pool.
+	*
+	*					decode_can_msg() only toggles the LEDs with CAN_RX_LEDS, times its lookup
+	*					with CAN_DECODE_TIMING, checks for duplicates with the dual bus and looks
+	*					at the waiters while one is armed (ul_ack_armed).
+	*
+	*					can_tx_push() loads a frame straight into a free mailbox when nothing is
+	*					waiting (can_tx_load()), instead of through the queue pool.
+	*
+	*					Added can_rx_replan(), which loads the reception filters again without
+	*					the IDs of babbling nodes. The dispatch task runs can_guard_service()
+	*					after each batch of frames and sleeps no longer than its next cooldown;
+	*					the RX handler wakes it when the guard drops a frame or isolates a
+	*					mailbox.
+	*
 	*	DESCRIPTION:	
 	*
 	*	This file is being used to house the housekeeping task.
 	*	
  */
 
-#include "can_func.h"
+#include "can_func.h"
+#include "can_hk.h"
+#include "can_transport.h"
+#include "can_filter.h"
+#include "can_stats.h"
+#include "can_tt.h"
+#include "can_err.h"
+#include "can_dual.h"
+#include "can_capture.h"
+#include "can_gw.h"
+#include "can_poll.h"
+#include "can_guard.h"
+#include "can_nmt.h"
+#include "can_pdo.h"
+#include "can_route.h"
+
+#if (CAN_ROUTE_MID_EXT != CAN_MID_MIDE) || (CAN_ROUTE_CLASS_PDO != CAN_PRIO_PDO) \
+	|| (CAN_ROUTE_MID_CLASS_Pos != CAN_MID_MIDvA_Pos + CAN_ID_CLASS_Pos)
+#error "can_route.h does not match the ID layout of can_func.h"
+#endif
+
+/* Kernel includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/** CAN0 Transceiver */
+sn65hvd234_ctrl_t can0_transceiver;
+
+/** CAN1 Transceiver */
+sn65hvd234_ctrl_t can1_transceiver;
+
+/* Owner of each mailbox, [controller][mailbox]. */
+static uint8_t uc_mb_owner[2][CANMB_NUMBER];
+
+volatile can_rx_stats_t can_rx_stats;
+
+/* RX ring shared between the CAN handlers (producer) and prvCANDispatchTask (consumer).
+*  ul_rx_head and ul_rx_tail are free-running, the slot is found with the mask. */
+static can_frame_t can_rx_ring[CAN_RX_RING_SIZE];
+static uint32_t ul_rx_stamp[CAN_RX_RING_SIZE];		// DWT cycle count when the frame was stored.
+static volatile uint32_t ul_rx_head = 0;
+static volatile uint32_t ul_rx_tail = 0;
+
+static SemaphoreHandle_t xCanRxSemaphore = NULL;
+
+volatile can_tx_stats_t can_tx_stats;
+
+/* TX queue: one FIFO per priority level, threaded through a shared pool of entries.
+*  ul_tx_ready has bit (31 - prio) set when that level has frames waiting and
+*  ul_tx_busy has it set while a mailbox (on either bus) holds a frame of that level.
+*  The transmit mailboxes are numbered CAN_TX_SLOT(ctrl, mb): CAN0 MB0-7 are
+*  slots 0-7 and CAN1 MB0-7 slots 8-15. */
+typedef struct {
+	can_frame_t frame;
+	uint16_t us_next;
+	uint32_t ul_stamp;				// DWT cycle count when the frame was queued.
+} can_tx_entry_t;
+
+#define CAN_TX_NONE		0xFFFF
+
+static can_tx_entry_t can_tx_pool[CAN_TX_QUEUE_SIZE];
+static uint16_t us_tx_head[CAN_TX_PRIO_LEVELS];
+static uint16_t us_tx_tail[CAN_TX_PRIO_LEVELS];
+static uint16_t us_tx_free;
+static uint32_t ul_tx_count;
+static uint32_t ul_tx_ready;
+static uint32_t ul_tx_busy;
+static uint32_t ul_tx_mb_free;					// One bit per free slot.
+static uint8_t uc_tx_mb_prio[2 * CANMB_NUMBER];
+static uint32_t ul_tx_mb_stamp[2 * CANMB_NUMBER];
+static can_frame_t can_tx_mb_frame[2 * CANMB_NUMBER];	// Frame in each transmit mailbox.
+static volatile uint32_t ul_tx_hold = 0;			// Bit n set while controller n is bus-off: none of its mailboxes is refilled.
+
+#define CAN_TX_SLOT(ctrl, mb)	( ( ctrl ) * CANMB_NUMBER + ( mb ) )
+#define CAN_TX_CTRL_MASK		( ( 1u << CANMB_NUMBER ) - 1 )
+
+#if CAN_DUAL_BUS_ENABLE && CAN_TT_ENABLE
+#error "The time-triggered schedule needs CAN1 MB2-MB7, which the dual bus gives to the TX scheduler."
+#endif
+
+#if CAN_GW_ENABLE && ( CAN_DUAL_BUS_ENABLE || CAN_TT_ENABLE )
+#error "The gateway needs all of CAN1, which the dual bus and the time-triggered schedule also use."
+#endif
+
+/* Called from the CAN interrupt when a frame has left a transmit mailbox. */
+#define CAN_TX_HOOKS			4
+static can_handler_t can_tx_hook[CAN_TX_HOOKS];
+
+static void prvCANDispatchTask(void *pvParameters);
+static uint32_t can_mailbox_isr(Can *controller, uint8_t uc_ctrl);
+static void can_tx_init(void);
+static void can_tx_fill(void);
+static uint32_t can_tx_push(const can_frame_t *p_frame, uint32_t ul_prio);
+static void can_tx_complete_isr(uint8_t uc_ctrl, uint32_t ul_done);
+static void command_release(void);
+
+/************************************************************************/
+/*					RX RING PUT (ISR SIDE)                              */
+/*	Copies a frame into the next free slot of the RX ring. Returns 1 if  */
+/*	the frame was stored and 0 if the ring was full (frame dropped).	*/
+/************************************************************************/
+
+uint32_t can_rx_ring_put(const can_frame_t *p_frame)
+{
+	uint32_t head = ul_rx_head;
+	uint32_t used = head - ul_rx_tail;
+
+	if (used >= CAN_RX_RING_SIZE) {
+		can_rx_stats.ul_dropped++;
+		return 0;
+	}
+
+	can_rx_ring[head & (CAN_RX_RING_SIZE - 1)] = *p_frame;
+	ul_rx_stamp[head & (CAN_RX_RING_SIZE - 1)] = CAN_DWT_CYCCNT;
+	__DMB();						// The record must be visible before the new head.
+	ul_rx_head = head + 1;
+
+	can_rx_stats.ul_frames++;
+	if (used + 1 > can_rx_stats.ul_high_water)
+		can_rx_stats.ul_high_water = used + 1;
+
+	return 1;
+}
+
+/************************************************************************/
+/*					RX RING GET (TASK SIDE)                             */
+/*	Copies the oldest frame out of the RX ring. Returns 1 if a frame was */
+/*	copied and 0 if the ring was empty.									*/
+/************************************************************************/
+
+uint32_t can_rx_ring_get(can_frame_t *p_frame)
+{
+	uint32_t tail = ul_rx_tail;
+
+	if (tail == ul_rx_head)
+		return 0;
+
+	*p_frame = can_rx_ring[tail & (CAN_RX_RING_SIZE - 1)];
+	can_stats_latency(CAN_STATS_LAT_RX, CAN_DWT_CYCCNT - ul_rx_stamp[tail & (CAN_RX_RING_SIZE - 1)]);
+	__DMB();						// Finish reading the slot before handing it back.
+	ul_rx_tail = tail + 1;
+
+	return 1;
+}
+
+/************************************************************************/
+/*					MAILBOX FRAME COPY									*/
+/*	The per-frame path moves a can_frame_t to and from a mailbox		*/
+/*	directly: no can_mb_conf_t is filled in and MFID is not read.		*/
+/*	MDL and MDH follow each other in the mailbox as ul_datal and		*/
+/*	ul_datah do in can_frame_t, so the data moves with one LDM and one	*/
+/*	STM (CAN_MB_COPY2()). Cycles against the ASF functions:				*/
+/*	can_mb_bench().														*/
+/************************************************************************/
+
+/* Reads the frame of a mailbox whose MSR (ul_status) has MRDY set. Leaves MCR
+*  to the caller. Returns the can_mailbox_read() flags. */
+static uint32_t can_mb_read_frame(Can *controller, uint8_t uc_mb, uint32_t ul_status, can_frame_t *p_frame)
+{
+	CanMb *p_mb = &controller->CAN_MB[uc_mb];
+	uint32_t ul_flags = CAN_MAILBOX_TRANSFER_OK;
+
+	/* MMI with MRDY: a frame was lost before this one (or overwritten). */
+	if (ul_status & CAN_MSR_MMI)
+		ul_flags = CAN_MAILBOX_RX_OVER;
+
+	p_frame->ul_id = p_mb->CAN_MID;
+	CAN_MB_COPY2(&p_frame->ul_datal, &p_mb->CAN_MDL);
+	p_frame->uc_length = (uint8_t)((ul_status & CAN_MSR_MDLC_Msk) >> CAN_MSR_MDLC_Pos);
+	if (p_frame->uc_length <= 4)
+		p_frame->ul_datah = 0;
+	p_frame->us_timestamp = (uint16_t)(ul_status & CAN_MSR_MTIMESTAMP_Msk);
+
+	/* MMI now means a frame came in while the data was read. */
+	if (p_mb->CAN_MSR & CAN_MSR_MMI)
+		ul_flags |= CAN_MAILBOX_RX_NEED_RD_AGAIN;
+
+	return ul_flags;
+}
+
+/* Loads a frame into a transmit mailbox with MRDY set and starts it. ul_id is
+*  written as it is, so MIDE is already set for an extended frame. */
+void can_mb_write_frame(Can *controller, uint8_t uc_mb, const can_frame_t *p_frame)
+{
+	CanMb *p_mb = &controller->CAN_MB[uc_mb];
+
+	p_mb->CAN_MID = p_frame->ul_id;
+	CAN_MB_COPY2(&p_mb->CAN_MDL, &p_frame->ul_datal);
+	p_mb->CAN_MCR = CAN_MCR_MTCR | CAN_MCR_MDLC(p_frame->uc_length);
+}
+
+#if CAN_MB_BENCH
+/************************************************************************/
+/*					MAILBOX COPY BENCHMARK								*/
+/*	Average CPU cycles to read a received frame into a can_frame_t and	*/
+/*	to load one into a transmit mailbox, through the ASF functions as	*/
+/*	the handlers used to and through the functions above. Runs on a		*/
+/*	copy of the register block in RAM so that nothing is sent; the real	*/
+/*	registers add the same peripheral wait states per access to both,	*/
+/*	and the new path makes fewer accesses (no MFID, no second MCR).		*/
+/************************************************************************/
+
+static Can can_bench_regs;
+
+void can_mb_bench(can_mb_bench_t *p_bench)
+{
+	Can *controller = &can_bench_regs;
+	can_mb_conf_t mailbox;
+	can_frame_t frame = { 0x12345678, 0x11223344, 0x55667788, 8, 0, 0 };
+	uint32_t ul_start, ul_status, i;
+
+	memset(&can_bench_regs, 0, sizeof(can_bench_regs));
+	controller->CAN_MB[0].CAN_MSR = CAN_MSR_MRDY | (8u << CAN_MSR_MDLC_Pos);
+	ul_status = controller->CAN_MB[0].CAN_MSR;
+
+	ul_start = CAN_DWT_CYCCNT;
+	for (i = 0; i < CAN_MB_BENCH_LOOPS; i++) {
+		mailbox.ul_mb_idx = 0;
+		mailbox.ul_status = ul_status;
+		mailbox.ul_datah = 0;
+		frame.uc_info = CAN_FRAME_INFO(CAN_CTRL_0, 0, can_mailbox_read(controller, &mailbox));
+		frame.ul_id = controller->CAN_MB[0].CAN_MID;
+		frame.ul_datal = mailbox.ul_datal;
+		frame.ul_datah = mailbox.ul_datah;
+		frame.uc_length = mailbox.uc_length;
+		frame.us_timestamp = (uint16_t)(ul_status & CAN_MSR_MTIMESTAMP_Msk);
+	}
+	p_bench->ul_asf_read = (CAN_DWT_CYCCNT - ul_start) / CAN_MB_BENCH_LOOPS;
+
+	ul_start = CAN_DWT_CYCCNT;
+	for (i = 0; i < CAN_MB_BENCH_LOOPS; i++) {
+		frame.uc_info = CAN_FRAME_INFO(CAN_CTRL_0, 0, can_mb_read_frame(controller, 0, ul_status, &frame));
+		controller->CAN_MB[0].CAN_MCR = CAN_MCR_MTCR;
+	}
+	p_bench->ul_read = (CAN_DWT_CYCCNT - ul_start) / CAN_MB_BENCH_LOOPS;
+
+	ul_start = CAN_DWT_CYCCNT;
+	for (i = 0; i < CAN_MB_BENCH_LOOPS; i++) {
+		mailbox.ul_mb_idx = 0;
+		mailbox.uc_id_ver = 0;
+		mailbox.ul_id = frame.ul_id;
+		mailbox.ul_datal = frame.ul_datal;
+		mailbox.ul_datah = frame.ul_datah;
+		mailbox.uc_length = frame.uc_length;
+		can_mailbox_write(controller, &mailbox);
+		can_mailbox_send_transfer_cmd(controller, &mailbox);
+	}
+	p_bench->ul_asf_write = (CAN_DWT_CYCCNT - ul_start) / CAN_MB_BENCH_LOOPS;
+
+	ul_start = CAN_DWT_CYCCNT;
+	for (i = 0; i < CAN_MB_BENCH_LOOPS; i++)
+		can_mb_write_frame(controller, 0, &frame);
+	p_bench->ul_write = (CAN_DWT_CYCCNT - ul_start) / CAN_MB_BENCH_LOOPS;
+}
+#endif
+
+/************************************************************************/
+/*					CAN RX INTERRUPT WORK								*/
+/*	Shared by both CAN handlers: copy the ready mailboxes into the RX	*/
+/*	ring and wake the dispatch task. No decoding is done in interrupt	*/
+/*	context.															*/
+/*																		*/
+/*	CAN_SR is read once and masked with the enabled mailbox interrupts.	*/
+/*	Every set bit is then serviced in the same entry: the receive FIFO	*/
+/*	mailboxes oldest frame first, then the others highest mailbox		*/
+/*	first, by walking the mask with count-leading-zeros.				*/
+/************************************************************************/
+
+/* Fills puc_order with the mailboxes of ul_fifo which hold a frame, oldest
+*  frame first (largest age of MTIMESTAMP against the CAN timer). Returns how
+*  many there are. */
+static uint8_t can_rx_fifo_order(Can *controller, uint32_t ul_fifo, uint8_t *puc_order)
+{
+	uint16_t us_age[CANMB_NUMBER], us_now, us;
+	uint32_t ul_status;
+	uint8_t uc_n = 0, uc_mb, j;
+
+	if (!ul_fifo)
+		return 0;
+
+	us_now = (uint16_t)(controller->CAN_TIM & CAN_TIM_TIMER_Msk);
+	while (ul_fifo) {
+		uc_mb = (uint8_t)(31 - __CLZ(ul_fifo));
+		ul_fifo &= ~(1u << uc_mb);
+
+		ul_status = controller->CAN_MB[uc_mb].CAN_MSR;
+		if (!(ul_status & CAN_MSR_MRDY))
+			continue;
+		us = (uint16_t)(us_now - (ul_status & CAN_MSR_MTIMESTAMP_Msk));
+
+		/* Insertion sort, at most CANMB_NUMBER entries. */
+		for (j = uc_n; j && (us_age[j - 1] < us); j--) {
+			us_age[j] = us_age[j - 1];
+			puc_order[j] = puc_order[j - 1];
+		}
+		us_age[j] = us;
+		puc_order[j] = uc_mb;
+		uc_n++;
+	}
+
+	return uc_n;
+}
+
+static uint32_t can_mailbox_isr(Can *controller, uint8_t uc_ctrl)
+{
+	uint32_t ul_pending, ul_status, ul_start, ul_tx_done = 0, ul_gw_done, ul_frames = 0;
+	uint32_t ul_sr, ul_guard, ul_guard_wake = 0;
+	uint8_t i, k, uc_n, uc_order[CANMB_NUMBER];
+	can_frame_t frame;
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	ul_start = CAN_DWT_CYCCNT;
+	can_rx_stats.ul_isr_entries++;
+
+	/* Reading CAN_SR clears TOVF, so it is read once here. */
+	ul_sr = can_get_status(controller);
+
+	/* Change of error state (only enabled by can_err.c). */
+	if (ul_sr & can_get_interrupt_mask(controller) & CAN_ERR_IRQ_MASK)
+		can_err_isr(uc_ctrl, ul_sr, &xHigherPriorityTaskWoken);
+
+	/* Polled reception mailboxes count as enabled (only with CAN_POLL_ENABLE). */
+	ul_sr &= can_get_interrupt_mask(controller) | can_rx_polled[uc_ctrl];
+	ul_pending = ul_sr & GLOBAL_MAILBOX_MASK & ~can_rx_isolated[uc_ctrl];
+
+	/* Start of a time-triggered cycle (only enabled by can_tt_start()). */
+	if ((uc_ctrl == CAN_CTRL_1) && (ul_sr & CAN_SR_TOVF))
+		can_tt_cycle_isr(&xHigherPriorityTaskWoken);
+
+	/* Transmit mailboxes of the TX scheduler which have finished sending. */
+	ul_tx_done = ul_pending & ((uc_ctrl == CAN_CTRL_0) ? CAN_TX_MB_MASK : CAN1_TX_MB_MASK);
+	ul_pending &= ~ul_tx_done;
+	if (ul_tx_done)
+		can_tx_complete_isr(uc_ctrl, ul_tx_done);
+
+	/* Gateway transmit mailboxes (only with CAN_GW_ENABLE). */
+	ul_gw_done = ul_pending & CAN_GW_TX_MB_MASK(uc_ctrl);
+	ul_pending &= ~ul_gw_done;
+	if (ul_gw_done)
+		can_gw_tx_done_isr(uc_ctrl, ul_gw_done);
+
+	/* Receive FIFO mailboxes in arrival order, then the rest. */
+	uc_n = can_rx_fifo_order(controller, ul_pending & can_rx_fifo_mask[uc_ctrl], uc_order);
+	ul_pending &= ~can_rx_fifo_mask[uc_ctrl];
+	while (ul_pending) {
+		i = (uint8_t)(31 - __CLZ(ul_pending));
+		ul_pending &= ~(1u << i);
+		uc_order[uc_n++] = i;
+	}
+
+	for (k = 0; k < uc_n; k++) {
+		i = uc_order[k];
+
+		ul_status = can_mailbox_get_status(controller, i);
+		if (!(ul_status & CAN_MSR_MRDY))
+			continue;
+
+		frame.uc_info = CAN_FRAME_INFO(uc_ctrl, i, can_mb_read_frame(controller, i, ul_status, &frame));
+		ul_frames++;
+
+		/* Over the budget of the controller: the mailbox stays full and isolated.
+		*  Either way the dispatch task has guard work to do. */
+		ul_guard = can_guard_rx_isr(uc_ctrl, i, &frame);
+		ul_guard_wake |= ul_guard;
+		if (ul_guard == CAN_GUARD_ISOLATE)
+			continue;
+
+		/* A consumer answer leaves the mailbox idle (MACR clears MRDY) until
+		*  its owner requests again; MTCR would send another remote frame. */
+		if ((controller->CAN_MB[i].CAN_MMR & CAN_MMR_MOT_Msk) == CAN_MMR_MOT_MB_CONSUMER)
+			controller->CAN_MB[i].CAN_MCR = CAN_MCR_MACR;
+		else
+			controller->CAN_MB[i].CAN_MCR = CAN_MCR_MTCR;		// Ready for the next frame.
+
+		/* Over the budget of its node: dropped, the mailbox is free for the others. */
+		if (ul_guard == CAN_GUARD_DROP)
+			continue;
+
+		can_stats_rx(uc_ctrl, frame.ul_id, frame.uc_length, CAN_FRAME_FLAGS(&frame));
+		can_capture_frame(&frame, 0);
+
+		/* Frames taken by the gateway go no further. */
+		if (CAN_GW_ENABLE && !can_gw_rx_isr(uc_ctrl, &frame))
+			continue;
+
+		if (can_rx_ring_put(&frame))
+			xSemaphoreGiveFromISR(xCanRxSemaphore, &xHigherPriorityTaskWoken);
+	}
+
+	if (ul_guard_wake)
+		xSemaphoreGiveFromISR(xCanRxSemaphore, &xHigherPriorityTaskWoken);
+
+	ul_start = CAN_DWT_CYCCNT - ul_start;
+	can_rx_stats.ul_isr_cycles += ul_start;
+	if (ul_start > can_rx_stats.ul_isr_max_cycles)
+		can_rx_stats.ul_isr_max_cycles = ul_start;
+
+	can_poll_count_isr(uc_ctrl, ul_frames);
+
+	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+	return ul_frames;
+}
+
+/* Runs the handler work of a controller from the TC0 poll (can_poll.c).
+*  Returns the number of frames read. */
+uint32_t can_rx_poll(uint8_t uc_ctrl)
+{
+	return can_mailbox_isr((uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0, uc_ctrl);
+}
+
+/**
+ * \brief Default interrupt handler for CAN 1.
+ */
+void CAN1_Handler(void)
+{
+	can_mailbox_isr(CAN1, CAN_CTRL_1);
+}
+/************************************************************************/
+/* Default Interrupt Handler for CAN0								    */
+/************************************************************************/
+
+/**
+ * \brief Default interrupt handler for CAN0
+ */
+void CAN0_Handler(void)
+{
+	can_mailbox_isr(CAN0, CAN_CTRL_0);
+}
+
+/************************************************************************/
+/*					CAN DISPATCH TASK                                   */
+/*	Sleeps until a CAN handler pushes frames into the RX ring, then		*/
+/*	decodes every frame that is waiting. The receive guard is serviced	*/
+/*	after each batch; while it has a cooldown running the task wakes	*/
+/*	up for its end even if no frame comes in. So is the error handling	*/
+/*	(a timer command which did not fit into the timer queue).			*/
+/************************************************************************/
+
+static void prvCANDispatchTask(void *pvParameters)
+{
+	can_frame_t frame;
+	TickType_t xWait = portMAX_DELAY, xWait2;
+	(void)pvParameters;
+
+	/* @non-terminating@ */
+	for (;;)
+	{
+		xSemaphoreTake(xCanRxSemaphore, xWait);
+
+		while (can_rx_ring_get(&frame))
+		{
+			decode_can_msg(&frame);
+			can_rx_stats.ul_dispatched++;
+		}
+
+		xWait = can_guard_service();
+		xWait2 = can_err_service();
+		if (xWait2 < xWait)
+			xWait = xWait2;
+	}
+}
+
+/* Wakes the dispatch task for its service work, from an ISR if
+*  pxHigherPriorityTaskWoken is not NULL. */
+void can_dispatch_wake(BaseType_t *pxHigherPriorityTaskWoken)
+{
+	if (!xCanRxSemaphore)
+		return;
+	if (pxHigherPriorityTaskWoken)
+		xSemaphoreGiveFromISR(xCanRxSemaphore, pxHigherPriorityTaskWoken);
+	else
+		xSemaphoreGive(xCanRxSemaphore);
+}
+
+/************************************************************************/
+/*					TX SCHEDULER: INITIALIZE                            */
+/*	Empties the TX queue and sets up CAN0 MB6-MB7 as transmit mailboxes	*/
+/*	(and CAN1 MB6-MB7 with the dual bus).								*/
+/************************************************************************/
+
+static Can *can_tx_controller(uint8_t uc_ctrl)
+{
+	return (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+}
+
+static void can_tx_init(void)
+{
+	can_mb_conf_t mailbox;
+	uint16_t i;
+	uint8_t uc_ctrl;
+
+	for (i = 0; i < CAN_TX_QUEUE_SIZE; i++)
+		can_tx_pool[i].us_next = (i + 1 < CAN_TX_QUEUE_SIZE) ? (i + 1) : CAN_TX_NONE;
+	us_tx_free = 0;
+
+	for (i = 0; i < CAN_TX_PRIO_LEVELS; i++) {
+		us_tx_head[i] = CAN_TX_NONE;
+		us_tx_tail[i] = CAN_TX_NONE;
+	}
+
+	ul_tx_count = 0;
+	ul_tx_ready = 0;
+	ul_tx_busy = 0;
+	ul_tx_mb_free = CAN_TX_MB_MASK | (CAN1_TX_MB_MASK << CAN_TX_SLOT(CAN_CTRL_1, 0));
+
+	for (uc_ctrl = CAN_CTRL_0; uc_ctrl <= CAN_CTRL_1; uc_ctrl++) {
+		for (i = CAN_TX_MB_FIRST; i <= CAN_TX_MB_LAST; i++) {
+			if (!(ul_tx_mb_free & (1u << CAN_TX_SLOT(uc_ctrl, i))))
+				continue;
+			reset_mailbox_conf(&mailbox);
+			mailbox.ul_mb_idx = i;
+			mailbox.uc_obj_type = CAN_MB_TX_MODE;
+			mailbox.uc_tx_prio = 15;		// Set per frame by can_tx_fill().
+			mailbox.uc_id_ver = 0;
+			mailbox.ul_id_msk = 0;
+			can_mailbox_init(can_tx_controller(uc_ctrl), &mailbox);
+		}
+	}
+}
+
+/************************************************************************/
+/*					TX SCHEDULER: FILL MAILBOXES                        */
+/*	Moves queued frames into free transmit mailboxes, most urgent level */
+/*	first. A level that already has a frame in a mailbox is skipped so	*/
+/*	frames of the same priority go out in the order they were queued.	*/
+/*	can_dual_route() picks the bus of each level; a level whose bus is	*/
+/*	held or has no free mailbox waits for the next call.				*/
+/*																		*/
+/*	Must be called with the CAN interrupts masked.						*/
+/************************************************************************/
+
+/* Loads one frame of level uc_prio into transmit mailbox uc_mb of uc_ctrl. */
+static void can_tx_load(uint8_t uc_ctrl, uint8_t uc_mb, uint8_t uc_prio, const can_frame_t *p_frame,
+		uint32_t ul_stamp)
+{
+	Can *controller = can_tx_controller(uc_ctrl);
+	uint8_t uc_slot = CAN_TX_SLOT(uc_ctrl, uc_mb);
+
+	/* The controller sends the pending mailbox with the lowest PRIOR first. */
+	controller->CAN_MB[uc_mb].CAN_MMR = (controller->CAN_MB[uc_mb].CAN_MMR & ~CAN_MMR_PRIOR_Msk) |
+			CAN_MMR_PRIOR((uc_prio > 15) ? 15 : uc_prio);
+
+	can_mb_write_frame(controller, uc_mb, p_frame);
+
+	ul_tx_busy |= (0x80000000u >> uc_prio);
+	ul_tx_mb_free &= ~(1u << uc_slot);
+	uc_tx_mb_prio[uc_slot] = uc_prio;
+	ul_tx_mb_stamp[uc_slot] = ul_stamp;
+	can_tx_mb_frame[uc_slot] = *p_frame;
+	can_tx_mb_frame[uc_slot].uc_info = CAN_FRAME_INFO(uc_ctrl, uc_mb, 0);
+	can_dual_stats.ul_sent[uc_ctrl]++;
+	if (uc_ctrl != CAN_DUAL_HOME(uc_prio))
+		can_dual_stats.ul_failover++;
+
+	/* MRDY will come back when the frame is on the bus. */
+	can_enable_interrupt(controller, (1u << uc_mb));
+}
+
+static void can_tx_fill(void)
+{
+	uint32_t ul_avail, ul_skip = 0, ul_free;
+	uint8_t uc_prio, uc_mb, uc_ctrl;
+	uint16_t idx;
+
+	while (ul_tx_mb_free && (ul_avail = (ul_tx_ready & ~ul_tx_busy & ~ul_skip))) {
+		uc_prio = (uint8_t)__CLZ(ul_avail);
+		uc_ctrl = can_dual_route(uc_prio, ul_tx_hold);
+		ul_free = (uc_ctrl == CAN_DUAL_NONE) ? 0
+				: ((ul_tx_mb_free >> CAN_TX_SLOT(uc_ctrl, 0)) & CAN_TX_CTRL_MASK);
+		if (!ul_free) {
+			ul_skip |= (0x80000000u >> uc_prio);
+			continue;
+		}
+		uc_mb = (uint8_t)(31 - __CLZ(ul_free));
+
+		/* Pop the oldest frame of this priority level. */
+		idx = us_tx_head[uc_prio];
+		us_tx_head[uc_prio] = can_tx_pool[idx].us_next;
+		if (us_tx_head[uc_prio] == CAN_TX_NONE) {
+			us_tx_tail[uc_prio] = CAN_TX_NONE;
+			ul_tx_ready &= ~(0x80000000u >> uc_prio);
+		}
+
+		can_tx_load(uc_ctrl, uc_mb, uc_prio, &can_tx_pool[idx].frame, can_tx_pool[idx].ul_stamp);
+
+		/* Give the entry back to the free list. */
+		can_tx_pool[idx].us_next = us_tx_free;
+		us_tx_free = idx;
+		ul_tx_count--;
+	}
+}
+
+/************************************************************************/
+/*					TX SCHEDULER: QUEUE A FRAME                         */
+/*	Appends a frame to the FIFO of its priority level and starts it if	*/
+/*	a mailbox is free. Returns 1 if queued and 0 if the queue is full.	*/
+/*	With nothing waiting at any level and this level not in a mailbox,	*/
+/*	the frame goes straight into a free mailbox of its bus, as			*/
+/*	can_tx_fill() would put it, without passing through the pool.		*/
+/*																		*/
+/*	Must be called with the CAN interrupts masked.						*/
+/************************************************************************/
+
+static uint32_t can_tx_push(const can_frame_t *p_frame, uint32_t ul_prio)
+{
+	uint32_t ul_free;
+	uint16_t idx;
+	uint8_t uc_ctrl;
+
+	if (ul_prio >= CAN_TX_PRIO_LEVELS)
+		ul_prio = CAN_TX_PRIO_LEVELS - 1;
+
+	if (!ul_tx_ready && !(ul_tx_busy & (0x80000000u >> ul_prio)) && ul_tx_mb_free) {
+		uc_ctrl = can_dual_route((uint8_t)ul_prio, ul_tx_hold);
+		ul_free = (uc_ctrl == CAN_DUAL_NONE) ? 0
+				: ((ul_tx_mb_free >> CAN_TX_SLOT(uc_ctrl, 0)) & CAN_TX_CTRL_MASK);
+		if (ul_free) {
+			can_tx_load(uc_ctrl, (uint8_t)(31 - __CLZ(ul_free)), (uint8_t)ul_prio, p_frame, CAN_DWT_CYCCNT);
+			can_tx_stats.ul_queued++;
+			return 1;
+		}
+	}
+
+	idx = us_tx_free;
+	if (idx == CAN_TX_NONE) {
+		can_tx_stats.ul_dropped++;
+		return 0;
+	}
+	us_tx_free = can_tx_pool[idx].us_next;
+
+	can_tx_pool[idx].frame = *p_frame;
+	can_tx_pool[idx].ul_stamp = CAN_DWT_CYCCNT;
+	can_tx_pool[idx].us_next = CAN_TX_NONE;
+	if (us_tx_head[ul_prio] == CAN_TX_NONE)
+		us_tx_head[ul_prio] = idx;
+	else
+		can_tx_pool[us_tx_tail[ul_prio]].us_next = idx;
+	us_tx_tail[ul_prio] = idx;
+	ul_tx_ready |= (0x80000000u >> ul_prio);
+
+	can_tx_stats.ul_queued++;
+	if (++ul_tx_count > can_tx_stats.ul_high_water)
+		can_tx_stats.ul_high_water = ul_tx_count;
+
+	can_tx_fill();
+	return 1;
+}
+
+/**
+ * \brief Queues a frame for the TX scheduler (task level), which sends it from the
+ *  CAN0 TX mailboxes, or from CAN1 for the levels the dual bus routes there.
+ * @param *p_frame:	Frame to send, ul_id is in CAN_MID format.
+ * @param ul_prio:	Priority level, 0 is the most urgent (see can_func.h).
+ * @return 1 if the frame was queued, 0 if the TX queue is full.
+ */
+uint32_t can_tx_enqueue(const can_frame_t *p_frame, uint32_t ul_prio)
+{
+	uint32_t ret;
+
+	taskENTER_CRITICAL();
+	ret = can_tx_push(p_frame, ul_prio);
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
+
+/**
+ * \brief Number of frames waiting in the TX queue (not counting the ones
+ * already in a mailbox). Bulk senders use it to leave room for other traffic.
+ */
+uint32_t can_tx_pending(void)
+{
+	return ul_tx_count;
+}
+
+/************************************************************************/
+/*					HOLD THE TX SCHEDULER								*/
+/*	While uc_ctrl is held, frames are still queued but none of its		*/
+/*	mailboxes is refilled (with the dual bus they go out on the other	*/
+/*	bus). Releasing the hold refills the mailboxes at once. May be		*/
+/*	called from the CAN interrupt with ul_hold = 1.						*/
+/************************************************************************/
+
+void can_tx_hold(uint8_t uc_ctrl, uint32_t ul_hold)
+{
+	if (uc_ctrl > CAN_CTRL_1)
+		return;
+
+	if (ul_hold) {
+		ul_tx_hold |= (1u << uc_ctrl);
+		return;
+	}
+
+	taskENTER_CRITICAL();
+	ul_tx_hold &= ~(1u << uc_ctrl);
+	can_tx_fill();
+	taskEXIT_CRITICAL();
+}
+
+/* Frees the mailbox of uc_slot, whose frame was aborted, and puts the frame
+*  back at the head of its priority level. Called with the TX state locked.
+*  Returns 0 if the queue is full and the frame is lost. */
+static uint32_t can_tx_requeue(uint8_t uc_slot)
+{
+	uint16_t idx;
+	uint8_t uc_prio = uc_tx_mb_prio[uc_slot];
+
+	ul_tx_busy &= ~(0x80000000u >> uc_prio);
+	ul_tx_mb_free |= (1u << uc_slot);
+
+	idx = us_tx_free;
+	if (idx == CAN_TX_NONE)
+		return 0;
+	us_tx_free = can_tx_pool[idx].us_next;
+
+	can_tx_pool[idx].frame = can_tx_mb_frame[uc_slot];
+	can_tx_pool[idx].ul_stamp = ul_tx_mb_stamp[uc_slot];
+	can_tx_pool[idx].us_next = us_tx_head[uc_prio];
+	if (us_tx_head[uc_prio] == CAN_TX_NONE)
+		us_tx_tail[uc_prio] = idx;
+	us_tx_head[uc_prio] = idx;
+	ul_tx_ready |= (0x80000000u >> uc_prio);
+	ul_tx_count++;
+	return 1;
+}
+
+/************************************************************************/
+/*					RECLAIM THE TRANSMIT MAILBOXES						*/
+/*	Aborts every frame still waiting in the transmit mailboxes of		*/
+/*	uc_ctrl and puts it back at the head of its priority level, so it	*/
+/*	is sent again first once the hold is released (or at once on the	*/
+/*	other bus). Only a frame the controller reports aborted (MABT) is	*/
+/*	put back: one which went out before the abort, or is still on the	*/
+/*	bus and ends either way, is left to the TX-complete interrupt,		*/
+/*	which puts it back itself if it ends aborted. Returns the number	*/
+/*	of frames which could not be put back here (queue full) and are		*/
+/*	lost.																*/
+/************************************************************************/
+
+uint32_t can_tx_reclaim(uint8_t uc_ctrl)
+{
+	uint32_t ul_busy, ul_status, ul_lost = 0;
+	uint8_t uc_mb, uc_slot;
+	Can *controller;
+
+	if (uc_ctrl > CAN_CTRL_1)
+		return 0;
+	controller = can_tx_controller(uc_ctrl);
+
+	taskENTER_CRITICAL();
+	ul_busy = ((uc_ctrl == CAN_CTRL_0) ? CAN_TX_MB_MASK : CAN1_TX_MB_MASK)
+			& ~(ul_tx_mb_free >> CAN_TX_SLOT(uc_ctrl, 0));
+	while (ul_busy) {
+		uc_mb = (uint8_t)(31 - __CLZ(ul_busy));
+		ul_busy &= ~(1u << uc_mb);
+		uc_slot = CAN_TX_SLOT(uc_ctrl, uc_mb);
+
+		if (controller->CAN_MB[uc_mb].CAN_MSR & CAN_MSR_MRDY)
+			continue;
+		can_global_send_abort_cmd(controller, (uint8_t)(1u << uc_mb));
+
+		/* The frame may have won arbitration before the abort: then MRDY
+		*  comes without MABT, or later with the end of the frame. */
+		ul_status = controller->CAN_MB[uc_mb].CAN_MSR;
+		if ((ul_status & (CAN_MSR_MRDY | CAN_MSR_MABT)) != (CAN_MSR_MRDY | CAN_MSR_MABT))
+			continue;
+		can_disable_interrupt(controller, (1u << uc_mb));
+		if (!can_tx_requeue(uc_slot))
+			ul_lost++;
+	}
+	taskEXIT_CRITICAL();
+
+	return ul_lost;
+}
+
+/**
+ * \brief Queues a frame for the TX scheduler (interrupt level), which sends it from the
+ *  CAN0 TX mailboxes, or from CAN1 for the levels the dual bus routes there.
+ * @param *p_frame:	Frame to send, ul_id is in CAN_MID format.
+ * @param ul_prio:	Priority level, 0 is the most urgent (see can_func.h).
+ * @return 1 if the frame was queued, 0 if the TX queue is full.
+ */
+uint32_t can_tx_enqueue_from_isr(const can_frame_t *p_frame, uint32_t ul_prio)
+{
+	uint32_t ret, ul_mask;
+
+	ul_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+	ret = can_tx_push(p_frame, ul_prio);
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ul_mask);
+
+	return ret;
+}
+
+/************************************************************************/
+/*					TX SCHEDULER: TX COMPLETE                           */
+/*	Called from the CAN handler of uc_ctrl with the transmit mailboxes	*/
+/*	that are ready again. Frees them and refills them from the queue.	*/
+/************************************************************************/
+
+static void can_tx_complete_isr(uint8_t uc_ctrl, uint32_t ul_done)
+{
+	uint32_t ul_mask, ul_status;
+	uint8_t uc_mb, uc_slot, i;
+	Can *controller = can_tx_controller(uc_ctrl);
+
+	ul_mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+	can_disable_interrupt(controller, ul_done);
+	while (ul_done) {
+		uc_mb = (uint8_t)(31 - __CLZ(ul_done));
+		ul_done &= ~(1u << uc_mb);
+		uc_slot = CAN_TX_SLOT(uc_ctrl, uc_mb);
+		ul_status = controller->CAN_MB[uc_mb].CAN_MSR;
+
+		/* Aborted by can_tx_reclaim() while it was on the bus. */
+		if (ul_status & CAN_MSR_MABT) {
+			if (!can_tx_requeue(uc_slot))
+				can_tx_stats.ul_dropped++;
+			continue;
+		}
+
+		ul_tx_busy &= ~(0x80000000u >> uc_tx_mb_prio[uc_slot]);
+		ul_tx_mb_free |= (1u << uc_slot);
+		can_tx_stats.ul_sent++;
+		can_tx_mb_frame[uc_slot].us_timestamp = (uint16_t)(ul_status & CAN_MSR_MTIMESTAMP_Msk);
+		can_stats_tx(uc_ctrl, can_tx_mb_frame[uc_slot].ul_id, can_tx_mb_frame[uc_slot].uc_length);
+		can_capture_frame(&can_tx_mb_frame[uc_slot], CAN_CAPTURE_TX);
+		can_stats_latency(CAN_STATS_LAT_TX, CAN_DWT_CYCCNT - ul_tx_mb_stamp[uc_slot]);
+		for (i = 0; (i < CAN_TX_HOOKS) && can_tx_hook[i]; i++)
+			can_tx_hook[i](&can_tx_mb_frame[uc_slot]);
+	}
+	can_tx_fill();
+
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(ul_mask);
+}
+
+/************************************************************************/
+/*					BUILT-IN MESSAGE HANDLERS							*/
+/*	One handler per (controller, opcode). The LED pattern is the same	*/
+/*	as the old if-chain in decode_can_msg() produced.					*/
+/************************************************************************/
+
+static void can_on_command_out0(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED0_GPIO);
+}
+
+static void can_on_command_out1(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED0_GPIO);
+	pio_toggle_pin(LED2_GPIO);	// LED2 indicates the response to the command
+								// has been received.
+	command_release();			// The answer ends the exchange, whether or not
+}								// command_out() waits for it.
+
+static void can_on_command_in0(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED1_GPIO);
+	// Command has been received, respond.
+	pio_toggle_pin(LED0_GPIO);
+	command_in();				// Does not wait: this task delivers the reply.
+}
 
-volatile uint32_t g_ul_recv_status = 0;
+static void can_on_command_in1(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED1_GPIO);
+}
 
-/**
- * \brief Default interrupt handler for CAN 1.
- */
-void CAN1_Handler(void)
+static void can_on_hk_transmit1(const can_frame_t *p_frame)
 {
-	uint32_t ul_status;
-	/* Save the state of the can1_mailbox object */	
-	save_can_object(&can1_mailbox, &temp_mailbox_C1);	//Doesn't erase the CAN message.
-	
-	ul_status = can_get_status(CAN1);
-	if (ul_status & GLOBAL_MAILBOX_MASK) {
-		for (uint8_t i = 0; i < CANMB_NUMBER; i++) {
-			ul_status = can_mailbox_get_status(CAN1, i);
-			
-			if ((ul_status & CAN_MSR_MRDY) == CAN_MSR_MRDY) {
-				can1_mailbox.ul_mb_idx = i;
-				can1_mailbox.ul_status = ul_status;
-				can_mailbox_read(CAN1, &can1_mailbox);
-				
-				/* Decode CAN Message */
-				decode_can_msg(&can1_mailbox, CAN1);
-				/*assert(g_ul_recv_status); ***Implement assert here.*/
-				
-				/* Restore the can0 mailbox object */
-				restore_can_object(&can1_mailbox, &temp_mailbox_C1);
-				break;
-			}
+	(void)p_frame;
+	pio_toggle_pin(LED3_GPIO);	// LED3 indicates housekeeping has been received.
+}
+
+/* DUMMY_COMMAND and MSG_ACK. */
+static void can_on_ack0(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED1_GPIO);
+}
+
+static void can_on_ack1(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	pio_toggle_pin(LED1_GPIO);
+	pio_toggle_pin(LED3_GPIO);	// LED3 indicates the reception of a return message.
+}
+
+/************************************************************************/
+/*					DISPATCH TABLE										*/
+/*	Only read by the dispatch task and written by can_register_handler. */
+/************************************************************************/
+
+typedef struct {
+	uint32_t ul_opcode;
+	uint32_t ul_mask;			// Bits of ul_datal compared against ul_opcode.
+	can_handler_t handler;
+} can_dispatch_entry_t;
+
+#define CAN_DISPATCH(opcode, fn)	[CAN_OPCODE_INDEX(opcode)] = { (opcode), 0xFFFFFFFF, (fn) }
+
+static can_dispatch_entry_t can_dispatch_table[2][CAN_DISPATCH_SLOTS] = {
+	[CAN_CTRL_0] = {
+		CAN_DISPATCH(COMMAND_OUT,	can_on_command_out0),
+		CAN_DISPATCH(COMMAND_IN,	can_on_command_in0),
+		CAN_DISPATCH(DUMMY_COMMAND,	can_on_ack0),
+		CAN_DISPATCH(MSG_ACK,		can_on_ack0),
+	},
+	[CAN_CTRL_1] = {
+		CAN_DISPATCH(COMMAND_OUT,	can_on_command_out1),
+		CAN_DISPATCH(COMMAND_IN,	can_on_command_in1),
+		CAN_DISPATCH(HK_TRANSMIT,	can_on_hk_transmit1),
+		CAN_DISPATCH(DUMMY_COMMAND,	can_on_ack1),
+		CAN_DISPATCH(MSG_ACK,		can_on_ack1),
+	},
+};
+
+/* Handlers bound to a mailbox; they take precedence over the opcode table. */
+static can_handler_t can_mb_handler[2][CANMB_NUMBER];
+
+/* Extended frames: handlers by [controller][type], next sequence number per
+*  destination and last sequence number seen per source. */
+static can_handler_t can_ext_dispatch[2][CAN_EXT_TYPES];
+static uint8_t uc_ext_tx_seq[CAN_EXT_NODES];
+static uint8_t uc_ext_rx_seq[CAN_EXT_NODES];
+static uint32_t ul_ext_rx_seen;			// Bit n set once node n has been heard from.
+
+/* Request/acknowledge waiters. ul_armed is only set while a task waits. */
+typedef struct {
+	uint32_t ul_armed;
+	uint32_t ul_done;
+	uint8_t uc_ctrl;
+	uint32_t ul_opcode;
+	can_frame_t reply;
+	SemaphoreHandle_t xDone;
+} can_ack_t;
+
+static can_ack_t can_ack[CAN_ACK_WAITERS];
+static volatile uint32_t ul_ack_armed;	// Waiters armed, so decode_can_msg() can skip them.
+
+/************************************************************************/
+/*					REGISTER A MESSAGE HANDLER							*/
+/*	Adds (or replaces) the handler for ul_opcode on one controller.		*/
+/*	ul_mask selects the bits of ul_datal which must match ul_opcode:	*/
+/*	0xFFFFFFFF for a plain opcode, 0xFF000000 to take every frame with	*/
+/*	that top byte (the rest of ul_datal is then free for data).			*/
+/*	Returns 0 if the slot is already taken by a different opcode.		*/
+/*	Passing handler = NULL removes the entry.							*/
+/************************************************************************/
+
+static uint32_t can_register_entry(uint8_t uc_ctrl, uint32_t ul_opcode, uint32_t ul_mask, can_handler_t handler)
+{
+	can_dispatch_entry_t *p_entry;
+
+	if ((uc_ctrl > CAN_CTRL_1) || ((ul_mask & 0xFF000000) != 0xFF000000))
+		return 0;
+	p_entry = &can_dispatch_table[uc_ctrl][CAN_OPCODE_INDEX(ul_opcode)];
+
+	taskENTER_CRITICAL();
+	if (p_entry->handler && ((p_entry->ul_opcode != ul_opcode) || (p_entry->ul_mask != ul_mask))) {
+		taskEXIT_CRITICAL();
+		return 0;
+	}
+	p_entry->ul_opcode = ul_opcode & ul_mask;
+	p_entry->ul_mask = ul_mask;
+	p_entry->handler = handler;
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
+uint32_t can_register_handler(uint8_t uc_ctrl, uint32_t ul_opcode, can_handler_t handler)
+{
+	return can_register_entry(uc_ctrl, ul_opcode, 0xFFFFFFFF, handler);
+}
+
+uint32_t can_register_prefix_handler(uint8_t uc_ctrl, uint8_t uc_type, can_handler_t handler)
+{
+	return can_register_entry(uc_ctrl, (uint32_t)uc_type << 24, 0xFF000000, handler);
+}
+
+/************************************************************************/
+/*					REGISTER A MAILBOX HANDLER							*/
+/*	Every frame received in mailbox uc_mb of controller uc_ctrl goes to	*/
+/*	handler, whatever its data. Passing handler = NULL removes it.		*/
+/************************************************************************/
+
+uint32_t can_register_mb_handler(uint8_t uc_ctrl, uint8_t uc_mb, can_handler_t handler)
+{
+	if ((uc_ctrl > CAN_CTRL_1) || (uc_mb >= CANMB_NUMBER))
+		return 0;
+
+	taskENTER_CRITICAL();
+	can_mb_handler[uc_ctrl][uc_mb] = handler;
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
+/************************************************************************/
+/*					REGISTER AN EXTENDED FRAME HANDLER					*/
+/*	Extended frames of type uc_type received on controller uc_ctrl go	*/
+/*	to handler. Passing handler = NULL removes it.						*/
+/************************************************************************/
+
+uint32_t can_register_ext_handler(uint8_t uc_ctrl, uint8_t uc_type, can_handler_t handler)
+{
+	if (uc_ctrl > CAN_CTRL_1)
+		return 0;
+
+	taskENTER_CRITICAL();
+	can_ext_dispatch[uc_ctrl][uc_type] = handler;
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
+/* Dispatch task context. Checks the sequence number against the last frame from
+*  the same node and calls the handler of the frame's type. */
+static void can_ext_decode(const can_frame_t *p_frame)
+{
+	uint32_t ul_ext_id = CAN_MID_TO_EXT_ID(p_frame->ul_id);
+	uint8_t uc_src = (uint8_t)CAN_EXT_SRC(ul_ext_id);
+	can_handler_t handler;
+
+	can_rx_stats.ul_ext_frames++;
+	if ((ul_ext_rx_seen & (1u << uc_src)) && ((uint8_t)CAN_EXT_SEQ(ul_ext_id) != (uint8_t)(uc_ext_rx_seq[uc_src] + 1)))
+		can_rx_stats.ul_ext_seq_gaps++;
+	uc_ext_rx_seq[uc_src] = (uint8_t)CAN_EXT_SEQ(ul_ext_id);
+	ul_ext_rx_seen |= (1u << uc_src);
+
+	handler = can_ext_dispatch[CAN_DUAL_LOGICAL(CAN_FRAME_CTRL(p_frame))][CAN_EXT_TYPE(ul_ext_id)];
+	if (handler)
+		handler(p_frame);
+	else
+		can_rx_stats.ul_unhandled++;
+}
+
+/************************************************************************/
+/*					ARM A REPLY WAITER									*/
+/*	Reserves a waiter for the next frame carrying ul_opcode on			*/
+/*	controller uc_ctrl. Must be called before the request is sent so	*/
+/*	that a fast reply is not missed. Returns a handle for can_ack_wait() */
+/*	or 0 if all waiters are in use.										*/
+/************************************************************************/
+
+uint32_t can_ack_arm(uint8_t uc_ctrl, uint32_t ul_opcode)
+{
+	uint32_t i;
+
+	if (uc_ctrl > CAN_CTRL_1)
+		return 0;
+
+	/* The waiter is reserved with ul_done set, which can_ack_release() skips. */
+	taskENTER_CRITICAL();
+	for (i = 0; i < CAN_ACK_WAITERS; i++) {
+		if (!can_ack[i].ul_armed && can_ack[i].xDone) {
+			can_ack[i].uc_ctrl = uc_ctrl;
+			can_ack[i].ul_opcode = ul_opcode;
+			can_ack[i].ul_done = 1;
+			can_ack[i].ul_armed = 1;
+			ul_ack_armed++;
+			break;
 		}
 	}
+	taskEXIT_CRITICAL();
+
+	if (i == CAN_ACK_WAITERS)
+		return 0;
+
+	/* Drop a give left over from a late reply before the waiter can be
+	*  released, or it could be taken for this reply's. */
+	xSemaphoreTake(can_ack[i].xDone, 0);
+	taskENTER_CRITICAL();
+	can_ack[i].ul_done = 0;
+	taskEXIT_CRITICAL();
+
+	return i + 1;
 }
+
 /************************************************************************/
-/* Default Interrupt Handler for CAN0								    */
+/*					WAIT FOR A REPLY									*/
+/*	Blocks the calling task until the armed reply arrives or xTimeout	*/
+/*	ticks pass, then frees the waiter. The reply is copied to *p_reply	*/
+/*	if p_reply is not NULL. Returns CAN_CMD_OK or CAN_CMD_TIMEOUT.		*/
 /************************************************************************/
 
-/**
- * \brief Default interrupt handler for CAN0
- */
-void CAN0_Handler(void)
+uint32_t can_ack_wait(uint32_t ul_handle, TickType_t xTimeout, can_frame_t *p_reply)
 {
-	uint32_t ul_status;
-	/* Save the state of the can0_mailbox object */
-	save_can_object(&can0_mailbox, &temp_mailbox_C0);
-
-	ul_status = can_get_status(CAN0);
-	if (ul_status & GLOBAL_MAILBOX_MASK) {
-		for (uint8_t i = 0; i < CANMB_NUMBER; i++) {
-			ul_status = can_mailbox_get_status(CAN0, i);
-			
-			if ((ul_status & CAN_MSR_MRDY) == CAN_MSR_MRDY) {
-				can0_mailbox.ul_mb_idx = i;
-				can0_mailbox.ul_status = ul_status;
-				can_mailbox_read(CAN0, &can0_mailbox);
-				g_ul_recv_status = 1;
-				
-				// Decode CAN Message
-				decode_can_msg(&can0_mailbox, CAN0);
-				//assert(g_ul_recv_status); ***implement assert here.
-				
-				/* Restore the can0 mailbox object */
-				restore_can_object(&can0_mailbox, &temp_mailbox_C0);
-				break;
-			}
+	can_ack_t *p_ack;
+	uint32_t ret;
+
+	if (!ul_handle || (ul_handle > CAN_ACK_WAITERS))
+		return CAN_CMD_INVALID;
+	p_ack = &can_ack[ul_handle - 1];
+	if (!p_ack->ul_armed)
+		return CAN_CMD_INVALID;
+
+	xSemaphoreTake(p_ack->xDone, xTimeout);
+
+	taskENTER_CRITICAL();
+	if (p_ack->ul_done) {
+		if (p_reply)
+			*p_reply = p_ack->reply;
+		ret = CAN_CMD_OK;
+	}
+	else
+		ret = CAN_CMD_TIMEOUT;
+	p_ack->ul_armed = 0;
+	ul_ack_armed--;
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
+
+/************************************************************************/
+/*					CANCEL A REPLY WAITER								*/
+/*	Frees a waiter which will not be waited on (e.g. the request could	*/
+/*	not be sent).														*/
+/************************************************************************/
+
+void can_ack_cancel(uint32_t ul_handle)
+{
+	if (!ul_handle || (ul_handle > CAN_ACK_WAITERS))
+		return;
+
+	taskENTER_CRITICAL();
+	if (can_ack[ul_handle - 1].ul_armed) {
+		can_ack[ul_handle - 1].ul_armed = 0;
+		ul_ack_armed--;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/* Called by decode_can_msg() for every frame while a waiter is armed: releases
+*  the first armed waiter which matches, so a waiter sees at most one reply. */
+static void can_ack_release(const can_frame_t *p_frame)
+{
+	uint32_t i;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < CAN_ACK_WAITERS; i++) {
+		if (can_ack[i].ul_armed && !can_ack[i].ul_done
+			&& (can_ack[i].uc_ctrl == CAN_DUAL_LOGICAL(CAN_FRAME_CTRL(p_frame)))
+			&& (can_ack[i].ul_opcode == p_frame->ul_datal)) {
+			can_ack[i].reply = *p_frame;
+			can_ack[i].ul_done = 1;
+			break;
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	if (i < CAN_ACK_WAITERS)
+		xSemaphoreGive(can_ack[i].xDone);
+}
+
+/************************************************************************/
+/*					REGISTER A TRANSMIT HOOK							*/
+/*	hook is called from the CAN interrupt with every frame that has		*/
+/*	been sent by the TX scheduler, including its hardware timestamp.	*/
+/*	It must be short and may only use FromISR functions.				*/
+/*	Returns 0 if all CAN_TX_HOOKS slots are taken.						*/
+/************************************************************************/
+
+uint32_t can_register_tx_hook(can_handler_t hook)
+{
+	uint8_t i;
+	uint32_t ret = 0;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < CAN_TX_HOOKS; i++) {
+		if (!can_tx_hook[i]) {
+			can_tx_hook[i] = hook;
+			ret = 1;
+			break;
 		}
 	}
+	taskEXIT_CRITICAL();
+
+	return ret;
 }
 
 /************************************************************************/
@@ -128,56 +1366,60 @@ void CAN0_Handler(void)
 
 /**
  * \brief Decodes the CAN message and performs a prescribed action depending on 
- * the message received.
- * @param *controller:  	CAN sending controller
- * @param *p_mailbox:		CAN mailbox structure of sending controller
+ * the message received. Called from the CAN dispatch task, not from the ISR.
+ * The opcode costs one table index and one compare regardless of how many
+ * opcodes are registered. The rest is the route (can_route()) and one test of
+ * the armed waiters; the LEDs, the lookup timing and the dual-bus duplicate
+ * check are only built with CAN_RX_LEDS, CAN_DECODE_TIMING and
+ * CAN_DUAL_BUS_ENABLE.
+ * @param *p_frame:		Frame record taken out of the RX ring
  */
-void decode_can_msg(can_mb_conf_t *p_mailbox, Can* controller)
-{
-	//assert(g_ul_recv_status);		// Only decode if a message was received.	***Asserts here.
-	//assert(controller);				// CAN0 or CAN1 are nonzero.
-	uint32_t ul_data_incom = p_mailbox->ul_datal;
-	if(controller == CAN0)
-		pio_toggle_pin(LED0_GPIO);
-	if(controller == CAN1)
-		pio_toggle_pin(LED1_GPIO);
-	if (ul_data_incom == COMMAND_OUT)
-		pio_toggle_pin(LED0_GPIO);
-	if (ul_data_incom == COMMAND_IN)
-		pio_toggle_pin(LED1_GPIO);
-	if (ul_data_incom == DUMMY_COMMAND)
-		pio_toggle_pin(LED1_GPIO);
-	if (ul_data_incom == MSG_ACK)
-		pio_toggle_pin(LED1_GPIO);
-
-	if ((ul_data_incom == COMMAND_IN) & (controller == CAN0)) 
-	{
-		// Command has been received, respond.
-		pio_toggle_pin(LED0_GPIO);
-		command_in();
-	}
-	if ((ul_data_incom == COMMAND_OUT) & (controller == CAN1))
-	{
-		pio_toggle_pin(LED2_GPIO);	// LED2 indicates the response to the command
-	}								// has been received.
-	if ((ul_data_incom == HK_TRANSMIT) & (controller == CAN1))
-	{
-		pio_toggle_pin(LED3_GPIO);	// LED3 indicates housekeeping has been received.
-	}
-	if ((ul_data_incom == DUMMY_COMMAND) & (controller == CAN1))
-	{
-		pio_toggle_pin(LED3_GPIO);	// LED3 indicates housekeeping has been received.
+void decode_can_msg(can_frame_t *p_frame)
+{
+	const can_dispatch_entry_t *p_entry;
+	can_handler_t p_mb_handler;
+	uint32_t ul_start = 0, ul_cycles, ul_route;
+	uint8_t uc_ctrl = CAN_DUAL_LOGICAL(CAN_FRAME_CTRL(p_frame));
+
+	if (CAN_DECODE_TIMING)
+		ul_start = CAN_DWT_CYCCNT;
+
+	if (CAN_RX_LEDS) {
+		if (CAN_FRAME_CTRL(p_frame) == CAN_CTRL_1)
+			pio_toggle_pin(LED1_GPIO);
+		else
+			pio_toggle_pin(LED0_GPIO);
 	}
-	
-	if ((ul_data_incom == MSG_ACK) & (controller == CAN1))
-	{
-		pio_toggle_pin(LED3_GPIO);	// LED3 indicates the reception of a return message.
+
+	/* Second copy of a frame already received on the other bus. */
+	if (CAN_DUAL_BUS_ENABLE && !can_dual_accept(p_frame))
+		return;
+
+	p_mb_handler = can_mb_handler[uc_ctrl][CAN_FRAME_MB(p_frame)];
+	p_entry = &can_dispatch_table[uc_ctrl][CAN_OPCODE_INDEX(p_frame->ul_datal)];
+
+	if (CAN_DECODE_TIMING) {
+		ul_cycles = CAN_DWT_CYCCNT - ul_start;
+		can_rx_stats.ul_decode_cycles += ul_cycles;
+		if (ul_cycles > can_rx_stats.ul_decode_max_cycles)
+			can_rx_stats.ul_decode_max_cycles = ul_cycles;
 	}
-	
-	if ((ul_data_incom == HK_RETURNED) & (controller == CAN0))
-	{
-		pio_toggle_pin(LED2_GPIO);	// LED3 indicates the reception of housekeeping.
-	}	
+
+	if (ul_ack_armed)
+		can_ack_release(p_frame);
+
+	ul_route = can_route(p_frame->ul_id, p_mb_handler != NULL);
+	if (ul_route == CAN_ROUTE_MAILBOX)
+		p_mb_handler(p_frame);
+	else if (ul_route == CAN_ROUTE_EXT)
+		can_ext_decode(p_frame);
+	else if (ul_route == CAN_ROUTE_PDO)
+		can_pdo_rx(p_frame);
+	else if (p_entry->handler && (p_entry->ul_opcode == (p_frame->ul_datal & p_entry->ul_mask)))
+		p_entry->handler(p_frame);
+	else
+		can_rx_stats.ul_unhandled++;
+
 	return;
 }
 
@@ -208,151 +1450,145 @@ void reset_mailbox_conf(can_mb_conf_t *p_mailbox)
 /*                 SEND A 'COMMAND' FROM CAN1 TO CAN0		            */
 /************************************************************************/
 
+/* Gives back the mailboxes of the command exchange: CAN0 MB0 and CAN1 MB1 of
+*  command_out(), and CAN0 MB1 of command_in(), which also turns CAN1 MB1 into
+*  the reception mailbox of the answer. can_mailbox_release() disables their
+*  interrupts; a mailbox another owner holds is left alone. */
+static void command_release(void)
+{
+	can_mailbox_release(CAN0, 0, CAN_OWNER_COMMAND);
+	can_mailbox_release(CAN0, 1, CAN_OWNER_COMMAND);
+	can_mailbox_release(CAN1, 1, CAN_OWNER_COMMAND);
+}
+
 /**
- * \brief Sends a 'command' from CAN0 to CAN1
+ * \brief Sends a 'command' from CAN1 MB1 to CAN0 MB0 and waits for the response
+ * @param xTimeout:	Ticks to wait for the COMMAND_OUT response on CAN1.
+ * @return			CAN_CMD_OK, CAN_CMD_BUSY, CAN_CMD_TX_FAIL or CAN_CMD_TIMEOUT.
+ *
+ * Must not be called from a message handler (see can_ack_wait()).
  */
-void command_out(void)
+uint32_t command_out(TickType_t xTimeout)
 {
+	can_mb_conf_t rx_mailbox, tx_mailbox;
+	uint32_t ul_ack, ret;
+
+	if (!can_mailbox_claim(CAN0, 0, CAN_OWNER_COMMAND) || !can_mailbox_claim(CAN1, 1, CAN_OWNER_COMMAND)) {
+		command_release();
+		return CAN_CMD_BUSY;
+	}
+
 	pio_toggle_pin(LED0_GPIO);
-	can_reset_all_mailbox(CAN0);
-	can_reset_all_mailbox(CAN1);
 
 	/* Init CAN0 Mailbox 0 to Reception Mailbox. */
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 0;
-	can0_mailbox.uc_obj_type = CAN_MB_RX_MODE;
-	can0_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
-	can0_mailbox.ul_id = CAN_MID_MIDvA(7);
-	can_mailbox_init(CAN0, &can0_mailbox);
-
-	/* Init CAN1 Mailbox 0 to Transmit Mailbox. */
-	reset_mailbox_conf(&can1_mailbox);
-	can1_mailbox.ul_mb_idx = 0;
-	can1_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can1_mailbox.uc_tx_prio = 15;
-	can1_mailbox.uc_id_ver = 0;
-	can1_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN1, &can1_mailbox);
-
-	/* Write transmit information into mailbox. */
-	can1_mailbox.ul_id = CAN_MID_MIDvA(7);
-	can1_mailbox.ul_datal = COMMAND_IN;
-	can1_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
-	can1_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-	can_mailbox_write(CAN1, &can1_mailbox);
-
-	/* Enable CAN1 mailbox 0 interrupt. */
+	reset_mailbox_conf(&rx_mailbox);
+	rx_mailbox.ul_mb_idx = 0;
+	rx_mailbox.uc_obj_type = CAN_MB_RX_MODE;
+	rx_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
+	rx_mailbox.ul_id = CAN_MID_MIDvA(NODE1_ID);
+	can_mailbox_setup(CAN0, &rx_mailbox, CAN_OWNER_COMMAND);
+
+	/* Init CAN1 Mailbox 1 to Transmit Mailbox. */
+	reset_mailbox_conf(&tx_mailbox);
+	tx_mailbox.ul_mb_idx = 1;
+	tx_mailbox.uc_obj_type = CAN_MB_TX_MODE;
+	tx_mailbox.uc_tx_prio = 15;
+	tx_mailbox.uc_id_ver = 0;
+	tx_mailbox.ul_id_msk = 0;
+	can_mailbox_setup(CAN1, &tx_mailbox, CAN_OWNER_COMMAND);
+
+	/* Enable CAN0 mailbox 0 interrupt. */
 	can_enable_interrupt(CAN0, CAN_IER_MB0);
 
-	/* Send out the information in the mailbox. */
-	can_global_send_transfer_cmd(CAN1, CAN_TCR_MB0);
+	/* The response comes back to CAN1 from command_in(). */
+	ul_ack = can_ack_arm(CAN_CTRL_1, COMMAND_OUT);
+	if (!ul_ack) {
+		command_release();
+		return CAN_CMD_BUSY;
+	}
 
-	/* potentially @non-terminating@ */
-	while (!g_ul_recv_status) {
+	/* Write transmit information into mailbox and send it out. */
+	tx_mailbox.ul_id = CAN_MID_MIDvA(NODE1_ID);
+	tx_mailbox.ul_datal = COMMAND_IN;
+	tx_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
+	tx_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	if (can_mailbox_send(CAN1, &tx_mailbox, CAN_OWNER_COMMAND) != CAN_MAILBOX_TRANSFER_OK) {
+		can_ack_cancel(ul_ack);
+		command_release();
+		return CAN_CMD_TX_FAIL;
 	}
 
+	ret = can_ack_wait(ul_ack, xTimeout, NULL);
+	command_release();
+	return ret;
 }
 
 /************************************************************************/
 /*                 SEND A MESSAGE/COMMAND FROM CAN0				        */
 /*	This function will take in two 32 bit integers representing the high*/
 /*  bits and low bits of the message to be sent. It will then take in   */
-/*  the ID of the message to be sent and it's priority, the message will*/
-/*  then be sent out from CAN0 MB7.										*/
+/*  the ID of the message to be sent and it's priority. The message is	*/
+/*	placed in the TX queue at that priority and will be sent out from	*/
+/*	one of CAN0 MB6-MB7 as soon as one is free.							*/
 /*																		*/
-/*  The function will return 1 if the action was completed and 0 if not.*/
+/*  The function will return 1 if the message was queued and 0 if the	*/
+/*	TX queue is full (the message is dropped and counted).				*/
 /*	NOTE: a '1' does not indicate the transmission was successful.		*/
 /*																		*/
-/*	This function does not alter the can0_mailbox object.				*/
+/*	This function does not block and may be called in a loop.			*/
 /************************************************************************/
 
 uint32_t send_can_command(uint32_t low, uint32_t high, uint32_t ID, uint32_t PRIORITY)
 {	
-	/* We don't need to worry about saving and restoring the state of the can0_mailbox
-	*  because the interrupt handlers should do that for us, and in the future only one
-	*  task will be allowed in a CAN mailbox at any point in the through the use of
-	*  mutex locks.
-	*
-	*  Another thing! Don't place this function in a for loop if you plan on using it to
-	*  send from the same mailbox over and over again, make sure to yield in between calls
-	*  if that is what you're trying to do. Also, be sure to release and acquire mutex locks
-	*  in between each use of the CAN resource.
-	*/
-	
-	
-	/* Save current can0_mailbox object */
-	can_temp_t temp_mailbox;
-	save_can_object(&can0_mailbox, &temp_mailbox);
-	
-	/* Init CAN0 Mailbox 7 to Transmit Mailbox. */	
-	/* CAN0 MB7 == COMMAND/MSG MB				*/
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 7;			//Mailbox Number 7
-	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can0_mailbox.uc_tx_prio = 9;		//Transmission Priority (Can be Changed dynamically)
-	can0_mailbox.uc_id_ver = 0;
-	can0_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN0, &can0_mailbox);
-
-	/* Write transmit information into mailbox. */
-	can0_mailbox.ul_id = CAN_MID_MIDvA(ID);			// ID of the message being sent,
-	can0_mailbox.ul_datal = low;					// shifted over to the standard frame position.
-	can0_mailbox.ul_datah = high;
-	can0_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-	can_mailbox_write(CAN0, &can0_mailbox);
-
-	/* Send out the information in the mailbox. */
-	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB7);
-	
-	/* Restore the can0_mailbox object */
-	restore_can_object(&can0_mailbox, &temp_mailbox);
-	
-	return 1;
+	can_frame_t frame;
+
+	frame.ul_id = CAN_MID_MIDvA(ID);		// ID of the message being sent (see CAN_ID()),
+	frame.ul_datal = low;					// shifted over to the standard frame position.
+	frame.ul_datah = high;
+	frame.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	frame.uc_info = CAN_FRAME_INFO(CAN_CTRL_0, 0, 0);
+	frame.us_timestamp = 0;
+
+	return can_tx_enqueue(&frame, PRIORITY);
 }
 
 /************************************************************************/
-/*                 REQUEST HOUSKEEPING TO BE SENT TO CAN0		        */
-/*	This function will take in the ID of the node of interest. It will  */
-/*	then send a housekeeping request to this node at a fixed priority	*/
-/*	from CAN0 MB6.														*/
+/*                 SEND AN EXTENDED FRAME FROM CAN0				        */
+/*	ul_addr is CAN_EXT_ID(class, dst, CAN_NODE_OBC, type, 0); the		*/
+/*	sequence number is filled in here, one count per destination. low	*/
+/*	and high are uc_length bytes of payload (no opcode word). The frame */
+/*	is queued at PRIORITY like send_can_command().						*/
 /*																		*/
-/*  The function will return 1 if the action was completed and 0 if not.*/
-/*	NOTE: a '1' does not indicate the transaction was successful.		*/
-/*																		*/
-/*	This function does not alter the can0_mailbox object.				*/
+/*  Returns 1 if the frame was queued and 0 if the TX queue is full	*/
+/*	(the sequence number is not used up in that case).					*/
 /************************************************************************/
 
-uint32_t request_housekeeping(uint32_t ID)
+uint32_t send_can_ext(uint32_t ul_addr, uint32_t low, uint32_t high, uint8_t uc_length, uint32_t PRIORITY)
 {
-	/* Save current can0_mailbox object */
-	can_temp_t temp_mailbox;
-	save_can_object(&can0_mailbox, &temp_mailbox);
-	
-	/* Init CAN0 Mailbox 6 to Housekeeping Request Mailbox. */	
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 6;			//Mailbox Number 6
-	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can0_mailbox.uc_tx_prio = HK_REQUEST_PRIO;		//Transmission Priority (Can be Changed dynamically)
-	can0_mailbox.uc_id_ver = 0;
-	can0_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN0, &can0_mailbox);
-
-	/* Write transmit information into mailbox. */
-	can0_mailbox.ul_id = CAN_MID_MIDvA(ID);			// ID of the message being sent,
-	can0_mailbox.ul_datal = HK_REQUEST;				// shifted over to the standard frame position.
-	can0_mailbox.ul_datah = HK_REQUEST;
-	can0_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-	can_mailbox_write(CAN0, &can0_mailbox);
-
-	/* Send out the information in the mailbox. */
-	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB6);
-	
-	/* Restore the can0_mailbox object */
-	restore_can_object(&can0_mailbox, &temp_mailbox);
-		
-	return 1;
-}
+	can_frame_t frame;
+	uint8_t uc_dst = (uint8_t)CAN_EXT_DST(ul_addr);
+	uint32_t ret;
+
+	if (uc_length > MAX_CAN_FRAME_DATA_LEN)
+		return 0;
+
+	frame.ul_datal = low;
+	frame.ul_datah = high;
+	frame.uc_length = uc_length;
+	frame.uc_info = CAN_FRAME_INFO(CAN_CTRL_0, 0, 0);
+	frame.us_timestamp = 0;
 
+	/* The sequence number and the queue position are taken together so that
+	*  two tasks sending to one destination at the same priority cannot swap. */
+	taskENTER_CRITICAL();
+	frame.ul_id = CAN_MID_EXT((ul_addr & ~CAN_EXT_SEQ_Msk) | CAN_EXT_ID(0, 0, 0, 0, uc_ext_tx_seq[uc_dst]));
+	ret = can_tx_enqueue(&frame, PRIORITY);
+	if (ret)
+		uc_ext_tx_seq[uc_dst]++;
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
 
 /************************************************************************/
 /*				RESPOND TO THE COMMAND FROM CAN0 AND SEND TO CAN1       */
@@ -360,101 +1596,145 @@ uint32_t request_housekeeping(uint32_t ID)
 
 /**
  * \brief Responds to he command from CAN0 and sends to CAN1
+ * @return	CAN_CMD_OK once the response is in its mailbox, CAN_CMD_BUSY or CAN_CMD_TX_FAIL.
+ *
+ * Called from the dispatch task, so it does not wait for the response to arrive.
  **/
-void command_in(void)
+uint32_t command_in(void)
 {
+	can_mb_conf_t rx_mailbox, tx_mailbox;
+
+	if (!can_mailbox_claim(CAN1, 1, CAN_OWNER_COMMAND) || !can_mailbox_claim(CAN0, 1, CAN_OWNER_COMMAND)) {
+		command_release();
+		return CAN_CMD_BUSY;
+	}
+
 	pio_toggle_pin(LED0_GPIO);
 	
 	can_disable_interrupt(CAN0, CAN_IER_MB0);
-	NVIC_DisableIRQ(CAN0_IRQn);
-	
-	can_reset_all_mailbox(CAN0);
-	can_reset_all_mailbox(CAN1);
 
-	/* Init CAN1 Mailbox 0 to Reception Mailbox. */
-	reset_mailbox_conf(&can0_mailbox);
-	can1_mailbox.ul_mb_idx = 1;
-	can1_mailbox.uc_obj_type = CAN_MB_RX_MODE;
-	can1_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
-	can1_mailbox.ul_id = CAN_MID_MIDvA(7);
-	can_mailbox_init(CAN1, &can1_mailbox);
-
-	/* Init CAN0 Mailbox 0 to Transmit Mailbox. */
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 1;
-	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can0_mailbox.uc_tx_prio = 15;
-	can0_mailbox.uc_id_ver = 0;
-	can0_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN0, &can0_mailbox);
-
-	/* Write transmit information into mailbox. */
-	can0_mailbox.ul_id = CAN_MID_MIDvA(7);
-	can0_mailbox.ul_datal = COMMAND_OUT;
-	can0_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
-	can0_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-	can_mailbox_write(CAN0, &can0_mailbox);
-
-	/* Enable CAN1 mailbox 0 interrupt. */
-	can_enable_interrupt(CAN1, CAN_IER_MB1);
+	/* Init CAN1 Mailbox 1 to Reception Mailbox. */
+	reset_mailbox_conf(&rx_mailbox);
+	rx_mailbox.ul_mb_idx = 1;
+	rx_mailbox.uc_obj_type = CAN_MB_RX_MODE;
+	rx_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
+	rx_mailbox.ul_id = CAN_MID_MIDvA(NODE1_ID);
+	can_mailbox_setup(CAN1, &rx_mailbox, CAN_OWNER_COMMAND);
+
+	/* Init CAN0 Mailbox 1 to Transmit Mailbox. */
+	reset_mailbox_conf(&tx_mailbox);
+	tx_mailbox.ul_mb_idx = 1;
+	tx_mailbox.uc_obj_type = CAN_MB_TX_MODE;
+	tx_mailbox.uc_tx_prio = 15;
+	tx_mailbox.uc_id_ver = 0;
+	tx_mailbox.ul_id_msk = 0;
+	can_mailbox_setup(CAN0, &tx_mailbox, CAN_OWNER_COMMAND);
 
-	/* Send out the information in the mailbox. */
-	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB1);
+	/* Enable CAN1 mailbox 1 interrupt. */
+	can_enable_interrupt(CAN1, CAN_IER_MB1);
 
-	/* potentially @non-terminating@ */
-	while (!g_ul_recv_status) {
+	/* Write transmit information into mailbox and send it out. */
+	tx_mailbox.ul_id = CAN_MID_MIDvA(NODE1_ID);
+	tx_mailbox.ul_datal = COMMAND_OUT;
+	tx_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
+	tx_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	if (can_mailbox_send(CAN0, &tx_mailbox, CAN_OWNER_COMMAND) != CAN_MAILBOX_TRANSFER_OK) {
+		command_release();
+		return CAN_CMD_TX_FAIL;
 	}
+
+	return CAN_CMD_OK;
 }
 
 /************************************************************************/
-/*					SAVING CAN OBJECTS                                  */
-/*	This function will take in a mailbox object as the original pointer */
-/*  and save each of it's elements in a temporary can structure.        */
+/*					MAILBOX OWNERSHIP                                   */
+/*	Each of the 16 mailboxes has an owner. A mailbox must be claimed	*/
+/*	before it is configured or written and only its owner may use it.	*/
+/*	This replaces the old can0_mailbox/can1_mailbox save and restore;	*/
+/*	callers keep their can_mb_conf_t on their own stack.				*/
 /************************************************************************/
 
-void save_can_object(can_mb_conf_t *original, can_temp_t *temp)
+/**
+ * \brief Claims a mailbox for an owner.
+ * @param *controller:	CAN0 or CAN1
+ * @param uc_index:		Mailbox number (0 - 7)
+ * @param uc_owner:		One of the CAN_OWNER_* values
+ * @return 1 if the mailbox is now owned by uc_owner, 0 if someone else owns it.
+ */
+uint32_t can_mailbox_claim(Can *controller, uint8_t uc_index, uint8_t uc_owner)
 {
-	/*This function takes in a mailbox object as the original pointer*/
-	
-	
-	temp->ul_mb_idx		= original->ul_mb_idx;
-	temp->uc_obj_type	= original->uc_obj_type;
-	temp->uc_id_ver		= original->uc_id_ver;
-	temp->uc_length		= original->uc_length;
-	temp->uc_tx_prio	= original->uc_tx_prio;
-	temp->ul_status		= original->ul_status;
-	temp->ul_id_msk		= original->ul_id_msk;
-	temp->ul_id			= original->ul_id;
-	temp->ul_fid		= original->ul_fid;
-	temp->ul_datal		= original->ul_datal;
-	temp->ul_datah		= original->ul_datah;
-	
-	return;
+	uint8_t *p_owner = &uc_mb_owner[CAN_CTRL_INDEX(controller)][uc_index];
+	uint32_t ret = 0;
+
+	taskENTER_CRITICAL();
+	if ((*p_owner == CAN_OWNER_NONE) || (*p_owner == uc_owner)) {
+		*p_owner = uc_owner;
+		ret = 1;
+	}
+	taskEXIT_CRITICAL();
+
+	return ret;
 }
 
-/************************************************************************/
-/*					RESTORING CAN OBJECTS                               */
-/*	This function will take in a mailbox object as the original pointer */
-/*  and restore each of it's elements from a temporary can structure.   */
-/************************************************************************/
+/**
+ * \brief Releases a mailbox and disables it.
+ * @return 1 if released, 0 if uc_owner did not own the mailbox.
+ */
+uint32_t can_mailbox_release(Can *controller, uint8_t uc_index, uint8_t uc_owner)
+{
+	can_mb_conf_t mailbox;
+
+	if (!can_mailbox_owned(controller, uc_index, uc_owner))
+		return 0;
+
+	can_disable_interrupt(controller, (1u << uc_index));
+	reset_mailbox_conf(&mailbox);
+	mailbox.ul_mb_idx = uc_index;
+	mailbox.uc_obj_type = CAN_MB_DISABLE_MODE;
+	can_mailbox_init(controller, &mailbox);
+
+	uc_mb_owner[CAN_CTRL_INDEX(controller)][uc_index] = CAN_OWNER_NONE;
+	return 1;
+}
+
+/**
+ * \brief Returns 1 if uc_owner owns the mailbox.
+ */
+uint32_t can_mailbox_owned(Can *controller, uint8_t uc_index, uint8_t uc_owner)
+{
+	return (uc_mb_owner[CAN_CTRL_INDEX(controller)][uc_index] == uc_owner);
+}
 
-void restore_can_object(can_mb_conf_t *original, can_temp_t *temp)
+/**
+ * \brief Configures a mailbox that the caller owns.
+ * @param *p_mailbox:	Caller's (stack-local) mailbox descriptor
+ * @return 1 if the mailbox was configured, 0 if uc_owner does not own it.
+ */
+uint32_t can_mailbox_setup(Can *controller, can_mb_conf_t *p_mailbox, uint8_t uc_owner)
 {
-	/*This function takes in a mailbox object as the original pointer*/	
-	
-	original->ul_mb_idx		= temp->ul_mb_idx; 
-	original->uc_obj_type	= temp->uc_obj_type;
-	original->uc_id_ver		= temp->uc_id_ver;
-	original->uc_length		= temp->uc_length;
-	original->uc_tx_prio	= temp->uc_tx_prio;
-	original->ul_status		= temp->ul_status;
-	original->ul_id_msk		= temp->ul_id_msk;
-	original->ul_id			= temp->ul_id;
-	original->ul_fid		= temp->ul_fid;
-	original->ul_datal		= temp->ul_datal;
-	original->ul_datah		= temp->ul_datah;
-	
-	return;
+	if (!can_mailbox_owned(controller, (uint8_t)p_mailbox->ul_mb_idx, uc_owner))
+		return 0;
+
+	can_mailbox_init(controller, p_mailbox);
+	return 1;
+}
+
+/**
+ * \brief Writes a frame into a transmit mailbox that the caller owns and sends it.
+ * @param *p_mailbox:	Caller's (stack-local) mailbox descriptor
+ * @return CAN_MAILBOX_TRANSFER_OK, or CAN_MAILBOX_NOT_READY if the mailbox is
+ *         busy or not owned by uc_owner.
+ */
+uint32_t can_mailbox_send(Can *controller, can_mb_conf_t *p_mailbox, uint8_t uc_owner)
+{
+	if (!can_mailbox_owned(controller, (uint8_t)p_mailbox->ul_mb_idx, uc_owner))
+		return CAN_MAILBOX_NOT_READY;
+
+	if (can_mailbox_write(controller, p_mailbox) != CAN_MAILBOX_TRANSFER_OK)
+		return CAN_MAILBOX_NOT_READY;
+
+	can_global_send_transfer_cmd(controller, (uint8_t)(1u << p_mailbox->ul_mb_idx));
+	return CAN_MAILBOX_TRANSFER_OK;
 }
 
 /**
@@ -465,6 +1745,7 @@ void can_initialize(void)
 {
 	uint32_t ul_sysclk;
 	uint32_t x = 1;
+	uint32_t i;
 
 	/* Initialize CAN0 Transceiver. */
 	sn65hvd234_set_rs(&can0_transceiver, PIN_CAN0_TR_RS_IDX);
@@ -485,12 +1766,39 @@ void can_initialize(void)
 	pmc_enable_periph_clk(ID_CAN1);
 
 	ul_sysclk = sysclk_get_cpu_hz();
+	/* Start the cycle counter used for the ISR timing statistics. */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	CAN_DWT_CYCCNT = 0;
+	CAN_DWT_CTRL |= CAN_DWT_CTRL_CYCCNTENA;
+
+	can_stats_init();
+
+	/* The RX semaphore and dispatch task must exist before the handlers can run. */
+	xCanRxSemaphore = xSemaphoreCreateBinary();
+	for (i = 0; i < CAN_ACK_WAITERS; i++)
+		can_ack[i].xDone = xSemaphoreCreateBinary();
+	xTaskCreate(prvCANDispatchTask,				/* The function that implements the task. */
+				"CANRX",						/* The text name assigned to the task - for debug only. */
+				CAN_DISPATCH_STACK,				/* The size of the stack to allocate to the task. */
+				NULL,							/* No parameter is passed. */
+				CAN_DISPATCH_PRIORITY,			/* The priority assigned to the task. */
+				NULL);							/* The task handle is not required. */
+
 	if (can_init(CAN0, ul_sysclk, CAN_BPS_250K) &&
 	can_init(CAN1, ul_sysclk, CAN_BPS_250K)) {
 
+	/* Timestamps are taken at the end of each frame. */
+	can_set_timestamp_capture_point(CAN0, 1);
+	can_set_timestamp_capture_point(CAN1, 1);
+
 	/* Disable all CAN0 & CAN1 interrupts. */
 	can_disable_interrupt(CAN0, CAN_DISABLE_ALL_INTERRUPT_MASK);
 	can_disable_interrupt(CAN1, CAN_DISABLE_ALL_INTERRUPT_MASK);
+
+	/* The handlers call FreeRTOS FromISR functions, so they must not be above
+	*  configMAX_SYSCALL_INTERRUPT_PRIORITY. */
+	NVIC_SetPriority(CAN0_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	NVIC_SetPriority(CAN1_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
 		
 	NVIC_EnableIRQ(CAN0_IRQn);
 	NVIC_EnableIRQ(CAN1_IRQn);
@@ -501,46 +1809,195 @@ void can_initialize(void)
 	/* Initialize the CAN0 & CAN1 mailboxes */
 	x = can_init_mailboxes(x); // Prevent Random PC jumps to this point.
 	//configASSERT(x);
+
+	/* Error interrupts and bus-off recovery. */
+	can_err_init();
+
+	/* Per-node receive budgets (babbling-idiot guard). */
+	can_guard_init();
+
+	/* Interrupt / polling receive mode (only with CAN_POLL_ENABLE). */
+	can_poll_init();
 	
 	
 	}
 	return;
 }
 
+/* IDs the OBC listens to on each controller. Add a range here to subscribe to
+*  more traffic; the filter planner takes care of the mailboxes. */
+static const can_id_range_t can0_subscriptions[] = {
+	{ CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID0, 0),		// Transport frames.
+	  CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID5, 3) },
+	{ CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID0, 0),		// Housekeeping replies.
+	  CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID5, 3) },
+};
+
+static const can_id_range_t can0_pdo_subscriptions[] = {
+	{ PDO_ID(SUB0_ID0, 0),									// Cyclic process data.
+	  PDO_ID(SUB0_ID5, CAN_PDO_PER_NODE - 1) },
+};
+
+#if !CAN_DUAL_BUS_ENABLE && !CAN_GW_ENABLE
+static const can_id_range_t can1_subscriptions[] = {
+	{ NODE0_ID, NODE0_ID },
+};
+#endif
+
+can_filter_plan_t can_rx_plan[2];
+can_filter_plan_t can_rx_pdo_plan;
+
+static void can_ext_rx_setup(Can *controller)
+{
+	can_mb_conf_t mailbox;
+
+	if (!can_mailbox_claim(controller, CAN0_EXT_RX_MB, CAN_OWNER_DRIVER))
+		return;
+
+	reset_mailbox_conf(&mailbox);
+	mailbox.ul_mb_idx = CAN0_EXT_RX_MB;
+	mailbox.uc_obj_type = CAN_MB_RX_MODE;
+	mailbox.uc_id_ver = 1;
+	mailbox.ul_id_msk = CAN_EXT_DST_Msk;
+	mailbox.ul_id = CAN_EXT_ID(0, CAN_NODE_OBC, 0, 0, 0);
+	can_mailbox_setup(controller, &mailbox, CAN_OWNER_DRIVER);
+	can_enable_interrupt(controller, (1u << CAN0_EXT_RX_MB));
+}
+
+/************************************************************************/
+/*				RE-PLAN THE RECEPTION FILTERS                           */
+/*	Dispatch task context (can_guard_service()). Loads the filter of	*/
+/*	the commands and replies of uc_ctrl again, without the IDs of the	*/
+/*	source nodes in ul_nodes (bit n = node n), or the full plan when	*/
+/*	ul_nodes is 0. When one filter cannot keep the nodes out, the		*/
+/*	mailboxes of its FIFO are planned as separate filters until the		*/
+/*	full plan is back. A frame waiting in one of them is lost.			*/
+/*	The process-data and extended mailboxes keep their filters.			*/
+/*	Returns 1 if the frames of the nodes no longer reach the mailboxes	*/
+/*	(or the full plan was loaded), 0 if the filters were left alone.	*/
+/************************************************************************/
+
+uint32_t can_rx_replan(uint8_t uc_ctrl, uint32_t ul_nodes)
+{
+	Can *controller = (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+	const can_id_range_t *p_subs = can0_subscriptions;
+	uint32_t ul_subs = sizeof(can0_subscriptions) / sizeof(can0_subscriptions[0]);
+	uint8_t uc_first = CAN0_RX_MB_FIRST, uc_filters = CAN0_RX_MB_COUNT, uc_depth = CAN0_RX_FIFO_DEPTH;
+	can_id_range_t ranges[CAN_FILTER_MAX_BLOCKS];
+	can_filter_t except[8];
+	can_filter_plan_t plan;
+	can_mb_conf_t mailbox;
+	uint32_t ul_except = 0, ul_ranges, ul_mbs;
+	uint8_t i;
+
+	if (CAN_GW_ENABLE && (uc_ctrl == CAN_CTRL_1))
+		return 0;				// The gateway rules own the CAN1 filters.
+#if !CAN_DUAL_BUS_ENABLE && !CAN_GW_ENABLE
+	if (uc_ctrl == CAN_CTRL_1) {
+		p_subs = can1_subscriptions;
+		ul_subs = sizeof(can1_subscriptions) / sizeof(can1_subscriptions[0]);
+		uc_first = CAN1_RX_MB_FIRST;
+		uc_filters = CAN1_RX_MB_COUNT;
+		uc_depth = CAN1_RX_FIFO_DEPTH;
+	}
+#endif
+
+	/* Standard IDs carry sources 0 - 7 only. */
+	for (i = 0; i < 8; i++) {
+		if (ul_nodes & (1u << i)) {
+			except[ul_except].us_id = (uint16_t)CAN_ID(0, 0, i, 0);
+			except[ul_except].us_mask = (uint16_t)CAN_ID(0, 0, 0x7, 0);
+			ul_except++;
+		}
+	}
+	if (ul_nodes && !ul_except)
+		return 0;
+
+	ul_ranges = can_filter_subtract(p_subs, ul_subs, except, ul_except, ranges, CAN_FILTER_MAX_BLOCKS);
+	if (!ul_ranges)
+		return 0;
+	if (!can_filter_plan_except(ranges, ul_ranges, except, ul_except, uc_filters, &plan)) {
+		if (!can_filter_plan_except(ranges, ul_ranges, except, ul_except, uc_filters * uc_depth, &plan))
+			return 0;
+		uc_filters *= uc_depth;
+		uc_depth = 1;
+	}
+
+	ul_mbs = ((1u << (uc_filters * uc_depth)) - 1) << uc_first;
+
+	taskENTER_CRITICAL();
+	can_disable_interrupt(controller, ul_mbs);
+	can_rx_fifo_mask[uc_ctrl] &= ~ul_mbs;
+	for (i = uc_first + plan.uc_count * uc_depth; i < uc_first + uc_filters * uc_depth; i++) {
+		reset_mailbox_conf(&mailbox);
+		mailbox.ul_mb_idx = i;
+		mailbox.uc_obj_type = CAN_MB_DISABLE_MODE;
+		can_mailbox_setup(controller, &mailbox, CAN_OWNER_DRIVER);
+	}
+	can_filter_apply(controller, &plan, uc_first, uc_depth, CAN_OWNER_DRIVER);
+	/* Polled and isolated mailboxes keep their interrupt off. */
+	can_disable_interrupt(controller, ul_mbs & (can_rx_polled[uc_ctrl] | can_rx_isolated[uc_ctrl]));
+	can_rx_plan[uc_ctrl] = plan;
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
 uint32_t can_init_mailboxes(uint32_t x)
 {
-	/* Init CAN0 Mailbox 7 to Transmit Mailbox. */	
-	/* CAN0 MB7 == COMMAND/MSG MB				*/
+	uint8_t i;
+
+	/* CAN0 MB6-MB7 == TX scheduler mailboxes (COMMAND/MSG and HK requests),
+	*  and CAN1 MB6-MB7 with the dual bus. */
 	//configASSERT(x);	//Check if this function was called naturally.
+	(void)x;
+	for (i = CAN_TX_MB_FIRST; i <= CAN_TX_MB_LAST; i++) {
+		can_mailbox_claim(CAN0, i, CAN_OWNER_DRIVER);
+		if (CAN1_TX_MB_MASK & (1u << i))
+			can_mailbox_claim(CAN1, i, CAN_OWNER_DRIVER);
+	}
+	can_tx_init();
 	
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 7;			//Mailbox Number 7
-	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can0_mailbox.uc_tx_prio = 5;		//Transmission Priority (Can be Changed dynamically)
-	can0_mailbox.uc_id_ver = 0;
-	can0_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN0, &can0_mailbox);
-	
-	/* Init CAN1 Mailbox 0 to Reception Mailbox. */
-	reset_mailbox_conf(&can1_mailbox);
-	can1_mailbox.ul_mb_idx = 0;				// Mailbox 0
-	can1_mailbox.uc_obj_type = CAN_MB_RX_MODE;
-	can1_mailbox.ul_id_msk = CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk;	  // Compare the full 11 bits of the ID in both standard and extended.
-	can1_mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);					  // The ID of CAN1 MB0 is currently NODE0_ID (standard).
-	can_mailbox_init(CAN1, &can1_mailbox);
-	
-	can_enable_interrupt(CAN1, CAN_IER_MB0);
-	
-	/* Init CAN0 Mailbox 6 to Housekeeping Request Mailbox. */	
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 6;			//Mailbox Number 6
-	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can0_mailbox.uc_tx_prio = HK_REQUEST_PRIO;		//Transmission Priority (Can be Changed dynamically)
-	can0_mailbox.uc_id_ver = 0;
-	can0_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN0, &can0_mailbox);
+	/* Reception mailboxes: commands and replies in the FIFO, process data in a
+	*  mailbox of their own. The false-accept counts are kept in the plans. */
+	if (can_filter_plan(can0_subscriptions, sizeof(can0_subscriptions) / sizeof(can0_subscriptions[0]),
+			CAN0_RX_MB_COUNT, &can_rx_plan[CAN_CTRL_0]))
+		can_filter_apply(CAN0, &can_rx_plan[CAN_CTRL_0], CAN0_RX_MB_FIRST, CAN0_RX_FIFO_DEPTH, CAN_OWNER_DRIVER);
+	if (can_filter_plan(can0_pdo_subscriptions, sizeof(can0_pdo_subscriptions) / sizeof(can0_pdo_subscriptions[0]),
+			1, &can_rx_pdo_plan))
+		can_filter_apply(CAN0, &can_rx_pdo_plan, CAN0_PDO_RX_MB, 1, CAN_OWNER_DRIVER);
+#if CAN_DUAL_BUS_ENABLE
+	/* The second bus carries the same traffic: CAN1 gets the CAN0 filters. */
+	can_rx_plan[CAN_CTRL_1] = can_rx_plan[CAN_CTRL_0];
+	if (can_rx_plan[CAN_CTRL_1].uc_count)
+		can_filter_apply(CAN1, &can_rx_plan[CAN_CTRL_1], CAN0_RX_MB_FIRST, CAN0_RX_FIFO_DEPTH, CAN_OWNER_DRIVER);
+	if (can_rx_pdo_plan.uc_count)
+		can_filter_apply(CAN1, &can_rx_pdo_plan, CAN0_PDO_RX_MB, 1, CAN_OWNER_DRIVER);
+#elif CAN_GW_ENABLE
+	/* CAN1 is the payload bus: the gateway rules decide what it receives. */
+	can_gw_init();
+#else
+	if (can_filter_plan(can1_subscriptions, sizeof(can1_subscriptions) / sizeof(can1_subscriptions[0]),
+			CAN1_RX_MB_COUNT, &can_rx_plan[CAN_CTRL_1]))
+		can_filter_apply(CAN1, &can_rx_plan[CAN_CTRL_1], CAN1_RX_MB_FIRST, CAN1_RX_FIFO_DEPTH, CAN_OWNER_DRIVER);
+#endif
+
+	/* Extended frames addressed to the OBC, whatever their class, source or type. */
+	can_ext_rx_setup(CAN0);
+	if (CAN_DUAL_BUS_ENABLE)
+		can_ext_rx_setup(CAN1);
+
+	/* Housekeeping replies. */
+	can_hk_init();
+
+	/* Segmented transport (uses the TX scheduler). */
+	can_tp_init();
+
+	/* Node heartbeats. */
+	can_nmt_init();
+
+	/* Cyclic process data. */
+	can_pdo_init();
 
 	return 1;
 }
-	
-	
\ No newline at end of file
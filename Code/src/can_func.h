@@ -11,7 +11,7 @@
 	*	
 	*
 	*	FILE REFERENCES:	sn65hvd234.h, can.h, stdio.h, string.h, board.h, sysclk.h, exceptions.h
-	*						pmc.h, conf_board.h, conf_clock.h, pio.h
+	*						pmc.h, conf_board.h, conf_clock.h, pio.h, FreeRTOS.h
 	*
 	*	EXTERNAL VARIABLES:	
 	*
@@ -38,11 +38,73 @@
 	*					Added to the list of ID and message definitions in order to communicate
 	*					more effectively with the STK600.
 	*
+	*	10/17/2026		Added can_frame_t and the RX ring which the CAN interrupt handlers now use
+	*					to hand received frames off to the CAN dispatch task.
+	*
+	*					Added the TX scheduler definitions (CAN0 MB6-MB7 transmit pool).
+	*
+	*					Removed can_temp_t and the shared can0_mailbox/can1_mailbox objects.
+	*					Added the mailbox owners, one per module and test program. The
+	*					transceivers are now defined in can_func.c.
+	*
+	*					request_housekeeping() is now implemented in can_hk.c; see can_hk.h for
+	*					waiting on the reply.
+	*
+	*					Added can_handler_t and can_register_handler() for the dispatch table.
+	*
+	*					Added can_register_prefix_handler() and can_tx_pending().
+	*
+	*					Added the reception mailbox ranges used by the filter planner.
+	*
+	*					can_frame_t now carries the hardware timestamp of the frame. The
+	*					controller, mailbox and read flags share uc_info, and the size is
+	*					checked to stay 16 bytes with the data words adjacent.
+	*					Added can_register_tx_hook().
+	*
+	*					Added can_register_mb_handler().
+	*
+	*					Added the request/acknowledge waiters (can_ack_arm(), can_ack_wait()).
+	*					command_out() and command_in() now return a CAN_CMD_* result.
+	*
+	*					Added the identifier layout (CAN_ID()). Priority classes are now encoded in
+	*					the high bits of every ID so bus arbitration follows mission priority.
+	*					NODE0_ID/NODE1_ID are now built with CAN_ID() and SUB0_IDx are node numbers.
+	*
+	*					Added extended frames (CAN_EXT_ID(), send_can_ext(), can_register_ext_handler())
+	*					and the CAN0 MB5 extended reception mailbox.
+	*
+	*					Added can_tx_hold() and can_tx_reclaim() for the bus-off recovery
+	*					(can_err.c). They take the controller: with the dual bus (can_dual.h)
+	*					the TX scheduler also uses CAN1 MB6-MB7.
+	*
+	*					Added can_mb_bench() (CAN_MB_BENCH, can be set from the build).
+	*
+	*					Added CAN0_RX_FIFO_DEPTH and CAN1_RX_FIFO_DEPTH (receive FIFOs).
+	*					Added can_rx_poll() for the polling receive mode (can_poll.h).
+	*
+	*					Class 6 is now CAN_PRIO_PDO (cyclic process data, can_pdo.h).
+	*
+	*					CAN0 layout: MB0-MB1 test programs, MB2-MB3 the reception FIFO
+	*					(CAN0_RX_FIFO_DEPTH 2), MB4 the process data (CAN0_PDO_RX_MB), MB5 the
+	*					extended frames (CAN0_EXT_RX_MB) and MB6-MB7 the TX pool.
+	*
+	*					Added CAN_RX_LEDS and CAN_DECODE_TIMING; both are off by default so that
+	*					decode_can_msg() is the table lookup and the route.
+	*
+	*					Added can_rx_replan() for the receive guard (can_guard.c) and
+	*					can_dispatch_wake() for the error handling (can_err.c).
+	*
+	*					Added CAN_MB_COPY2(), shared by can_func.c and the gateway (can_gw.c).
+	*
 */
 
+#ifndef CAN_FUNC_H
+#define CAN_FUNC_H
+
 #include <asf/sam/components/can/sn65hvd234.h>
 #include <asf/sam/drivers/can/can.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include "board.h"
 #include "sysclk.h"
@@ -51,28 +113,13 @@
 #include "conf_board.h"
 #include "conf_clock.h"
 #include "pio.h"
-
-typedef struct {
-	uint32_t ul_mb_idx;
-	uint8_t uc_obj_type;  /**< Mailbox object type, one of the six different
-	                         objects. */
-	uint8_t uc_id_ver;    /**< 0 stands for standard frame, 1 stands for
-	                         extended frame. */
-	uint8_t uc_length;    /**< Received data length or transmitted data
-	                         length. */
-	uint8_t uc_tx_prio;   /**< Mailbox priority, no effect in receive mode. */
-	uint32_t ul_status;   /**< Mailbox status register value. */
-	uint32_t ul_id_msk;   /**< No effect in transmit mode. */
-	uint32_t ul_id;       /**< Received frame ID or the frame ID to be
-	                         transmitted. */
-	uint32_t ul_fid;      /**< Family ID. */
-	uint32_t ul_datal;
-	uint32_t ul_datah;
-} can_temp_t;
+#include "FreeRTOS.h"
 
 /*		CURRENT PRIORITY LEVELS			
 	Note: ID and priority are two different things.
-		  For the sake of simplicity, I am making them the same.
+		  These levels order the OBC's own TX queue (can_tx_enqueue()). What
+		  decides arbitration on the bus is the class in the ID, see
+		  IDENTIFIER LAYOUT below.
 
 		COMS TO CDH COMMAND (IMMED)	0
 		PAYLOAD COMMAND				1
@@ -97,15 +144,130 @@ typedef struct {
 #define HK_RETURNED					0XF0F0F0F0
 #define HK_REQUEST					0x0F0F0F0F
 
-#define NODE0_ID				10
-#define NODE1_ID				9
+/*		IDENTIFIER LAYOUT (11-bit standard ID)
+		bits 10:8	class	priority class, 0 wins arbitration (CAN_PRIO_*)
+		bits 7:5	dst		destination node (CAN_NODE_*)
+		bits 4:2	src		source node
+		bits 1:0	type	CAN_TYPE_*
+
+	Since the class is the most significant field, a frame of class k always wins
+	arbitration against any frame of a class > k, whatever the nodes. Within a
+	class, lower destination, then lower source, wins. Every frame on the bus must
+	be built with CAN_ID(); all fields are constants in normal use, so the ID is
+	computed by the compiler.
+
+	Worst-case latency of a class k frame, from being queued in a mailbox to the
+	end of its transmission (non-preemptive fixed priority):
+		R(k) = C + B + I(k)
+		C	 = CAN_FRAME_MAX_US, the frame itself
+		B	 = CAN_FRAME_MAX_US, one lower-class frame which already started
+		I(k) = sum over the classes j < k of ceil(R(k) / T(j)) * C * N(j),
+			   T(j) = shortest period of class j, N(j) = frames per period
+	Only the classes above k count, so housekeeping and bulk data never add to
+	the latency of an immediate command (R(0) = 2 * C, 1.08 ms at 250 kbit/s).
+*/
+#define CAN_ID_CLASS_Pos		8
+#define CAN_ID_DST_Pos			5
+#define CAN_ID_SRC_Pos			2
+#define CAN_ID_TYPE_Pos			0
+
+#define CAN_ID(class, dst, src, type)	( ( ( ( uint32_t )( class ) & 0x7 ) << CAN_ID_CLASS_Pos ) \
+										| ( ( ( uint32_t )( dst ) & 0x7 ) << CAN_ID_DST_Pos ) \
+										| ( ( ( uint32_t )( src ) & 0x7 ) << CAN_ID_SRC_Pos ) \
+										| ( ( ( uint32_t )( type ) & 0x3 ) << CAN_ID_TYPE_Pos ) )
+#define CAN_ID_CLASS(id)		( ( ( uint32_t )( id ) >> CAN_ID_CLASS_Pos ) & 0x7 )
+#define CAN_ID_DST(id)			( ( ( uint32_t )( id ) >> CAN_ID_DST_Pos ) & 0x7 )
+#define CAN_ID_SRC(id)			( ( ( uint32_t )( id ) >> CAN_ID_SRC_Pos ) & 0x7 )
+#define CAN_ID_TYPE(id)			( ( ( uint32_t )( id ) >> CAN_ID_TYPE_Pos ) & 0x3 )
+#define CAN_MID_TO_ID(mid)		( ( ( uint32_t )( mid ) & CAN_MID_MIDvA_Msk ) >> CAN_MID_MIDvA_Pos )
+
+/* Priority classes, from the list above. */
+#define CAN_PRIO_IMMED			0		// COMS to CDH command (immediate).
+#define CAN_PRIO_PAYLOAD_CMD	1		// Payload command.
+#define CAN_PRIO_SCHED			2		// COMS to CDH command (scheduled).
+#define CAN_PRIO_SUB_CMD		3		// EPS and COMS commands.
+#define CAN_PRIO_DATA			4		// COMS and payload data (segmented transport).
+#define CAN_PRIO_HK				5		// Housekeeping requests and replies.
+#define CAN_PRIO_PDO			6		// Cyclic process data (can_pdo.h).
+#define CAN_PRIO_TEST			7		// LED toggle and test traffic.
+
+/* Message types. A reply uses the class of the message it answers. */
+#define CAN_TYPE_CMD			0
+#define CAN_TYPE_REQ			1
+#define CAN_TYPE_REPLY			2
+#define CAN_TYPE_DATA			3
+
+/* Nodes. */
+#define CAN_NODE_OBC			0		// This board (CDH).
+#define CAN_NODE_SUB(n)			( ( n ) + 1 )
+#define CAN_NODE_ALL			7		// Broadcast.
+
+/* Longest standard frame on the bus: 8 data bytes, worst-case stuffing and
+*  the interframe space (135 bit times). */
+#define CAN_FRAME_MAX_BITS		135
+#define CAN_FRAME_MAX_US		( CAN_FRAME_MAX_BITS * 4 )		// At 250 kbit/s.
+
+/* Rejects a layout which no longer fits in 11 bits at compile time. */
+typedef char can_id_layout_check[( CAN_ID(7, 7, 7, 3) == 0x7FF ) ? 1 : -1];
+
+/*		EXTENDED FRAMES (29-bit ID)
+		bits 28:26	class	same classes as CAN_ID()
+		bits 25:21	dst		destination node
+		bits 20:16	src		source node
+		bits 15:8	type	message type; replaces the opcode word so all 8 data
+							bytes are payload
+		bits 7:0	seq		sequence number per destination, set by send_can_ext()
+
+	The class is in the top bits of the base ID of both formats, so standard and
+	extended frames arbitrate against each other by class as well. Both formats
+	share the TX queue and the dispatch task: decode_can_msg() passes extended
+	frames to the handler registered for their type with can_register_ext_handler()
+	and standard frames to the opcode table as before, so the standard API keeps
+	working during the migration.
+
+	Since the 29-bit ID fills MIDvA and MIDvB, the MID value of an extended frame
+	(can_frame_t.ul_id) is CAN_MID_EXT(id).
+*/
+#define CAN_EXT_CLASS_Pos		26
+#define CAN_EXT_DST_Pos			21
+#define CAN_EXT_SRC_Pos			16
+#define CAN_EXT_TYPE_Pos		8
+#define CAN_EXT_SEQ_Pos			0
+
+#define CAN_EXT_DST_Msk			( 0x1Fu << CAN_EXT_DST_Pos )
+#define CAN_EXT_SEQ_Msk			( 0xFFu << CAN_EXT_SEQ_Pos )
+#define CAN_EXT_NODES			32
+#define CAN_EXT_TYPES			256
+
+#define CAN_EXT_ID(class, dst, src, type, seq)	( ( ( ( uint32_t )( class ) & 0x7 ) << CAN_EXT_CLASS_Pos ) \
+												| ( ( ( uint32_t )( dst ) & 0x1F ) << CAN_EXT_DST_Pos ) \
+												| ( ( ( uint32_t )( src ) & 0x1F ) << CAN_EXT_SRC_Pos ) \
+												| ( ( ( uint32_t )( type ) & 0xFF ) << CAN_EXT_TYPE_Pos ) \
+												| ( ( ( uint32_t )( seq ) & 0xFF ) << CAN_EXT_SEQ_Pos ) )
+#define CAN_EXT_CLASS(id)		( ( ( uint32_t )( id ) >> CAN_EXT_CLASS_Pos ) & 0x7 )
+#define CAN_EXT_DST(id)			( ( ( uint32_t )( id ) >> CAN_EXT_DST_Pos ) & 0x1F )
+#define CAN_EXT_SRC(id)			( ( ( uint32_t )( id ) >> CAN_EXT_SRC_Pos ) & 0x1F )
+#define CAN_EXT_TYPE(id)		( ( ( uint32_t )( id ) >> CAN_EXT_TYPE_Pos ) & 0xFF )
+#define CAN_EXT_SEQ(id)			( ( ( uint32_t )( id ) >> CAN_EXT_SEQ_Pos ) & 0xFF )
+
+#define CAN_MID_EXT(id)			( ( ( uint32_t )( id ) & 0x1FFFFFFF ) | CAN_MID_MIDE )
+#define CAN_MID_IS_EXT(mid)		( ( ( uint32_t )( mid ) & CAN_MID_MIDE ) != 0 )
+#define CAN_MID_TO_EXT_ID(mid)	( ( uint32_t )( mid ) & 0x1FFFFFFF )
+
+typedef char can_ext_layout_check[( CAN_EXT_ID(7, 31, 31, 255, 255) == 0x1FFFFFFF ) ? 1 : -1];
 
-#define SUB0_ID0				20
-#define SUB0_ID1				21
-#define SUB0_ID2				22
-#define SUB0_ID3				23
-#define SUB0_ID4				24
-#define SUB0_ID5				25
+/* Test traffic between CAN0 and CAN1 of the OBC. */
+#define NODE0_ID				CAN_ID(CAN_PRIO_TEST, CAN_NODE_OBC, CAN_NODE_OBC, CAN_TYPE_CMD)
+#define NODE1_ID				CAN_ID(CAN_PRIO_TEST, CAN_NODE_OBC, CAN_NODE_OBC, CAN_TYPE_REPLY)
+
+/* Subsystem nodes. These are node numbers: build the ID of a frame to or from
+*  them with CAN_ID(). */
+#define SUB0_ID0				CAN_NODE_SUB(0)
+#define SUB0_ID1				CAN_NODE_SUB(1)
+#define SUB0_ID2				CAN_NODE_SUB(2)
+#define SUB0_ID3				CAN_NODE_SUB(3)
+#define SUB0_ID4				CAN_NODE_SUB(4)
+#define SUB0_ID5				CAN_NODE_SUB(5)
 
 #define COMMAND_PRIO			10
 #define HK_REQUEST_PRIO			20
@@ -113,34 +275,272 @@ typedef struct {
 /** CAN frame max data length */
 #define MAX_CAN_FRAME_DATA_LEN      8
 
-/** CAN0 Transceiver */
-sn65hvd234_ctrl_t can0_transceiver;
+/*		RX RING AND DISPATCH TASK
+	The interrupt handlers only copy the mailbox into a can_frame_t and push it
+	into the RX ring (single producer = ISR, single consumer = dispatch task).
+	CAN_RX_RING_SIZE must be a power of two.
+*/
+#define CAN_RX_RING_SIZE		32
+#define CAN_DISPATCH_PRIORITY	( tskIDLE_PRIORITY + 4 )	// Highest task priority (configMAX_PRIORITIES = 5).
+#define CAN_DISPATCH_STACK		( configMINIMAL_STACK_SIZE * 2 )
 
-/** CAN1 Transceiver */
-sn65hvd234_ctrl_t can1_transceiver;
+#define CAN_CTRL_0				0		// Controller values in can_frame_t (CAN_FRAME_CTRL).
+#define CAN_CTRL_1				1
+
+/* DWT cycle counter, used to measure time spent in the interrupt handlers. */
+#define CAN_DWT_CTRL			( *( volatile uint32_t * ) 0xE0001000 )
+#define CAN_DWT_CYCCNT			( *( volatile uint32_t * ) 0xE0001004 )
+#define CAN_DWT_CTRL_CYCCNTENA	( 0x1u << 0 )
+
+/* Compact record of a received or transmitted frame (16 bytes, word aligned).
+*  This is all the per-frame path carries; the mailbox configuration stays in
+*  can_mb_conf_t and is only used when a mailbox is set up. ul_datal and
+*  ul_datah must stay adjacent: they are copied to and from MDL/MDH as a pair. */
+typedef struct {
+	uint32_t ul_id;			/**< CAN_MID value of the frame. */
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	uint8_t uc_length;
+	uint8_t uc_info;		/**< Mailbox (2:0), controller (3), can_mailbox_read() flags (5:4). */
+	uint16_t us_timestamp;	/**< CAN timer value captured at the end of the frame (MSR.MTIMESTAMP). */
+} can_frame_t;
+
+typedef char can_frame_layout_check[( ( sizeof(can_frame_t) == 16 )
+		&& ( offsetof(can_frame_t, ul_datah) == offsetof(can_frame_t, ul_datal) + 4 ) ) ? 1 : -1];
+
+#define CAN_FRAME_INFO(ctrl, mb, flags)	( ( uint8_t )( ( ( mb ) & 0x7 ) | ( ( ( ctrl ) & 0x1 ) << 3 ) | ( ( ( flags ) & 0x3 ) << 4 ) ) )
+#define CAN_FRAME_MB(p_frame)		( ( p_frame )->uc_info & 0x7 )
+#define CAN_FRAME_CTRL(p_frame)		( ( ( p_frame )->uc_info >> 3 ) & 0x1 )
+#define CAN_FRAME_FLAGS(p_frame)	( ( ( p_frame )->uc_info >> 4 ) & 0x3 )
+
+/*		HARDWARE TIMESTAMPS
+	The CAN timer counts bit times, so at 250 kbit/s one tick is 4 us and the
+	16-bit value wraps every 262 ms. The timestamp is captured at the end of
+	frame (CAN_MR.TEOF) for both received and transmitted frames. Only compare
+	timestamps taken on the same controller.
+*/
+#define CAN_TIMESTAMP_US		4
+#define CAN_TIMESTAMP_WRAP_US	( 65536UL * CAN_TIMESTAMP_US )
+#define CAN_TIMESTAMP_DIFF(later, earlier)	( ( uint16_t )( ( later ) - ( earlier ) ) )
+
+/* Copies MDL and MDH of a mailbox to or from ul_datal and ul_datah, which
+*  follow each other as they do, with one LDM and one STM. A host build
+*  (tools/host) supplies its own. */
+#define CAN_MB_COPY2(p_dst, p_src)	__ASM volatile ("ldmia %1, {r2, r3}\n\tstmia %0, {r2, r3}" \
+										: : "r" (p_dst), "r" (p_src) : "r2", "r3", "memory")
+
+/* Set to 1 to build can_mb_bench(). */
+#ifndef CAN_MB_BENCH
+#define CAN_MB_BENCH			0
+#endif
+#define CAN_MB_BENCH_LOOPS		64
+
+/* Average CPU cycles per frame (see can_mb_bench()). On the host
+*  (tools/host/test_mb_bench.c, x86 TSC cycles, median of 2001 runs of 64
+*  frames) the word copy comes out cheaper both ways, but the figures are a few
+*  cycles and change from run to run, so only the order is checked. They say
+*  nothing about the SAM3X: the host simulates the mailbox registers in RAM,
+*  where on the SAM3X they are peripheral registers with wait states on every
+*  access, which the word copy makes fewer of. */
+typedef struct {
+	uint32_t ul_asf_read;		/**< can_mailbox_read() and the copy into a can_frame_t. */
+	uint32_t ul_read;			/**< can_mb_read_frame() and the MCR write. */
+	uint32_t ul_asf_write;		/**< can_mailbox_write() and can_mailbox_send_transfer_cmd(). */
+	uint32_t ul_write;			/**< can_mb_write_frame(). */
+} can_mb_bench_t;
+
+/* Set to 1 to toggle LED0 / LED1 for every frame decoded from CAN0 / CAN1. */
+#ifndef CAN_RX_LEDS
+#define CAN_RX_LEDS				0
+#endif
+
+/* Set to 1 to time the lookup of decode_can_msg() into can_rx_stats. */
+#ifndef CAN_DECODE_TIMING
+#define CAN_DECODE_TIMING		0
+#endif
+
+/* RX path statistics, updated by the interrupt handlers and the dispatch task. */
+typedef struct {
+	uint32_t ul_frames;			/**< Frames pushed into the ring. */
+	uint32_t ul_dispatched;		/**< Frames decoded by the dispatch task. */
+	uint32_t ul_dropped;		/**< Frames lost because the ring was full. */
+	uint32_t ul_high_water;		/**< Largest number of frames waiting in the ring. */
+	uint32_t ul_isr_max_cycles;	/**< Longest time spent in a CAN handler (CPU cycles). */
+	uint32_t ul_isr_entries;	/**< Number of CAN handler entries. */
+	uint32_t ul_isr_cycles;		/**< Total CPU cycles spent in the CAN handlers. */
+	uint32_t ul_unhandled;		/**< Frames with no handler for their opcode. */
+	uint32_t ul_decode_max_cycles;	/**< Longest decode_can_msg() lookup (CPU cycles, excludes the handler; CAN_DECODE_TIMING). */
+	uint32_t ul_decode_cycles;	/**< Total CPU cycles spent in decode_can_msg() lookups (CAN_DECODE_TIMING). */
+	uint32_t ul_ext_frames;		/**< Extended frames dispatched. */
+	uint32_t ul_ext_seq_gaps;	/**< Extended frames whose seq did not follow the last one from the same node. */
+} can_rx_stats_t;
 
-/** CAN0 Transfer mailbox structure */
-can_mb_conf_t can0_mailbox;
+/*		TX SCHEDULER
+	send_can_command() and request_housekeeping() queue frames in software, one FIFO
+	per priority level (0 = most urgent, see CURRENT PRIORITY LEVELS above). Frames are
+	moved into CAN0 MB6-MB7 from the TX-complete interrupt. Only one mailbox holds a
+	given level at a time, so frames of equal priority leave in the order queued.
+	Two mailboxes are enough to keep the bus busy while the interrupt refills the
+	one which just finished, and a more urgent level never waits for more than the
+	frame on the bus: it takes the mailbox that frame leaves and wins against the
+	other one.
+*/
+#define CAN_TX_QUEUE_SIZE		256		// Max frames waiting in software (< 0xFFFF).
+#define CAN_TX_PRIO_LEVELS		32		// Priorities above 31 are sent as 31.
+#define CAN_TX_MB_FIRST			6
+#define CAN_TX_MB_LAST			7
+#define CAN_TX_MB_MASK			( CAN_IER_MB6 | CAN_IER_MB7 )
+
+/* TX scheduler statistics. Frames/sec = change in ul_sent over a known interval. */
+typedef struct {
+	uint32_t ul_queued;			/**< Frames accepted into the TX queue. */
+	uint32_t ul_sent;			/**< Frames which left a transmit mailbox. */
+	uint32_t ul_dropped;		/**< Frames refused, or aborted and not put back, because the queue was full. */
+	uint32_t ul_high_water;		/**< Largest number of frames waiting in the queue. */
+} can_tx_stats_t;
 
-/** CAN1 Transfer mailbox structure */
-can_mb_conf_t can1_mailbox;
+extern volatile can_tx_stats_t can_tx_stats;
 
-can_temp_t temp_mailbox_C0;
-can_temp_t temp_mailbox_C1;
+/* Interrupts per frame = ul_isr_entries / ul_frames,
+*  cycles per frame     = ul_isr_cycles / ul_frames. */
+
+extern volatile can_rx_stats_t can_rx_stats;
+
+/*		MAILBOX OWNERS
+	A mailbox must be claimed with can_mailbox_claim() before it is configured or
+	written. can_mailbox_setup() and can_mailbox_send() refuse mailboxes the caller
+	does not own, so tasks never share a descriptor or a mailbox. Every module and
+	test program claims with an owner of its own: a claim by the same owner
+	succeeds again, so two users sharing one owner would not see each other.
+*/
+#define CAN_OWNER_NONE			0
+#define CAN_OWNER_DRIVER		1		// can_func.c (RX mailboxes, TX scheduler pool), can_gw.c.
+#define CAN_OWNER_TT			2		// can_tt.c: the schedule slots on CAN1.
+#define CAN_OWNER_HK_REMOTE		3		// can_hk.c: remote-frame housekeeping on CAN1.
+#define CAN_OWNER_COMMAND		4		// command_out() and command_in(), which answers it: one
+											// exchange, so command_in() may turn CAN1 MB1 (TX of
+											// command_out()) into the RX of the answer.
+#define CAN_OWNER_HK_TEST		5		// housekeep_test.c
+#define CAN_OWNER_STK600_TEST	6		// stk600_test0.c
+#define CAN_OWNER_TEST			7		// Host test programs (tools/host).
+
+/*		MESSAGE DISPATCH
+	decode_can_msg() looks the opcode in ul_datal up in a table indexed by
+	[controller][top byte of the opcode] and calls the registered handler. The
+	full opcode is compared as well, so two opcodes may not share a top byte on
+	the same controller. Built-in handlers are placed in the table at compile time;
+	other modules add theirs with can_register_handler() during initialization.
+	can_register_prefix_handler() matches on the top byte only and leaves the
+	low 24 bits of ul_datal to the handler.
+	A handler bound to a mailbox with can_register_mb_handler() takes every frame
+	of that mailbox before the opcode is looked at (used for consumer mailboxes,
+	whose data carries no opcode).
+*/
+#define CAN_DISPATCH_SLOTS			256
+#define CAN_OPCODE_INDEX(opcode)	( ( uint32_t )( opcode ) >> 24 )
+
+typedef void (*can_handler_t)(const can_frame_t *p_frame);
+
+/*		REQUEST / ACKNOWLEDGE
+	A task that expects a reply arms a waiter for (controller, opcode) with
+	can_ack_arm() before it sends its request, then blocks in can_ack_wait().
+	decode_can_msg() gives the waiter's semaphore when a matching frame arrives,
+	so the task uses no CPU while it waits. The frame is still passed to its
+	handler as usual. can_ack_wait() must not be called from the dispatch task
+	(the handlers), which is the task that delivers the reply.
+*/
+#define CAN_ACK_WAITERS			4
 
-/** Receive status */
-//volatile uint32_t g_ul_recv_status = 0;
+/* Results of can_ack_wait(), command_out() and command_in(). */
+#define CAN_CMD_OK				0
+#define CAN_CMD_BUSY			1		// No free waiter or the mailboxes are in use.
+#define CAN_CMD_TX_FAIL			2		// The request could not be written to its mailbox.
+#define CAN_CMD_TIMEOUT			3		// No reply within the timeout.
+#define CAN_CMD_INVALID			4		// Not an armed waiter.
+
+#define CAN_CMD_TIMEOUT_TICKS	10		// Default for command_out() (1 s).
+
+/*		RECEPTION MAILBOXES
+	can_init_mailboxes() hands these mailboxes to the filter planner (can_filter.c)
+	together with the list of IDs subscribed to on each controller. The rest of the
+	mailboxes are the TX pool (CAN0 MB6-MB7) or are left to the test programs.
+	The process data (class 6) are planned on their own into CAN0 MB4: in one filter
+	with the commands and replies they took classes 4 - 7 of every source, 56 IDs
+	nobody sends to the OBC, and a PDO frame could push a housekeeping reply out of
+	the FIFO. CAN0 MB5 takes the extended frames addressed to the OBC: its mask only
+	compares the destination field.
+
+	With a FIFO depth above 1 every filter gets that many mailboxes, which hold a
+	burst of frames instead of one (see RECEIVE FIFO in can_filter.h). The CAN0
+	filter takes MB2-MB3: the six housekeeping replies of collect_housekeeping_all()
+	arrive back to back, 444 us apart. Two mailboxes do not hold the whole burst;
+	they make the handler's hold-off limit longer. In tools/host/test_rx_fifo.c
+	(hold-off up to the given time before each reply is read), depth 2 loses no
+	reply up to 1200 us and 3% of them at 1600 us, depth 1 already 4% at 1200 us.
+	A longer hold-off needs a deeper FIFO, and CAN0 has no mailbox left for it.
+*/
+#define CAN0_RX_MB_FIRST		2
+#define CAN0_RX_MB_COUNT		1
+#ifndef CAN0_RX_FIFO_DEPTH
+#define CAN0_RX_FIFO_DEPTH		2
+#endif
+#define CAN1_RX_MB_FIRST		0
+#define CAN1_RX_MB_COUNT		1
+#define CAN1_RX_FIFO_DEPTH		1
+#define CAN0_PDO_RX_MB			4
+#define CAN0_EXT_RX_MB			5
+
+#if ( CAN0_RX_MB_FIRST + CAN0_RX_MB_COUNT * CAN0_RX_FIFO_DEPTH > CAN0_PDO_RX_MB ) \
+	|| ( CAN0_PDO_RX_MB >= CAN0_EXT_RX_MB ) || ( CAN0_EXT_RX_MB >= CAN_TX_MB_FIRST ) \
+	|| ( CAN1_RX_MB_FIRST + CAN1_RX_MB_COUNT * CAN1_RX_FIFO_DEPTH > CANMB_NUMBER )
+#error "The reception FIFOs do not fit in their mailboxes."
+#endif
+
+#define CAN_CTRL_INDEX(controller)	( ( ( controller ) == CAN1 ) ? CAN_CTRL_1 : CAN_CTRL_0 )
+
+/** CAN0 Transceiver */
+extern sn65hvd234_ctrl_t can0_transceiver;
+
+/** CAN1 Transceiver */
+extern sn65hvd234_ctrl_t can1_transceiver;
 
 void CAN1_Handler(void);
 void CAN0_Handler(void);
-void decode_can_msg(can_mb_conf_t *p_mailbox, Can* controller);
+void decode_can_msg(can_frame_t *p_frame);
 void reset_mailbox_conf(can_mb_conf_t *p_mailbox);
-void command_out(void);
-void command_in(void);
+uint32_t command_out(TickType_t xTimeout);
+uint32_t command_in(void);
 void can_initialize(void);
 uint32_t can_init_mailboxes(uint32_t x);
-void save_can_object(can_mb_conf_t *original, can_temp_t *temp);
-void restore_can_object(can_mb_conf_t *original, can_temp_t *temp);
+uint32_t can_mailbox_claim(Can *controller, uint8_t uc_index, uint8_t uc_owner);
+uint32_t can_mailbox_release(Can *controller, uint8_t uc_index, uint8_t uc_owner);
+uint32_t can_mailbox_owned(Can *controller, uint8_t uc_index, uint8_t uc_owner);
+uint32_t can_mailbox_setup(Can *controller, can_mb_conf_t *p_mailbox, uint8_t uc_owner);
+uint32_t can_mailbox_send(Can *controller, can_mb_conf_t *p_mailbox, uint8_t uc_owner);
+void can_mb_write_frame(Can *controller, uint8_t uc_mb, const can_frame_t *p_frame);
+uint32_t can_rx_poll(uint8_t uc_ctrl);
+uint32_t can_rx_replan(uint8_t uc_ctrl, uint32_t ul_nodes);
+void can_dispatch_wake(BaseType_t *pxHigherPriorityTaskWoken);
 uint32_t send_can_command(uint32_t low, uint32_t high, uint32_t ID, uint32_t PRIORITY);		// API Function.
+uint32_t send_can_ext(uint32_t ul_addr, uint32_t low, uint32_t high, uint8_t uc_length, uint32_t PRIORITY);	// API Function.
 uint32_t request_housekeeping(uint32_t ID);													// API Function.
+uint32_t can_tx_enqueue(const can_frame_t *p_frame, uint32_t ul_prio);
+uint32_t can_tx_enqueue_from_isr(const can_frame_t *p_frame, uint32_t ul_prio);
+uint32_t can_tx_pending(void);
+void can_tx_hold(uint8_t uc_ctrl, uint32_t ul_hold);
+#if CAN_MB_BENCH
+void can_mb_bench(can_mb_bench_t *p_bench);
+#endif
+uint32_t can_tx_reclaim(uint8_t uc_ctrl);
+uint32_t can_rx_ring_put(const can_frame_t *p_frame);
+uint32_t can_rx_ring_get(can_frame_t *p_frame);
+uint32_t can_register_handler(uint8_t uc_ctrl, uint32_t ul_opcode, can_handler_t handler);
+uint32_t can_register_prefix_handler(uint8_t uc_ctrl, uint8_t uc_type, can_handler_t handler);
+uint32_t can_register_tx_hook(can_handler_t hook);
+uint32_t can_register_mb_handler(uint8_t uc_ctrl, uint8_t uc_mb, can_handler_t handler);
+uint32_t can_register_ext_handler(uint8_t uc_ctrl, uint8_t uc_type, can_handler_t handler);
+uint32_t can_ack_arm(uint8_t uc_ctrl, uint32_t ul_opcode);
+uint32_t can_ack_wait(uint32_t ul_handle, TickType_t xTimeout, can_frame_t *p_reply);
+void can_ack_cancel(uint32_t ul_handle);
 
+#endif /* CAN_FUNC_H */
@@ -0,0 +1,328 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_guard.c
+	*
+	*	PURPOSE:
+	*	Keeps a node which floods the bus from taking the CPU with it: every node gets
+	*	a budget of received frames, past which its frames are dropped and the
+	*	reception filters are re-planned without it for a while, and a reception
+	*	mailbox is shut off when all nodes together send more than the CPU is meant
+	*	to read.
+	*
+	*	FILE REFERENCES:	can_guard.h, can_poll.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_guard_stats, can_rx_isolated, can_guard_nodes_out
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Nodes over their budget are reported through can_guard_babblers() and counted
+	*	in can_guard_stats.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_guard.h.
+	*	The buckets are refilled from the DWT cycle counter, which wraps every 51 s at
+	*	84 MHz. A bucket untouched for CAN_GUARD_FULL_TICKS or more is full by the
+	*	tick count instead, so the wrap never shortens a burst.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		A node silent for more than 51 s no longer gets its refill from an
+	*					aliased cycle count: the last tick of each node is kept as well, and
+	*					a bucket untouched for CAN_GUARD_FULL_TICKS is full.
+	*
+	*	10/17/2026		A node over its budget no longer isolates the mailbox it shares with
+	*					the healthy nodes: its frames are dropped in software. Each controller
+	*					has a bucket of its own (CAN_GUARD_CPU_RATE), and only an empty one
+	*					isolates a mailbox. The bucket arithmetic is in can_guard_take().
+	*
+	*	10/17/2026		A node over its budget is filtered out for a cooldown through
+	*					can_rx_replan() instead of only being dropped in software. A frame
+	*					costs its node according to its class (ul_guard_class_cost), so
+	*					CAN_PRIO_DATA may use the whole bus. The cooldown timers were removed:
+	*					xTimerStartFromISR() could fail on a full timer queue and leave a
+	*					mailbox isolated for good. can_guard_service() ends the cooldowns from
+	*					the dispatch task, which sleeps no longer than the next one.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_guard_init() is called by can_initialize(); it fills the buckets.
+	*	can_guard_rx_isr() is called by can_mailbox_isr() for each frame read from a
+	*	reception mailbox, before the mailbox is released; it tells it whether to pass
+	*	the frame on, drop it, or leave the mailbox full.
+	*	can_guard_service() is called by the dispatch task after each batch of frames:
+	*	it filters out the nodes which went over their budget, and at the end of a
+	*	cooldown loads the full filters again and empties and enables the isolated
+	*	mailboxes. It returns how long the task may sleep.
+	*
+ */
+
+#include "can_guard.h"
+#include "can_poll.h"
+
+#include "task.h"
+
+volatile can_guard_stats_t can_guard_stats[2];
+volatile uint32_t can_rx_isolated[2] = { 0, 0 };
+volatile uint32_t can_guard_nodes_out[2] = { 0, 0 };
+
+/* Token buckets, in CPU cycles: a frame of class k costs ul_guard_class_cost[k]
+*  from the bucket of its node and ul_guard_cpu_cost from that of its
+*  controller. A full node bucket holds CAN_GUARD_BURST frames of
+*  CAN_GUARD_RATE, a full controller bucket CAN_GUARD_BURST frames. */
+typedef struct {
+	uint32_t ul_tokens;
+	uint32_t ul_last;				// Cycle count of the last frame.
+	TickType_t xLastTick;			// Tick of the last frame.
+} can_guard_bucket_t;
+
+static can_guard_bucket_t guard_node[2][CAN_GUARD_NODES];
+static can_guard_bucket_t guard_cpu[2];
+static uint32_t ul_guard_class_cost[8];
+static uint32_t ul_guard_node_max;
+static uint32_t ul_guard_cpu_cost;
+static uint32_t ul_guard_babblers[2];					// Nodes over budget since the last can_guard_babblers().
+static volatile uint32_t ul_guard_over[2];				// Nodes over budget which can_guard_service() has not seen.
+
+/* Cooldowns, ended by can_guard_service(). */
+static uint32_t ul_guard_filtered[2];					// can_rx_replan() keeps can_guard_nodes_out out.
+static TickType_t xGuardNodesSince[2];					// Since the nodes of can_guard_nodes_out are out.
+static volatile TickType_t xGuardMbSince[2];			// Since the mailboxes of can_rx_isolated are isolated.
+
+static Can *can_guard_controller(uint8_t uc_ctrl)
+{
+	return (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+}
+
+/************************************************************************/
+/*				INITIALIZE                                              */
+/************************************************************************/
+
+void can_guard_init(void)
+{
+	uint32_t ul_now = CAN_DWT_CYCCNT;
+	TickType_t xNow = xTaskGetTickCount();
+	uint8_t i, j;
+
+	if (!CAN_GUARD_ENABLE)
+		return;
+
+	for (i = 0; i < 8; i++)
+		ul_guard_class_cost[i] = sysclk_get_cpu_hz() / ((i == CAN_PRIO_DATA) ? CAN_GUARD_DATA_RATE : CAN_GUARD_RATE);
+	ul_guard_node_max = sysclk_get_cpu_hz() / CAN_GUARD_RATE * CAN_GUARD_BURST;
+	ul_guard_cpu_cost = sysclk_get_cpu_hz() / CAN_GUARD_CPU_RATE;
+
+	for (i = 0; i < 2; i++) {
+		memset((void *)&can_guard_stats[i], 0, sizeof(can_guard_stats[i]));
+		ul_guard_babblers[i] = 0;
+		ul_guard_over[i] = 0;
+		ul_guard_filtered[i] = 0;
+		can_guard_nodes_out[i] = 0;
+		for (j = 0; j < CAN_GUARD_NODES; j++) {
+			guard_node[i][j].ul_tokens = ul_guard_node_max;
+			guard_node[i][j].ul_last = ul_now;
+			guard_node[i][j].xLastTick = xNow;
+		}
+		guard_cpu[i].ul_tokens = ul_guard_cpu_cost * CAN_GUARD_BURST;
+		guard_cpu[i].ul_last = ul_now;
+		guard_cpu[i].xLastTick = xNow;
+	}
+}
+
+/************************************************************************/
+/*				TAKE FROM A BUCKET                                      */
+/*	Refills p_bucket for the time since its last frame, up to ul_max,	*/
+/*	then takes ul_cost from it. Returns 1 if there was enough. The		*/
+/*	cycle count is only trusted over less than CAN_GUARD_FULL_TICKS,	*/
+/*	far inside its wrap.												*/
+/************************************************************************/
+
+static uint32_t can_guard_take(can_guard_bucket_t *p_bucket, uint32_t ul_cost, uint32_t ul_max, uint32_t ul_now,
+		TickType_t xNow)
+{
+	uint32_t ul_tokens = p_bucket->ul_tokens + (ul_now - p_bucket->ul_last);
+
+	if ((ul_tokens > ul_max) || (ul_tokens < p_bucket->ul_tokens)
+			|| ((TickType_t)(xNow - p_bucket->xLastTick) >= CAN_GUARD_FULL_TICKS))
+		ul_tokens = ul_max;
+	p_bucket->ul_last = ul_now;
+	p_bucket->xLastTick = xNow;
+
+	if (ul_tokens < ul_cost) {
+		p_bucket->ul_tokens = ul_tokens;
+		return 0;
+	}
+	p_bucket->ul_tokens = ul_tokens - ul_cost;
+	return 1;
+}
+
+/************************************************************************/
+/*				CHARGE A FRAME                                          */
+/*	CAN interrupt context. Returns CAN_GUARD_PASS if the frame is		*/
+/*	within the budgets of its node and of its controller. Over the		*/
+/*	node's it marks the node for can_guard_service() and returns		*/
+/*	CAN_GUARD_DROP, as it does for every frame of a node which is out.	*/
+/*	Over the controller's it isolates mailbox uc_mb, which the caller	*/
+/*	must then leave full, and returns CAN_GUARD_ISOLATE.				*/
+/************************************************************************/
+
+uint32_t can_guard_rx_isr(uint8_t uc_ctrl, uint8_t uc_mb, const can_frame_t *p_frame)
+{
+	Can *controller = can_guard_controller(uc_ctrl);
+	uint32_t ul_mot, ul_now, ul_class;
+	TickType_t xNow;
+	uint8_t uc_node;
+
+	if (!CAN_GUARD_ENABLE)
+		return CAN_GUARD_PASS;
+
+	ul_mot = controller->CAN_MB[uc_mb].CAN_MMR & CAN_MMR_MOT_Msk;
+	if ((ul_mot != CAN_MMR_MOT_MB_RX) && (ul_mot != CAN_MMR_MOT_MB_RX_OVERWRITE))
+		return CAN_GUARD_PASS;
+	if (!can_mailbox_owned(controller, uc_mb, CAN_OWNER_DRIVER))
+		return CAN_GUARD_PASS;
+
+	if (CAN_MID_IS_EXT(p_frame->ul_id)) {
+		uc_node = (uint8_t)CAN_EXT_SRC(CAN_MID_TO_EXT_ID(p_frame->ul_id));
+		ul_class = CAN_EXT_CLASS(CAN_MID_TO_EXT_ID(p_frame->ul_id));
+	}
+	else {
+		uc_node = (uint8_t)CAN_ID_SRC(CAN_MID_TO_ID(p_frame->ul_id));
+		ul_class = CAN_ID_CLASS(CAN_MID_TO_ID(p_frame->ul_id));
+	}
+
+	ul_now = CAN_DWT_CYCCNT;
+	xNow = xTaskGetTickCountFromISR();
+
+	/* Every frame read costs the CPU, dropped or not. */
+	if (!can_guard_take(&guard_cpu[uc_ctrl], ul_guard_cpu_cost, ul_guard_cpu_cost * CAN_GUARD_BURST, ul_now, xNow)) {
+		can_guard_stats[uc_ctrl].ul_isolations++;
+		can_disable_interrupt(controller, (1u << uc_mb));
+		if (!can_rx_isolated[uc_ctrl])
+			xGuardMbSince[uc_ctrl] = xNow;
+		can_rx_isolated[uc_ctrl] |= (1u << uc_mb);
+		return CAN_GUARD_ISOLATE;
+	}
+
+	/* A node out for a cooldown gets nothing through, whatever its bucket. */
+	if (can_guard_nodes_out[uc_ctrl] & (1u << uc_node)) {
+		can_guard_stats[uc_ctrl].node[uc_node].ul_dropped++;
+		return CAN_GUARD_DROP;
+	}
+
+	if (!can_guard_take(&guard_node[uc_ctrl][uc_node], ul_guard_class_cost[ul_class], ul_guard_node_max,
+			ul_now, xNow)) {
+		can_guard_stats[uc_ctrl].node[uc_node].ul_dropped++;
+		ul_guard_babblers[uc_ctrl] |= (1u << uc_node);
+		ul_guard_over[uc_ctrl] |= (1u << uc_node);
+		return CAN_GUARD_DROP;
+	}
+
+	can_guard_stats[uc_ctrl].node[uc_node].ul_frames++;
+	return CAN_GUARD_PASS;
+}
+
+/************************************************************************/
+/*				SERVICE                                                 */
+/*	Dispatch task context. Filters out the nodes which went over their	*/
+/*	budget since the last call and ends the cooldowns which are due:	*/
+/*	the full filters are loaded again, and the frame left in each		*/
+/*	isolated mailbox is thrown away. A mailbox which is being polled	*/
+/*	(can_poll.c) gets no interrupt back.								*/
+/*	Returns the ticks until the next cooldown ends, portMAX_DELAY if	*/
+/*	none is running.													*/
+/************************************************************************/
+
+TickType_t can_guard_service(void)
+{
+	TickType_t xNow = xTaskGetTickCount(), xWait = portMAX_DELAY, xLeft;
+	Can *controller;
+	uint32_t ul_over, ul_mask;
+	uint8_t uc_ctrl, i;
+
+	if (!CAN_GUARD_ENABLE)
+		return portMAX_DELAY;
+
+	for (uc_ctrl = CAN_CTRL_0; uc_ctrl <= CAN_CTRL_1; uc_ctrl++) {
+		controller = can_guard_controller(uc_ctrl);
+
+		/* Nodes over budget. One which the filters cannot keep out is dropped
+		*  in software until the end of the cooldown instead. */
+		taskENTER_CRITICAL();
+		ul_over = ul_guard_over[uc_ctrl] & ~can_guard_nodes_out[uc_ctrl];
+		ul_guard_over[uc_ctrl] = 0;
+		taskEXIT_CRITICAL();
+		if (ul_over) {
+			if (can_rx_replan(uc_ctrl, can_guard_nodes_out[uc_ctrl] | ul_over)) {
+				ul_guard_filtered[uc_ctrl] = 1;
+				can_guard_stats[uc_ctrl].ul_filtered++;
+			}
+			else
+				can_guard_stats[uc_ctrl].ul_unfiltered++;
+			can_guard_nodes_out[uc_ctrl] |= ul_over;
+			xGuardNodesSince[uc_ctrl] = xNow;
+		}
+
+		/* End of the cooldown of the nodes. */
+		if (can_guard_nodes_out[uc_ctrl]) {
+			xLeft = (TickType_t)(xNow - xGuardNodesSince[uc_ctrl]);
+			if (xLeft >= CAN_GUARD_COOLDOWN_TICKS) {
+				if (ul_guard_filtered[uc_ctrl])
+					can_rx_replan(uc_ctrl, 0);
+				ul_guard_filtered[uc_ctrl] = 0;
+				can_guard_nodes_out[uc_ctrl] = 0;
+				can_guard_stats[uc_ctrl].ul_releases++;
+			}
+			else if (CAN_GUARD_COOLDOWN_TICKS - xLeft < xWait)
+				xWait = CAN_GUARD_COOLDOWN_TICKS - xLeft;
+		}
+
+		/* End of the cooldown of the isolated mailboxes. */
+		taskENTER_CRITICAL();
+		ul_mask = can_rx_isolated[uc_ctrl];
+		if (ul_mask) {
+			xLeft = (TickType_t)(xNow - xGuardMbSince[uc_ctrl]);
+			if (xLeft >= CAN_GUARD_COOLDOWN_TICKS) {
+				can_rx_isolated[uc_ctrl] = 0;
+				for (i = 0; i < CANMB_NUMBER; i++) {
+					if (ul_mask & (1u << i))
+						controller->CAN_MB[i].CAN_MCR = CAN_MCR_MTCR;
+				}
+				can_enable_interrupt(controller, ul_mask & ~can_rx_polled[uc_ctrl]);
+				can_guard_stats[uc_ctrl].ul_releases++;
+			}
+			else if (CAN_GUARD_COOLDOWN_TICKS - xLeft < xWait)
+				xWait = CAN_GUARD_COOLDOWN_TICKS - xLeft;
+		}
+		taskEXIT_CRITICAL();
+	}
+
+	return xWait;
+}
+
+/************************************************************************/
+/*				REPORT                                                  */
+/*	Returns a mask of the nodes (bit n = node n) which went over their	*/
+/*	budget on uc_ctrl since the last call, and clears it.				*/
+/************************************************************************/
+
+uint32_t can_guard_babblers(uint8_t uc_ctrl)
+{
+	uint32_t ul_nodes;
+
+	taskENTER_CRITICAL();
+	ul_nodes = ul_guard_babblers[uc_ctrl];
+	ul_guard_babblers[uc_ctrl] = 0;
+	taskEXIT_CRITICAL();
+
+	return ul_nodes;
+}
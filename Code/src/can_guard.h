@@ -0,0 +1,142 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_guard.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the per-node receive rate limit in can_guard.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_guard_stats, can_rx_isolated, can_guard_nodes_out
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The source node is taken from the ID (CAN_ID_SRC() or CAN_EXT_SRC()), so a node
+	*	which also corrupts its source field is charged to the node it names.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Added CAN_GUARD_FULL_TICKS.
+	*
+	*	10/17/2026		A node over its budget has its frames dropped in software; a mailbox
+	*					is only isolated when the frames of all nodes together go over
+	*					CAN_GUARD_CPU_RATE. Added the CAN_GUARD_PASS/DROP/ISOLATE results and
+	*					can_guard_stats_t.ul_isolations. CAN_GUARD_ENABLE can be set from the
+	*					command line.
+	*
+	*	10/17/2026		A node over its budget is filtered out: can_guard_service() re-plans the
+	*					reception filters without it (can_rx_replan()) for the cooldown.
+	*					Frames of class CAN_PRIO_DATA cost a node less of its budget
+	*					(CAN_GUARD_DATA_RATE), so bulk transfers run at the bus rate. The
+	*					cooldowns are ended by the dispatch task instead of a software timer.
+	*
+*/
+
+#ifndef CAN_GUARD_H
+#define CAN_GUARD_H
+
+#include "FreeRTOS.h"
+#include "can_func.h"
+
+/* Set to 0 to let every node send as fast as the bus allows. */
+#ifndef CAN_GUARD_ENABLE
+#define CAN_GUARD_ENABLE			1
+#endif
+
+/*		BABBLING-IDIOT GUARD
+	Every frame read from a reception mailbox of the driver is charged to its
+	source node on that controller, from a token bucket which holds
+	CAN_GUARD_BURST frames of CAN_GUARD_RATE a second. The budget is a share of
+	time, so what a frame costs depends on its class: a frame of class
+	CAN_PRIO_DATA costs 1 / CAN_GUARD_DATA_RATE s, any other 1 / CAN_GUARD_RATE s.
+	CAN_GUARD_DATA_RATE is above a full bus of 8-byte frames at 250 kbit/s (2252
+	frames/s), so a segmented transfer (can_transport.c) from a peer with STmin 0
+	never runs out; a node sending housekeeping or commands runs out at 1000
+	frames/s.
+
+	A frame which finds the bucket of its node empty is dropped in the handler,
+	and the node is marked. The dispatch task (can_guard_service()) then re-plans
+	the filters of the controller's commands and replies without the IDs of that
+	source (can_rx_replan()), so the controller refuses its frames and the other
+	nodes keep the mailboxes. After CAN_GUARD_COOLDOWN_TICKS the full plan is
+	loaded again; a node still babbling is filtered out again once its bucket is
+	empty. Extended frames, process data (one mailbox, one filter) and a plan the
+	mailboxes cannot hold without the node are left to the software drop.
+
+	Dropping still costs a handler run per frame, so every frame read is also
+	charged to a bucket of the controller, which refills at CAN_GUARD_CPU_RATE.
+	Only when that one is empty is the mailbox itself isolated: it is left full
+	with its interrupt off, so the controller throws away whatever else it
+	accepts without the CPU seeing it, until the dispatch task empties and
+	enables it again after CAN_GUARD_COOLDOWN_TICKS. This is the last resort for
+	floods the filters cannot stop, e.g. short extended frames; back-to-back
+	frames of 4 bytes or less can go over it (3164 frames/s and up without bit
+	stuffing), 8-byte frames cannot.
+	Consumer mailboxes (remote housekeeping) only receive what was asked for and
+	are not charged.
+*/
+#define CAN_GUARD_NODES				CAN_EXT_NODES		// Source fields up to 5 bits.
+#define CAN_GUARD_RATE				1000				// Frames per second per node.
+#ifndef CAN_GUARD_DATA_RATE
+#define CAN_GUARD_DATA_RATE			2300				// Frames of class CAN_PRIO_DATA per second per node.
+#endif
+#define CAN_GUARD_BURST				64
+#define CAN_GUARD_CPU_RATE			3000				// Frames per second per controller, all nodes.
+#define CAN_GUARD_COOLDOWN_TICKS	10					// 1 s.
+
+/* Ticks after which a silent bucket is full whatever the cycle counter says:
+*  a full refill of a node (CAN_GUARD_BURST / CAN_GUARD_RATE, the slower of
+*  the two buckets) rounded up, plus the tick the last frame came in. */
+#define CAN_GUARD_FULL_TICKS		( ( CAN_GUARD_BURST * configTICK_RATE_HZ + CAN_GUARD_RATE - 1 ) \
+										/ CAN_GUARD_RATE + 1 )
+
+/* Results of can_guard_rx_isr(). */
+#define CAN_GUARD_PASS				0
+#define CAN_GUARD_DROP				1		// Over the node's budget: release the mailbox, drop the frame.
+#define CAN_GUARD_ISOLATE			2		// Over the controller's: leave the mailbox full.
+
+/* A non-PASS result leaves work for can_guard_service(): the RX handler wakes
+*  the dispatch task for it. */
+
+typedef struct {
+	uint32_t ul_frames;				/**< Frames accepted. */
+	uint32_t ul_dropped;			/**< Frames over the budget of the node, dropped. */
+} can_guard_node_stats_t;
+
+typedef struct {
+	can_guard_node_stats_t node[CAN_GUARD_NODES];
+	uint32_t ul_isolations;			/**< Frames over the budget of the controller (each isolated its mailbox). */
+	uint32_t ul_filtered;			/**< Re-plans which filtered nodes out. */
+	uint32_t ul_unfiltered;			/**< Nodes over budget which the filters could not keep out. */
+	uint32_t ul_releases;			/**< Cooldowns which ended. */
+} can_guard_stats_t;
+
+extern volatile can_guard_stats_t can_guard_stats[2];
+
+/* Reception mailboxes of each controller which are isolated; can_mailbox_isr()
+*  leaves them alone until the cooldown ends. */
+extern volatile uint32_t can_rx_isolated[2];
+
+/* Nodes of each controller (bit n = node n) which are out for a cooldown:
+*  filtered out, or dropped in software where the filters could not do it. */
+extern volatile uint32_t can_guard_nodes_out[2];
+
+void can_guard_init(void);
+uint32_t can_guard_rx_isr(uint8_t uc_ctrl, uint8_t uc_mb, const can_frame_t *p_frame);
+TickType_t can_guard_service(void);
+uint32_t can_guard_babblers(uint8_t uc_ctrl);													// API Function.
+
+#endif /* CAN_GUARD_H */
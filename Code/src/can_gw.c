@@ -0,0 +1,320 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_gw.c
+	*
+	*	PURPOSE:
+	*	Forwards frames between CAN0 and CAN1 according to a rule table, from the
+	*	receive interrupt straight into the transmit mailboxes of the other controller,
+	*	so that a noisy payload bus can be kept apart from the platform bus.
+	*
+	*	FILE REFERENCES:	can_gw.h, can_filter.h, can_stats.h, can_capture.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_gw_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	can_gw_init() returns 0 if a mailbox could not be claimed.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_gw.h.
+	*	Everything except can_gw_init() runs in the CAN interrupt handlers, which have
+	*	the same NVIC priority, so the gateway state needs no locking.
+	*
+	*	NOTES:
+	*	The OBC only receives on the payload bus what the rules of CAN1 cover: its own
+	*	traffic there needs a CAN_GW_LOCAL rule (or a rule of its own with the flag).
+	*
+	*	Forwarding latency and the highest rate seen are kept in can_gw_stats. The
+	*	sustained rate is bounded by the slower bus; frames which arrive faster than
+	*	the other bus takes them fill the FIFO and are then counted as dropped.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					A forwarded frame is written into the mailbox straight from the received
+	*					one, or from its FIFO entry; only its ID and length are kept while the
+	*					mailbox sends, the data for the capture are read back from it.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_gw_init() is called by can_init_mailboxes(); it plans the receive filters of
+	*	both controllers from the rules and sets up the gateway transmit mailboxes.
+	*	can_gw_rx_isr() is called by can_mailbox_isr() for every frame received.
+	*	can_gw_tx_done_isr() is called by can_mailbox_isr() when gateway transmit
+	*	mailboxes are ready again; it refills them from the FIFO.
+	*
+ */
+
+#include "can_gw.h"
+#include "can_filter.h"
+#include "can_stats.h"
+#include "can_capture.h"
+
+#include "task.h"
+
+volatile can_gw_stats_t can_gw_stats;
+
+/* First match wins. */
+static const can_gw_rule_t can_gw_rules[] = {
+	/* Payload commands from the platform bus to the payload bus. */
+	{ CAN_CTRL_0, 0, CAN_ID(CAN_PRIO_PAYLOAD_CMD, 0, 0, 0), CAN_ID(CAN_PRIO_PAYLOAD_CMD, 7, 7, 3), 0, 0, 0 },
+	/* Payload data for the other subsystems, at most 50 frames per 100 ms. */
+	{ CAN_CTRL_1, 0, CAN_ID(CAN_PRIO_DATA, 1, 0, 0), CAN_ID(CAN_PRIO_DATA, 7, 7, 3), 0, 0, 50 },
+};
+
+#define CAN_GW_RULES	( sizeof(can_gw_rules) / sizeof(can_gw_rules[0]) )
+
+typedef char can_gw_rules_check[( CAN_GW_RULES <= CAN_GW_MAX_RULES ) ? 1 : -1];
+
+/* FIFO per direction, indexed by the controller the frames are sent on.
+*  Head and tail are free-running, the slot is found with the mask. */
+typedef struct {
+	can_frame_t frame;
+	uint32_t ul_stamp;			// DWT cycle count when the frame was received.
+} can_gw_entry_t;
+
+static can_gw_entry_t can_gw_queue[2][CAN_GW_QUEUE_SIZE];
+static uint32_t ul_gw_head[2];
+static uint32_t ul_gw_tail[2];
+
+static uint32_t ul_gw_free[2];							// Free gateway transmit mailboxes.
+static uint32_t ul_gw_mb_stamp[2][CANMB_NUMBER];
+static uint32_t ul_gw_mb_id[2][CANMB_NUMBER];			// MID of the frame in each gateway transmit mailbox.
+static uint8_t uc_gw_mb_length[2][CANMB_NUMBER];
+
+static uint32_t ul_rule_frames[CAN_GW_MAX_RULES];
+static TickType_t xRuleWindow[CAN_GW_MAX_RULES];
+static TickType_t xDirWindow[2];
+
+static Can *can_gw_controller(uint8_t uc_ctrl)
+{
+	return (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+}
+
+/************************************************************************/
+/*				INITIALIZE THE GATEWAY                                  */
+/************************************************************************/
+
+uint32_t can_gw_init(void)
+{
+	can_id_range_t ranges[CAN_GW_MAX_RULES];
+	can_filter_plan_t plan;
+	can_mb_conf_t mailbox;
+	uint8_t uc_ctrl, uc_first, uc_count, i;
+	uint32_t ul_n;
+
+	if (!CAN_GW_ENABLE)
+		return 0;
+
+	memset((void *)&can_gw_stats, 0, sizeof(can_gw_stats));
+
+	for (uc_ctrl = CAN_CTRL_0; uc_ctrl <= CAN_CTRL_1; uc_ctrl++) {
+		ul_gw_head[uc_ctrl] = 0;
+		ul_gw_tail[uc_ctrl] = 0;
+		ul_gw_free[uc_ctrl] = 0;
+
+		/* Receive what the rules of this controller forward. */
+		for (i = 0, ul_n = 0; i < CAN_GW_RULES; i++) {
+			if (can_gw_rules[i].uc_from != uc_ctrl)
+				continue;
+			ranges[ul_n].us_first = can_gw_rules[i].us_first;
+			ranges[ul_n].us_last = can_gw_rules[i].us_last;
+			ul_n++;
+		}
+		uc_first = (uc_ctrl == CAN_CTRL_1) ? CAN1_GW_RX_MB_FIRST : CAN0_GW_RX_MB_FIRST;
+		uc_count = (uc_ctrl == CAN_CTRL_1) ? CAN1_GW_RX_MB_COUNT : CAN0_GW_RX_MB_COUNT;
+		if (ul_n && can_filter_plan(ranges, ul_n, uc_count, &plan)
+			&& !can_filter_apply(can_gw_controller(uc_ctrl), &plan, uc_first, 1, CAN_OWNER_DRIVER))
+			return 0;
+
+		/* Send what the rules of the other controller forward. */
+		for (i = 0; i < CANMB_NUMBER; i++) {
+			if (!(CAN_GW_TX_MB_MASK(uc_ctrl) & (1u << i)))
+				continue;
+			if (!can_mailbox_claim(can_gw_controller(uc_ctrl), i, CAN_OWNER_DRIVER))
+				return 0;
+			reset_mailbox_conf(&mailbox);
+			mailbox.ul_mb_idx = i;
+			mailbox.uc_obj_type = CAN_MB_TX_MODE;
+			mailbox.uc_tx_prio = 15;		// Set per frame from the class of its ID.
+			can_mailbox_init(can_gw_controller(uc_ctrl), &mailbox);
+			ul_gw_free[uc_ctrl] |= (1u << i);
+		}
+	}
+
+	return 1;
+}
+
+/************************************************************************/
+/*				LOAD A GATEWAY MAILBOX                                  */
+/*	Writes the data of p_frame with the MID ul_mid (the ID after the	*/
+/*	rule's rewrite) into a free gateway mailbox of uc_dst and starts	*/
+/*	it. Returns 0 if none is free or if a frame with the same ID is		*/
+/*	still waiting in one (it would otherwise be free to overtake it).	*/
+/************************************************************************/
+
+static uint32_t can_gw_load(uint8_t uc_dst, uint32_t ul_mid, const can_frame_t *p_frame, uint32_t ul_stamp)
+{
+	Can *controller = can_gw_controller(uc_dst);
+	CanMb *p_mb;
+	uint32_t ul_busy = CAN_GW_TX_MB_MASK(uc_dst) & ~ul_gw_free[uc_dst];
+	uint8_t uc_mb;
+
+	if (!ul_gw_free[uc_dst])
+		return 0;
+	while (ul_busy) {
+		uc_mb = (uint8_t)(31 - __CLZ(ul_busy));
+		ul_busy &= ~(1u << uc_mb);
+		if (ul_gw_mb_id[uc_dst][uc_mb] == ul_mid)
+			return 0;
+	}
+
+	/* As can_mb_write_frame(), with the ID of the rule. */
+	uc_mb = (uint8_t)(31 - __CLZ(ul_gw_free[uc_dst]));
+	p_mb = &controller->CAN_MB[uc_mb];
+	p_mb->CAN_MMR = (p_mb->CAN_MMR & ~CAN_MMR_PRIOR_Msk) | CAN_MMR_PRIOR(CAN_ID_CLASS(CAN_MID_TO_ID(ul_mid)));
+	p_mb->CAN_MID = ul_mid;
+	CAN_MB_COPY2(&p_mb->CAN_MDL, &p_frame->ul_datal);
+	p_mb->CAN_MCR = CAN_MCR_MTCR | CAN_MCR_MDLC(p_frame->uc_length);
+
+	ul_gw_free[uc_dst] &= ~(1u << uc_mb);
+	ul_gw_mb_stamp[uc_dst][uc_mb] = ul_stamp;
+	ul_gw_mb_id[uc_dst][uc_mb] = ul_mid;
+	uc_gw_mb_length[uc_dst][uc_mb] = p_frame->uc_length;
+
+	can_enable_interrupt(controller, (1u << uc_mb));
+	return 1;
+}
+
+/************************************************************************/
+/*				FRAME RECEIVED                                          */
+/*	CAN interrupt context. Forwards p_frame if a rule of uc_ctrl		*/
+/*	matches. Returns 1 if the frame must also go to the dispatch task	*/
+/*	(no rule, or a CAN_GW_LOCAL rule), 0 if the gateway took it.		*/
+/************************************************************************/
+
+uint32_t can_gw_rx_isr(uint8_t uc_ctrl, const can_frame_t *p_frame)
+{
+	const can_gw_rule_t *p_rule;
+	uint32_t ul_id, ul_mid = p_frame->ul_id, ul_local, ul_stamp = CAN_DWT_CYCCNT;
+	uint8_t uc_dst = uc_ctrl ^ 1, i;
+	TickType_t xNow;
+	can_gw_entry_t *p_entry;
+
+	if (CAN_MID_IS_EXT(p_frame->ul_id))
+		return 1;
+	ul_id = CAN_MID_TO_ID(p_frame->ul_id);
+
+	for (i = 0; i < CAN_GW_RULES; i++) {
+		p_rule = &can_gw_rules[i];
+		if ((p_rule->uc_from == uc_ctrl) && (ul_id >= p_rule->us_first) && (ul_id <= p_rule->us_last))
+			break;
+	}
+	if (i == CAN_GW_RULES)
+		return 1;
+	ul_local = (p_rule->uc_flags & CAN_GW_LOCAL) ? 1 : 0;
+
+	if (p_rule->ul_max_frames) {
+		xNow = xTaskGetTickCountFromISR();
+		if ((xNow - xRuleWindow[i]) >= CAN_GW_RATE_TICKS) {
+			xRuleWindow[i] = xNow;
+			ul_rule_frames[i] = 0;
+		}
+		if (ul_rule_frames[i] >= p_rule->ul_max_frames) {
+			can_gw_stats.rule[i].ul_rate_limited++;
+			return ul_local;
+		}
+		ul_rule_frames[i]++;
+	}
+
+	if (p_rule->us_rewrite_mask) {
+		ul_id = (ul_id & ~p_rule->us_rewrite_mask) | (p_rule->us_rewrite_id & p_rule->us_rewrite_mask);
+		ul_mid = CAN_MID_MIDvA(ul_id);
+	}
+	can_gw_stats.rule[i].ul_forwarded++;
+
+	/* Nothing waiting: straight into a mailbox. */
+	if ((ul_gw_head[uc_dst] == ul_gw_tail[uc_dst]) && can_gw_load(uc_dst, ul_mid, p_frame, ul_stamp)) {
+		can_gw_stats.dir[uc_dst].ul_direct++;
+		return ul_local;
+	}
+
+	if (ul_gw_head[uc_dst] - ul_gw_tail[uc_dst] >= CAN_GW_QUEUE_SIZE) {
+		can_gw_stats.dir[uc_dst].ul_dropped++;
+		return ul_local;
+	}
+	p_entry = &can_gw_queue[uc_dst][ul_gw_head[uc_dst] & (CAN_GW_QUEUE_SIZE - 1)];
+	p_entry->frame = *p_frame;
+	p_entry->frame.ul_id = ul_mid;
+	p_entry->ul_stamp = ul_stamp;
+	ul_gw_head[uc_dst]++;
+	if (ul_gw_head[uc_dst] - ul_gw_tail[uc_dst] > can_gw_stats.dir[uc_dst].ul_high_water)
+		can_gw_stats.dir[uc_dst].ul_high_water = ul_gw_head[uc_dst] - ul_gw_tail[uc_dst];
+
+	return ul_local;
+}
+
+/************************************************************************/
+/*				FRAME SENT                                              */
+/*	CAN interrupt context, with the gateway mailboxes of uc_ctrl which	*/
+/*	are ready again. Records the latency and refills them from the FIFO.*/
+/************************************************************************/
+
+void can_gw_tx_done_isr(uint8_t uc_ctrl, uint32_t ul_done)
+{
+	Can *controller = can_gw_controller(uc_ctrl);
+	volatile can_gw_dir_stats_t *p_stats = &can_gw_stats.dir[uc_ctrl];
+	can_gw_entry_t *p_entry;
+	can_frame_t sent;
+	uint32_t ul_cycles;
+	TickType_t xNow = xTaskGetTickCountFromISR();
+	uint8_t uc_mb;
+
+	if ((xNow - xDirWindow[uc_ctrl]) >= CAN_GW_RATE_TICKS) {
+		xDirWindow[uc_ctrl] = xNow;
+		p_stats->ul_window_frames = 0;
+	}
+
+	can_disable_interrupt(controller, ul_done);
+	while (ul_done) {
+		uc_mb = (uint8_t)(31 - __CLZ(ul_done));
+		ul_done &= ~(1u << uc_mb);
+
+		ul_cycles = CAN_DWT_CYCCNT - ul_gw_mb_stamp[uc_ctrl][uc_mb];
+		if (!p_stats->ul_lat_count || (ul_cycles < p_stats->ul_lat_min))
+			p_stats->ul_lat_min = ul_cycles;
+		if (ul_cycles > p_stats->ul_lat_max)
+			p_stats->ul_lat_max = ul_cycles;
+		p_stats->ul_lat_sum += ul_cycles;
+		p_stats->ul_lat_count++;
+		p_stats->ul_forwarded++;
+		if (++p_stats->ul_window_frames > p_stats->ul_peak_frames)
+			p_stats->ul_peak_frames = p_stats->ul_window_frames;
+
+		can_stats_tx(uc_ctrl, ul_gw_mb_id[uc_ctrl][uc_mb], uc_gw_mb_length[uc_ctrl][uc_mb]);
+
+		/* The data for the capture are still in the mailbox. */
+		sent.ul_id = ul_gw_mb_id[uc_ctrl][uc_mb];
+		CAN_MB_COPY2(&sent.ul_datal, &controller->CAN_MB[uc_mb].CAN_MDL);
+		sent.uc_length = uc_gw_mb_length[uc_ctrl][uc_mb];
+		sent.uc_info = CAN_FRAME_INFO(uc_ctrl, uc_mb, 0);
+		sent.us_timestamp = (uint16_t)(controller->CAN_MB[uc_mb].CAN_MSR & CAN_MSR_MTIMESTAMP_Msk);
+		can_capture_frame(&sent, CAN_CAPTURE_TX);
+		ul_gw_mb_id[uc_ctrl][uc_mb] = 0xFFFFFFFF;		// Matches no received ID.
+		ul_gw_free[uc_ctrl] |= (1u << uc_mb);
+	}
+
+	while (ul_gw_tail[uc_ctrl] != ul_gw_head[uc_ctrl]) {
+		p_entry = &can_gw_queue[uc_ctrl][ul_gw_tail[uc_ctrl] & (CAN_GW_QUEUE_SIZE - 1)];
+		if (!can_gw_load(uc_ctrl, p_entry->frame.ul_id, &p_entry->frame, p_entry->ul_stamp))
+			break;
+		ul_gw_tail[uc_ctrl]++;
+	}
+}
@@ -0,0 +1,147 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_gw.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the CAN0 <-> CAN1 gateway in can_gw.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_gw_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	With CAN_GW_ENABLE, CAN0 is on the platform bus and CAN1 on a separate payload
+	*	bus; CAN1 is no longer a loopback to CAN0. The gateway takes CAN0 MB0 - MB1
+	*	(so command_out(), command_in() and housekeep_test cannot claim them) and
+	*	CAN1 MB0 - MB7. It cannot be combined with the dual bus, the time-triggered
+	*	schedule or remote-frame housekeeping.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		CAN_GW_ENABLE can be set from the build. Added the forwarding latency
+	*					and sustained rate measured on the host (tools/host/test_gw.c).
+	*
+*/
+
+#ifndef CAN_GW_H
+#define CAN_GW_H
+
+#include "can_func.h"
+
+/* Set to 1 to forward frames between CAN0 and CAN1 (rules in can_gw.c). */
+#ifndef CAN_GW_ENABLE
+#define CAN_GW_ENABLE			0
+#endif
+
+/*		FORWARDING
+	A standard frame received on one controller is checked against the rules of
+	that controller, first match wins. A matching frame is counted against the
+	rule's rate limit, its ID is rewritten if the rule says so, and it is handed
+	to the other controller from the receive interrupt: written straight into a
+	free gateway transmit mailbox if nothing is waiting, otherwise appended to a
+	short FIFO which the transmit-complete interrupt drains. No task is involved.
+	Frames without a matching rule, and frames of CAN_GW_LOCAL rules, are also
+	passed to the dispatch task as usual.
+
+	Frames with the same ID leave in the order they came in: a frame is not loaded
+	while another frame with its ID is still in a mailbox. The mailbox priority
+	is the class of the ID, so forwarded traffic keeps its arbitration order.
+
+	Mailboxes:	CAN0 MB1 receives, MB0 sends (to the platform bus).
+				CAN1 MB0 - MB3 receive, MB4 - MB7 send (to the payload bus).
+
+	Measured in the host simulation (tools/host/test_gw.c: both buses at 250 kbit/s,
+	8-byte frames of 444 us, handler time not simulated), platform -> payload:
+		payload bus idle:		every frame forwarded up to a full platform bus
+								(2252 frames/s); latency 444 us, the forwarded
+								frame itself, from end of frame to end of frame.
+		25% of it taken by		1600 frames/s without loss (1692 is what is left);
+		higher classes:			latency 444 / 586 / 888 us min / mean / max.
+		50% taken:				1100 frames/s without loss (1130 left); latency
+								444 / 556 / 888 us.
+	Offered more than what is left, the FIFO fills (16 frames, about 14 ms of
+	backlog at 1130 frames/s) and the rest is dropped and counted in ul_dropped.
+	One source node gets at most CAN_GUARD_RATE frames/s past the receive guard.
+*/
+#define CAN_GW_MAX_RULES		8
+#define CAN_GW_QUEUE_SIZE		16			// Per direction, a power of two.
+
+#define CAN0_GW_RX_MB_FIRST		1
+#define CAN0_GW_RX_MB_COUNT		1
+#define CAN0_GW_TX_MB_MASK		( CAN_IER_MB0 )
+#define CAN1_GW_RX_MB_FIRST		0
+#define CAN1_GW_RX_MB_COUNT		4
+#define CAN1_GW_TX_MB_MASK		( CAN_IER_MB4 | CAN_IER_MB5 | CAN_IER_MB6 | CAN_IER_MB7 )
+
+#if CAN_GW_ENABLE
+#define CAN_GW_TX_MB_MASK(ctrl)	( ( ( ctrl ) == CAN_CTRL_1 ) ? CAN1_GW_TX_MB_MASK : CAN0_GW_TX_MB_MASK )
+#else
+#define CAN_GW_TX_MB_MASK(ctrl)	0
+#endif
+
+/* Rule flags. */
+#define CAN_GW_LOCAL			0x01		// Also pass the frame to the dispatch task.
+
+/* ID sent = (ID & ~us_rewrite_mask) | (us_rewrite_id & us_rewrite_mask). A mask of
+*  0 forwards the ID unchanged. ul_max_frames limits the frames forwarded per
+*  CAN_GW_RATE_TICKS, 0 = no limit. */
+#define CAN_GW_RATE_TICKS		1
+
+typedef struct {
+	uint8_t uc_from;			/**< CAN_CTRL_0 or CAN_CTRL_1. */
+	uint8_t uc_flags;
+	uint16_t us_first;			/**< Standard IDs us_first ... us_last. */
+	uint16_t us_last;
+	uint16_t us_rewrite_mask;
+	uint16_t us_rewrite_id;
+	uint32_t ul_max_frames;
+} can_gw_rule_t;
+
+typedef struct {
+	uint32_t ul_forwarded;
+	uint32_t ul_rate_limited;
+} can_gw_rule_stats_t;
+
+/* Per direction, indexed by the controller the frames are sent on. Latency is
+*  in CPU cycles from the receive interrupt to the end of the frame on the
+*  other bus. Peak rate in frames per second = ul_peak_frames * configTICK_RATE_HZ
+*  / CAN_GW_RATE_TICKS. */
+typedef struct {
+	uint32_t ul_forwarded;		/**< Frames sent. */
+	uint32_t ul_direct;			/**< Of which went straight into a mailbox. */
+	uint32_t ul_dropped;		/**< FIFO full. */
+	uint32_t ul_high_water;
+	uint32_t ul_lat_count;
+	uint32_t ul_lat_sum;
+	uint32_t ul_lat_min;
+	uint32_t ul_lat_max;
+	uint32_t ul_window_frames;	/**< Frames sent in the current rate window. */
+	uint32_t ul_peak_frames;	/**< Most frames sent in one rate window. */
+} can_gw_dir_stats_t;
+
+typedef struct {
+	can_gw_dir_stats_t dir[2];
+	can_gw_rule_stats_t rule[CAN_GW_MAX_RULES];
+} can_gw_stats_t;
+
+extern volatile can_gw_stats_t can_gw_stats;
+
+uint32_t can_gw_init(void);
+uint32_t can_gw_rx_isr(uint8_t uc_ctrl, const can_frame_t *p_frame);
+void can_gw_tx_done_isr(uint8_t uc_ctrl, uint32_t ul_done);
+
+#endif /* CAN_GW_H */
@@ -0,0 +1,569 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_hk.c
+	*
+	*	PURPOSE:		
+	*	This file matches housekeeping replies to the requests which were sent out
+	*	with request_housekeeping() and hands the data to the task waiting for it.
+	*
+	*	FILE REFERENCES:	can_hk.h, can_nmt.h
+	*
+	*	EXTERNAL VARIABLES:		hk_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: 
+	*	wait_housekeeping() returns 0 if no reply arrived within the timeout.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_hk.h for the reply format.
+	*
+	*	NOTES:	
+	*	Every node has one slot in the outstanding-request table, so all of SUB0_ID0 -
+	*	SUB0_ID5 can be waiting for a reply at the same time.
+	*	
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:			
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and 
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:		
+	*	10/17/2026		Created. request_housekeeping() moved here from can_func.c.
+	*
+	*					can_hk_reply() is now registered for HK_RETURNED on CAN0 through
+	*					can_register_handler() instead of being called from decode_can_msg().
+	*
+	*					The reply mailbox is now set up by the filter planner in
+	*					can_init_mailboxes().
+	*
+	*					The hardware timestamps of each request (from the TX hook) and its reply
+	*					give a per-node round-trip time, kept in hk_rtt.
+	*
+	*					Added hk_expect(), which marks a node as pending without queuing the
+	*					request, for requests released by the time-triggered schedule.
+	*
+	*					Added remote-frame housekeeping through CAN1 consumer mailboxes, claimed
+	*					as CAN_OWNER_HK_REMOTE and refreshed by a software timer.
+	*
+	*					Requests are sent with HK_REQUEST_ID() and replies are matched on the
+	*					source node of their ID instead of on the whole ID.
+	*
+	*					The round-trip time is only taken when the reply arrives on the bus the
+	*					request was sent from (dual bus).
+	*
+	*					request_housekeeping_all() and the remote sweeps leave out the nodes whose
+	*					heartbeat has stopped (can_nmt.c).
+	*
+	*					collect_housekeeping_all() only waits for the nodes requested since the
+	*					last collection (by request_housekeeping(), request_housekeeping_all()
+	*					or hk_expect()) and not DEAD; the nodes left out are reported not valid
+	*					at once.
+	*
+	*	DESCRIPTION:	
+	*
+	*	request_housekeeping() marks the node's slot as pending and queues the request.
+	*	can_hk_reply() is called by the CAN dispatch task for every HK_RETURNED frame; it
+	*	stores the data in the slot and gives the slot's semaphore. wait_housekeeping()
+	*	blocks on that semaphore with a timeout.
+	*	
+ */
+
+#include "can_hk.h"
+#include "can_nmt.h"
+
+#include "task.h"
+#include "timers.h"
+
+typedef struct {
+	volatile uint32_t ul_state;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	SemaphoreHandle_t xDone;
+	volatile uint32_t ul_tx_valid;		// us_tx_stamp belongs to the outstanding request.
+	uint16_t us_tx_stamp;
+	uint8_t uc_tx_ctrl;					// Bus the request left from (dual bus).
+	TickType_t xTxTick;
+} hk_slot_t;
+
+volatile hk_stats_t hk_stats;
+
+static hk_slot_t hk_table[HK_NODE_COUNT];
+static hk_rtt_t hk_rtt[HK_NODE_COUNT];
+static uint32_t ul_hk_sweep = 0;		// Bit n: node HK_NODE_FIRST + n requested for the next collection.
+
+/* Latest answer of each node in remote-frame mode. */
+typedef struct {
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	TickType_t xTick;
+	uint32_t ul_valid;
+	uint32_t ul_fresh;			// Answered since the last sweep.
+} hk_remote_t;
+
+static hk_remote_t hk_remote[HK_NODE_COUNT];
+static uint32_t ul_remote_running = 0;
+static TimerHandle_t xHkRemoteTimer = NULL;
+
+static void can_hk_tx_done(const can_frame_t *p_frame);
+
+/************************************************************************/
+/*				INITIALIZE THE HOUSEKEEPING TABLE                       */
+/*	Called from can_init_mailboxes(). Creates one semaphore per node.	*/
+/************************************************************************/
+
+void can_hk_init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		hk_table[i].ul_state = HK_IDLE;
+		hk_table[i].xDone = xSemaphoreCreateBinary();
+	}
+
+	hk_clear_rtt();
+
+	can_register_handler(CAN_CTRL_0, HK_RETURNED, can_hk_reply);
+	can_register_tx_hook(can_hk_tx_done);
+}
+
+/************************************************************************/
+/*				REQUEST SENT                                            */
+/*	TX hook, CAN interrupt context. Keeps the hardware timestamp of		*/
+/*	each housekeeping request that leaves a mailbox.					*/
+/************************************************************************/
+
+static void can_hk_tx_done(const can_frame_t *p_frame)
+{
+	uint32_t ul_can_id = CAN_MID_TO_ID(p_frame->ul_id);
+	uint32_t ID = CAN_ID_DST(ul_can_id);
+
+	if ((p_frame->ul_datal != HK_REQUEST) || (ul_can_id != HK_REQUEST_ID(ID)) || !HK_NODE_VALID(ID))
+		return;
+
+	hk_table[ID - HK_NODE_FIRST].us_tx_stamp = p_frame->us_timestamp;
+	hk_table[ID - HK_NODE_FIRST].uc_tx_ctrl = CAN_FRAME_CTRL(p_frame);
+	hk_table[ID - HK_NODE_FIRST].xTxTick = xTaskGetTickCountFromISR();
+	hk_table[ID - HK_NODE_FIRST].ul_tx_valid = 1;
+}
+
+/* Dispatch task context, called with a matched reply. The two controllers have
+*  their own timers, so a reply which came back on the other bus is not timed. */
+static void can_hk_record_rtt(hk_slot_t *p_slot, hk_rtt_t *p_rtt, const can_frame_t *p_frame)
+{
+	uint16_t us_rx_stamp = p_frame->us_timestamp;
+	uint32_t ul_us;
+
+	if (!p_slot->ul_tx_valid)
+		return;
+	p_slot->ul_tx_valid = 0;
+	if (p_slot->uc_tx_ctrl != CAN_FRAME_CTRL(p_frame))
+		return;
+
+	if (xTaskGetTickCount() - p_slot->xTxTick > 1) {
+		p_rtt->ul_overrange++;
+		return;
+	}
+
+	ul_us = CAN_TIMESTAMP_DIFF(us_rx_stamp, p_slot->us_tx_stamp) * CAN_TIMESTAMP_US;
+	p_rtt->ul_last_us = ul_us;
+	p_rtt->ul_sum_us += ul_us;
+	if (!p_rtt->ul_count || (ul_us < p_rtt->ul_min_us))
+		p_rtt->ul_min_us = ul_us;
+	if (ul_us > p_rtt->ul_max_us)
+		p_rtt->ul_max_us = ul_us;
+	p_rtt->ul_count++;
+}
+
+/************************************************************************/
+/*                 REQUEST HOUSKEEPING TO BE SENT TO CAN0		        */
+/*	This function will take in the ID of the node of interest. It will  */
+/*	mark the node's slot as pending and then queue a housekeeping		*/
+/*	request to this node at HK_REQUEST_PRIO.							*/
+/*																		*/
+/*  The function will return 1 if the request was queued and 0 if not.	*/
+/*	Use wait_housekeeping() to get the reply, or collect_housekeeping_all()*/
+/*	to get it with those of the other nodes requested.					*/
+/************************************************************************/
+
+uint32_t request_housekeeping(uint32_t ID)
+{
+	hk_slot_t *p_slot;
+
+	if (!HK_NODE_VALID(ID))
+		return 0;
+	p_slot = &hk_table[ID - HK_NODE_FIRST];
+
+	/* Throw away a reply to an earlier request which nobody waited for. */
+	xSemaphoreTake(p_slot->xDone, 0);
+	p_slot->ul_tx_valid = 0;
+	p_slot->ul_state = HK_PENDING;
+
+	if (!send_can_command(HK_REQUEST, HK_REQUEST, HK_REQUEST_ID(ID), HK_REQUEST_PRIO)) {
+		p_slot->ul_state = HK_IDLE;
+		return 0;
+	}
+
+	taskENTER_CRITICAL();
+	ul_hk_sweep |= (1u << (ID - HK_NODE_FIRST));
+	taskEXIT_CRITICAL();
+
+	hk_stats.ul_requests++;
+	return 1;
+}
+
+/************************************************************************/
+/*				EXPECT A HOUSEKEEPING REPLY                             */
+/*	Marks ID as pending like request_housekeeping() but does not send	*/
+/*	anything; the request is sent by someone else (can_tt.c). Use		*/
+/*	wait_housekeeping() to get the reply. Returns 0 for an unknown ID.	*/
+/************************************************************************/
+
+uint32_t hk_expect(uint32_t ID)
+{
+	hk_slot_t *p_slot;
+
+	if (!HK_NODE_VALID(ID))
+		return 0;
+	p_slot = &hk_table[ID - HK_NODE_FIRST];
+
+	xSemaphoreTake(p_slot->xDone, 0);
+	p_slot->ul_tx_valid = 0;
+	p_slot->ul_state = HK_PENDING;
+	taskENTER_CRITICAL();
+	ul_hk_sweep |= (1u << (ID - HK_NODE_FIRST));
+	taskEXIT_CRITICAL();
+	hk_stats.ul_requests++;
+
+	return 1;
+}
+
+/************************************************************************/
+/*				MATCH A HOUSEKEEPING REPLY                              */
+/*	Dispatch table handler for HK_RETURNED on CAN0.						*/
+/************************************************************************/
+
+void can_hk_reply(const can_frame_t *p_frame)
+{
+	uint32_t ul_can_id = CAN_MID_TO_ID(p_frame->ul_id);
+	uint32_t ID = CAN_ID_SRC(ul_can_id);
+	hk_slot_t *p_slot;
+
+	pio_toggle_pin(LED2_GPIO);	// LED2 indicates the reception of housekeeping.
+
+	if ((ul_can_id != HK_REPLY_ID(ID)) || !HK_NODE_VALID(ID)) {
+		hk_stats.ul_unmatched++;
+		return;
+	}
+	p_slot = &hk_table[ID - HK_NODE_FIRST];
+
+	if (p_slot->ul_state != HK_PENDING) {
+		hk_stats.ul_unmatched++;			// Late reply or nothing was requested.
+		return;
+	}
+
+	p_slot->ul_datal = p_frame->ul_datal;
+	p_slot->ul_datah = p_frame->ul_datah;
+	can_hk_record_rtt(p_slot, &hk_rtt[ID - HK_NODE_FIRST], p_frame);
+	p_slot->ul_state = HK_DONE;
+	hk_stats.ul_replies++;
+
+	xSemaphoreGive(p_slot->xDone);
+}
+
+/************************************************************************/
+/*				WAIT FOR A HOUSEKEEPING REPLY                           */
+/*	Blocks the calling task until the node answers or xTimeout ticks	*/
+/*	have passed. Returns 1 and fills p_low and p_high with the reply, or	*/
+/*	0 on timeout (a reply arriving later is dropped).					*/
+/************************************************************************/
+
+uint32_t wait_housekeeping(uint32_t ID, uint32_t *p_low, uint32_t *p_high, TickType_t xTimeout)
+{
+	hk_slot_t *p_slot;
+
+	if (!HK_NODE_VALID(ID))
+		return 0;
+	p_slot = &hk_table[ID - HK_NODE_FIRST];
+
+	if (p_slot->ul_state == HK_PENDING)
+		xSemaphoreTake(p_slot->xDone, xTimeout);
+
+	taskENTER_CRITICAL();
+	if (p_slot->ul_state != HK_DONE) {
+		if (p_slot->ul_state == HK_PENDING) {
+			p_slot->ul_state = HK_TIMED_OUT;
+			hk_stats.ul_timeouts++;
+		}
+		taskEXIT_CRITICAL();
+		return 0;
+	}
+	*p_low = p_slot->ul_datal;
+	*p_high = p_slot->ul_datah;
+	p_slot->ul_state = HK_IDLE;
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
+/************************************************************************/
+/*				REQUEST HOUSEKEEPING FROM EVERY NODE                    */
+/*	Queues a request to each of SUB0_ID0 - SUB0_ID5 back to back so the */
+/*	replies all come back within one round trip. Nodes which are DEAD	*/
+/*	(can_nmt.h) are skipped. Returns the number of requests that were	*/
+/*	queued; only those nodes are waited for by collect_housekeeping_all().*/
+/************************************************************************/
+
+uint32_t request_housekeeping_all(void)
+{
+	uint32_t ID, count = 0;
+
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++) {
+		if (can_nmt_state(ID) == CAN_NMT_DEAD) {
+			hk_stats.ul_skipped_dead++;
+			continue;
+		}
+		if (request_housekeeping(ID))
+			count++;
+	}
+
+	return count;
+}
+
+/************************************************************************/
+/*				COLLECT A HOUSEKEEPING SWEEP                            */
+/*	Waits for every node requested (request_housekeeping(), hk_expect())*/
+/*	since the last collection began and not DEAD (can_nmt.h); the		*/
+/*	others are not valid, whatever their slot holds. All nodes share	*/
+/*	one window of xWindow ticks. p_results must have room for			*/
+/*	HK_NODE_COUNT entries. Returns the number of nodes that replied.	*/
+/************************************************************************/
+
+uint32_t collect_housekeeping_all(hk_result_t *p_results, TickType_t xWindow)
+{
+	TickType_t xStart = xTaskGetTickCount(), xElapsed;
+	uint32_t ul_sweep, i, count = 0;
+
+	/* Requests made while this one waits belong to the next collection. */
+	taskENTER_CRITICAL();
+	ul_sweep = ul_hk_sweep;
+	ul_hk_sweep = 0;
+	taskEXIT_CRITICAL();
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		p_results[i].ul_id = HK_NODE_FIRST + i;
+		if (!(ul_sweep & (1u << i)) || (can_nmt_state(HK_NODE_FIRST + i) == CAN_NMT_DEAD)) {
+			p_results[i].ul_valid = 0;
+			continue;
+		}
+		xElapsed = xTaskGetTickCount() - xStart;
+		p_results[i].ul_valid = wait_housekeeping(HK_NODE_FIRST + i, &p_results[i].ul_datal,
+				&p_results[i].ul_datah, (xElapsed < xWindow) ? (xWindow - xElapsed) : 0);
+		count += p_results[i].ul_valid;
+	}
+
+	return count;
+}
+
+/************************************************************************/
+/*				ROUND-TRIP STATISTICS                                   */
+/*	hk_get_rtt() copies the statistics of one node, it returns 0 for an */
+/*	unknown ID.															*/
+/************************************************************************/
+
+uint32_t hk_get_rtt(uint32_t ID, hk_rtt_t *p_rtt)
+{
+	if (!HK_NODE_VALID(ID))
+		return 0;
+
+	taskENTER_CRITICAL();
+	*p_rtt = hk_rtt[ID - HK_NODE_FIRST];
+	taskEXIT_CRITICAL();
+
+	return 1;
+}
+
+void hk_clear_rtt(void)
+{
+	uint8_t i;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		hk_rtt[i].ul_count = 0;
+		hk_rtt[i].ul_last_us = 0;
+		hk_rtt[i].ul_min_us = 0;
+		hk_rtt[i].ul_max_us = 0;
+		hk_rtt[i].ul_sum_us = 0;
+		hk_rtt[i].ul_overrange = 0;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				REMOTE-FRAME HOUSEKEEPING                               */
+/************************************************************************/
+
+/* Mailbox handler of the consumer mailboxes (dispatch task context). */
+static void can_hk_remote_reply(const can_frame_t *p_frame)
+{
+	uint8_t i = CAN_FRAME_MB(p_frame) - HK_REMOTE_MB_FIRST;
+
+	if (i >= HK_NODE_COUNT)
+		return;
+
+	taskENTER_CRITICAL();
+	hk_remote[i].ul_datal = p_frame->ul_datal;
+	hk_remote[i].ul_datah = p_frame->ul_datah;
+	hk_remote[i].xTick = xTaskGetTickCount();
+	hk_remote[i].ul_valid = 1;
+	hk_remote[i].ul_fresh = 1;
+	taskEXIT_CRITICAL();
+
+	hk_stats.ul_remote_replies++;
+}
+
+static void prvHkRemoteTimer(TimerHandle_t xTimer)
+{
+	(void)xTimer;
+	hk_remote_sweep();
+}
+
+/************************************************************************/
+/*				START REMOTE-FRAME HOUSEKEEPING                         */
+/*	Sets up one consumer mailbox per node and, if xPeriod is not 0,		*/
+/*	sweeps every xPeriod ticks from a software timer. Returns 0 if the	*/
+/*	mailboxes are in use (e.g. by the time-triggered schedule).			*/
+/************************************************************************/
+
+uint32_t hk_remote_start(TickType_t xPeriod)
+{
+	can_mb_conf_t mailbox;
+	uint8_t i;
+
+	if (ul_remote_running)
+		return 0;
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (!can_mailbox_claim(CAN1, HK_REMOTE_MB_FIRST + i, CAN_OWNER_HK_REMOTE)) {
+			while (i--)
+				can_mailbox_release(CAN1, HK_REMOTE_MB_FIRST + i, CAN_OWNER_HK_REMOTE);
+			return 0;
+		}
+	}
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		hk_remote[i].ul_valid = 0;
+		hk_remote[i].ul_fresh = 1;		// Nothing to miss before the first sweep.
+
+		reset_mailbox_conf(&mailbox);
+		mailbox.ul_mb_idx = HK_REMOTE_MB_FIRST + i;
+		mailbox.uc_obj_type = CAN_MB_CONSUMER_MODE;
+		mailbox.uc_tx_prio = HK_REMOTE_TX_PRIO;
+		mailbox.ul_id_msk = CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk;
+		mailbox.ul_id = CAN_MID_MIDvA(HK_REMOTE_ID(HK_NODE_FIRST + i));
+		can_mailbox_setup(CAN1, &mailbox, CAN_OWNER_HK_REMOTE);
+
+		can_register_mb_handler(CAN_CTRL_1, HK_REMOTE_MB_FIRST + i, can_hk_remote_reply);
+		can_enable_interrupt(CAN1, (1u << (HK_REMOTE_MB_FIRST + i)));
+	}
+	ul_remote_running = 1;
+
+	if (xPeriod) {
+		if (!xHkRemoteTimer)
+			xHkRemoteTimer = xTimerCreate("HKRM", xPeriod, pdTRUE, NULL, prvHkRemoteTimer);
+		else
+			xTimerChangePeriod(xHkRemoteTimer, xPeriod, 0);
+		if (xHkRemoteTimer)
+			xTimerStart(xHkRemoteTimer, 0);
+	}
+
+	return 1;
+}
+
+/************************************************************************/
+/*				STOP REMOTE-FRAME HOUSEKEEPING                          */
+/************************************************************************/
+
+void hk_remote_stop(void)
+{
+	uint8_t i;
+
+	if (!ul_remote_running)
+		return;
+
+	if (xHkRemoteTimer)
+		xTimerStop(xHkRemoteTimer, 0);
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		can_disable_interrupt(CAN1, (1u << (HK_REMOTE_MB_FIRST + i)));
+		can_register_mb_handler(CAN_CTRL_1, HK_REMOTE_MB_FIRST + i, NULL);
+	}
+	can_global_send_abort_cmd(CAN1, (uint8_t)(((1u << HK_NODE_COUNT) - 1) << HK_REMOTE_MB_FIRST));
+	for (i = 0; i < HK_NODE_COUNT; i++)
+		can_mailbox_release(CAN1, HK_REMOTE_MB_FIRST + i, CAN_OWNER_HK_REMOTE);
+
+	ul_remote_running = 0;
+}
+
+/************************************************************************/
+/*				REMOTE SWEEP                                            */
+/*	Sends one remote frame to every node which is not DEAD (can_nmt.h)	*/
+/*	with a single transfer command. Returns 0 if remote-frame mode is	*/
+/*	not running.														*/
+/************************************************************************/
+
+uint32_t hk_remote_sweep(void)
+{
+	uint32_t ul_mask = 0;
+	uint8_t i;
+
+	if (!ul_remote_running)
+		return 0;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (can_nmt_state(HK_NODE_FIRST + i) == CAN_NMT_DEAD) {
+			hk_remote[i].ul_fresh = 1;		// Not asked, so nothing to miss.
+			hk_stats.ul_skipped_dead++;
+			continue;
+		}
+		if (!hk_remote[i].ul_fresh)
+			hk_stats.ul_remote_missed++;
+		hk_remote[i].ul_fresh = 0;
+		ul_mask |= (1u << (HK_REMOTE_MB_FIRST + i));
+	}
+	taskEXIT_CRITICAL();
+
+	if (ul_mask)
+		can_global_send_transfer_cmd(CAN1, (uint8_t)ul_mask);
+	hk_stats.ul_remote_sweeps++;
+
+	return 1;
+}
+
+/************************************************************************/
+/*				READ REMOTE HOUSEKEEPING                                */
+/*	Copies the latest answer of node ID. *p_age is the number of ticks	*/
+/*	since it arrived. Returns 0 if the node has not answered yet.		*/
+/************************************************************************/
+
+uint32_t hk_remote_get(uint32_t ID, uint32_t *p_low, uint32_t *p_high, TickType_t *p_age)
+{
+	hk_remote_t *p_node;
+	uint32_t ret = 0;
+
+	if (!HK_NODE_VALID(ID))
+		return 0;
+	p_node = &hk_remote[ID - HK_NODE_FIRST];
+
+	taskENTER_CRITICAL();
+	if (p_node->ul_valid) {
+		*p_low = p_node->ul_datal;
+		*p_high = p_node->ul_datah;
+		*p_age = xTaskGetTickCount() - p_node->xTick;
+		ret = 1;
+	}
+	taskEXIT_CRITICAL();
+
+	return ret;
+}
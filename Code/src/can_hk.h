@@ -0,0 +1,147 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_hk.h
+	*
+	*	PURPOSE:		
+	*	Definitions and prototypes for the housekeeping request/response engine in
+	*	can_hk.c.
+	*
+	*	FILE REFERENCES:	can_func.h, FreeRTOS.h, semphr.h
+	*
+	*	EXTERNAL VARIABLES:		hk_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	
+	*	A subsystem answers an HK_REQUEST with a frame whose ID is HK_REPLY_ID(its SUB0_IDx),
+	*	ul_datal = HK_RETURNED and the housekeeping data in ul_datah.
+	*
+	*	NOTES:	
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					Added the round-trip statistics (hk_rtt_t, hk_get_rtt()).
+	*
+	*					Added hk_expect() for requests sent by the time-triggered schedule.
+	*
+	*					Added remote-frame housekeeping (hk_remote_start() ...).
+	*
+	*					Added HK_REQUEST_ID() and HK_REPLY_ID(); the remote IDs are built with
+	*					CAN_ID() too.
+	*
+	*					Added hk_stats.ul_skipped_dead (nodes left out by their heartbeat).
+	*
+	*					Noted why remote-frame housekeeping runs on CAN1 and when it cannot.
+	*
+*/
+
+#ifndef CAN_HK_H
+#define CAN_HK_H
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "can_func.h"
+
+/* Subsystem nodes which can be asked for housekeeping (SUB0_ID0 - SUB0_ID5). */
+#define HK_NODE_FIRST			SUB0_ID0
+#define HK_NODE_COUNT			6
+#define HK_NODE_VALID(ID)		( ( ( ID ) >= HK_NODE_FIRST ) && ( ( ID ) < HK_NODE_FIRST + HK_NODE_COUNT ) )
+
+/* IDs of the housekeeping class (see IDENTIFIER LAYOUT in can_func.h). The ID
+*  parameter of the functions below is the node number (SUB0_IDx). */
+#define HK_REQUEST_ID(ID)		CAN_ID(CAN_PRIO_HK, ( ID ), CAN_NODE_OBC, CAN_TYPE_REQ)
+#define HK_REPLY_ID(ID)			CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, ( ID ), CAN_TYPE_REPLY)
+
+/* Replies arrive through the CAN0 subscription mailboxes (see can_init_mailboxes()).
+*  An ID the filters let through by mistake is dropped by can_hk_reply(). */
+
+/* State of an outstanding request. */
+#define HK_IDLE					0
+#define HK_PENDING				1
+#define HK_DONE					2
+#define HK_TIMED_OUT			3
+
+/* Result of one node in a housekeeping sweep. */
+typedef struct {
+	uint32_t ul_id;
+	uint32_t ul_valid;		/**< 1 if ul_datal/ul_datah hold a reply, 0 on timeout or if the node was not requested. */
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+} hk_result_t;
+
+typedef struct {
+	uint32_t ul_requests;
+	uint32_t ul_replies;
+	uint32_t ul_timeouts;
+	uint32_t ul_unmatched;		/**< Replies from unknown nodes or with no request pending. */
+	uint32_t ul_remote_sweeps;
+	uint32_t ul_remote_replies;
+	uint32_t ul_remote_missed;	/**< Nodes which had not answered the previous sweep. */
+	uint32_t ul_skipped_dead;	/**< Requests not sent because the node's heartbeat had stopped. */
+} hk_stats_t;
+
+extern volatile hk_stats_t hk_stats;
+
+/* Round trip of one node: hardware timestamp of the reply minus that of the
+*  request, both taken on CAN0. Times are in us (resolution CAN_TIMESTAMP_US).
+*  Replies more than one tick after the request are outside the range of the
+*  16-bit CAN timer and are only counted in ul_overrange.
+*  Jitter = ul_max_us - ul_min_us, mean = ul_sum_us / ul_count. */
+typedef struct {
+	uint32_t ul_count;
+	uint32_t ul_last_us;
+	uint32_t ul_min_us;
+	uint32_t ul_max_us;
+	uint32_t ul_sum_us;
+	uint32_t ul_overrange;
+} hk_rtt_t;
+
+/*		REMOTE-FRAME HOUSEKEEPING
+	Each subsystem keeps its latest housekeeping in a producer mailbox with ID
+	HK_REMOTE_ID(its SUB0_IDx). The OBC has one consumer mailbox per subsystem on
+	CAN1 MB2 - MB7; a sweep sets MTCR on all of them at once, so it costs one remote
+	frame per node and the CAN controller matches each answer to its mailbox.
+	The answers are stored by mailbox, no opcode is decoded.
+
+	The remote IDs are broadcast (CAN_NODE_ALL), so they are out of the range of the
+	CAN0 subscription mailboxes and housekeeping data is never mistaken for a
+	command.
+
+	CAN1, because CAN0 has no six mailboxes to spare (MB0 - MB1 test programs,
+	MB2 - MB3 reception FIFO, MB4 process data, MB5 extended frames, MB6 - MB7 TX
+	pool). In the default build CAN1 is on the same bus as CAN0 and reaches every
+	subsystem. With the dual bus (can_dual.h) it still does, but CAN1 MB2 - MB7 are
+	the driver's; with the gateway (can_gw.h) CAN1 is on the payload bus and all its
+	mailboxes are the gateway's. hk_remote_start() then fails to claim them and
+	returns 0. So it does while the time-triggered schedule (can_tt.h, the same
+	mailboxes) runs, or a test program holds one of them (housekeep_test.c uses
+	CAN1 MB3).
+*/
+#define HK_REMOTE_ID(ID)		CAN_ID(CAN_PRIO_HK, CAN_NODE_ALL, ( ID ), CAN_TYPE_DATA)
+#define HK_REMOTE_MB_FIRST		2
+#define HK_REMOTE_TX_PRIO		9
+
+void can_hk_init(void);
+void can_hk_reply(const can_frame_t *p_frame);
+uint32_t wait_housekeeping(uint32_t ID, uint32_t *p_low, uint32_t *p_high, TickType_t xTimeout);	// API Function.
+uint32_t hk_expect(uint32_t ID);																	// API Function.
+uint32_t request_housekeeping_all(void);															// API Function.
+uint32_t collect_housekeeping_all(hk_result_t *p_results, TickType_t xWindow);						// API Function.
+uint32_t hk_get_rtt(uint32_t ID, hk_rtt_t *p_rtt);													// API Function.
+void hk_clear_rtt(void);																			// API Function.
+uint32_t hk_remote_start(TickType_t xPeriod);														// API Function.
+void hk_remote_stop(void);																			// API Function.
+uint32_t hk_remote_sweep(void);																		// API Function.
+uint32_t hk_remote_get(uint32_t ID, uint32_t *p_low, uint32_t *p_high, TickType_t *p_age);			// API Function.
+
+#endif /* CAN_HK_H */
@@ -0,0 +1,279 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_nmt.c
+	*
+	*	PURPOSE:
+	*	Tracks which nodes are alive from their periodic heartbeat frames and tells
+	*	the rest of the OBC when one of them appears or goes silent.
+	*
+	*	FILE REFERENCES:	can_nmt.h, task.h, timers.h
+	*
+	*	EXTERNAL VARIABLES:		can_nmt_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Heartbeats whose ID does not match their node are counted and ignored.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_nmt.h.
+	*	The wheel is changed by the dispatch task (heartbeats) and the timer task
+	*	(ticks), each time inside a short critical section.
+	*
+	*	NOTES:
+	*	can_hk.c leaves DEAD nodes out of request_housekeeping_all() and of the
+	*	remote-frame sweeps.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_nmt_init() is called by can_init_mailboxes(); it registers the heartbeat
+	*	handlers and starts the wheel timer.
+	*	can_nmt_heartbeat() is called by the CAN dispatch task for every heartbeat.
+	*	prvNmtWheelTimer() runs once per tick and marks the nodes whose deadline is
+	*	this tick DEAD.
+	*
+ */
+
+#include "can_nmt.h"
+
+#include "task.h"
+#include "timers.h"
+
+volatile can_nmt_stats_t can_nmt_stats;
+
+#define CAN_NMT_NIL		0xFF
+
+typedef struct {
+	uint8_t uc_state;				// CAN_NMT_*
+	uint8_t uc_reported;			// State the node put in its last heartbeat.
+	uint8_t uc_next;				// Wheel slot list, CAN_NMT_NIL at the end.
+	uint8_t uc_prev;
+	uint32_t ul_deadline;			// Wheel tick; the slot is ul_deadline & (CAN_NMT_WHEEL_SLOTS - 1).
+	TickType_t xLastSeen;
+} nmt_node_t;
+
+typedef char can_nmt_nodes_check[( CAN_NMT_NODES < CAN_NMT_NIL ) && ( CAN_NMT_NODES <= 32 ) ? 1 : -1];
+
+static nmt_node_t nmt_node[CAN_NMT_NODES];
+static uint8_t uc_wheel[CAN_NMT_WHEEL_SLOTS];		// First node of each slot.
+static uint32_t ul_wheel_now = 0;
+static can_nmt_listener_t nmt_listener[CAN_NMT_LISTENERS];
+static TimerHandle_t xNmtWheelTimer = NULL;
+
+static void can_nmt_heartbeat(const can_frame_t *p_frame);
+static void prvNmtWheelTimer(TimerHandle_t xTimer);
+
+/************************************************************************/
+/*				WHEEL LISTS                                             */
+/*	Callers hold a critical section.									*/
+/************************************************************************/
+
+static void can_nmt_unlink(uint8_t uc_node)
+{
+	nmt_node_t *p_node = &nmt_node[uc_node];
+
+	if (p_node->uc_prev != CAN_NMT_NIL)
+		nmt_node[p_node->uc_prev].uc_next = p_node->uc_next;
+	else
+		uc_wheel[p_node->ul_deadline & (CAN_NMT_WHEEL_SLOTS - 1)] = p_node->uc_next;
+	if (p_node->uc_next != CAN_NMT_NIL)
+		nmt_node[p_node->uc_next].uc_prev = p_node->uc_prev;
+}
+
+static void can_nmt_link(uint8_t uc_node, uint32_t ul_deadline)
+{
+	nmt_node_t *p_node = &nmt_node[uc_node];
+	uint8_t *p_head = &uc_wheel[ul_deadline & (CAN_NMT_WHEEL_SLOTS - 1)];
+
+	p_node->ul_deadline = ul_deadline;
+	p_node->uc_prev = CAN_NMT_NIL;
+	p_node->uc_next = *p_head;
+	if (*p_head != CAN_NMT_NIL)
+		nmt_node[*p_head].uc_prev = uc_node;
+	*p_head = uc_node;
+}
+
+static void can_nmt_event(uint8_t uc_node, uint8_t uc_state)
+{
+	uint8_t i;
+
+	for (i = 0; i < CAN_NMT_LISTENERS; i++) {
+		if (nmt_listener[i])
+			nmt_listener[i](uc_node, uc_state);
+	}
+}
+
+/************************************************************************/
+/*				INITIALIZE                                              */
+/************************************************************************/
+
+void can_nmt_init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < CAN_NMT_NODES; i++)
+		nmt_node[i].uc_state = CAN_NMT_UNKNOWN;
+	memset(uc_wheel, CAN_NMT_NIL, sizeof(uc_wheel));
+
+	can_register_handler(CAN_CTRL_0, NMT_HEARTBEAT, can_nmt_heartbeat);
+	can_register_ext_handler(CAN_CTRL_0, CAN_NMT_EXT_TYPE, can_nmt_heartbeat);
+
+	if (!xNmtWheelTimer)
+		xNmtWheelTimer = xTimerCreate("NMT", 1, pdTRUE, NULL, prvNmtWheelTimer);
+	if (xNmtWheelTimer)
+		xTimerStart(xNmtWheelTimer, 0);
+}
+
+/************************************************************************/
+/*				HEARTBEAT                                               */
+/*	Dispatch table handler (CAN dispatch task). Moves the node to the	*/
+/*	slot of its new deadline.											*/
+/************************************************************************/
+
+static void can_nmt_heartbeat(const can_frame_t *p_frame)
+{
+	nmt_node_t *p_node;
+	uint32_t ul_id;
+	uint8_t uc_node, uc_old, uc_reported;
+
+	if (CAN_MID_IS_EXT(p_frame->ul_id)) {
+		ul_id = CAN_MID_TO_EXT_ID(p_frame->ul_id);
+		uc_node = (uint8_t)CAN_EXT_SRC(ul_id);
+		uc_reported = (uint8_t)p_frame->ul_datal;
+	} else {
+		ul_id = CAN_MID_TO_ID(p_frame->ul_id);
+		uc_node = (uint8_t)CAN_ID_SRC(ul_id);
+		uc_reported = (uint8_t)p_frame->ul_datah;
+		if (ul_id != NMT_HEARTBEAT_ID(uc_node))
+			uc_node = CAN_NODE_OBC;
+	}
+	if (uc_node == CAN_NODE_OBC) {
+		can_nmt_stats.ul_invalid++;
+		return;
+	}
+	p_node = &nmt_node[uc_node];
+
+	taskENTER_CRITICAL();
+	if (p_node->uc_state == CAN_NMT_ALIVE)
+		can_nmt_unlink(uc_node);
+	can_nmt_link(uc_node, ul_wheel_now + CAN_NMT_TIMEOUT_TICKS);
+	uc_old = p_node->uc_state;
+	p_node->uc_state = CAN_NMT_ALIVE;
+	p_node->uc_reported = uc_reported;
+	p_node->xLastSeen = xTaskGetTickCount();
+	taskEXIT_CRITICAL();
+
+	can_nmt_stats.ul_heartbeats++;
+	if (uc_old != CAN_NMT_ALIVE) {
+		can_nmt_stats.ul_to_alive++;
+		can_nmt_event(uc_node, CAN_NMT_ALIVE);
+	}
+}
+
+/************************************************************************/
+/*				WHEEL TICK                                              */
+/*	Timer task, once per tick. Nodes in this tick's slot whose			*/
+/*	deadline is a later turn of the wheel stay where they are.			*/
+/************************************************************************/
+
+static void prvNmtWheelTimer(TimerHandle_t xTimer)
+{
+	uint32_t ul_dead = 0, ul_seen = 0;
+	uint8_t i, uc_next;
+
+	(void)xTimer;
+
+	taskENTER_CRITICAL();
+	ul_wheel_now++;
+	for (i = uc_wheel[ul_wheel_now & (CAN_NMT_WHEEL_SLOTS - 1)]; i != CAN_NMT_NIL; i = uc_next) {
+		uc_next = nmt_node[i].uc_next;
+		ul_seen++;
+		if (nmt_node[i].ul_deadline != ul_wheel_now)
+			continue;
+		can_nmt_unlink(i);
+		nmt_node[i].uc_state = CAN_NMT_DEAD;
+		ul_dead |= (1u << i);
+	}
+	taskEXIT_CRITICAL();
+
+	if (ul_seen > can_nmt_stats.ul_wheel_max)
+		can_nmt_stats.ul_wheel_max = ul_seen;
+
+	while (ul_dead) {
+		i = (uint8_t)(31 - __CLZ(ul_dead));
+		ul_dead &= ~(1u << i);
+		can_nmt_stats.ul_to_dead++;
+		can_nmt_event(i, CAN_NMT_DEAD);
+	}
+}
+
+/************************************************************************/
+/*				QUERIES                                                 */
+/*	can_nmt_state() returns the CAN_NMT_* state of a node (UNKNOWN for	*/
+/*	a number out of range). can_nmt_node_state() returns the state the	*/
+/*	node itself reported in its last heartbeat and the ticks since it.	*/
+/*	can_nmt_alive_mask() has bit n set for every ALIVE node n.			*/
+/************************************************************************/
+
+uint32_t can_nmt_state(uint32_t ul_node)
+{
+	if (ul_node >= CAN_NMT_NODES)
+		return CAN_NMT_UNKNOWN;
+	return nmt_node[ul_node].uc_state;
+}
+
+uint32_t can_nmt_node_state(uint32_t ul_node, TickType_t *p_age)
+{
+	uint32_t ul_reported;
+
+	if ((ul_node >= CAN_NMT_NODES) || (nmt_node[ul_node].uc_state == CAN_NMT_UNKNOWN))
+		return 0;
+
+	taskENTER_CRITICAL();
+	ul_reported = nmt_node[ul_node].uc_reported;
+	*p_age = xTaskGetTickCount() - nmt_node[ul_node].xLastSeen;
+	taskEXIT_CRITICAL();
+
+	return ul_reported;
+}
+
+uint32_t can_nmt_alive_mask(void)
+{
+	uint32_t ul_mask = 0;
+	uint8_t i;
+
+	for (i = 0; i < CAN_NMT_NODES; i++) {
+		if (nmt_node[i].uc_state == CAN_NMT_ALIVE)
+			ul_mask |= (1u << i);
+	}
+
+	return ul_mask;
+}
+
+/************************************************************************/
+/*				LISTENERS                                               */
+/*	Call during initialization. Returns 0 if all places are taken.		*/
+/************************************************************************/
+
+uint32_t can_nmt_register_listener(can_nmt_listener_t listener)
+{
+	uint8_t i;
+
+	for (i = 0; i < CAN_NMT_LISTENERS; i++) {
+		if (!nmt_listener[i]) {
+			nmt_listener[i] = listener;
+			return 1;
+		}
+	}
+
+	return 0;
+}
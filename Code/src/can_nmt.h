@@ -0,0 +1,96 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_nmt.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the node heartbeat / network management
+	*	service in can_nmt.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_nmt_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	A subsystem sends a heartbeat with the ID NMT_HEARTBEAT_ID(its SUB0_IDx),
+	*	ul_datal = NMT_HEARTBEAT and its own state in the low byte of ul_datah, every
+	*	CAN_NMT_PERIOD_TICKS. A node with a 5-bit number may send it as an extended
+	*	frame instead: CAN_EXT_ID(CAN_PRIO_HK, CAN_NODE_OBC, node, CAN_NMT_EXT_TYPE, seq),
+	*	its state in the low byte of ul_datal.
+	*
+	*	NOTES:
+	*	The heartbeat ID is in the range of the housekeeping replies, so the CAN0
+	*	reception filters need no change.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+*/
+
+#ifndef CAN_NMT_H
+#define CAN_NMT_H
+
+#include "FreeRTOS.h"
+#include "can_func.h"
+
+#define NMT_HEARTBEAT				0x4E4E4E4E
+#define NMT_HEARTBEAT_ID(ID)		CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, ( ID ), CAN_TYPE_DATA)
+#define CAN_NMT_EXT_TYPE			0x4E
+
+/*		LIVENESS
+	Every node starts UNKNOWN, becomes ALIVE with its first heartbeat and DEAD
+	when none has come for CAN_NMT_TIMEOUT_TICKS; the next heartbeat makes it
+	ALIVE again. A node which never sent a heartbeat stays UNKNOWN and is treated
+	as alive by the housekeeping functions, so nodes without heartbeat support
+	are still polled.
+
+	The deadlines are kept in a hashed timing wheel of CAN_NMT_WHEEL_SLOTS slots,
+	one slot per tick: a heartbeat moves its node to the slot of its new deadline
+	(unlink and link, no search), and each tick only looks at the nodes in the
+	slot of that tick, whose deadline is either now or a whole number of turns
+	of the wheel later. A heartbeat costs the same however many nodes there are,
+	and a tick looks at N / CAN_NMT_WHEEL_SLOTS nodes on average instead of all N.
+
+	Listeners registered with can_nmt_register_listener() are called on every
+	change of state, from the CAN dispatch task (to ALIVE) or the timer task
+	(to DEAD). They must not block.
+*/
+#define CAN_NMT_UNKNOWN				0
+#define CAN_NMT_ALIVE				1
+#define CAN_NMT_DEAD				2
+
+#define CAN_NMT_NODES				CAN_EXT_NODES		// Node numbers 0 - 31.
+#define CAN_NMT_PERIOD_TICKS		10					// Heartbeat period of the nodes (1 s).
+#define CAN_NMT_TIMEOUT_TICKS		( 3 * CAN_NMT_PERIOD_TICKS )
+#define CAN_NMT_WHEEL_SLOTS			64					// A power of two.
+#define CAN_NMT_LISTENERS			4
+
+typedef void (*can_nmt_listener_t)(uint8_t uc_node, uint8_t uc_state);
+
+typedef struct {
+	uint32_t ul_heartbeats;
+	uint32_t ul_invalid;			/**< Heartbeats with an ID that does not match the node. */
+	uint32_t ul_to_alive;
+	uint32_t ul_to_dead;
+	uint32_t ul_wheel_max;			/**< Most nodes looked at in one tick. */
+} can_nmt_stats_t;
+
+extern volatile can_nmt_stats_t can_nmt_stats;
+
+void can_nmt_init(void);
+uint32_t can_nmt_state(uint32_t ul_node);																// API Function.
+uint32_t can_nmt_node_state(uint32_t ul_node, TickType_t *p_age);										// API Function.
+uint32_t can_nmt_alive_mask(void);																		// API Function.
+uint32_t can_nmt_register_listener(can_nmt_listener_t listener);										// API Function.
+
+#endif /* CAN_NMT_H */
@@ -0,0 +1,254 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_pdo.c
+	*
+	*	PURPOSE:
+	*	Unpacks the cyclic process-data frames of the subsystems into a store of
+	*	scaled signal values, driven by a compile-time mapping table.
+	*
+	*	FILE REFERENCES:	can_pdo.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_pdo_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Frames with no mapping or too short for their mapping are counted and ignored.
+	*	Mapping entries which do not fit in 64 bits or name no signal are counted by
+	*	can_pdo_init() and left out.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_pdo.h.
+	*	The mapping below must match what the subsystems send.
+	*
+	*	NOTES:
+	*	This is the PDO mapping of CANopen, fixed at compile time.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		can_pdo_rx() unpacks the frame into a local array and only holds the
+	*					critical section while it copies the values into the store.
+	*					A frame maps at most CAN_PDO_MAP_MAX signals.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_pdo_init() is called by can_init_mailboxes(); it checks the mapping and
+	*	builds the frame lookup.
+	*	can_pdo_rx() is called by decode_can_msg() (CAN dispatch task) for every frame
+	*	of class CAN_PRIO_PDO.
+	*
+ */
+
+#include "can_pdo.h"
+
+#include "task.h"
+
+volatile can_pdo_stats_t can_pdo_stats;
+
+/************************************************************************/
+/*				MAPPING                                                 */
+/*	PDO_MAP(signal, bit, width, signed, mul, shift, offset)				*/
+/************************************************************************/
+
+/* EPS frame 0: bus and battery, 7 bytes. Temperature in 1/16 C. */
+static const can_pdo_map_t pdo_eps_0[] = {
+	PDO_MAP(PDO_EPS_BUS_MV,		0,	16,	0,	1,	0,	0),
+	PDO_MAP(PDO_EPS_BUS_MA,		16,	16,	1,	1,	0,	0),
+	PDO_MAP(PDO_EPS_BATT_DC,	32,	12,	1,	5,	3,	0),
+	PDO_MAP(PDO_EPS_SOC,		44,	7,	0,	1,	0,	0),
+};
+
+/* EPS frame 1: solar panels, 12-bit ADC counts of 2 mV, 6 bytes. */
+static const can_pdo_map_t pdo_eps_1[] = {
+	PDO_MAP(PDO_EPS_PANEL_MV(0),	0,	12,	0,	2,	0,	0),
+	PDO_MAP(PDO_EPS_PANEL_MV(1),	12,	12,	0,	2,	0,	0),
+	PDO_MAP(PDO_EPS_PANEL_MV(2),	24,	12,	0,	2,	0,	0),
+	PDO_MAP(PDO_EPS_PANEL_MV(3),	36,	12,	0,	2,	0,	0),
+};
+
+/* COMS frame 0: receiver, 3 bytes. PA temperature in 1/4 C from -40 C. */
+static const can_pdo_map_t pdo_coms_0[] = {
+	PDO_MAP(PDO_COMS_RSSI_DBM,	0,	8,	1,	1,	0,	0),
+	PDO_MAP(PDO_COMS_PA_DC,		8,	10,	0,	5,	1,	-400),
+	PDO_MAP(PDO_COMS_LOCKED,	18,	1,	0,	1,	0,	0),
+};
+
+/* Payload frame 0: environment, 7 bytes. Temperatures in 1/256 C, pressure in 2 Pa. */
+static const can_pdo_map_t pdo_pay_0[] = {
+	PDO_MAP(PDO_PAY_TEMP_MC(0),		0,	16,	1,	125,	5,	0),
+	PDO_MAP(PDO_PAY_TEMP_MC(1),		16,	16,	1,	125,	5,	0),
+	PDO_MAP(PDO_PAY_PRESSURE_PA,	32,	24,	0,	2,		0,	0),
+};
+
+#define PDO_FRAME(node, n, length, map)	\
+	{ ( node ), ( n ), ( length ), sizeof(map) / sizeof(map[0]), map }
+
+static const can_pdo_frame_t can_pdo_frames[] = {
+	PDO_FRAME(SUB0_ID0, 0, 7, pdo_eps_0),
+	PDO_FRAME(SUB0_ID0, 1, 6, pdo_eps_1),
+	PDO_FRAME(SUB0_ID1, 0, 3, pdo_coms_0),
+	PDO_FRAME(SUB0_ID2, 0, 7, pdo_pay_0),
+};
+
+#define CAN_PDO_FRAMES		( sizeof(can_pdo_frames) / sizeof(can_pdo_frames[0]) )
+#define CAN_PDO_NODES		8				// 3-bit source field.
+
+typedef char can_pdo_frames_check[( CAN_PDO_FRAMES < 0xFF ) ? 1 : -1];
+
+/************************************************************************/
+/*				SIGNAL STORE                                            */
+/************************************************************************/
+
+static int32_t l_pdo_value[PDO_SIGNALS];
+static TickType_t xPdoUpdated[CAN_PDO_FRAMES];
+static uint8_t uc_pdo_seen[CAN_PDO_FRAMES];
+static uint32_t ul_pdo_valid[CAN_PDO_FRAMES];				// Bit n = entry n passed can_pdo_init().
+static uint8_t uc_pdo_index[CAN_PDO_NODES][CAN_PDO_PER_NODE];	// Frame + 1, 0 = not mapped.
+
+/************************************************************************/
+/*				INITIALIZE                                              */
+/*	Checks every entry once, so that the unpack loop need not.			*/
+/************************************************************************/
+
+void can_pdo_init(void)
+{
+	const can_pdo_frame_t *p_frame;
+	const can_pdo_map_t *p_map;
+	uint8_t i, j;
+
+	memset(uc_pdo_index, 0, sizeof(uc_pdo_index));
+	memset(l_pdo_value, 0, sizeof(l_pdo_value));
+	memset(uc_pdo_seen, 0, sizeof(uc_pdo_seen));
+	can_pdo_stats.ul_bad_map = 0;
+
+	for (i = 0; i < CAN_PDO_FRAMES; i++) {
+		p_frame = &can_pdo_frames[i];
+		if ((p_frame->uc_node >= CAN_PDO_NODES) || (p_frame->uc_pdo >= CAN_PDO_PER_NODE)
+				|| (p_frame->uc_length > 8) || (p_frame->uc_count > CAN_PDO_MAP_MAX) || uc_pdo_index[p_frame->uc_node][p_frame->uc_pdo]) {
+			can_pdo_stats.ul_bad_map += p_frame->uc_count;
+			continue;
+		}
+
+		ul_pdo_valid[i] = 0;
+		for (j = 0; j < p_frame->uc_count; j++) {
+			p_map = &p_frame->p_map[j];
+			if ((p_map->uc_signal >= PDO_SIGNALS) || !p_map->uc_width || (p_map->uc_width > 32)
+					|| (p_map->uc_bit + p_map->uc_width > p_frame->uc_length * 8)
+					|| (p_map->uc_shift > 63))
+				can_pdo_stats.ul_bad_map++;
+			else
+				ul_pdo_valid[i] |= (1u << j);
+		}
+		uc_pdo_index[p_frame->uc_node][p_frame->uc_pdo] = i + 1;
+	}
+}
+
+/************************************************************************/
+/*				UNPACK                                                  */
+/*	CAN dispatch task. One pass over the entries of the frame: shift	*/
+/*	the field down, mask, sign-extend, scale. The values are then		*/
+/*	stored together in a critical section, for can_pdo_read_frame().	*/
+/************************************************************************/
+
+void can_pdo_rx(const can_frame_t *p_frame)
+{
+	const can_pdo_frame_t *p_pdo;
+	const can_pdo_map_t *p_map;
+	uint64_t ull_data;
+	int64_t ll_raw;
+	int32_t l_value[CAN_PDO_MAP_MAX];
+	uint32_t ul_id, ul_raw, ul_field, ul_valid, ul_start, ul_cycles;
+	uint8_t i, uc_frame;
+
+	ul_start = CAN_DWT_CYCCNT;
+
+	ul_id = CAN_MID_TO_ID(p_frame->ul_id);
+	uc_frame = uc_pdo_index[CAN_ID_SRC(ul_id)][CAN_ID_TYPE(ul_id)];
+	if (!uc_frame || (CAN_ID_DST(ul_id) != CAN_NODE_OBC)) {
+		can_pdo_stats.ul_unmapped++;
+		return;
+	}
+	uc_frame--;
+	p_pdo = &can_pdo_frames[uc_frame];
+	if (p_frame->uc_length < p_pdo->uc_length) {
+		can_pdo_stats.ul_bad_length++;
+		return;
+	}
+
+	ull_data = ((uint64_t)p_frame->ul_datah << 32) | p_frame->ul_datal;
+	ul_valid = ul_pdo_valid[uc_frame];
+
+	for (i = 0, p_map = p_pdo->p_map; i < p_pdo->uc_count; i++, p_map++) {
+		if (!(ul_valid & (1u << i)))
+			continue;
+		ul_raw = (uint32_t)(ull_data >> p_map->uc_bit);
+		if (p_map->uc_width < 32) {
+			ul_field = (1u << p_map->uc_width) - 1;
+			ul_raw &= ul_field;
+			if (p_map->uc_signed && (ul_raw & (1u << (p_map->uc_width - 1))))
+				ul_raw |= ~ul_field;
+		}
+		ll_raw = p_map->uc_signed ? (int64_t)(int32_t)ul_raw : (int64_t)ul_raw;
+		l_value[i] = (int32_t)((ll_raw * p_map->l_mul) >> p_map->uc_shift) + p_map->l_offset;
+	}
+
+	taskENTER_CRITICAL();
+	for (i = 0, p_map = p_pdo->p_map; i < p_pdo->uc_count; i++, p_map++) {
+		if (ul_valid & (1u << i))
+			l_pdo_value[p_map->uc_signal] = l_value[i];
+	}
+	xPdoUpdated[uc_frame] = xTaskGetTickCount();
+	uc_pdo_seen[uc_frame] = 1;
+	taskEXIT_CRITICAL();
+
+	can_pdo_stats.ul_frames++;
+	ul_cycles = CAN_DWT_CYCCNT - ul_start;
+	can_pdo_stats.ul_unpack_cycles += ul_cycles;
+	if (ul_cycles > can_pdo_stats.ul_unpack_max_cycles)
+		can_pdo_stats.ul_unpack_max_cycles = ul_cycles;
+}
+
+/************************************************************************/
+/*				READ                                                    */
+/*	can_pdo_get() returns the last value of one signal (0 until its		*/
+/*	frame has come). can_pdo_read_frame() copies the signals of frame	*/
+/*	uc_pdo of node uc_node into p_values, in the order of its mapping,	*/
+/*	with the ticks since that frame came; it returns the number of		*/
+/*	signals, or 0 if the frame is not mapped or has not come yet.		*/
+/************************************************************************/
+
+int32_t can_pdo_get(uint32_t ul_signal)
+{
+	if (ul_signal >= PDO_SIGNALS)
+		return 0;
+	return l_pdo_value[ul_signal];
+}
+
+uint32_t can_pdo_read_frame(uint8_t uc_node, uint8_t uc_pdo, int32_t *p_values, TickType_t *p_age)
+{
+	const can_pdo_frame_t *p_pdo;
+	uint8_t i, uc_frame;
+
+	if ((uc_node >= CAN_PDO_NODES) || (uc_pdo >= CAN_PDO_PER_NODE))
+		return 0;
+	uc_frame = uc_pdo_index[uc_node][uc_pdo];
+	if (!uc_frame || !uc_pdo_seen[uc_frame - 1])
+		return 0;
+	uc_frame--;
+	p_pdo = &can_pdo_frames[uc_frame];
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < p_pdo->uc_count; i++)
+		p_values[i] = (ul_pdo_valid[uc_frame] & (1u << i)) ? l_pdo_value[p_pdo->p_map[i].uc_signal] : 0;
+	*p_age = xTaskGetTickCount() - xPdoUpdated[uc_frame];
+	taskEXIT_CRITICAL();
+
+	return p_pdo->uc_count;
+}
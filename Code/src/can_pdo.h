@@ -0,0 +1,122 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_pdo.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the cyclic process-data frames in can_pdo.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		can_pdo_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	A subsystem sends process-data frame n (0 - 3) with the ID PDO_ID(its SUB0_IDx, n),
+	*	the signals packed as described by the mapping of that frame in can_pdo.c.
+	*	The payload is taken as one 64-bit little-endian word: bit 0 is bit 0 of the
+	*	first data byte (ul_datal), bit 32 is bit 0 of the fifth (ul_datah).
+	*
+	*	NOTES:
+	*	Process-data frames carry no opcode; all 8 bytes are signals. decode_can_msg()
+	*	recognises them by their class.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Added CAN_PDO_MAP_MAX.
+	*
+*/
+
+#ifndef CAN_PDO_H
+#define CAN_PDO_H
+
+#include "FreeRTOS.h"
+#include "can_func.h"
+
+#define PDO_ID(ID, n)				CAN_ID(CAN_PRIO_PDO, CAN_NODE_OBC, ( ID ), ( n ))
+#define CAN_PDO_PER_NODE			4					// Frame numbers 0 - 3 (the type field).
+
+/*		PROCESS-DATA MAPPING
+	Which signals a frame carries, and where, is fixed at compile time by the
+	mapping table in can_pdo.c: one entry per signal, giving its bit offset and
+	width in the payload, whether the raw field is two's complement, and the
+	scaling to engineering units:
+
+		value = ( ( raw * l_mul ) >> uc_shift ) + l_offset
+
+	(a 32 x 32 -> 64-bit multiply and a shift, no division). Every received frame
+	is unpacked by the same loop over the entries of its frame, then copied into
+	the signal store in one short critical section; adding a signal is one line
+	in the table and one number below, no parsing code.
+
+	The store holds one int32_t per signal plus, per frame, the tick of its last
+	update. A signal is read with can_pdo_get(), or together with the other
+	signals of its frame with can_pdo_read_frame(), which copies them in a
+	critical section so that they all come from the same frame.
+*/
+
+/* Signals. The numbers index the signal store. */
+#define PDO_EPS_BUS_MV				0		// Bus voltage, mV.
+#define PDO_EPS_BUS_MA				1		// Bus current, mA (positive = discharge).
+#define PDO_EPS_BATT_DC				2		// Battery temperature, 0.1 C.
+#define PDO_EPS_SOC					3		// Battery state of charge, %.
+#define PDO_EPS_PANEL_MV(n)			( 4 + ( n ) )	// Solar panel voltages, mV (n = 0 - 3).
+#define PDO_COMS_RSSI_DBM			8		// Received signal strength, dBm.
+#define PDO_COMS_PA_DC				9		// Power amplifier temperature, 0.1 C.
+#define PDO_COMS_LOCKED				10		// Receiver locked (0 / 1).
+#define PDO_PAY_TEMP_MC(n)			( 11 + ( n ) )	// Payload temperatures, m C (n = 0 - 1).
+#define PDO_PAY_PRESSURE_PA			13		// Payload pressure, Pa.
+#define PDO_SIGNALS					14
+
+typedef struct {
+	uint8_t uc_signal;				/**< PDO_* signal. */
+	uint8_t uc_bit;					/**< Offset of the field in the 64-bit payload. */
+	uint8_t uc_width;				/**< Width of the field, 1 - 32 bits. */
+	uint8_t uc_signed;				/**< 1 if the field is two's complement. */
+	uint8_t uc_shift;
+	int32_t l_mul;
+	int32_t l_offset;
+} can_pdo_map_t;
+
+/* Entries of one frame at most: can_pdo_rx() unpacks a frame on the dispatch
+*  task's stack before it stores it. */
+#define CAN_PDO_MAP_MAX				16
+
+#define PDO_MAP(signal, bit, width, sign, mul, shift, offset)	\
+	{ ( signal ), ( bit ), ( width ), ( sign ), ( shift ), ( mul ), ( offset ) }
+
+typedef struct {
+	uint8_t uc_node;				/**< SUB0_IDx. */
+	uint8_t uc_pdo;					/**< Frame number 0 - 3. */
+	uint8_t uc_length;				/**< Data length the node sends. */
+	uint8_t uc_count;
+	const can_pdo_map_t *p_map;
+} can_pdo_frame_t;
+
+typedef struct {
+	uint32_t ul_frames;
+	uint32_t ul_unmapped;			/**< Process-data frames with no mapping. */
+	uint32_t ul_bad_length;
+	uint32_t ul_bad_map;			/**< Mapping entries rejected by can_pdo_init(). */
+	uint32_t ul_unpack_cycles;
+	uint32_t ul_unpack_max_cycles;
+} can_pdo_stats_t;
+
+extern volatile can_pdo_stats_t can_pdo_stats;
+
+void can_pdo_init(void);
+void can_pdo_rx(const can_frame_t *p_frame);
+int32_t can_pdo_get(uint32_t ul_signal);																// API Function.
+uint32_t can_pdo_read_frame(uint8_t uc_node, uint8_t uc_pdo, int32_t *p_values, TickType_t *p_age);	// API Function.
+
+#endif /* CAN_PDO_H */
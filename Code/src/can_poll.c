@@ -0,0 +1,223 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_poll.c
+	*
+	*	PURPOSE:
+	*	Switches the reception mailboxes of a controller between one interrupt per
+	*	frame and periodic polling from a TC0 interrupt, depending on the frame rate,
+	*	so that the cost of taking the CAN handler for every frame is only paid when
+	*	the bus is quiet.
+	*
+	*	FILE REFERENCES:	can_poll.h, can_guard.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_poll_stats, can_rx_polled
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_poll.h.
+	*	Only the reception mailboxes owned by the driver are polled; those of the test
+	*	programs and the consumer mailboxes of remote housekeeping keep their interrupts.
+	*
+	*	NOTES:
+	*	This is the NAPI scheme of the Linux network drivers, with TC0 in place of the
+	*	softirq: the handler that would have been taken for a frame is run from a
+	*	timer instead while the bus is busy.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Mailboxes isolated by can_guard.c keep their interrupt off when polling
+	*					stops.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_poll_init() is called by can_initialize(); it sets up TC0 channel 0 and
+	*	applies CAN_POLL_MODE.
+	*	can_poll_count_isr() is called at the end of every can_mailbox_isr() run, from
+	*	an interrupt or from a poll, with the number of frames read; it keeps the frame
+	*	rate and makes the adaptive switches.
+	*	TC0_Handler() runs can_rx_poll() for each controller being polled.
+	*
+ */
+
+#include "can_poll.h"
+#include "can_guard.h"
+
+#include "task.h"
+
+volatile can_poll_stats_t can_poll_stats[2];
+volatile uint32_t can_rx_polled[2] = { 0, 0 };
+
+static uint32_t ul_poll_mode = CAN_POLL_IRQ;
+static TickType_t xPollWindow[2];
+
+static Can *can_poll_controller(uint8_t uc_ctrl)
+{
+	return (uc_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+}
+
+/* Reception mailboxes of the driver whose interrupt is enabled. */
+static uint32_t can_poll_rx_mask(Can *controller)
+{
+	uint32_t ul_imr = can_get_interrupt_mask(controller), ul_mask = 0, ul_mot;
+	uint8_t i;
+
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		if (!(ul_imr & (1u << i)) || !can_mailbox_owned(controller, i, CAN_OWNER_DRIVER))
+			continue;
+		ul_mot = controller->CAN_MB[i].CAN_MMR & CAN_MMR_MOT_Msk;
+		if ((ul_mot == CAN_MMR_MOT_MB_RX) || (ul_mot == CAN_MMR_MOT_MB_RX_OVERWRITE))
+			ul_mask |= (1u << i);
+	}
+
+	return ul_mask;
+}
+
+/************************************************************************/
+/*				SWITCH MODES                                            */
+/*	Called from the CAN / TC0 interrupts or from a critical section.	*/
+/*	TC0 runs while at least one controller is polled.					*/
+/************************************************************************/
+
+static void can_poll_start(uint8_t uc_ctrl)
+{
+	Can *controller = can_poll_controller(uc_ctrl);
+	uint32_t ul_mask = can_poll_rx_mask(controller);
+
+	can_rx_polled[uc_ctrl] = ul_mask;
+	can_disable_interrupt(controller, ul_mask);
+	can_poll_stats[uc_ctrl].ul_polling = 1;
+	can_poll_stats[uc_ctrl].ul_to_poll++;
+
+	TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+static void can_poll_stop(uint8_t uc_ctrl)
+{
+	uint32_t ul_mask = can_rx_polled[uc_ctrl];
+
+	can_rx_polled[uc_ctrl] = 0;
+	/* Fires at once if a frame is waiting; isolated mailboxes (can_guard.c)
+	*  get theirs back at the end of the cooldown. */
+	can_enable_interrupt(can_poll_controller(uc_ctrl), ul_mask & ~can_rx_isolated[uc_ctrl]);
+	can_poll_stats[uc_ctrl].ul_polling = 0;
+	can_poll_stats[uc_ctrl].ul_to_irq++;
+
+	if (!can_poll_stats[CAN_CTRL_0].ul_polling && !can_poll_stats[CAN_CTRL_1].ul_polling)
+		TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKDIS;
+}
+
+/************************************************************************/
+/*				INITIALIZE                                              */
+/*	TC0 channel 0 counts MCK / 2 up to RC and interrupts on RC compare.	*/
+/************************************************************************/
+
+void can_poll_init(void)
+{
+	if (!CAN_POLL_ENABLE)
+		return;
+
+	pmc_enable_periph_clk(ID_TC0);
+	TC0->TC_CHANNEL[0].TC_CCR = TC_CCR_CLKDIS;
+	TC0->TC_CHANNEL[0].TC_IDR = 0xFFFFFFFF;
+	TC0->TC_CHANNEL[0].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC;
+	TC0->TC_CHANNEL[0].TC_RC = sysclk_get_peripheral_hz() / 2 / 1000000 * CAN_POLL_PERIOD_US;
+	TC0->TC_CHANNEL[0].TC_IER = TC_IER_CPCS;
+
+	/* Same priority as the CAN handlers: a poll and a CAN interrupt never nest. */
+	NVIC_SetPriority(TC0_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(TC0_IRQn);
+
+	xPollWindow[CAN_CTRL_0] = xTaskGetTickCount();
+	xPollWindow[CAN_CTRL_1] = xPollWindow[CAN_CTRL_0];
+	can_poll_set_mode(CAN_POLL_MODE);
+}
+
+/************************************************************************/
+/*				SET THE MODE                                            */
+/*	CAN_POLL_IRQ or CAN_POLL_POLL apply to both controllers at once;	*/
+/*	CAN_POLL_ADAPTIVE leaves them as they are until the end of their	*/
+/*	current window.														*/
+/************************************************************************/
+
+void can_poll_set_mode(uint32_t ul_mode)
+{
+	uint8_t uc_ctrl;
+
+	if (!CAN_POLL_ENABLE)
+		return;
+
+	taskENTER_CRITICAL();
+	ul_poll_mode = ul_mode;
+	for (uc_ctrl = CAN_CTRL_0; uc_ctrl <= CAN_CTRL_1; uc_ctrl++) {
+		if ((ul_mode == CAN_POLL_POLL) && !can_poll_stats[uc_ctrl].ul_polling)
+			can_poll_start(uc_ctrl);
+		else if ((ul_mode == CAN_POLL_IRQ) && can_poll_stats[uc_ctrl].ul_polling)
+			can_poll_stop(uc_ctrl);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				FRAME RATE                                              */
+/*	CAN interrupt context. The window is closed by the first handler	*/
+/*	run after it has ended; if that is later than one window (a quiet	*/
+/*	bus in interrupt mode), the count is scaled back to one window.		*/
+/************************************************************************/
+
+void can_poll_count_isr(uint8_t uc_ctrl, uint32_t ul_frames)
+{
+	volatile can_poll_stats_t *p_stats = &can_poll_stats[uc_ctrl];
+	TickType_t xNow, xElapsed;
+
+	if (!CAN_POLL_ENABLE)
+		return;
+
+	p_stats->ul_window_frames += ul_frames;
+	xNow = xTaskGetTickCountFromISR();
+	xElapsed = xNow - xPollWindow[uc_ctrl];
+	if (xElapsed < CAN_POLL_WINDOW_TICKS)
+		return;
+
+	xPollWindow[uc_ctrl] = xNow;
+	p_stats->ul_last_frames = p_stats->ul_window_frames * CAN_POLL_WINDOW_TICKS / xElapsed;
+	p_stats->ul_window_frames = 0;
+
+	if (ul_poll_mode != CAN_POLL_ADAPTIVE)
+		return;
+	if (!p_stats->ul_polling && (p_stats->ul_last_frames >= CAN_POLL_ENTER_FRAMES))
+		can_poll_start(uc_ctrl);
+	else if (p_stats->ul_polling && (p_stats->ul_last_frames < CAN_POLL_EXIT_FRAMES))
+		can_poll_stop(uc_ctrl);
+}
+
+/************************************************************************/
+/*				POLL                                                    */
+/************************************************************************/
+
+void TC0_Handler(void)
+{
+	uint32_t ul_start;
+	uint8_t uc_ctrl;
+
+	(void)TC0->TC_CHANNEL[0].TC_SR;		// Clears CPCS.
+
+	for (uc_ctrl = CAN_CTRL_0; uc_ctrl <= CAN_CTRL_1; uc_ctrl++) {
+		if (!can_rx_polled[uc_ctrl])
+			continue;
+		ul_start = CAN_DWT_CYCCNT;
+		if (!can_rx_poll(uc_ctrl))
+			can_poll_stats[uc_ctrl].ul_empty_polls++;
+		can_poll_stats[uc_ctrl].ul_polls++;
+		can_poll_stats[uc_ctrl].ul_poll_cycles += CAN_DWT_CYCCNT - ul_start;
+	}
+}
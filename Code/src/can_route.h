@@ -0,0 +1,74 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_route.h
+	*
+	*	PURPOSE:
+	*	The routing decision of decode_can_msg(): which handler a received frame goes
+	*	to. Shared by can_func.c and the host tool tools/can_replay.c, so the replay
+	*	follows the firmware.
+	*
+	*	FILE REFERENCES:	stdint.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Needs nothing but stdint.h (no ASF, no FreeRTOS) so that host tools can include
+	*	it. The constants below repeat CAN_MID_MIDE, the class field of the ID and
+	*	CAN_PRIO_PDO; can_func.c checks that they agree.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+*/
+
+#ifndef CAN_ROUTE_H
+#define CAN_ROUTE_H
+
+#include <stdint.h>
+
+/*		ROUTES, in the order they are tried
+	MAILBOX		a handler bound to the receiving mailbox (can_register_mb_handler()).
+	EXT			extended (29-bit) frame: can_ext_decode(), by type.
+	PDO			standard frame of class CAN_PRIO_PDO: can_pdo_rx(), by source and frame number.
+	OPCODE		any other standard frame: can_dispatch_table, by controller and opcode index.
+*/
+#define CAN_ROUTE_MAILBOX		0
+#define CAN_ROUTE_EXT			1
+#define CAN_ROUTE_PDO			2
+#define CAN_ROUTE_OPCODE		3
+
+#define CAN_ROUTE_MID_EXT		( 1u << 29 )		// CAN_MID_MIDE
+#define CAN_ROUTE_MID_CLASS_Pos	26					// CAN_MID_MIDvA_Pos + CAN_ID_CLASS_Pos
+#define CAN_ROUTE_CLASS_PDO		6					// CAN_PRIO_PDO
+
+/**
+ * \brief Route of a received frame.
+ * @param ul_mid:		Identifier in CAN_MID format.
+ * @param ul_mb_bound:	Non-zero if a handler is bound to the receiving mailbox.
+ * @return				CAN_ROUTE_*
+ */
+static inline uint32_t can_route(uint32_t ul_mid, uint32_t ul_mb_bound)
+{
+	if (ul_mb_bound)
+		return CAN_ROUTE_MAILBOX;
+	if (ul_mid & CAN_ROUTE_MID_EXT)
+		return CAN_ROUTE_EXT;
+	if (((ul_mid >> CAN_ROUTE_MID_CLASS_Pos) & 0x7) == CAN_ROUTE_CLASS_PDO)
+		return CAN_ROUTE_PDO;
+	return CAN_ROUTE_OPCODE;
+}
+
+#endif /* CAN_ROUTE_H */
@@ -0,0 +1,315 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_stats.c
+	*
+	*	PURPOSE:
+	*	Keeps statistics on the health of both CAN buses (frame counts per ID, overruns,
+	*	error counters, bus-off events, bus load and latency histograms) and packs them
+	*	into a binary block which housekeeping can downlink.
+	*
+	*	FILE REFERENCES:	can_stats.h, FreeRTOS.h, task.h, timers.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	can_stats_snapshot() returns 0 if the buffer is too small for the header.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_stats.h.
+	*
+	*	NOTES:
+	*	The functions called from the interrupt handlers only add to counters; there is
+	*	no locking and no division on the RX/TX path except the cycles to us conversion
+	*	of a latency. Everything else is done by the sampling timer or the snapshot.
+	*
+	*	Bus load is estimated from the frames this node sees, i.e. frames sent by the TX
+	*	scheduler and frames let through by the acceptance filters, without stuff bits.
+	*	It is a lower bound on the real load of the bus.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					The bus state comes from can_err_state() instead of a read of CAN_SR,
+	*					which cleared TOVF under the CAN1 handler.
+	*
+	*					The ID tables are hashed by a multiply, probe linearly for a free slot
+	*					and are sized to the subscriptions. Bus-off events are the count kept by can_err_isr()
+	*					rather than a bus-off state seen by the 100 ms sample.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_stats_rx() / can_stats_tx() are called for every frame by the CAN handlers.
+	*	can_stats_latency() is called by the RX ring and the TX scheduler.
+	*	prvCANStatsTimer() runs every CAN_STATS_PERIOD ticks in the timer task; it reads
+	*	TEC/REC, the bus state and the bus-off count of each controller and turns the bits
+	*	counted since the last period into a load figure.
+	*
+ */
+
+#include "can_stats.h"
+#include "can_err.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+typedef struct {
+	uint32_t ul_rx_frames;
+	uint32_t ul_tx_frames;
+	uint32_t ul_overruns;
+	uint32_t ul_bits;				// Bits seen since the last sample.
+	uint16_t us_bus_off;
+	uint16_t us_err_passive;
+	uint16_t us_load;
+	uint16_t us_load_max;
+	uint8_t uc_tec;
+	uint8_t uc_rec;
+	uint8_t uc_tec_max;
+	uint8_t uc_rec_max;
+	uint32_t ul_bus_off_seen;		// can_err_stats[].ul_bus_off at the last sample.
+} can_stats_ctrl_t;
+
+static can_stats_ctrl_t can_stats_ctrl[2];
+
+/* ID tables, RX slots first: 0xFFFFFFFF marks an empty slot. Slots are only
+*  emptied all at once by can_stats_clear(), so a probe may stop at the first
+*  empty one. */
+static uint32_t ul_id_tag[CAN_STATS_ID_SLOTS];
+static uint32_t ul_id_count[CAN_STATS_ID_SLOTS];
+static uint32_t ul_id_overflow;
+
+static const uint8_t uc_id_base[2] = { 0, CAN_STATS_RX_ID_SLOTS };
+static const uint8_t uc_id_bits[2] = { CAN_STATS_RX_ID_BITS, CAN_STATS_TX_ID_BITS };
+
+static uint16_t us_latency[2][CAN_STATS_LAT_BUCKETS];
+static uint32_t ul_cycles_per_us;
+
+static TimerHandle_t xCanStatsTimer = NULL;
+
+static void prvCANStatsTimer(TimerHandle_t xTimer);
+
+/************************************************************************/
+/*				INITIALIZE THE STATISTICS                               */
+/*	Called from can_initialize() before the CAN interrupts are enabled.	*/
+/************************************************************************/
+
+void can_stats_init(void)
+{
+	ul_cycles_per_us = sysclk_get_cpu_hz() / 1000000;
+	can_stats_clear();
+
+	xCanStatsTimer = xTimerCreate("CANST", CAN_STATS_PERIOD, pdTRUE, NULL, prvCANStatsTimer);
+	if (xCanStatsTimer)
+		xTimerStart(xCanStatsTimer, 0);
+}
+
+/************************************************************************/
+/*				CLEAR THE STATISTICS                                    */
+/************************************************************************/
+
+void can_stats_clear(void)
+{
+	uint8_t i, j;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < 2; i++) {
+		memset(&can_stats_ctrl[i], 0, sizeof(can_stats_ctrl[i]));
+		can_stats_ctrl[i].ul_bus_off_seen = can_err_stats[i].ul_bus_off;
+		for (j = 0; j < CAN_STATS_LAT_BUCKETS; j++)
+			us_latency[i][j] = 0;
+	}
+	for (j = 0; j < CAN_STATS_ID_SLOTS; j++) {
+		ul_id_tag[j] = 0xFFFFFFFF;
+		ul_id_count[j] = 0;
+	}
+	ul_id_overflow = 0;
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				HOT PATH                                                */
+/*	Called from the CAN interrupt handlers.								*/
+/************************************************************************/
+
+/* CAN_MID value to the ID recorded in the tables (see CAN_STATS_ID_EXT). */
+static uint32_t can_stats_id(uint32_t ul_mid)
+{
+	if (ul_mid & CAN_MID_MIDE)
+		return ul_mid & (CAN_STATS_ID_EXT | CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk);
+	return (ul_mid & CAN_MID_MIDvA_Msk) >> CAN_MID_MIDvA_Pos;
+}
+
+static void can_stats_count_id(uint8_t uc_dir, uint32_t ul_id)
+{
+	uint32_t ul_mask = (1u << uc_id_bits[uc_dir]) - 1, ul_slot, ul_hash, i;
+
+	ul_hash = (ul_id * CAN_STATS_ID_HASH) >> (32 - uc_id_bits[uc_dir]);
+	for (i = 0; i < CAN_STATS_ID_PROBES; i++) {
+		ul_slot = uc_id_base[uc_dir] + ((ul_hash + i) & ul_mask);
+		if (ul_id_tag[ul_slot] == ul_id) {
+			ul_id_count[ul_slot]++;
+			return;
+		}
+		if (ul_id_tag[ul_slot] == 0xFFFFFFFF) {
+			ul_id_tag[ul_slot] = ul_id;
+			ul_id_count[ul_slot] = 1;
+			return;
+		}
+	}
+	ul_id_overflow++;
+}
+
+void can_stats_rx(uint8_t uc_ctrl, uint32_t ul_mid, uint8_t uc_length, uint8_t uc_flags)
+{
+	can_stats_ctrl_t *p_ctrl = &can_stats_ctrl[uc_ctrl & 1];
+
+	p_ctrl->ul_rx_frames++;
+	if (uc_flags & CAN_MAILBOX_RX_OVER)
+		p_ctrl->ul_overruns++;
+	p_ctrl->ul_bits += (ul_mid & CAN_MID_MIDE) ? CAN_STATS_EXT_BITS(uc_length) : CAN_STATS_STD_BITS(uc_length);
+	can_stats_count_id(CAN_STATS_RX, can_stats_id(ul_mid));
+}
+
+void can_stats_tx(uint8_t uc_ctrl, uint32_t ul_mid, uint8_t uc_length)
+{
+	can_stats_ctrl_t *p_ctrl = &can_stats_ctrl[uc_ctrl & 1];
+
+	p_ctrl->ul_tx_frames++;
+	p_ctrl->ul_bits += (ul_mid & CAN_MID_MIDE) ? CAN_STATS_EXT_BITS(uc_length) : CAN_STATS_STD_BITS(uc_length);
+	can_stats_count_id(CAN_STATS_TX, can_stats_id(ul_mid));
+}
+
+/* ul_cycles is a DWT cycle count. The RX latency is recorded by the dispatch
+*  task, the TX latency by the CAN0 handler, so each histogram has one writer. */
+void can_stats_latency(uint8_t uc_which, uint32_t ul_cycles)
+{
+	uint32_t ul_us = ul_cycles / ul_cycles_per_us;
+	uint32_t ul_bucket = ul_us ? (32 - __CLZ(ul_us)) : 0;
+
+	if (ul_bucket >= CAN_STATS_LAT_BUCKETS)
+		ul_bucket = CAN_STATS_LAT_BUCKETS - 1;
+	if (us_latency[uc_which & 1][ul_bucket] != 0xFFFF)
+		us_latency[uc_which & 1][ul_bucket]++;
+}
+
+/************************************************************************/
+/*				SAMPLING TIMER                                          */
+/*	Runs in the timer task every CAN_STATS_PERIOD ticks.				*/
+/************************************************************************/
+
+static void prvCANStatsTimer(TimerHandle_t xTimer)
+{
+	Can *controller;
+	can_stats_ctrl_t *p_ctrl;
+	uint32_t ul_bits, ul_bus_off;
+	uint8_t i;
+	(void)xTimer;
+
+	for (i = 0; i < 2; i++) {
+		controller = (i == CAN_CTRL_1) ? CAN1 : CAN0;
+		p_ctrl = &can_stats_ctrl[i];
+
+		taskENTER_CRITICAL();
+		ul_bits = p_ctrl->ul_bits;
+		p_ctrl->ul_bits = 0;
+		taskEXIT_CRITICAL();
+
+		p_ctrl->us_load = (uint16_t)((ul_bits * 1000) /
+				(CAN_STATS_BITRATE / configTICK_RATE_HZ * CAN_STATS_PERIOD));
+		if (p_ctrl->us_load > p_ctrl->us_load_max)
+			p_ctrl->us_load_max = p_ctrl->us_load;
+
+		p_ctrl->uc_tec = can_get_tx_error_cnt(controller);
+		p_ctrl->uc_rec = can_get_rx_error_cnt(controller);
+		if (p_ctrl->uc_tec > p_ctrl->uc_tec_max)
+			p_ctrl->uc_tec_max = p_ctrl->uc_tec;
+		if (p_ctrl->uc_rec > p_ctrl->uc_rec_max)
+			p_ctrl->uc_rec_max = p_ctrl->uc_rec;
+
+		/* Not CAN_SR: reading it clears TOVF. Bus-off events are counted by
+		*  can_err_isr() as they happen, so one which recovers within a period
+		*  is not missed. */
+		if (can_err_state(i) == CAN_ERR_PASSIVE)
+			p_ctrl->us_err_passive++;
+		ul_bus_off = can_err_stats[i].ul_bus_off;
+		p_ctrl->us_bus_off += (uint16_t)(ul_bus_off - p_ctrl->ul_bus_off_seen);
+		p_ctrl->ul_bus_off_seen = ul_bus_off;
+	}
+}
+
+/************************************************************************/
+/*				SNAPSHOT                                                */
+/*	Packs the statistics into puc_buf in the format described in		*/
+/*	can_stats.h. ID records which do not fit are left out.				*/
+/*	Returns the number of bytes written.								*/
+/************************************************************************/
+
+static uint8_t *can_stats_put16(uint8_t *p, uint32_t ul_value)
+{
+	*p++ = (uint8_t)ul_value;
+	*p++ = (uint8_t)(ul_value >> 8);
+	return p;
+}
+
+static uint8_t *can_stats_put32(uint8_t *p, uint32_t ul_value)
+{
+	p = can_stats_put16(p, ul_value);
+	return can_stats_put16(p, ul_value >> 16);
+}
+
+uint32_t can_stats_snapshot(uint8_t *puc_buf, uint32_t ul_size)
+{
+	uint8_t *p = puc_buf, *puc_count = puc_buf + 1;
+	uint8_t i, j, uc_records = 0;
+
+	if (ul_size < CAN_STATS_HEADER_SIZE)
+		return 0;
+
+	taskENTER_CRITICAL();
+	*p++ = CAN_STATS_VERSION;
+	*p++ = 0;
+	p = can_stats_put16(p, 0);
+	p = can_stats_put32(p, xTaskGetTickCount());
+
+	for (i = 0; i < 2; i++) {
+		p = can_stats_put32(p, can_stats_ctrl[i].ul_rx_frames);
+		p = can_stats_put32(p, can_stats_ctrl[i].ul_tx_frames);
+		p = can_stats_put32(p, can_stats_ctrl[i].ul_overruns);
+		p = can_stats_put16(p, can_stats_ctrl[i].us_bus_off);
+		*p++ = can_stats_ctrl[i].uc_tec;
+		*p++ = can_stats_ctrl[i].uc_rec;
+		*p++ = can_stats_ctrl[i].uc_tec_max;
+		*p++ = can_stats_ctrl[i].uc_rec_max;
+		p = can_stats_put16(p, can_stats_ctrl[i].us_err_passive);
+		p = can_stats_put16(p, can_stats_ctrl[i].us_load);
+		p = can_stats_put16(p, can_stats_ctrl[i].us_load_max);
+	}
+	p = can_stats_put32(p, ul_id_overflow);
+
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < CAN_STATS_LAT_BUCKETS; j++)
+			p = can_stats_put16(p, us_latency[i][j]);
+	}
+
+	for (j = 0; j < CAN_STATS_ID_SLOTS; j++) {
+		if (ul_id_tag[j] == 0xFFFFFFFF)
+			continue;
+		if ((uint32_t)(p - puc_buf) + 8 > ul_size)
+			break;
+		p = can_stats_put32(p, ul_id_tag[j] | ((j >= CAN_STATS_RX_ID_SLOTS) ? CAN_STATS_ID_TX : 0));
+		p = can_stats_put32(p, ul_id_count[j]);
+		uc_records++;
+	}
+	taskEXIT_CRITICAL();
+
+	*puc_count = uc_records;
+	return (uint32_t)(p - puc_buf);
+}
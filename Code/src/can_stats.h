@@ -0,0 +1,115 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_stats.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the CAN bus statistics in can_stats.c.
+	*
+	*	FILE REFERENCES:	can_func.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	can_stats_rx() and can_stats_tx() are only called from the CAN interrupt handlers,
+	*	which run at the same NVIC priority and so never interrupt each other.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		The ID tables are hashed by a multiply, use linear probing and are sized
+	*					to the subscriptions (CAN_STATS_RX_ID_SLOTS, CAN_STATS_TX_ID_SLOTS)
+	*					instead of 32 direct mapped slots each. Bus-off events are taken from
+	*					can_err.c.
+	*
+*/
+
+#ifndef CAN_STATS_H
+#define CAN_STATS_H
+
+#include "can_func.h"
+
+/* Per-ID counters: one open-addressed table per direction. The ID is hashed
+*  by a multiply (Fibonacci hashing: the class, node and type fields of the
+*  standard IDs all land in the top bits) and at most CAN_STATS_ID_PROBES slots
+*  are tried from there. An ID which finds neither itself nor a free slot is
+*  only counted in ul_id_overflow. CAN0 subscribes to 72 standard IDs
+*  (transport, housekeeping replies and process data of six nodes), so the RX
+*  table is kept at most about half full; the OBC sends fewer. Both tables must
+*  fit the record count of the snapshot. */
+#define CAN_STATS_RX_ID_BITS	7
+#define CAN_STATS_TX_ID_BITS	6
+#define CAN_STATS_RX_ID_SLOTS	( 1u << CAN_STATS_RX_ID_BITS )
+#define CAN_STATS_TX_ID_SLOTS	( 1u << CAN_STATS_TX_ID_BITS )
+#define CAN_STATS_ID_SLOTS		( CAN_STATS_RX_ID_SLOTS + CAN_STATS_TX_ID_SLOTS )
+#define CAN_STATS_ID_PROBES		8
+#define CAN_STATS_ID_HASH		2654435761u		// 2^32 / golden ratio.
+#define CAN_STATS_RX			0
+#define CAN_STATS_TX			1
+
+typedef char can_stats_slots_check[( CAN_STATS_ID_SLOTS <= 255 ) ? 1 : -1];
+
+/* Latency histograms: bucket b counts latencies of [2^(b-1), 2^b) us, bucket 0
+*  is < 1 us and the last bucket takes everything longer. */
+#define CAN_STATS_LAT_BUCKETS	16
+#define CAN_STATS_LAT_RX		0		// RX interrupt to dispatch task.
+#define CAN_STATS_LAT_TX		1		// can_tx_enqueue() to frame on the bus.
+
+/* Error counters and bus load are sampled by a software timer, which also
+*  adds the bus-off events can_err_isr() counted since the last period. */
+#define CAN_STATS_PERIOD		1		// Ticks (100 ms).
+#define CAN_STATS_BITRATE		250000
+
+/* Bits of a frame on the bus without stuff bits (SOF to end of interframe space). */
+#define CAN_STATS_STD_BITS(dlc)	( 47 + 8 * ( dlc ) )
+#define CAN_STATS_EXT_BITS(dlc)	( 67 + 8 * ( dlc ) )
+
+/*		SNAPSHOT FORMAT (version 1, little endian)
+	Offset	Size	Field
+	0		1		Version (CAN_STATS_VERSION)
+	1		1		Number of ID records (n)
+	2		2		Reserved (0)
+	4		4		Tick count when the snapshot was taken
+	8		2 x 24	Per controller (CAN0 then CAN1):
+					4  frames received
+					4  frames sent
+					4  receive overruns (CAN_MAILBOX_RX_OVER)
+					2  bus-off events (can_err_stats[].ul_bus_off)
+					1  TEC (last sample)		1  REC (last sample)
+					1  TEC (highest)			1  REC (highest)
+					2  error-passive samples
+					2  bus load, last period (per mille)
+					2  bus load, highest period (per mille)
+	56		4		ID slot overflows
+	60		2 x 32	Latency histograms (RX, then TX), 16 x 2 bytes each, saturating
+	124		n x 8	ID records:
+					4  ID (bits 28:0), bit 29 = extended, bit 30 = transmitted
+					4  frame count
+*/
+#define CAN_STATS_VERSION		1
+#define CAN_STATS_HEADER_SIZE	124
+#define CAN_STATS_MAX_SIZE		( CAN_STATS_HEADER_SIZE + 8 * CAN_STATS_ID_SLOTS )
+
+#define CAN_STATS_ID_EXT		( 1u << 29 )
+#define CAN_STATS_ID_TX			( 1u << 30 )
+
+void can_stats_init(void);
+void can_stats_rx(uint8_t uc_ctrl, uint32_t ul_mid, uint8_t uc_length, uint8_t uc_flags);
+void can_stats_tx(uint8_t uc_ctrl, uint32_t ul_mid, uint8_t uc_length);
+void can_stats_latency(uint8_t uc_which, uint32_t ul_cycles);
+uint32_t can_stats_snapshot(uint8_t *puc_buf, uint32_t ul_size);				// API Function.
+void can_stats_clear(void);													// API Function.
+
+#endif /* CAN_STATS_H */
@@ -0,0 +1,663 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_transport.c
+	*
+	*	PURPOSE:
+	*	Segmented transport on top of the CAN API, for transfers longer than one 8-byte
+	*	frame (payload images, telemetry blocks, COMS data).
+	*
+	*	FILE REFERENCES:	can_transport.h, task.h
+	*
+	*	EXTERNAL VARIABLES:		can_tp_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	can_tp_send() and can_tp_rx_wait() return one of the CAN_TP_ERR_ codes.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_transport.h for the frame format.
+	*
+	*	NOTES:
+	*	The receive buffer is supplied by the caller of can_tp_rx_open() and data is
+	*	copied straight into it, so no memory is allocated per transfer. The only state
+	*	kept here is CAN_TP_RX_SESSIONS + CAN_TP_TX_SESSIONS small session records.
+	*
+	*	The sender times STmin from the end of the previous consecutive frame (its TX
+	*	timestamp, on the CAN timer): it sleeps whole ticks while more than one tick
+	*	of the gap is left and sleeps on its xRoom semaphore for the rest, which
+	*	TC1_Handler() gives when a one-shot on TC0 channel 1 reaches the end of the
+	*	gap. Nothing spins, so lower priority tasks run during the gap. The 16-bit
+	*	timer wraps every 262 ms, so the tick count at the TX hook bounds the time
+	*	since the frame: once two ticks have passed a sub-tick gap is over, and a
+	*	longer gap found after the timer may have wrapped is counted in ticks.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					Peers are node numbers; frames are sent with CAN_TP_ID(peer) and the
+	*					peer of a received frame is the source node of its ID.
+	*
+	*					A sender whose window is full now sleeps on its session's xRoom
+	*					semaphore, given by a TX hook, instead of polling with vTaskDelay(1).
+	*					STmin is timed on the CAN timer instead of being rounded up to ticks.
+	*
+	*					The rest of a gap shorter than a tick is slept on TC0 channel 1 instead
+	*					of polling the timer with taskYIELD(), which left lower priority tasks
+	*					no time. The tick count of the TX hook guards the timer wrap.
+	*
+	*	DESCRIPTION:
+	*
+	*	Receiving: a task opens a session for one peer with its own buffer and waits on it.
+	*	The CAN dispatch task calls can_tp_on_ff()/can_tp_on_cf() for every transport frame,
+	*	copies the data into the buffer, answers with flow control frames and gives the
+	*	session's semaphore when the transfer is complete or has failed.
+	*
+	*	Sending: can_tp_send() blocks the calling task. It sends the first frame, waits
+	*	for flow control and then queues one block of consecutive frames at a time.
+	*	can_tp_on_fc() hands the flow control status to the waiting sender. When the
+	*	sender has CAN_TP_TX_WINDOW frames queued it sleeps until can_tp_tx_done(), a
+	*	TX hook, sees the queue down to CAN_TP_TX_RESUME.
+	*
+ */
+
+#include "can_transport.h"
+
+#include "task.h"
+
+typedef struct {
+	uint32_t ul_peer;
+	uint8_t *puc_buf;
+	uint32_t ul_size;
+	uint32_t ul_length;				// Total length announced by the first frame.
+	uint32_t ul_received;
+	uint32_t ul_prio;				// Priority of our flow control frames.
+	uint8_t uc_block_size;
+	uint8_t uc_st_min;
+	uint8_t uc_seq;					// Sequence number of the next consecutive frame.
+	uint8_t uc_block_count;
+	volatile uint32_t ul_state;
+	SemaphoreHandle_t xDone;
+} can_tp_rx_t;
+
+typedef struct {
+	uint32_t ul_peer;
+	uint32_t ul_busy;
+	volatile uint32_t ul_fc;		// Last flow control frame (ul_datal).
+	volatile uint32_t ul_room_wait;	// Set while the sender waits for room in the TX queue.
+	volatile uint32_t ul_cf_wait;	// Set while the sender waits for its last frame to leave.
+	volatile uint32_t ul_cf_sent;	// Consecutive frames sent (TX hook).
+	volatile uint16_t us_cf_stamp;	// End of the last one, on the timer of uc_cf_ctrl.
+	volatile uint8_t uc_cf_ctrl;
+	volatile TickType_t xCfTick;	// Tick count when the TX hook saw it.
+	volatile uint32_t ul_gap_wait;	// Set while the sender waits for the gap timer.
+	SemaphoreHandle_t xFlow;
+	SemaphoreHandle_t xRoom;		// Given by the TX hook for either wait.
+} can_tp_tx_t;
+
+volatile can_tp_stats_t can_tp_stats;
+
+static can_tp_rx_t can_tp_rx[CAN_TP_RX_SESSIONS];
+static can_tp_tx_t can_tp_tx[CAN_TP_TX_SESSIONS];
+static volatile uint32_t ul_gap_armed;		// TC0 channel 1 is counting to RC.
+
+/* A gap shorter than a tick is over, or still measurable on the CAN timer,
+*  two ticks after the frame. */
+typedef char can_tp_wrap_check[( CAN_TIMESTAMP_WRAP_US / ( 1000000 / configTICK_RATE_HZ ) >= 2 ) ? 1 : -1];
+
+static void can_tp_on_ff(const can_frame_t *p_frame);
+static void can_tp_on_cf(const can_frame_t *p_frame);
+static void can_tp_on_fc(const can_frame_t *p_frame);
+static void can_tp_tx_done(const can_frame_t *p_frame);
+
+#define CAN_TP_PEER(p_frame)		CAN_ID_SRC(CAN_MID_TO_ID(( p_frame )->ul_id))
+#define CAN_TP_FC_WORD(status, bs, st)	( ( ( uint32_t )CAN_TP_FC << 24 ) | ( ( uint32_t )( status ) << 16 ) \
+										| ( ( uint32_t )( bs ) << 8 ) | ( st ) )
+
+/************************************************************************/
+/*				INITIALIZE THE TRANSPORT                                */
+/*	Called from can_init_mailboxes(). Frames come in through the CAN0	*/
+/*	subscription mailboxes, the same ones as housekeeping replies.		*/
+/************************************************************************/
+
+void can_tp_init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < CAN_TP_RX_SESSIONS; i++) {
+		can_tp_rx[i].ul_state = CAN_TP_IDLE;
+		can_tp_rx[i].xDone = xSemaphoreCreateBinary();
+	}
+	for (i = 0; i < CAN_TP_TX_SESSIONS; i++) {
+		can_tp_tx[i].ul_busy = 0;
+		can_tp_tx[i].ul_room_wait = 0;
+		can_tp_tx[i].ul_cf_wait = 0;
+		can_tp_tx[i].ul_gap_wait = 0;
+		can_tp_tx[i].xFlow = xSemaphoreCreateBinary();
+		can_tp_tx[i].xRoom = xSemaphoreCreateBinary();
+	}
+
+	can_register_prefix_handler(CAN_CTRL_0, CAN_TP_FF, can_tp_on_ff);
+	can_register_prefix_handler(CAN_CTRL_0, CAN_TP_CF, can_tp_on_cf);
+	can_register_prefix_handler(CAN_CTRL_0, CAN_TP_FC, can_tp_on_fc);
+	can_register_tx_hook(can_tp_tx_done);
+
+	/* TC0 channel 1: one-shot, counts MCK / 2 up to RC and stops there. */
+	pmc_enable_periph_clk(ID_TC1);
+	TC0->TC_CHANNEL[1].TC_CCR = TC_CCR_CLKDIS;
+	TC0->TC_CHANNEL[1].TC_IDR = 0xFFFFFFFF;
+	TC0->TC_CHANNEL[1].TC_CMR = TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_CPCSTOP;
+	TC0->TC_CHANNEL[1].TC_IER = TC_IER_CPCS;
+	ul_gap_armed = 0;
+	NVIC_SetPriority(TC1_IRQn, configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY);
+	NVIC_EnableIRQ(TC1_IRQn);
+}
+
+/************************************************************************/
+/*				HELPERS                                                 */
+/************************************************************************/
+
+static void can_tp_unpack(uint8_t *puc_dst, uint32_t ul_word, uint32_t ul_count)
+{
+	while (ul_count--) {
+		*puc_dst++ = (uint8_t)ul_word;
+		ul_word >>= 8;
+	}
+}
+
+static uint32_t can_tp_pack(const uint8_t *puc_src, uint32_t ul_count)
+{
+	uint32_t ul_word = 0, i;
+
+	for (i = 0; i < ul_count; i++)
+		ul_word |= (uint32_t)puc_src[i] << (8 * i);
+
+	return ul_word;
+}
+
+static void can_tp_send_fc(uint32_t ul_peer, uint32_t ul_status, uint8_t uc_bs, uint8_t uc_st, uint32_t ul_prio)
+{
+	send_can_command(CAN_TP_FC_WORD(ul_status, uc_bs, uc_st), 0, CAN_TP_ID(ul_peer), ul_prio);
+}
+
+static can_tp_rx_t *can_tp_find_rx(uint32_t ul_peer)
+{
+	uint8_t i;
+
+	for (i = 0; i < CAN_TP_RX_SESSIONS; i++) {
+		if ((can_tp_rx[i].ul_state != CAN_TP_IDLE) && (can_tp_rx[i].ul_peer == ul_peer))
+			return &can_tp_rx[i];
+	}
+	return NULL;
+}
+
+/* Ends a receive transfer and wakes the task waiting in can_tp_rx_wait(). */
+static void can_tp_rx_finish(can_tp_rx_t *p_rx, uint32_t ul_state)
+{
+	p_rx->ul_state = ul_state;
+	if (ul_state == CAN_TP_DONE) {
+		can_tp_stats.ul_rx_done++;
+		can_tp_stats.ul_rx_bytes += p_rx->ul_length;
+	}
+	else
+		can_tp_stats.ul_rx_errors++;
+	xSemaphoreGive(p_rx->xDone);
+}
+
+/************************************************************************/
+/*				RECEIVE: FIRST FRAME                                    */
+/*	Dispatch task context.												*/
+/************************************************************************/
+
+static void can_tp_on_ff(const can_frame_t *p_frame)
+{
+	uint32_t ul_peer = CAN_TP_PEER(p_frame);
+	uint32_t ul_length = p_frame->ul_datal & CAN_TP_MAX_LENGTH;
+	can_tp_rx_t *p_rx;
+
+	taskENTER_CRITICAL();
+	p_rx = can_tp_find_rx(ul_peer);
+	if (!p_rx || (p_rx->ul_state == CAN_TP_DONE) || (p_rx->ul_state >= CAN_TP_ERR_SEQ)) {
+		can_tp_stats.ul_unexpected++;
+		can_tp_send_fc(ul_peer, CAN_TP_ABORT, 0, 0, p_rx ? p_rx->ul_prio : CAN_TP_COMS_PRIO);
+		taskEXIT_CRITICAL();
+		return;
+	}
+	if (ul_length > p_rx->ul_size) {
+		can_tp_stats.ul_rx_errors++;
+		can_tp_send_fc(ul_peer, CAN_TP_OVERFLOW, 0, 0, p_rx->ul_prio);
+		taskEXIT_CRITICAL();
+		return;
+	}
+
+	/* A new first frame restarts a transfer that was in progress. */
+	p_rx->ul_length = ul_length;
+	p_rx->ul_received = (ul_length < CAN_TP_FF_DATA) ? ul_length : CAN_TP_FF_DATA;
+	can_tp_unpack(p_rx->puc_buf, p_frame->ul_datah, p_rx->ul_received);
+	p_rx->uc_seq = 1;
+	p_rx->uc_block_count = 0;
+	p_rx->ul_state = CAN_TP_BUSY;
+
+	if (p_rx->ul_received == ul_length)
+		can_tp_rx_finish(p_rx, CAN_TP_DONE);
+	else
+		can_tp_send_fc(ul_peer, CAN_TP_CTS, p_rx->uc_block_size, p_rx->uc_st_min, p_rx->ul_prio);
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				RECEIVE: CONSECUTIVE FRAME                              */
+/*	Dispatch task context.												*/
+/************************************************************************/
+
+static void can_tp_on_cf(const can_frame_t *p_frame)
+{
+	uint32_t ul_peer = CAN_TP_PEER(p_frame), ul_count;
+	uint8_t uc_seq = (uint8_t)(p_frame->ul_datal >> 16);
+	can_tp_rx_t *p_rx;
+	uint8_t *puc_dst;
+
+	taskENTER_CRITICAL();
+	p_rx = can_tp_find_rx(ul_peer);
+	if (!p_rx || (p_rx->ul_state != CAN_TP_BUSY)) {
+		can_tp_stats.ul_unexpected++;
+		taskEXIT_CRITICAL();
+		return;
+	}
+	if (uc_seq != p_rx->uc_seq) {
+		can_tp_send_fc(ul_peer, CAN_TP_ABORT, 0, 0, p_rx->ul_prio);
+		can_tp_rx_finish(p_rx, CAN_TP_ERR_SEQ);
+		taskEXIT_CRITICAL();
+		return;
+	}
+
+	ul_count = p_rx->ul_length - p_rx->ul_received;
+	if (ul_count > CAN_TP_CF_DATA)
+		ul_count = CAN_TP_CF_DATA;
+	puc_dst = p_rx->puc_buf + p_rx->ul_received;
+	if (ul_count > 2) {
+		can_tp_unpack(puc_dst, p_frame->ul_datal, 2);
+		can_tp_unpack(puc_dst + 2, p_frame->ul_datah, ul_count - 2);
+	}
+	else
+		can_tp_unpack(puc_dst, p_frame->ul_datal, ul_count);
+	p_rx->ul_received += ul_count;
+	p_rx->uc_seq++;
+
+	if (p_rx->ul_received == p_rx->ul_length)
+		can_tp_rx_finish(p_rx, CAN_TP_DONE);
+	else if (p_rx->uc_block_size && (++p_rx->uc_block_count == p_rx->uc_block_size)) {
+		p_rx->uc_block_count = 0;
+		can_tp_send_fc(ul_peer, CAN_TP_CTS, p_rx->uc_block_size, p_rx->uc_st_min, p_rx->ul_prio);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				SEND: FLOW CONTROL                                      */
+/*	Dispatch task context. Passes the frame to the waiting sender.		*/
+/************************************************************************/
+
+static void can_tp_on_fc(const can_frame_t *p_frame)
+{
+	uint32_t ul_peer = CAN_TP_PEER(p_frame);
+	uint8_t i;
+
+	for (i = 0; i < CAN_TP_TX_SESSIONS; i++) {
+		if (can_tp_tx[i].ul_busy && (can_tp_tx[i].ul_peer == ul_peer)) {
+			can_tp_tx[i].ul_fc = p_frame->ul_datal;
+			xSemaphoreGive(can_tp_tx[i].xFlow);
+			return;
+		}
+	}
+	can_tp_stats.ul_unexpected++;
+}
+
+/************************************************************************/
+/*				SEND: ROOM IN THE TX QUEUE                              */
+/*	TX hook, CAN interrupt context. Wakes the senders waiting in		*/
+/*	can_tp_wait_room() once the queue is down to CAN_TP_TX_RESUME, and	*/
+/*	keeps the end time of each consecutive frame for STmin.				*/
+/************************************************************************/
+
+static void can_tp_tx_done(const can_frame_t *p_frame)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint32_t ul_room = (can_tx_pending() <= CAN_TP_TX_RESUME);
+	uint8_t i;
+
+	for (i = 0; i < CAN_TP_TX_SESSIONS; i++) {
+		if (!can_tp_tx[i].ul_busy)
+			continue;
+		if (((p_frame->ul_datal >> 24) == CAN_TP_CF)
+				&& (p_frame->ul_id == CAN_MID_MIDvA(CAN_TP_ID(can_tp_tx[i].ul_peer)))) {
+			can_tp_tx[i].us_cf_stamp = p_frame->us_timestamp;
+			can_tp_tx[i].uc_cf_ctrl = CAN_FRAME_CTRL(p_frame);
+			can_tp_tx[i].xCfTick = xTaskGetTickCountFromISR();
+			can_tp_tx[i].ul_cf_sent++;
+			if (can_tp_tx[i].ul_cf_wait) {
+				can_tp_tx[i].ul_cf_wait = 0;
+				xSemaphoreGiveFromISR(can_tp_tx[i].xRoom, &xHigherPriorityTaskWoken);
+			}
+		}
+		if (ul_room && can_tp_tx[i].ul_room_wait) {
+			can_tp_tx[i].ul_room_wait = 0;
+			xSemaphoreGiveFromISR(can_tp_tx[i].xRoom, &xHigherPriorityTaskWoken);
+		}
+	}
+	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/* Sleeps until the TX queue has fewer than CAN_TP_TX_WINDOW frames. A stale
+*  give from an earlier wait is taken before the flag is set, and the queue is
+*  checked again after, so a wakeup between the check and the take is not lost.
+*  Returns 0 if the queue did not drain within xTimeout ticks. */
+static uint32_t can_tp_wait_room(can_tp_tx_t *p_tx, TickType_t xTimeout)
+{
+	while (can_tx_pending() >= CAN_TP_TX_WINDOW) {
+		xSemaphoreTake(p_tx->xRoom, 0);
+		p_tx->ul_room_wait = 1;
+		__DMB();
+		if (can_tx_pending() < CAN_TP_TX_WINDOW) {
+			p_tx->ul_room_wait = 0;
+			break;
+		}
+		if (xSemaphoreTake(p_tx->xRoom, xTimeout) != pdTRUE) {
+			p_tx->ul_room_wait = 0;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Starts TC0 channel 1 to interrupt in ul_us, unless it already will sooner.
+*  Called in a critical section. */
+static void can_tp_gap_arm(uint32_t ul_us)
+{
+	TcChannel *p_tc = &TC0->TC_CHANNEL[1];
+	uint32_t ul_rc = sysclk_get_peripheral_hz() / 2 / 1000000 * ul_us;
+
+	if (ul_gap_armed && (p_tc->TC_RC - p_tc->TC_CV <= ul_rc))
+		return;
+	ul_gap_armed = 1;
+	p_tc->TC_RC = ul_rc ? ul_rc : 1;
+	p_tc->TC_CCR = TC_CCR_CLKEN | TC_CCR_SWTRG;
+}
+
+/* Sleeps until ul_queued consecutive frames have left their mailboxes, then
+*  until ul_us have passed since the end of the last one, as measured on the
+*  CAN timer of the controller which sent it: whole ticks while more than a
+*  tick is left, the rest on the gap timer. Returns 0 if the frame was not
+*  sent within xTimeout ticks. */
+static uint32_t can_tp_gap(can_tp_tx_t *p_tx, uint32_t ul_queued, uint32_t ul_us, TickType_t xTimeout)
+{
+	const uint32_t ul_tick_us = 1000000 / configTICK_RATE_HZ;
+	uint32_t ul_elapsed;
+	TickType_t xTicks;
+	Can *controller;
+
+	while ((int32_t)(p_tx->ul_cf_sent - ul_queued) < 0) {
+		xSemaphoreTake(p_tx->xRoom, 0);
+		p_tx->ul_cf_wait = 1;
+		__DMB();
+		if ((int32_t)(p_tx->ul_cf_sent - ul_queued) >= 0) {
+			p_tx->ul_cf_wait = 0;
+			break;
+		}
+		if (xSemaphoreTake(p_tx->xRoom, xTimeout) != pdTRUE) {
+			p_tx->ul_cf_wait = 0;
+			return 0;
+		}
+	}
+
+	controller = (p_tx->uc_cf_ctrl == CAN_CTRL_1) ? CAN1 : CAN0;
+	for (;;) {
+		/* The frame ended less than xTicks + 1 and more than xTicks - 1 ticks ago. */
+		xTicks = xTaskGetTickCount() - p_tx->xCfTick;
+		if (xTicks >= (ul_us + ul_tick_us - 1) / ul_tick_us + 1)
+			return 1;
+		if (xTicks >= CAN_TIMESTAMP_WRAP_US / ul_tick_us) {
+			vTaskDelay(1);				// The timer may have wrapped since.
+			continue;
+		}
+
+		ul_elapsed = (uint16_t)(can_get_internal_timer_value(controller) - p_tx->us_cf_stamp) * CAN_TIMESTAMP_US;
+		if (ul_elapsed >= ul_us)
+			return 1;
+		if (ul_us - ul_elapsed > ul_tick_us) {
+			vTaskDelay((ul_us - ul_elapsed) / ul_tick_us);
+			continue;
+		}
+
+		/* TC1_Handler() gives xRoom at the end of the gap, or earlier for
+		*  another sender's gap; the timeout bounds a missed wake. */
+		xSemaphoreTake(p_tx->xRoom, 0);
+		taskENTER_CRITICAL();
+		p_tx->ul_gap_wait = 1;
+		can_tp_gap_arm(ul_us - ul_elapsed);
+		taskEXIT_CRITICAL();
+		xSemaphoreTake(p_tx->xRoom, 2);
+		p_tx->ul_gap_wait = 0;
+	}
+}
+
+/************************************************************************/
+/*				SEND: END OF AN STMIN GAP                               */
+/*	TC0 channel 1 compare. Wakes every sender waiting in can_tp_gap();	*/
+/*	each one checks its own gap and arms the timer again if needed.		*/
+/************************************************************************/
+
+void TC1_Handler(void)
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+	uint8_t i;
+
+	(void)TC0->TC_CHANNEL[1].TC_SR;		// Clears CPCS.
+	ul_gap_armed = 0;
+
+	for (i = 0; i < CAN_TP_TX_SESSIONS; i++) {
+		if (can_tp_tx[i].ul_gap_wait) {
+			can_tp_tx[i].ul_gap_wait = 0;
+			xSemaphoreGiveFromISR(can_tp_tx[i].xRoom, &xHigherPriorityTaskWoken);
+		}
+	}
+	portEND_SWITCHING_ISR(xHigherPriorityTaskWoken);
+}
+
+/************************************************************************/
+/*				OPEN A RECEIVE SESSION                                  */
+/*	Accepts one transfer of up to ul_size bytes from ul_peer into		*/
+/*	puc_buf. uc_block_size and uc_st_min are sent to the peer in every	*/
+/*	flow control frame, ul_prio is the priority of those frames.		*/
+/*	Returns a handle >= 0, or -1 if all sessions are in use or the		*/
+/*	peer already has one open.											*/
+/************************************************************************/
+
+int32_t can_tp_rx_open(uint32_t ul_peer, uint8_t *puc_buf, uint32_t ul_size,
+		uint8_t uc_block_size, uint8_t uc_st_min, uint32_t ul_prio)
+{
+	int32_t l_handle = -1;
+	uint8_t i;
+
+	if (!puc_buf || !ul_size)
+		return -1;
+
+	taskENTER_CRITICAL();
+	if (!can_tp_find_rx(ul_peer)) {
+		for (i = 0; i < CAN_TP_RX_SESSIONS; i++) {
+			if (can_tp_rx[i].ul_state == CAN_TP_IDLE) {
+				can_tp_rx[i].ul_peer = ul_peer;
+				can_tp_rx[i].puc_buf = puc_buf;
+				can_tp_rx[i].ul_size = (ul_size > CAN_TP_MAX_LENGTH) ? CAN_TP_MAX_LENGTH : ul_size;
+				can_tp_rx[i].ul_length = 0;
+				can_tp_rx[i].ul_received = 0;
+				can_tp_rx[i].ul_prio = ul_prio;
+				can_tp_rx[i].uc_block_size = uc_block_size;
+				can_tp_rx[i].uc_st_min = uc_st_min;
+				can_tp_rx[i].ul_state = CAN_TP_LISTEN;
+				xSemaphoreTake(can_tp_rx[i].xDone, 0);
+				l_handle = i;
+				break;
+			}
+		}
+	}
+	taskEXIT_CRITICAL();
+
+	return l_handle;
+}
+
+/************************************************************************/
+/*				WAIT FOR A TRANSFER                                     */
+/*	Blocks until the transfer on l_handle has finished or xTimeout		*/
+/*	ticks have passed. Returns CAN_TP_DONE and the length in			*/
+/*	*p_length, or an error code. After CAN_TP_DONE or an error the		*/
+/*	session listens for the next transfer into the same buffer.			*/
+/************************************************************************/
+
+uint32_t can_tp_rx_wait(int32_t l_handle, uint32_t *p_length, TickType_t xTimeout)
+{
+	can_tp_rx_t *p_rx;
+	uint32_t ul_state;
+
+	if ((l_handle < 0) || (l_handle >= CAN_TP_RX_SESSIONS))
+		return CAN_TP_ERR_PARAM;
+	p_rx = &can_tp_rx[l_handle];
+
+	if (xSemaphoreTake(p_rx->xDone, xTimeout) != pdTRUE)
+		return CAN_TP_ERR_TIMEOUT;
+
+	taskENTER_CRITICAL();
+	ul_state = p_rx->ul_state;
+	*p_length = p_rx->ul_length;
+	if (ul_state != CAN_TP_IDLE)
+		p_rx->ul_state = CAN_TP_LISTEN;
+	taskEXIT_CRITICAL();
+
+	return (ul_state == CAN_TP_IDLE) ? CAN_TP_ERR_NO_SESSION : ul_state;
+}
+
+/************************************************************************/
+/*				CLOSE A RECEIVE SESSION                                 */
+/*	The buffer is no longer written to once this returns.				*/
+/************************************************************************/
+
+void can_tp_rx_close(int32_t l_handle)
+{
+	if ((l_handle < 0) || (l_handle >= CAN_TP_RX_SESSIONS))
+		return;
+
+	taskENTER_CRITICAL();
+	can_tp_rx[l_handle].ul_state = CAN_TP_IDLE;
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				SEND A TRANSFER                                         */
+/*	Sends ul_length bytes from puc_data to ul_peer at priority ul_prio. */
+/*	Blocks the calling task until the last frame has been queued.		*/
+/*	xTimeout is the longest wait for each flow control frame, and for	*/
+/*	room in the TX queue.												*/
+/*	Returns CAN_TP_DONE or an error code.								*/
+/************************************************************************/
+
+uint32_t can_tp_send(uint32_t ul_peer, const uint8_t *puc_data, uint32_t ul_length,
+		uint32_t ul_prio, TickType_t xTimeout)
+{
+	can_tp_tx_t *p_tx = NULL;
+	uint32_t ul_sent, ul_count, ul_fc, ul_gap, ul_ret = CAN_TP_DONE;
+	uint32_t ul_block;
+	uint8_t uc_seq = 1, uc_bs, i;
+	uint32_t ul_cf = 0;
+
+	if (!puc_data || !ul_length || (ul_length > CAN_TP_MAX_LENGTH))
+		return CAN_TP_ERR_PARAM;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < CAN_TP_TX_SESSIONS; i++) {
+		if (can_tp_tx[i].ul_busy && (can_tp_tx[i].ul_peer == ul_peer)) {
+			p_tx = NULL;
+			break;
+		}
+		if (!can_tp_tx[i].ul_busy && !p_tx)
+			p_tx = &can_tp_tx[i];
+	}
+	if (p_tx) {
+		p_tx->ul_peer = ul_peer;
+		p_tx->ul_busy = 1;
+		p_tx->ul_cf_sent = 0;
+	}
+	taskEXIT_CRITICAL();
+	if (!p_tx)
+		return CAN_TP_ERR_NO_SESSION;
+	xSemaphoreTake(p_tx->xFlow, 0);
+
+	/* First frame. */
+	ul_sent = (ul_length < CAN_TP_FF_DATA) ? ul_length : CAN_TP_FF_DATA;
+	while (!send_can_command(((uint32_t)CAN_TP_FF << 24) | ul_length, can_tp_pack(puc_data, ul_sent), CAN_TP_ID(ul_peer), ul_prio)) {
+		if (!can_tp_wait_room(p_tx, xTimeout)) {
+			ul_ret = CAN_TP_ERR_TIMEOUT;
+			break;
+		}
+	}
+
+	while ((ul_ret == CAN_TP_DONE) && (ul_sent < ul_length)) {
+		/* Wait for a clear-to-send. */
+		if (xSemaphoreTake(p_tx->xFlow, xTimeout) != pdTRUE) {
+			ul_ret = CAN_TP_ERR_TIMEOUT;
+			break;
+		}
+		ul_fc = p_tx->ul_fc;
+		if (((ul_fc >> 16) & 0xFF) == CAN_TP_WAIT)
+			continue;
+		if (((ul_fc >> 16) & 0xFF) != CAN_TP_CTS) {
+			ul_ret = (((ul_fc >> 16) & 0xFF) == CAN_TP_OVERFLOW) ? CAN_TP_ERR_OVERFLOW : CAN_TP_ERR_ABORTED;
+			break;
+		}
+		uc_bs = (uint8_t)(ul_fc >> 8);
+		ul_gap = CAN_TP_ST_US((uint8_t)ul_fc);
+
+		/* One block of consecutive frames. */
+		for (ul_block = 0; (ul_sent < ul_length) && (!uc_bs || (ul_block < uc_bs)); ) {
+			ul_count = ul_length - ul_sent;
+			if (ul_count > CAN_TP_CF_DATA)
+				ul_count = CAN_TP_CF_DATA;
+
+			if (ul_gap && ul_block && !can_tp_gap(p_tx, ul_cf, ul_gap, xTimeout)) {
+				ul_ret = CAN_TP_ERR_TIMEOUT;
+				break;
+			}
+			if (!can_tp_wait_room(p_tx, xTimeout)) {
+				ul_ret = CAN_TP_ERR_TIMEOUT;
+				break;
+			}
+			if (!send_can_command(((uint32_t)CAN_TP_CF << 24) | ((uint32_t)uc_seq << 16)
+					| can_tp_pack(puc_data + ul_sent, (ul_count < 2) ? ul_count : 2),
+					(ul_count > 2) ? can_tp_pack(puc_data + ul_sent + 2, ul_count - 2) : 0,
+					CAN_TP_ID(ul_peer), ul_prio))
+				continue;			// Queue filled up by someone else: wait for room, same frame again.
+			ul_cf++;
+			ul_sent += ul_count;
+			uc_seq++;
+			ul_block++;
+		}
+	}
+
+	if (ul_ret == CAN_TP_DONE) {
+		can_tp_stats.ul_tx_done++;
+		can_tp_stats.ul_tx_bytes += ul_length;
+	}
+	else
+		can_tp_stats.ul_tx_errors++;
+
+	taskENTER_CRITICAL();
+	p_tx->ul_busy = 0;
+	taskEXIT_CRITICAL();
+
+	return ul_ret;
+}
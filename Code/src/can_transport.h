@@ -0,0 +1,135 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_transport.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the segmented CAN transport in can_transport.c.
+	*
+	*	FILE REFERENCES:	can_func.h, FreeRTOS.h, semphr.h
+	*
+	*	EXTERNAL VARIABLES:		can_tp_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Uses TC0 channel 1 and its interrupt (TC1_Handler) for STmin.
+	*	Transfers are always sent from CAN0 through the TX scheduler. A subsystem sends
+	*	its frames with its own ID; the OBC sends to a subsystem with the subsystem's ID,
+	*	so in both directions a transfer is identified by the ID of the other node.
+	*
+	*	NOTES:
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					Transport frames use the CAN_PRIO_DATA class (CAN_TP_ID()); a peer is a
+	*					node number.
+	*
+	*					STmin also takes the 100 - 900 us values (0xF1 - 0xF9). Added
+	*					CAN_TP_TX_RESUME.
+	*
+	*					Added TC1_Handler(), which ends the STmin gaps shorter than a tick.
+	*
+*/
+
+#ifndef CAN_TRANSPORT_H
+#define CAN_TRANSPORT_H
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "can_func.h"
+
+/*		FRAME FORMAT (all frames are 8 bytes)
+	The top byte of ul_datal is the frame type, the rest carries the header and data.
+
+	FIRST FRAME			ul_datal[23:0]  = total length of the transfer (bytes)
+						ul_datah        = data bytes 0 - 3
+	CONSECUTIVE FRAME	ul_datal[23:16] = sequence number (1, 2, ... 255, 0, 1, ...)
+						ul_datal[15:0]  = next 2 data bytes, ul_datah = next 4 data bytes
+	FLOW CONTROL		ul_datal[23:16] = status (CAN_TP_CTS, CAN_TP_WAIT, ...)
+						ul_datal[15:8]  = block size (consecutive frames before the next
+										  flow control, 0 = send everything)
+						ul_datal[7:0]   = STmin, minimum bus idle after each consecutive frame:
+										  0x00 - 0x7F ms, 0xF1 - 0xF9 100 - 900 us
+
+	Data bytes are packed little endian, byte 0 in bits 7:0.
+	The receiver answers a first frame with a flow control frame and sends another
+	one after every block. A transfer that fits in the first frame needs no flow control.
+*/
+#define CAN_TP_FF				0x70
+#define CAN_TP_CF				0x71
+#define CAN_TP_FC				0x72
+
+#define CAN_TP_ST_US(st)		( ( ( st ) <= 0x7F ) ? ( uint32_t )( st ) * 1000 \
+								: ( ( ( st ) >= 0xF1 ) && ( ( st ) <= 0xF9 ) ) ? ( uint32_t )( ( st ) - 0xF0 ) * 100 \
+								: 127000 )		// Reserved values: the longest gap.
+
+#define CAN_TP_FF_DATA			4
+#define CAN_TP_CF_DATA			6
+#define CAN_TP_MAX_LENGTH		0x00FFFFFF
+
+/* Flow control status. */
+#define CAN_TP_CTS				0		// Continue to send.
+#define CAN_TP_WAIT				1		// Receiver is busy, wait for the next flow control.
+#define CAN_TP_OVERFLOW			2		// Transfer does not fit in the receive buffer.
+#define CAN_TP_ABORT			3		// No receive session or sequence error.
+
+/* Transfer results (and receive session states). */
+#define CAN_TP_IDLE				0
+#define CAN_TP_LISTEN			1
+#define CAN_TP_BUSY				2
+#define CAN_TP_DONE				3
+#define CAN_TP_ERR_SEQ			4
+#define CAN_TP_ERR_OVERFLOW		5
+#define CAN_TP_ERR_TIMEOUT		6
+#define CAN_TP_ERR_ABORTED		7
+#define CAN_TP_ERR_NO_SESSION	8
+#define CAN_TP_ERR_PARAM		9
+
+#define CAN_TP_RX_SESSIONS		4
+#define CAN_TP_TX_SESSIONS		4
+
+/* A sender keeps at most this many frames in the shared TX queue so that other
+*  traffic is never refused while a bulk transfer is running. A sender that hits
+*  the window sleeps until the TX interrupt has brought the queue down to
+*  CAN_TP_TX_RESUME frames. */
+#define CAN_TP_TX_WINDOW		64
+#define CAN_TP_TX_RESUME		( CAN_TP_TX_WINDOW / 2 )
+
+/* Frames to a peer node, and the TX queue priorities from the table in can_func.h.
+*  Frames from the peer carry CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, peer, CAN_TYPE_DATA). */
+#define CAN_TP_ID(peer)			CAN_ID(CAN_PRIO_DATA, ( peer ), CAN_NODE_OBC, CAN_TYPE_DATA)
+#define CAN_TP_COMS_PRIO		6
+#define CAN_TP_PAYLOAD_PRIO		7
+
+typedef struct {
+	uint32_t ul_tx_bytes;		/**< Data bytes of completed transfers sent. */
+	uint32_t ul_rx_bytes;		/**< Data bytes of completed transfers received. */
+	uint32_t ul_tx_done;
+	uint32_t ul_rx_done;
+	uint32_t ul_tx_errors;
+	uint32_t ul_rx_errors;
+	uint32_t ul_unexpected;		/**< Frames which matched no session. */
+} can_tp_stats_t;
+
+extern volatile can_tp_stats_t can_tp_stats;
+
+void can_tp_init(void);
+void TC1_Handler(void);
+int32_t can_tp_rx_open(uint32_t ul_peer, uint8_t *puc_buf, uint32_t ul_size,
+		uint8_t uc_block_size, uint8_t uc_st_min, uint32_t ul_prio);									// API Function.
+uint32_t can_tp_rx_wait(int32_t l_handle, uint32_t *p_length, TickType_t xTimeout);						// API Function.
+void can_tp_rx_close(int32_t l_handle);																	// API Function.
+uint32_t can_tp_send(uint32_t ul_peer, const uint8_t *puc_data, uint32_t ul_length,
+		uint32_t ul_prio, TickType_t xTimeout);															// API Function.
+
+#endif /* CAN_TRANSPORT_H */
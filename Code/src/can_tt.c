@@ -0,0 +1,252 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_tt.c
+	*
+	*	PURPOSE:
+	*	Time-triggered transmission on CAN1: a static table of slots is loaded into
+	*	the transmit mailboxes with a timemark each, and the CAN controller releases
+	*	every frame when its internal timer reaches that mark.
+	*
+	*	FILE REFERENCES:	can_tt.h, task.h, semphr.h
+	*
+	*	EXTERNAL VARIABLES:		can_tt_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	can_tt_start() returns 0 if the table is too long or a CAN1 mailbox other than
+*	the reception mailbox is not free.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	See can_tt.h.
+	*
+	*	NOTES:
+	*	The release time of a slot is set by the controller, not by a task, so it does
+	*	not move with the task load. can_tt_stats records the delay of every slot from
+	*	its timemark to the end of the frame and the CPU time spent per cycle.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	can_tt_start() puts CAN1 into Time Triggered Mode, writes every slot into its
+	*	mailbox and enables the timer overflow interrupt. can_tt_cycle_isr() is called
+	*	by CAN1_Handler() at the start of each cycle: it reads the timestamp of the slots
+	*	which were due in the previous cycle, sets MTCR on the slots due in the new one
+	*	and wakes any task in can_tt_wait_cycle().
+	*
+ */
+
+#include "can_tt.h"
+
+#include "task.h"
+#include "semphr.h"
+
+volatile can_tt_stats_t can_tt_stats;
+
+static can_tt_slot_t can_tt_table[CAN_TT_MAX_SLOTS];
+static uint8_t uc_tt_count = 0;
+static uint8_t uc_tt_armed = 0;			// Slots (bit n = slot n) armed in the current cycle.
+static uint32_t ul_tt_cycle = 0;
+static SemaphoreHandle_t xCanTTCycle = NULL;
+
+/* CAN1 mailboxes held while the schedule runs: all but the reception mailbox. */
+#define CAN_TT_MB_HELD		( CAN1_RX_MB_FIRST + CAN1_RX_MB_COUNT )
+
+#if CAN_TT_MB_FIRST < CAN_TT_MB_HELD
+#error "The time-triggered slots overlap the CAN1 reception mailboxes."
+#endif
+
+/* Switches Time Triggered Mode, which may only be changed while the controller
+*  is disabled. No other owner has a CAN1 mailbox at this point; the reception
+*  mailbox stays armed, but a frame on the bus in these few cycles is lost to it. */
+static void can_tt_set_mode(uint32_t ul_ttm)
+{
+	taskENTER_CRITICAL();
+	can_disable(CAN1);
+	if (ul_ttm) {
+		can_enable_time_triggered_mode(CAN1);
+		can_reset_internal_timer(CAN1);
+	} else {
+		can_disable_time_triggered_mode(CAN1);
+	}
+	can_enable(CAN1);
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				START THE SCHEDULE                                      */
+/*	Copies p_table, loads the slots into CAN1 MB2 ... and switches CAN1 */
+/*	to Time Triggered Mode. The first slots go out in the next cycle.	*/
+/*	Every CAN1 mailbox but MB0 is claimed, so that none holds a frame	*/
+/*	when the mode changes and none is set up while it runs.				*/
+/************************************************************************/
+
+uint32_t can_tt_start(const can_tt_slot_t *p_table, uint8_t uc_count)
+{
+	can_mb_conf_t mailbox;
+	uint8_t i, uc_mb;
+
+	if (!uc_count || (uc_count > CAN_TT_MAX_SLOTS) || uc_tt_count)
+		return 0;
+
+	for (i = CAN_TT_MB_HELD; i < CANMB_NUMBER; i++) {
+		if (!can_mailbox_claim(CAN1, i, CAN_OWNER_TT)) {
+			while (i-- > CAN_TT_MB_HELD)
+				can_mailbox_release(CAN1, i, CAN_OWNER_TT);
+			return 0;
+		}
+	}
+
+	if (!xCanTTCycle)
+		xCanTTCycle = xSemaphoreCreateBinary();
+
+	for (i = 0; i < uc_count; i++) {
+		can_tt_table[i] = p_table[i];
+		if (!can_tt_table[i].uc_period)
+			can_tt_table[i].uc_period = 1;
+		can_tt_table[i].uc_phase %= can_tt_table[i].uc_period;
+		uc_mb = CAN_TT_MB_FIRST + i;
+
+		reset_mailbox_conf(&mailbox);
+		mailbox.ul_mb_idx = uc_mb;
+		mailbox.uc_obj_type = CAN_MB_TX_MODE;
+		mailbox.uc_tx_prio = 0;
+		mailbox.uc_id_ver = 0;
+		mailbox.ul_id_msk = 0;
+		can_mailbox_setup(CAN1, &mailbox, CAN_OWNER_TT);
+		can_mailbox_set_timemark(CAN1, uc_mb, can_tt_table[i].us_timemark);
+
+		mailbox.ul_id = CAN_MID_MIDvA(can_tt_table[i].ul_id);
+		mailbox.ul_datal = can_tt_table[i].ul_datal;
+		mailbox.ul_datah = can_tt_table[i].ul_datah;
+		mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+		can_mailbox_write(CAN1, &mailbox);
+
+		can_tt_stats.slot[i].ul_sent = 0;
+		can_tt_stats.slot[i].ul_missed = 0;
+		can_tt_stats.slot[i].ul_min_delay = 0xFFFFFFFF;
+		can_tt_stats.slot[i].ul_max_delay = 0;
+	}
+	can_tt_stats.ul_cycles = 0;
+	can_tt_stats.ul_isr_cycles = 0;
+	can_tt_stats.ul_isr_max_cycles = 0;
+
+	taskENTER_CRITICAL();
+	uc_tt_count = uc_count;
+	uc_tt_armed = 0;
+	ul_tt_cycle = 0;
+	taskEXIT_CRITICAL();
+
+	can_tt_set_mode(1);
+	can_enable_interrupt(CAN1, CAN_IER_TOVF);
+
+	return 1;
+}
+
+/************************************************************************/
+/*				STOP THE SCHEDULE                                       */
+/*	Aborts any pending slot, leaves Time Triggered Mode and gives the	*/
+/*	mailboxes back (CAN1 MB1 - MB7).									*/
+/************************************************************************/
+
+void can_tt_stop(void)
+{
+	uint8_t i;
+
+	if (!uc_tt_count)
+		return;
+
+	can_disable_interrupt(CAN1, CAN_IDR_TOVF);
+	can_global_send_abort_cmd(CAN1, (uint8_t)(((1u << uc_tt_count) - 1) << CAN_TT_MB_FIRST));
+
+	can_tt_set_mode(0);
+
+	for (i = CAN_TT_MB_HELD; i < CANMB_NUMBER; i++)
+		can_mailbox_release(CAN1, i, CAN_OWNER_TT);
+
+	taskENTER_CRITICAL();
+	uc_tt_count = 0;
+	uc_tt_armed = 0;
+	taskEXIT_CRITICAL();
+}
+
+/************************************************************************/
+/*				WAIT FOR THE NEXT CYCLE                                 */
+/*	Blocks until the next cycle starts. Returns 1 and the number of the */
+/*	new cycle in *p_cycle, or 0 on timeout.								*/
+/************************************************************************/
+
+uint32_t can_tt_wait_cycle(TickType_t xTimeout, uint32_t *p_cycle)
+{
+	if (!xCanTTCycle || (xSemaphoreTake(xCanTTCycle, xTimeout) != pdTRUE))
+		return 0;
+
+	*p_cycle = ul_tt_cycle;
+	return 1;
+}
+
+/************************************************************************/
+/*				CYCLE START                                             */
+/*	Called from CAN1_Handler() when the CAN1 timer overflows (TOVF).	*/
+/*	The caller does portEND_SWITCHING_ISR().							*/
+/************************************************************************/
+
+void can_tt_cycle_isr(BaseType_t *pxHigherPriorityTaskWoken)
+{
+	uint32_t ul_start, ul_status, ul_delay;
+	uint8_t i, uc_mb;
+	can_tt_slot_stats_t *p_stats;
+
+	ul_start = CAN_DWT_CYCCNT;
+
+	/* Results of the slots armed in the cycle that just ended. */
+	for (i = 0; i < uc_tt_count; i++) {
+		if (!(uc_tt_armed & (1u << i)))
+			continue;
+		uc_mb = CAN_TT_MB_FIRST + i;
+		p_stats = (can_tt_slot_stats_t *)&can_tt_stats.slot[i];
+		ul_status = CAN1->CAN_MB[uc_mb].CAN_MSR;
+
+		if ((ul_status & CAN_MSR_MABT) || !(ul_status & CAN_MSR_MRDY)) {
+			p_stats->ul_missed++;
+			if (!(ul_status & CAN_MSR_MRDY))
+				can_global_send_abort_cmd(CAN1, (uint8_t)(1u << uc_mb));	// Never late: drop it.
+			continue;
+		}
+
+		ul_delay = CAN_TIMESTAMP_DIFF(ul_status & CAN_MSR_MTIMESTAMP_Msk, can_tt_table[i].us_timemark)
+				* CAN_TIMESTAMP_US;
+		p_stats->ul_sent++;
+		if (ul_delay < p_stats->ul_min_delay)
+			p_stats->ul_min_delay = ul_delay;
+		if (ul_delay > p_stats->ul_max_delay)
+			p_stats->ul_max_delay = ul_delay;
+	}
+
+	/* Arm the slots due in the new cycle. */
+	ul_tt_cycle++;
+	uc_tt_armed = 0;
+	for (i = 0; i < uc_tt_count; i++) {
+		if ((ul_tt_cycle % can_tt_table[i].uc_period) != can_tt_table[i].uc_phase)
+			continue;
+		CAN1->CAN_MB[CAN_TT_MB_FIRST + i].CAN_MCR = CAN_MCR_MDLC(MAX_CAN_FRAME_DATA_LEN) | CAN_MCR_MTCR;
+		uc_tt_armed |= (1u << i);
+	}
+
+	can_tt_stats.ul_cycles = ul_tt_cycle;
+	if (xCanTTCycle)
+		xSemaphoreGiveFromISR(xCanTTCycle, pxHigherPriorityTaskWoken);
+
+	ul_start = CAN_DWT_CYCCNT - ul_start;
+	can_tt_stats.ul_isr_cycles += ul_start;
+	if (ul_start > can_tt_stats.ul_isr_max_cycles)
+		can_tt_stats.ul_isr_max_cycles = ul_start;
+}
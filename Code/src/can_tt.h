@@ -0,0 +1,120 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_tt.h
+	*
+	*	PURPOSE:
+	*	Definitions and prototypes for the time-triggered CAN schedule in can_tt.c.
+	*
+	*	FILE REFERENCES:	can_func.h, FreeRTOS.h
+	*
+	*	EXTERNAL VARIABLES:		can_tt_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None yet.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Time Triggered Mode is a setting of the whole controller: every transmit mailbox
+	*	then waits for its timemark. It is therefore only used on CAN1, whose transmit
+	*	mailboxes are not used by the TX scheduler, and only when CAN_TT_ENABLE is 1.
+	*	The mode may only be changed with the controller disabled, which cuts any
+	*	frame CAN1 is sending or receiving. can_tt_start() therefore claims every CAN1
+	*	mailbox but the reception mailbox MB0, and fails while another owner (the
+	*	command exchange, a test program, remote housekeeping) holds one of them; no
+	*	other frame is in CAN1 when the mode changes in can_tt_start() or can_tt_stop().
+	*	MB0 stays armed across the change, but a frame on the bus in those few cycles
+	*	is lost to it without being counted.
+	*
+	*	NOTES:
+	*	Against the task-driven sweep of prvHouseKeepTask2() (tools/host/test_tt.c,
+	*	host simulation: both buses at about 30% load, a higher priority task busy
+	*	0 - 30 ms after every tick, 40 sweeps of the six requests):
+	*
+	*						request delay		worst jitter	per sweep
+	*		task-driven		604 - 32433 us		29609 us		6 driver calls, 6 TX interrupts, 1 wake-up
+	*		time-triggered	444 - 868 us		424 us			6 cycle interrupts, 6 wake-ups
+	*
+	*	Delays and jitter are simulated times (444 us per frame); the time-triggered
+	*	jitter is at most one frame already on the bus. The work per sweep is
+	*	counted, not timed. The schedule trades six request calls and transmit
+	*	interrupts for one cycle interrupt (which re-arms the due slots) and one
+	*	wake-up of the task in every cycle, six cycles per sweep here. Which costs
+	*	less depends on the interrupt and task switch times of the target; what
+	*	the schedule buys is the jitter.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	New tasks should be written to use as much of CMSIS as possible. The ASF and
+	*	FreeRTOS API libraries should also be used whenever possible to make the program
+	*	more portable.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Added the jitter and the CPU work per sweep against the task-driven sweep.
+	*					CAN_TT_ENABLE can be set from the build.
+	*
+*/
+
+#ifndef CAN_TT_H
+#define CAN_TT_H
+
+#include "FreeRTOS.h"
+#include "can_func.h"
+
+/* Set to 1 to run housekeeping polling from the time-triggered schedule. */
+#ifndef CAN_TT_ENABLE
+#define CAN_TT_ENABLE			0
+#endif
+
+/*		SCHEDULE
+	One basic cycle is one pass of the 16-bit CAN timer (65536 bit times = 262 ms
+	at 250 kbit/s); the timer overflow interrupt marks the start of each cycle.
+	A slot is sent when the timer reaches its timemark, in every cycle where
+	(cycle % uc_period) == uc_phase. The controller times the release of the frame;
+	the CPU arms the due slots (MTCR) at the start of every cycle.
+
+	CAN1 MB2 - MB7 are used for the slots. MB0 is the reception mailbox; MB1 and
+	the slots the table leaves free are held idle while the schedule runs. In this mode a frame received in the last mailbox
+	would reset the timer, which cannot happen since MB7 only transmits here.
+*/
+#define CAN_TT_MB_FIRST			2
+#define CAN_TT_MAX_SLOTS		6
+#define CAN_TT_CYCLE_US			( 65536UL * CAN_TIMESTAMP_US )
+#define CAN_TT_MARK_US(us)		( ( uint16_t )( ( us ) / CAN_TIMESTAMP_US ) )
+
+typedef struct {
+	uint16_t us_timemark;		/**< Bit times into the cycle, see CAN_TT_MARK_US(). */
+	uint8_t uc_period;			/**< Send every uc_period cycles (1 = every cycle). */
+	uint8_t uc_phase;			/**< Cycle in the period in which the slot is sent. */
+	uint32_t ul_id;				/**< Standard ID. */
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+} can_tt_slot_t;
+
+/* Jitter of a slot = (ul_max_delay - ul_min_delay), in us. The delay is
+*  measured from the timemark to the end of the frame, so it includes the
+*  frame's own length on the bus. */
+typedef struct {
+	uint32_t ul_sent;
+	uint32_t ul_missed;			/**< Lost arbitration / error (TTM does not retry) or not sent in its cycle. */
+	uint32_t ul_min_delay;
+	uint32_t ul_max_delay;
+} can_tt_slot_stats_t;
+
+typedef struct {
+	uint32_t ul_cycles;
+	uint32_t ul_isr_cycles;		/**< CPU cycles spent in the cycle interrupt, total. */
+	uint32_t ul_isr_max_cycles;
+	can_tt_slot_stats_t slot[CAN_TT_MAX_SLOTS];
+} can_tt_stats_t;
+
+extern volatile can_tt_stats_t can_tt_stats;
+
+uint32_t can_tt_start(const can_tt_slot_t *p_table, uint8_t uc_count);		// API Function.
+void can_tt_stop(void);														// API Function.
+uint32_t can_tt_wait_cycle(TickType_t xTimeout, uint32_t *p_cycle);			// API Function.
+void can_tt_cycle_isr(BaseType_t *pxHigherPriorityTaskWoken);
+
+#endif /* CAN_TT_H */
@@ -35,6 +35,8 @@
 	*	02/17/2015		I made some changes to send_command() in can_func.c with regards to
 	*					how the ID of the mailboxes is being set.
 	*
+	*	10/17/2026		The command is sent with an ID built by CAN_ID() (EPS/COMS command class).
+	*
 	*	DESCRIPTION:	
 	*
 	*	This file is being used to test our CAN commands API. This file is used to encapsulate a 
@@ -124,7 +126,7 @@ static void prvCommandTask( void *pvParameters )
 	
 	low = DUMMY_COMMAND;
 	high = CAN_MSG_DUMMY_DATA;
-	ID = SUB0_ID0;
+	ID = CAN_ID(CAN_PRIO_SUB_CMD, SUB0_ID0, CAN_NODE_OBC, CAN_TYPE_CMD);
 	PRIORITY = COMMAND_PRIO;
 	
 	/* @non-terminating@ */	
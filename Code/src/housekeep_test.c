@@ -33,6 +33,12 @@
 	*	01/02/2015			Added CAN functionality and made use of vTaskDelayUntil(...) in order to
 	*						implement a delay in between housekeeping requests.
 	*
+	*	10/17/2026			The producer is CAN0 MB0, clear of the reception FIFO (MB2-MB3) and
+	*						the extended frames (MB5). The task claims it and CAN1 MB3 as
+	*						CAN_OWNER_HK_TEST, so a claim by command_out() or another test
+	*						program fails, and uses its own mailbox descriptors instead of the
+	*						removed can0_mailbox/can1_mailbox globals.
+	*
 	*	DESCRIPTION:	
 	*
 	*	This file is being used to house the housekeeping task.
@@ -111,36 +117,40 @@ static void prvHouseKeepTask( void *pvParameters )
 	TickType_t	xLastWakeTime;
 	const TickType_t xTimeToWait = 15;	//Number entered here corresponds to the number of ticks we should wait.
 	/* As SysTick will be approx. 1kHz, Num = 1000 * 60 * 60 = 1 hour.*/
+	can_mb_conf_t producer_mailbox, consumer_mailbox;
+	
+	configASSERT( can_mailbox_claim(CAN0, 0, CAN_OWNER_HK_TEST) );
+	configASSERT( can_mailbox_claim(CAN1, 3, CAN_OWNER_HK_TEST) );
 	
 	/* @non-terminating@ */
 	for( ;; )
 	{
-			/* Init CAN0 Mailbox 3 to Producer Mailbox. */
+			/* Init CAN0 Mailbox 0 to Producer Mailbox. */
 			/* The subsystems should be doing this part */
-			reset_mailbox_conf(&can0_mailbox);
-			can0_mailbox.ul_mb_idx = 3;				// Mailbox 3
-			can0_mailbox.uc_obj_type = CAN_MB_PRODUCER_MODE;
-			can0_mailbox.ul_id_msk = 0;
-			can0_mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);
-			can_mailbox_init(CAN0, &can0_mailbox);
+			reset_mailbox_conf(&producer_mailbox);
+			producer_mailbox.ul_mb_idx = 0;				// Mailbox 0 (MB2-MB3 are the reception FIFO)
+			producer_mailbox.uc_obj_type = CAN_MB_PRODUCER_MODE;
+			producer_mailbox.ul_id_msk = 0;
+			producer_mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);
+			can_mailbox_setup(CAN0, &producer_mailbox, CAN_OWNER_HK_TEST);
 
 			/* Prepare the response information when subsystem receives a remote frame. */
-			can0_mailbox.ul_datal = HK_TRANSMIT;
-			can0_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
-			can0_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-			can_mailbox_write(CAN0, &can0_mailbox);
+			producer_mailbox.ul_datal = HK_TRANSMIT;
+			producer_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
+			producer_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+			can_mailbox_write(CAN0, &producer_mailbox);
 
-			can_global_send_transfer_cmd(CAN0, CAN_TCR_MB3);
+			can_global_send_transfer_cmd(CAN0, CAN_TCR_MB0);
 
 			/* Init CAN1 Mailbox 3 to Consumer Mailbox. It sends a remote frame and waits for an answer. */
 			/* Here we will ask for HK from each subsystem sequentially, and wait for a response in between each */
-			reset_mailbox_conf(&can1_mailbox);
-			can1_mailbox.ul_mb_idx = 3;				// Mailbox 3
-			can1_mailbox.uc_obj_type = CAN_MB_CONSUMER_MODE;
-			can1_mailbox.uc_tx_prio = 9;
-			can1_mailbox.ul_id_msk = CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk;
-			can1_mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);
-			can_mailbox_init(CAN1, &can1_mailbox);
+			reset_mailbox_conf(&consumer_mailbox);
+			consumer_mailbox.ul_mb_idx = 3;				// Mailbox 3
+			consumer_mailbox.uc_obj_type = CAN_MB_CONSUMER_MODE;
+			consumer_mailbox.uc_tx_prio = 9;
+			consumer_mailbox.ul_id_msk = CAN_MID_MIDvA_Msk | CAN_MID_MIDvB_Msk;
+			consumer_mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);
+			can_mailbox_setup(CAN1, &consumer_mailbox, CAN_OWNER_HK_TEST);
 
 			/* Enable CAN1 mailbox 3 interrupt. */
 			can_enable_interrupt(CAN1, CAN_IER_MB3);
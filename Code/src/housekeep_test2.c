@@ -31,6 +31,19 @@
 	*	DEVELOPMENT HISTORY:		
 	*	02/17/2015		Created.
 	*
+	*	10/17/2026		The task now requests housekeeping from every subsystem at once and
+	*					collects the replies through collect_housekeeping_all().
+	*
+	*					With CAN_TT_ENABLE the requests are released by the time-triggered
+	*					schedule on CAN1 instead, and the task only collects the replies.
+	*
+	*					The schedule slots use HK_REQUEST_ID().
+	*
+	*					The collection window of the time-triggered sweep is worked out from
+	*					the schedule (hk_tt_window()); two ticks ended before the last slot.
+	*
+	*					Only one of the two task loops is compiled (#else).
+	*
 	*	DESCRIPTION:	
 	*
 	*	This file is being used to test Housekeeping Commands between the OBC and a subsystem micro. 
@@ -60,6 +73,8 @@
 
 /* CAN Function includes */
 #include "can_func.h"
+#include "can_hk.h"
+#include "can_tt.h"
 
 /* Priorities at which the tasks are created. */
 #define Housekeep_TEST2_PRIORITY		( tskIDLE_PRIORITY + 3 )		// Lower the # means lower the priority
@@ -68,6 +83,38 @@
 functionality. */
 #define HK_PARAMETER2			( 0xABCD )
 
+#if CAN_TT_ENABLE
+/* One slot per subsystem, 32 ms apart, every 6 cycles (6 x 262 ms = 1.57 s,
+*  about the 15 ticks of the task-driven sweep). */
+#define HK_TT_PERIOD			6
+#define HK_TT_SLOT(n)			{ CAN_TT_MARK_US(32768UL * ( ( n ) + 1 )), HK_TT_PERIOD, 0, HK_REQUEST_ID(SUB0_ID0 + ( n )), HK_REQUEST, HK_REQUEST }
+
+static const can_tt_slot_t hk_schedule[HK_NODE_COUNT] = {
+	HK_TT_SLOT(0), HK_TT_SLOT(1), HK_TT_SLOT(2), HK_TT_SLOT(3), HK_TT_SLOT(4), HK_TT_SLOT(5)
+};
+
+/* Longest time from a request on the bus to its reply: the subsystem's turnaround
+*  and the reply frame. */
+#define HK_TT_REPLY_US			10000
+
+/* Ticks from the start of a cycle until every reply can be in: the latest
+*  timemark of hk_schedule plus HK_TT_REPLY_US, rounded up to ticks, plus one
+*  for the part of a tick already gone when the task wakes up. */
+static TickType_t hk_tt_window(void)
+{
+	uint32_t ul_us = 0;
+	uint8_t i;
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (hk_schedule[i].us_timemark > ul_us)
+			ul_us = hk_schedule[i].us_timemark;
+	}
+	ul_us = ul_us * CAN_TIMESTAMP_US + HK_TT_REPLY_US;
+
+	return (TickType_t)((ul_us * configTICK_RATE_HZ + 999999) / 1000000) + 1;
+}
+#endif
+
 /*-----------------------------------------------------------*/
 
 /*
@@ -111,21 +158,41 @@ void housekeep_test2( void )
 static void prvHouseKeepTask2(void *pvParameters )
 {
 	configASSERT( ( ( unsigned long ) pvParameters ) == HK_PARAMETER2 );
-	TickType_t	xLastWakeTime;
 	const TickType_t xTimeToWait = 15;	// Number entered here corresponds to the number of ticks we should wait.
 	/* As SysTick will be approx. 1kHz, Num = 1000 * 60 * 60 = 1 hour.*/
 	
-	uint32_t ID, x;
-	
-	ID = SUB0_ID5;
+	hk_result_t results[HK_NODE_COUNT];
+	uint32_t x;
 	
+#if CAN_TT_ENABLE
+	uint32_t ID, cycle;
+	const TickType_t xWindow = hk_tt_window();	// 4 ticks: last slot at 196.6 ms.
+
+	configASSERT(can_tt_start(hk_schedule, HK_NODE_COUNT));
+
+	/* @non-terminating@ */	
+	for( ;; )
+	{
+		/* The controller sends the requests; this task only wakes once per cycle. */
+		if (!can_tt_wait_cycle(xTimeToWait, &cycle) || (cycle % HK_TT_PERIOD))
+			continue;
+		for (ID = SUB0_ID0; ID < SUB0_ID0 + HK_NODE_COUNT; ID++)
+			hk_expect(ID);
+		x = collect_housekeeping_all(results, xWindow);	// Ends well before the next request cycle.
+	}
+#else
+	TickType_t	xLastWakeTime;
+
 	/* @non-terminating@ */	
 	for( ;; )
 	{
-		x = request_housekeeping(SUB0_ID5);		// This is the CAN API function I have written for us to use.
 		xLastWakeTime = xTaskGetTickCount();
+		x = request_housekeeping_all();			// One request per subsystem, all outstanding at once.
+		if (x)
+			x = collect_housekeeping_all(results, xTimeToWait - 1);	// Replies must arrive before the next sweep.
 		vTaskDelayUntil(&xLastWakeTime, xTimeToWait);
 	}
+#endif
 }
 /*-----------------------------------------------------------*/
 
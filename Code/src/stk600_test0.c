@@ -32,6 +32,11 @@
 	*	DEVELOPMENT HISTORY:		
 	*	01/24/2015		Created.
 	*
+	*	10/17/2026		Uses its own mailbox descriptors and claims CAN0 MB0 and CAN1 MB1 instead
+	*					of resetting every mailbox (CAN1 MB0 and CAN0 MB4-MB7 belong to can_func.c).
+	*
+	*					Claims as CAN_OWNER_STK600_TEST.
+	*
 	*	DESCRIPTION:	
 	*
 	*	This file is being used to house test communication with the STK600.
@@ -61,41 +66,41 @@ void stk600_test0( void );
 
 void stk600_test0(void)
 {
+	can_mb_conf_t rx_mailbox, tx_mailbox;
+
+	if (!can_mailbox_claim(CAN0, 0, CAN_OWNER_STK600_TEST) || !can_mailbox_claim(CAN1, 1, CAN_OWNER_STK600_TEST))
+		while (1) { }
+
 	while(1)
 	{
 	pio_toggle_pin(LED0_GPIO);
-	can_reset_all_mailbox(CAN0);
-	can_reset_all_mailbox(CAN1);
 
 	/* Init CAN0 Mailbox 0 to Reception Mailbox. */
-	reset_mailbox_conf(&can0_mailbox);
-	can0_mailbox.ul_mb_idx = 0;
-	can0_mailbox.uc_obj_type = CAN_MB_RX_MODE;
-	can0_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
-	can0_mailbox.ul_id = NODE0_ID;
-	can_mailbox_init(CAN0, &can0_mailbox);
-
-	/* Init CAN1 Mailbox 0 to Transmit Mailbox. */
-	reset_mailbox_conf(&can1_mailbox);
-	can1_mailbox.ul_mb_idx = 0;
-	can1_mailbox.uc_obj_type = CAN_MB_TX_MODE;
-	can1_mailbox.uc_tx_prio = 15;
-	can1_mailbox.uc_id_ver = 0;		// Standard Frame
-	can1_mailbox.ul_id_msk = 0;
-	can_mailbox_init(CAN1, &can1_mailbox);
-
-	/* Write transmit information into mailbox. */
-	can1_mailbox.ul_id = NODE0_ID;
-	can1_mailbox.ul_datal = COMMAND_IN;
-	can1_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
-	can1_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
-	can_mailbox_write(CAN1, &can1_mailbox);
+	reset_mailbox_conf(&rx_mailbox);
+	rx_mailbox.ul_mb_idx = 0;
+	rx_mailbox.uc_obj_type = CAN_MB_RX_MODE;
+	rx_mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk | CAN_MAM_MIDvB_Msk;
+	rx_mailbox.ul_id = NODE0_ID;
+	can_mailbox_setup(CAN0, &rx_mailbox, CAN_OWNER_STK600_TEST);
+
+	/* Init CAN1 Mailbox 1 to Transmit Mailbox. */
+	reset_mailbox_conf(&tx_mailbox);
+	tx_mailbox.ul_mb_idx = 1;
+	tx_mailbox.uc_obj_type = CAN_MB_TX_MODE;
+	tx_mailbox.uc_tx_prio = 15;
+	tx_mailbox.uc_id_ver = 0;		// Standard Frame
+	tx_mailbox.ul_id_msk = 0;
+	can_mailbox_setup(CAN1, &tx_mailbox, CAN_OWNER_STK600_TEST);
 
 	/* Enable CAN0 mailbox 0 interrupt. */
 	can_enable_interrupt(CAN0, CAN_IER_MB0);
 
-	/* Send out the information in the mailbox. */
-	can_global_send_transfer_cmd(CAN1, CAN_TCR_MB0);
+	/* Write transmit information into mailbox and send it out. */
+	tx_mailbox.ul_id = NODE0_ID;
+	tx_mailbox.ul_datal = COMMAND_IN;
+	tx_mailbox.ul_datah = CAN_MSG_DUMMY_DATA;
+	tx_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	can_mailbox_send(CAN1, &tx_mailbox, CAN_OWNER_STK600_TEST);
 
 	}
 
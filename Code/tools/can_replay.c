@@ -0,0 +1,488 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		can_replay.c
+	*
+	*	PURPOSE:
+	*	Host (Linux) tool which reads a CAN capture dumped by can_capture_dump(), replays
+	*	the received frames through decode_can_msg() and the handlers the firmware
+	*	registers, and prints per-ID rates, inter-frame gaps and request to reply latencies.
+	*
+	*	FILE REFERENCES:	stdio.h, stdlib.h, string.h, host.h, can_capture.h, can_route.h,
+	*						can_pdo.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if the file cannot be read or a block header is not valid.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Built like the host tests (tools/Makefile): the firmware sources of src/ are
+	*	compiled as they are against the simulation of tools/host, so the capture
+	*	format and the ID layout come from the firmware headers, and the frames go
+	*	through the firmware's own decode_can_msg(), handlers and statistics.
+	*	The simulated OBC has only done can_initialize(); handlers registered later
+	*	by the flight tasks are not there and their frames count as unhandled.
+	*
+	*	NOTES:
+	*	Build:	make can_replay  in tools/.
+	*	Use:	can_replay [-l] [-m ctrl.mb]... capture.bin
+	*			- reads stdin, -l lists every frame, -m binds a counting handler to a
+	*			mailbox (e.g. -m 1.2 for the first remote housekeeping mailbox), as
+	*			a mailbox-bound handler took those frames; the capture does not record
+	*			which handlers were registered.
+	*
+	*	Capture on the serial port with e.g.  stty -F /dev/ttyACM0 115200 raw &&
+	*	cat /dev/ttyACM0 > capture.bin  while the OBC runs can_capture_dump().
+	*	The output is plain text so two runs can be compared with diff.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Frames are routed with can_route() (src/can_route.h), the decision
+	*					decode_can_msg() makes: bound mailboxes and process data frames now
+	*					have their own counts instead of landing in the opcode counts.
+	*
+	*	10/17/2026		Built against the host simulation: each received frame is passed to
+	*					the firmware's decode_can_msg(), after the simulated time has moved on
+	*					by the gap to the frame before, and the dispatch report gives the
+	*					frames it handled and the ones it counted in ul_unhandled.
+	*
+	*	DESCRIPTION:
+	*
+	*	The blocks are read into one list of records and the cycle counts are unwrapped
+	*	into a 64-bit time. Each received frame is then rebuilt as the can_frame_t the
+	*	dispatch task would have taken out of the RX ring and decoded by the firmware.
+	*	The report counts it under its route (can_route(), the choice decode_can_msg()
+	*	makes: bound mailboxes by mailbox, extended frames by type, process data by
+	*	source node and frame number, other standard frames by controller and opcode
+	*	index), as handled or, if can_rx_stats.ul_unhandled moved, unhandled. Every
+	*	frame is added to the statistics of its ID. A request or command sent by the
+	*	OBC is paired with the next reply from the same node and class.
+	*
+ */
+
+#include "host.h"
+#include "can_capture.h"
+#include "can_route.h"
+#include "can_pdo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bits of uc_info which can_frame_t carries (the rest are the capture's). */
+#define REPLAY_INFO_MASK		0x3F
+
+#define MAX_IDS					512
+#define MAX_NODES				32
+
+typedef struct {
+	uint64_t ull_cycles;		/* Unwrapped. */
+	uint32_t ul_id;				/* CAN_MID */
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	uint16_t us_timestamp;
+	uint8_t uc_info;
+	uint8_t uc_length;
+} rec_t;
+
+typedef struct {
+	double min, max, sum;
+	uint32_t count;
+} span_t;
+
+typedef struct {
+	uint32_t ul_mid;
+	uint8_t uc_dir;
+	uint32_t ul_frames;
+	uint64_t ull_first, ull_last;
+	span_t gap;					/* us between frames of this ID. */
+	uint32_t ul_long_gaps;		/* Gaps over twice the mean, counted in a second pass. */
+} id_stats_t;
+
+static rec_t *recs;
+static uint32_t ul_recs, ul_recs_max;
+static uint32_t ul_lost, ul_blocks;
+static double d_cpu_mhz;
+
+static id_stats_t ids[MAX_IDS];
+static uint32_t ul_ids;
+
+/* Replay, by route: bound mailboxes by [controller][mailbox], extended frames by
+*  type, process data by [source][frame number], the rest by [controller][opcode
+*  index]. [0] frames handled, [1] frames decode_can_msg() counted as unhandled. */
+static uint8_t uc_mb_bound[2][CANMB_NUMBER];
+static uint32_t ul_mb_dispatch[2][CANMB_NUMBER];
+static uint32_t ul_std_dispatch[2][2][256];
+static uint32_t ul_ext_dispatch[2][256];
+static uint32_t ul_pdo_dispatch[8][CAN_PDO_PER_NODE];
+static uint32_t ul_rx_frames;
+static uint64_t ull_rx_last;
+
+/* Open request or command per node, and the reply latencies per node. */
+static uint64_t ull_req_at[MAX_NODES];
+static uint8_t uc_req_class[MAX_NODES];
+static uint8_t uc_req_open[MAX_NODES];
+static span_t latency[MAX_NODES];
+static uint32_t ul_unanswered[MAX_NODES];
+
+static uint32_t get16(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return get16(p) | (get16(p + 2) << 16);
+}
+
+static void span_add(span_t *p_span, double d)
+{
+	if (!p_span->count || (d < p_span->min))
+		p_span->min = d;
+	if (!p_span->count || (d > p_span->max))
+		p_span->max = d;
+	p_span->sum += d;
+	p_span->count++;
+}
+
+static double us_between(uint64_t ull_later, uint64_t ull_earlier)
+{
+	return (double)(ull_later - ull_earlier) / d_cpu_mhz;
+}
+
+/************************************************************************/
+/*				READ THE CAPTURE                                        */
+/************************************************************************/
+
+static void read_capture(FILE *f)
+{
+	uint8_t header[CAN_CAPTURE_HEADER_SIZE], rec[CAN_CAPTURE_REC_SIZE];
+	uint32_t ul_count, ul_cycles, ul_prev = 0, i;
+	uint64_t ull_base = 0;
+
+	while (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+		if (memcmp(header, CAN_CAPTURE_MAGIC, 4) || (header[4] != CAN_CAPTURE_VERSION)
+			|| (header[5] != CAN_CAPTURE_REC_SIZE)) {
+			fprintf(stderr, "block %u: bad header\n", ul_blocks);
+			exit(1);
+		}
+		ul_count = get16(&header[6]);
+		d_cpu_mhz = get32(&header[8]) / 1e6;
+		ul_lost += get32(&header[12]);
+		ul_blocks++;
+
+		for (i = 0; i < ul_count; i++) {
+			if (fread(rec, 1, sizeof(rec), f) != sizeof(rec)) {
+				fprintf(stderr, "block %u: truncated\n", ul_blocks - 1);
+				exit(1);
+			}
+			if (ul_recs == ul_recs_max) {
+				ul_recs_max = ul_recs_max ? ul_recs_max * 2 : 1024;
+				recs = realloc(recs, ul_recs_max * sizeof(rec_t));
+				if (!recs) {
+					fprintf(stderr, "out of memory\n");
+					exit(1);
+				}
+			}
+
+			/* The cycle counter is 32 bits: count its wraps. */
+			ul_cycles = get32(&rec[0]);
+			if (ul_recs && (ul_cycles < ul_prev))
+				ull_base += 1ull << 32;
+			ul_prev = ul_cycles;
+
+			recs[ul_recs].ull_cycles = ull_base + ul_cycles;
+			recs[ul_recs].ul_id = get32(&rec[4]);
+			recs[ul_recs].ul_datal = get32(&rec[8]);
+			recs[ul_recs].ul_datah = get32(&rec[12]);
+			recs[ul_recs].us_timestamp = (uint16_t)get16(&rec[16]);
+			recs[ul_recs].uc_info = rec[18];
+			recs[ul_recs].uc_length = rec[19];
+			ul_recs++;
+		}
+	}
+	if (d_cpu_mhz <= 0)
+		d_cpu_mhz = 84.0;
+}
+
+/************************************************************************/
+/*				REPLAY                                                  */
+/************************************************************************/
+
+static id_stats_t *id_entry(const rec_t *p_rec)
+{
+	uint8_t uc_dir = p_rec->uc_info & CAN_CAPTURE_TX;
+	uint32_t i;
+
+	for (i = 0; i < ul_ids; i++) {
+		if ((ids[i].ul_mid == p_rec->ul_id) && (ids[i].uc_dir == uc_dir))
+			return &ids[i];
+	}
+	if (ul_ids == MAX_IDS)
+		return NULL;
+	ids[ul_ids].ul_mid = p_rec->ul_id;
+	ids[ul_ids].uc_dir = uc_dir;
+	return &ids[ul_ids++];
+}
+
+/* Bound to the mailboxes given with -m. */
+static void replay_mb_handler(const can_frame_t *p_frame)
+{
+	ul_mb_dispatch[CAN_FRAME_CTRL(p_frame)][CAN_FRAME_MB(p_frame)]++;
+}
+
+/* A received frame through decode_can_msg(), at its time in the capture. */
+static void replay_dispatch(const rec_t *p_rec)
+{
+	can_frame_t frame;
+	uint32_t ul_unhandled, ul_id, ul_route, ul_pdo;
+	uint8_t uc_ctrl = (p_rec->uc_info >> 3) & 1, uc_mb = p_rec->uc_info & 7;
+
+	if (ul_rx_frames++)
+		host_run_us((uint64_t)us_between(p_rec->ull_cycles, ull_rx_last));
+	ull_rx_last = p_rec->ull_cycles;
+
+	frame.ul_id = p_rec->ul_id;
+	frame.ul_datal = p_rec->ul_datal;
+	frame.ul_datah = p_rec->ul_datah;
+	frame.uc_length = p_rec->uc_length;
+	frame.uc_info = p_rec->uc_info & REPLAY_INFO_MASK;
+	frame.us_timestamp = p_rec->us_timestamp;
+
+	ul_unhandled = can_rx_stats.ul_unhandled;
+	ul_pdo = can_pdo_stats.ul_frames;
+	decode_can_msg(&frame);
+	ul_unhandled = (can_rx_stats.ul_unhandled != ul_unhandled);
+
+	ul_route = can_route(p_rec->ul_id, uc_mb_bound[uc_ctrl][uc_mb]);
+	if (ul_route == CAN_ROUTE_EXT)
+		ul_ext_dispatch[ul_unhandled][CAN_EXT_TYPE(CAN_MID_TO_EXT_ID(p_rec->ul_id))]++;
+	else if (ul_route == CAN_ROUTE_PDO) {
+		ul_id = CAN_MID_TO_ID(p_rec->ul_id);
+		if (can_pdo_stats.ul_frames != ul_pdo)
+			ul_pdo_dispatch[CAN_ID_SRC(ul_id)][CAN_ID_TYPE(ul_id)]++;
+	}
+	else if (ul_route != CAN_ROUTE_MAILBOX)
+		ul_std_dispatch[ul_unhandled][uc_ctrl][CAN_OPCODE_INDEX(p_rec->ul_datal)]++;
+}
+
+/* Pairs a request or command sent to a node with the node's next reply. */
+static void replay_latency(const rec_t *p_rec)
+{
+	uint32_t ul_id, uc_node;
+
+	if (p_rec->ul_id & CAN_MID_MIDE)
+		return;
+	ul_id = CAN_MID_TO_ID(p_rec->ul_id);
+
+	if (p_rec->uc_info & CAN_CAPTURE_TX) {
+		if ((CAN_ID_TYPE(ul_id) != CAN_TYPE_REQ) && (CAN_ID_TYPE(ul_id) != CAN_TYPE_CMD))
+			return;
+		uc_node = CAN_ID_DST(ul_id);
+		if (uc_req_open[uc_node])
+			ul_unanswered[uc_node]++;
+		ull_req_at[uc_node] = p_rec->ull_cycles;
+		uc_req_class[uc_node] = (uint8_t)CAN_ID_CLASS(ul_id);
+		uc_req_open[uc_node] = 1;
+		return;
+	}
+
+	if (CAN_ID_TYPE(ul_id) != CAN_TYPE_REPLY)
+		return;
+	uc_node = CAN_ID_SRC(ul_id);
+	if (!uc_req_open[uc_node] || (uc_req_class[uc_node] != CAN_ID_CLASS(ul_id)))
+		return;
+	uc_req_open[uc_node] = 0;
+	span_add(&latency[uc_node], us_between(p_rec->ull_cycles, ull_req_at[uc_node]));
+}
+
+static void replay(int list)
+{
+	id_stats_t *p_id;
+	double d_gap, d_mean;
+	uint32_t i, j;
+
+	for (i = 0; i < ul_recs; i++) {
+		if (list)
+			printf("%12.1f %s CAN%u MB%u %c %08X %u %08X %08X bus %5u\n",
+					us_between(recs[i].ull_cycles, recs[0].ull_cycles),
+					(recs[i].uc_info & CAN_CAPTURE_TX) ? "TX" : "RX",
+					(recs[i].uc_info >> 3) & 1, recs[i].uc_info & 7,
+					(recs[i].ul_id & CAN_MID_MIDE) ? 'X' : 'S',
+					(recs[i].ul_id & CAN_MID_MIDE) ? CAN_MID_TO_EXT_ID(recs[i].ul_id) : CAN_MID_TO_ID(recs[i].ul_id),
+					recs[i].uc_length, recs[i].ul_datal, recs[i].ul_datah, recs[i].us_timestamp);
+
+		if (!(recs[i].uc_info & CAN_CAPTURE_TX))
+			replay_dispatch(&recs[i]);
+		replay_latency(&recs[i]);
+
+		p_id = id_entry(&recs[i]);
+		if (!p_id)
+			continue;
+		if (p_id->ul_frames)
+			span_add(&p_id->gap, us_between(recs[i].ull_cycles, p_id->ull_last));
+		else
+			p_id->ull_first = recs[i].ull_cycles;
+		p_id->ull_last = recs[i].ull_cycles;
+		p_id->ul_frames++;
+	}
+
+	/* Second pass: gaps well over the mean of their ID (missed or late frames). */
+	for (j = 0; j < ul_ids; j++) {
+		uint64_t ull_prev = 0;
+		int seen = 0;
+
+		if (ids[j].gap.count < 2)
+			continue;
+		d_mean = ids[j].gap.sum / ids[j].gap.count;
+		for (i = 0; i < ul_recs; i++) {
+			if ((recs[i].ul_id != ids[j].ul_mid) || ((recs[i].uc_info & CAN_CAPTURE_TX) != ids[j].uc_dir))
+				continue;
+			if (seen) {
+				d_gap = us_between(recs[i].ull_cycles, ull_prev);
+				if (d_gap > 2 * d_mean)
+					ids[j].ul_long_gaps++;
+			}
+			ull_prev = recs[i].ull_cycles;
+			seen = 1;
+		}
+	}
+}
+
+/************************************************************************/
+/*				REPORT                                                  */
+/************************************************************************/
+
+static void report(void)
+{
+	double d_span, d_rate;
+	uint32_t i, j;
+
+	d_span = ul_recs ? us_between(recs[ul_recs - 1].ull_cycles, recs[0].ull_cycles) : 0;
+	printf("blocks %u  frames %u  lost %u  span %.3f s  cpu %.1f MHz\n\n",
+			ul_blocks, ul_recs, ul_lost, d_span / 1e6, d_cpu_mhz);
+
+	printf("dir fmt id        class dst src type  frames   rate/s   gap min/mean/max us        long\n");
+	for (i = 0; i < ul_ids; i++) {
+		id_stats_t *p = &ids[i];
+		int ext = (p->ul_mid & CAN_MID_MIDE) != 0;
+		uint32_t id = ext ? CAN_MID_TO_EXT_ID(p->ul_mid) : CAN_MID_TO_ID(p->ul_mid);
+
+		d_rate = (d_span > 0) ? p->ul_frames / (d_span / 1e6) : 0;
+		printf("%s  %s   %08X  ", p->uc_dir ? "TX" : "RX", ext ? "ext" : "std", id);
+		if (ext)
+			printf("  %u    -  %2u  %3u ", id >> 26, CAN_EXT_SRC(id), CAN_EXT_TYPE(id));
+		else
+			printf("  %u    %u   %u   %u  ", CAN_ID_CLASS(id), CAN_ID_DST(id), CAN_ID_SRC(id), CAN_ID_TYPE(id));
+		printf("%7u %8.1f", p->ul_frames, d_rate);
+		if (p->gap.count)
+			printf("   %9.1f %9.1f %9.1f %6u\n", p->gap.min, p->gap.sum / p->gap.count, p->gap.max, p->ul_long_gaps);
+		else
+			printf("\n");
+	}
+	if (ul_ids == MAX_IDS)
+		printf("(more than %u IDs, the rest are not listed)\n", MAX_IDS);
+
+	printf("\nreply latency per node (us)\nnode  count       min      mean       max  unanswered\n");
+	for (i = 0; i < MAX_NODES; i++) {
+		if (!latency[i].count && !ul_unanswered[i] && !uc_req_open[i])
+			continue;
+		printf("%4u %6u", i, latency[i].count);
+		if (latency[i].count)
+			printf(" %9.1f %9.1f %9.1f", latency[i].min, latency[i].sum / latency[i].count, latency[i].max);
+		else
+			printf(" %9s %9s %9s", "-", "-", "-");
+		printf(" %11u\n", ul_unanswered[i] + uc_req_open[i]);
+	}
+
+	printf("\ndispatch (received frames)\n");
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < CANMB_NUMBER; j++) {
+			if (ul_mb_dispatch[i][j])
+				printf("CAN%u MB%u bound handler   %u\n", i, j, ul_mb_dispatch[i][j]);
+		}
+	}
+	for (i = 0; i < 8; i++) {
+		for (j = 0; j < CAN_PDO_PER_NODE; j++) {
+			if (ul_pdo_dispatch[i][j])
+				printf("process data node %u frame %u  %u\n", i, j, ul_pdo_dispatch[i][j]);
+		}
+	}
+	if (can_pdo_stats.ul_unmapped || can_pdo_stats.ul_bad_length)
+		printf("process data dropped     %u unmapped, %u short\n", can_pdo_stats.ul_unmapped,
+				can_pdo_stats.ul_bad_length);
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 256; j++) {
+			if (ul_std_dispatch[0][i][j] || ul_std_dispatch[1][i][j])
+				printf("CAN%u opcode index 0x%02X  %u handled, %u unhandled\n", i, j,
+						ul_std_dispatch[0][i][j], ul_std_dispatch[1][i][j]);
+		}
+	}
+	for (j = 0; j < 256; j++) {
+		if (ul_ext_dispatch[0][j] || ul_ext_dispatch[1][j])
+			printf("extended type %3u        %u handled, %u unhandled\n", j, ul_ext_dispatch[0][j],
+					ul_ext_dispatch[1][j]);
+	}
+	printf("extended sequence gaps   %u\n", can_rx_stats.ul_ext_seq_gaps);
+	printf("unhandled                %u of %u\n", can_rx_stats.ul_unhandled, ul_rx_frames);
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = NULL;
+	FILE *f;
+	unsigned ctrl, mb;
+	int i, list = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-l"))
+			list = 1;
+		else if (!strcmp(argv[i], "-m") && (i + 1 < argc)) {
+			if ((sscanf(argv[++i], "%u.%u", &ctrl, &mb) != 2) || (ctrl > 1) || (mb >= CANMB_NUMBER)) {
+				fprintf(stderr, "-m %s: expected ctrl.mb, e.g. 1.2\n", argv[i]);
+				return 1;
+			}
+			uc_mb_bound[ctrl][mb] = 1;
+		}
+		else
+			name = argv[i];
+	}
+	if (!name) {
+		fprintf(stderr, "usage: %s [-l] [-m ctrl.mb]... capture.bin\n", argv[0]);
+		return 1;
+	}
+
+	f = strcmp(name, "-") ? fopen(name, "rb") : stdin;
+	if (!f) {
+		perror(name);
+		return 1;
+	}
+	read_capture(f);
+	if (f != stdin)
+		fclose(f);
+
+	/* The OBC as it is after can_initialize(), with the -m handlers. */
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+	can_rx_stats.ul_unhandled = 0;
+	for (ctrl = 0; ctrl < 2; ctrl++) {
+		for (mb = 0; mb < CANMB_NUMBER; mb++) {
+			if (uc_mb_bound[ctrl][mb])
+				can_register_mb_handler((uint8_t)ctrl, (uint8_t)mb, replay_mb_handler);
+		}
+	}
+
+	replay(list);
+	report();
+	free(recs);
+	return 0;
+}
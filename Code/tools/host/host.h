@@ -0,0 +1,226 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		host.h
+	*
+	*	PURPOSE:
+	*	Prelude for building the CAN modules of src/ on a Linux host. Every firmware
+	*	source is compiled with  -include host/host.h : the device, ASF and FreeRTOS
+	*	headers are taken from src/ as they are, then the peripherals the CAN code
+	*	touches are pointed at simulated register blocks (host_sim.c) and the
+	*	Cortex-M3 intrinsics are replaced by C.
+	*
+	*	FILE REFERENCES:	can_func.h, task.h, semphr.h, timers.h
+	*
+	*	EXTERNAL VARIABLES:		host_can, host_tc0, host_coredebug, host_dwt_ctrl
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The redefinitions below only reach code which comes after this file, which is
+	*	all of the firmware source but none of the inline functions of the CMSIS and
+	*	ASF headers; the ones the CAN code calls are redefined here by name.
+	*
+	*	NOTES:
+	*	See tools/Makefile for the build. Nothing here is linked into the firmware.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+#include "can_func.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+
+/************************************************************************/
+/*				SIMULATED PERIPHERALS (host_sim.c)                      */
+/************************************************************************/
+
+extern Can host_can[2];
+extern Tc host_tc0;
+extern CoreDebug_Type host_coredebug;
+extern volatile uint32_t host_dwt_ctrl;
+
+#undef CAN0
+#undef CAN1
+#undef TC0
+#undef CoreDebug
+#define CAN0					( &host_can[0] )
+#define CAN1					( &host_can[1] )
+#define TC0						( &host_tc0 )
+#define CoreDebug				( &host_coredebug )
+
+/* The cycle counter follows the simulated time (84 cycles per us) unless a
+*  benchmark switches it to the host time stamp counter. */
+volatile uint32_t *host_cyccnt(void);
+#undef CAN_DWT_CYCCNT
+#undef CAN_DWT_CTRL
+#define CAN_DWT_CYCCNT			( *host_cyccnt() )
+#define CAN_DWT_CTRL			host_dwt_ctrl
+
+void host_nvic_enable(IRQn_Type irq, uint32_t ul_enable);
+#define NVIC_SetPriority(irq, prio)		( ( void )( irq ), ( void )( prio ) )
+#define NVIC_EnableIRQ(irq)				host_nvic_enable(( irq ), 1)
+#define NVIC_DisableIRQ(irq)			host_nvic_enable(( irq ), 0)
+#define NVIC_ClearPendingIRQ(irq)		( ( void )( irq ) )
+
+/* IMR, TCR and ACR are only looked at by the simulation between tasks, so the
+*  driver calls which change them go to the simulation directly. So does
+*  can_mailbox_write(): a mailbox set to TX is ready at once on the target, and
+*  the simulation catches up on the mailbox before the ASF write looks at MRDY.
+*  The ASF can.c itself is built with HOST_ASF and keeps its own. */
+#ifndef HOST_ASF
+void host_can_enable_interrupt(Can *p_can, uint32_t dw_mask);
+void host_can_disable_interrupt(Can *p_can, uint32_t dw_mask);
+void host_can_transfer_cmd(Can *p_can, uint8_t uc_mask);
+void host_can_abort_cmd(Can *p_can, uint8_t uc_mask);
+uint32_t host_can_timer(Can *p_can);
+uint32_t host_can_mailbox_write(Can *p_can, can_mb_conf_t *p_mailbox);
+#define can_enable_interrupt(p_can, mask)			host_can_enable_interrupt(( p_can ), ( mask ))
+#define can_disable_interrupt(p_can, mask)			host_can_disable_interrupt(( p_can ), ( mask ))
+#define can_global_send_transfer_cmd(p_can, mask)	host_can_transfer_cmd(( p_can ), ( mask ))
+#define can_global_send_abort_cmd(p_can, mask)		host_can_abort_cmd(( p_can ), ( mask ))
+#define can_get_internal_timer_value(p_can)			host_can_timer(p_can)
+#define can_mailbox_write(p_can, p_mailbox)			host_can_mailbox_write(( p_can ), ( p_mailbox ))
+#endif
+
+/************************************************************************/
+/*				CORTEX-M3 INTRINSICS                                    */
+/************************************************************************/
+
+static inline uint32_t host_clz(uint32_t ul_value)
+{
+	return ul_value ? (uint32_t)__builtin_clz(ul_value) : 32;
+}
+
+#define __CLZ(x)				host_clz(x)
+#define __DMB()					__sync_synchronize()
+#define __DSB()					__sync_synchronize()
+#define __ISB()					__sync_synchronize()
+
+/* MDL/MDH <-> ul_datal/ul_datah (an LDM/STM pair on the target). */
+#undef CAN_MB_COPY2
+#define CAN_MB_COPY2(p_dst, p_src)	do { ( ( volatile uint32_t * )( p_dst ) )[0] = ( ( volatile uint32_t * )( p_src ) )[0]; \
+										( ( volatile uint32_t * )( p_dst ) )[1] = ( ( volatile uint32_t * )( p_src ) )[1]; } while (0)
+
+/************************************************************************/
+/*				KERNEL (host_rtos.c)                                    */
+/*	Interrupt handlers run between tasks, never inside one, so a yield	*/
+/*	request from an ISR only has to be noted.							*/
+/************************************************************************/
+
+void host_yield_from_isr(BaseType_t xSwitchRequired);
+#undef portEND_SWITCHING_ISR
+#undef portYIELD_FROM_ISR
+#define portEND_SWITCHING_ISR(x)		host_yield_from_isr(x)
+#define portYIELD_FROM_ISR(x)			host_yield_from_isr(x)
+
+/************************************************************************/
+/*				TEST PROGRAM INTERFACE                                  */
+/************************************************************************/
+
+/* host_init() flags. */
+#define HOST_SEPARATE_BUSES		( 1u << 0 )		// CAN0 and CAN1 on two buses (default: one).
+#define HOST_CYCLES_HOST		( 1u << 1 )		// CYCCNT counts host TSC cycles while code runs.
+
+#define HOST_TICK_US			( 1000000UL / configTICK_RATE_HZ )
+#define HOST_BIT_US				4				// 250 kbit/s.
+#define HOST_NODE_NONE			0xFF
+#define HOST_NODES				8
+
+/* A frame on the bus. ul_mid is in CAN_MID format (CAN_MID_MIDvA(id) or the
+*  29-bit ID with CAN_MID_MIDE). */
+typedef struct {
+	uint32_t ul_mid;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	uint8_t uc_length;
+	uint8_t uc_rtr;
+} host_frame_t;
+
+/* Called at the end of every frame on a bus. uc_ctrl is the controller which
+*  sent it, or HOST_NODE_NONE with uc_node the simulated node. */
+typedef void (*host_frame_hook_t)(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node);
+
+typedef struct {
+	uint32_t ul_frames;			/**< Frames completed. */
+	uint64_t ull_busy_us;		/**< Time the bus was busy. */
+	uint32_t ul_lost[2];		/**< Frames a controller matched but had no free mailbox for. */
+	uint32_t ul_overwritten[2];	/**< Frames stored over an unread one (RX_OVERWRITE). */
+	uint32_t ul_unmatched[2];	/**< Frames no mailbox of a controller accepted. */
+	uint32_t ul_node_dropped;	/**< host_node_send() calls refused (node queue full). */
+} host_bus_stats_t;
+
+#define HOST_HIST_STEP			32				// Host cycles per histogram bucket.
+#define HOST_HIST_BUCKETS		256
+
+/* The maximum includes the host's own interrupts; host_irq_percentile()
+*  gives a figure which does not. */
+typedef struct {
+	uint32_t ul_entries;		/**< Interrupt handler entries. */
+	uint64_t ull_cycles;		/**< Host TSC cycles spent in them. */
+	uint32_t ul_max_cycles;
+	uint32_t ul_hist[HOST_HIST_BUCKETS + 1];	/**< Entries by length; the last counts the longer ones. */
+} host_irq_stats_t;
+
+#define HOST_IRQ_CAN0			0
+#define HOST_IRQ_CAN1			1
+#define HOST_IRQ_TC0			2
+#define HOST_IRQ_TC1			3
+
+extern host_bus_stats_t host_bus_stats[2];
+extern host_irq_stats_t host_irq_stats[4];
+
+void host_init(uint32_t ul_flags);
+void host_run_us(uint64_t ull_us);
+uint64_t host_time_us(void);
+void host_set_frame_hook(host_frame_hook_t hook);
+uint32_t host_node_send(uint8_t uc_bus, uint8_t uc_node, const host_frame_t *p_frame, uint64_t ull_at_us);
+uint32_t host_node_queued(uint8_t uc_bus, uint8_t uc_node);
+void host_set_errors(uint8_t uc_ctrl, uint32_t ul_tec, uint32_t ul_rec, uint32_t ul_hold);
+uint32_t host_frame_bits(const host_frame_t *p_frame);
+uint64_t host_tsc(void);
+uint32_t host_irq_percentile(uint32_t ul_irq, uint32_t ul_permille);
+
+/* Test results: HOST_CHECK() prints and counts a failed condition, host_done()
+*  prints the verdict and gives the exit status. */
+extern uint32_t host_failures;
+#define HOST_CHECK(cond)	do { if (!( cond )) { host_failures++; \
+								printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+int host_done(void);
+
+/* Tasks, queues, semaphores and timers created so far: what the firmware would
+*  take from the FreeRTOS heap. */
+extern uint32_t host_rtos_objects;
+
+/* Timer commands still to fail, as with the timer queue full. */
+extern uint32_t host_timer_failures;
+
+/* host_rtos.c, for host_sim.c. */
+#define HOST_IDLE				0
+#define HOST_RAN				1
+#define HOST_SPINNING			2
+
+void host_rtos_reset(void);
+void host_rtos_tick(void);
+void host_rtos_unspin(void);
+void host_rtos_spin(void);
+uint32_t host_rtos_step(void);
+uint32_t host_rtos_in_task(void);
+TickType_t host_rtos_ticks(void);
+void host_isr_enter(void);
+void host_isr_exit(void);
+
+#endif /* HOST_H */
@@ -0,0 +1,544 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		host_rtos.c
+	*
+	*	PURPOSE:
+	*	The part of the FreeRTOS API the CAN modules use, for running them on a Linux
+	*	host: tasks, ticks, binary semaphores, software timers and critical sections.
+	*
+	*	FILE REFERENCES:	host.h, ucontext.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 2 if a task is created past HOST_TASKS or if the test program (which
+	*	is not a task) calls a function that would block.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Single thread. Each task runs on its own stack (ucontext) and gives up the CPU
+	*	only when it blocks, delays, yields or spins on the CAN timer, which is where
+	*	the firmware could be preempted in a way that matters to the CAN code. The
+	*	simulated time only moves between tasks (host_sim.c), so the code of a task
+	*	takes no time.
+	*
+	*	NOTES:
+	*	Timer callbacks run between tasks, as if the timer task (priority
+	*	configTIMER_TASK_PRIORITY) were ready.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define HOST_TASKS				16
+#define HOST_TIMERS				16
+#define HOST_STACK_SIZE			( 256 * 1024 )
+
+#define HOST_READY				0
+#define HOST_BLOCKED			1
+#define HOST_SPIN				2
+
+typedef struct {
+	ucontext_t ctx;
+	TaskFunction_t pxCode;
+	void *pvParameters;
+	const char *pcName;
+	UBaseType_t uxPriority;
+	uint8_t uc_state;
+	uint8_t uc_timed;			/**< The block has a timeout (xWake). */
+	void *pv_wait;				/**< Queue the task waits on. */
+	TickType_t xWake;
+	uint32_t ul_last_run;		/**< Round robin among tasks of one priority. */
+} host_task_t;
+
+typedef struct {
+	UBaseType_t uxLength;
+	UBaseType_t uxItemSize;
+	UBaseType_t uxCount;
+	UBaseType_t uxHead;
+	uint8_t *puc_items;
+} host_queue_t;
+
+typedef struct {
+	TickType_t xPeriod;
+	TickType_t xExpiry;
+	UBaseType_t uxAutoReload;
+	void *pvTimerID;
+	TimerCallbackFunction_t pxCallback;
+	uint8_t uc_active;
+	uint8_t uc_due;				/**< Expiries whose callback has not run yet. */
+} host_timer_t;
+
+static host_task_t host_tasks[HOST_TASKS];
+static host_timer_t host_timers[HOST_TIMERS];
+static uint32_t ul_host_tasks, ul_host_timers, ul_host_runs;
+uint32_t host_rtos_objects;
+static host_task_t *p_host_current;			// NULL: the test program, a timer callback or an ISR.
+static ucontext_t host_main_ctx;
+static TickType_t xHostTick;
+static UBaseType_t uxHostCritical;
+static uint32_t ul_host_isr;
+
+/************************************************************************/
+/*				SCHEDULER (called by host_sim.c)                        */
+/************************************************************************/
+
+static void host_fatal(const char *pc_what)
+{
+	fprintf(stderr, "host: %s\n", pc_what);
+	exit(2);
+}
+
+void host_rtos_reset(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_host_tasks; i++)
+		free(host_tasks[i].ctx.uc_stack.ss_sp);
+	memset(host_tasks, 0, sizeof(host_tasks));
+	memset(host_timers, 0, sizeof(host_timers));
+	ul_host_tasks = 0;
+	ul_host_timers = 0;
+	host_timer_failures = 0;
+	ul_host_runs = 0;
+	xHostTick = 0;
+	uxHostCritical = 0;
+	ul_host_isr = 0;
+}
+
+TickType_t host_rtos_ticks(void)
+{
+	return xHostTick;
+}
+
+uint32_t host_rtos_in_task(void)
+{
+	return (p_host_current != NULL) && !ul_host_isr && !uxHostCritical;
+}
+
+void host_isr_enter(void)
+{
+	ul_host_isr++;
+}
+
+void host_isr_exit(void)
+{
+	ul_host_isr--;
+}
+
+void host_yield_from_isr(BaseType_t xSwitchRequired)
+{
+	(void)xSwitchRequired;				// The woken task runs as soon as the handler returns.
+}
+
+static uint32_t host_tick_reached(TickType_t xWhen)
+{
+	return (TickType_t)(xHostTick - xWhen) < ((TickType_t)1 << 31);
+}
+
+/* One tick: wake the delayed tasks and mark the timers which expire. */
+void host_rtos_tick(void)
+{
+	uint32_t i;
+	host_task_t *p_task;
+	host_timer_t *p_timer;
+
+	xHostTick++;
+
+	for (i = 0; i < ul_host_tasks; i++) {
+		p_task = &host_tasks[i];
+		if ((p_task->uc_state == HOST_BLOCKED) && p_task->uc_timed && host_tick_reached(p_task->xWake)) {
+			p_task->uc_state = HOST_READY;
+			p_task->pv_wait = NULL;
+		}
+	}
+
+	for (i = 0; i < ul_host_timers; i++) {
+		p_timer = &host_timers[i];
+		if (!p_timer->uc_active || !host_tick_reached(p_timer->xExpiry))
+			continue;
+		p_timer->uc_due++;
+		if (p_timer->uxAutoReload)
+			p_timer->xExpiry += p_timer->xPeriod;
+		else
+			p_timer->uc_active = 0;
+	}
+}
+
+/* Tasks spinning on the CAN timer may go on once time has moved. */
+void host_rtos_unspin(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < ul_host_tasks; i++) {
+		if (host_tasks[i].uc_state == HOST_SPIN)
+			host_tasks[i].uc_state = HOST_READY;
+	}
+}
+
+static host_task_t *host_rtos_pick(void)
+{
+	host_task_t *p_best = NULL, *p_task;
+	uint32_t i;
+
+	for (i = 0; i < ul_host_tasks; i++) {
+		p_task = &host_tasks[i];
+		if (p_task->uc_state == HOST_BLOCKED)
+			continue;
+		if (!p_best || (p_task->uxPriority > p_best->uxPriority)
+				|| ((p_task->uxPriority == p_best->uxPriority) && (p_task->ul_last_run < p_best->ul_last_run)))
+			p_best = p_task;
+	}
+	return p_best;
+}
+
+/* Runs the highest priority work that is ready: one timer callback or one task
+*  until it blocks. Returns HOST_RAN, HOST_IDLE or HOST_SPINNING (the most urgent
+*  task waits for time to pass). */
+uint32_t host_rtos_step(void)
+{
+	host_task_t *p_task;
+	host_timer_t *p_timer;
+	uint32_t i;
+
+	p_task = host_rtos_pick();
+
+	if (!p_task || (p_task->uxPriority <= configTIMER_TASK_PRIORITY)) {
+		for (i = 0; i < ul_host_timers; i++) {
+			p_timer = &host_timers[i];
+			if (p_timer->uc_due) {
+				p_timer->uc_due--;
+				p_timer->pxCallback((TimerHandle_t)p_timer);
+				return HOST_RAN;
+			}
+		}
+	}
+
+	if (!p_task)
+		return HOST_IDLE;
+	if (p_task->uc_state == HOST_SPIN)
+		return HOST_SPINNING;
+
+	p_task->ul_last_run = ++ul_host_runs;
+	p_host_current = p_task;
+	swapcontext(&host_main_ctx, &p_task->ctx);
+	p_host_current = NULL;
+	return HOST_RAN;
+}
+
+/* Back to the scheduler; the task resumes when it is picked again. */
+static void host_switch_out(uint8_t uc_state)
+{
+	host_task_t *p_task = p_host_current;
+
+	if (!p_task || ul_host_isr)
+		host_fatal("blocking call outside a task");
+	p_task->uc_state = uc_state;
+	swapcontext(&p_task->ctx, &host_main_ctx);
+}
+
+void host_rtos_spin(void)
+{
+	host_switch_out(HOST_SPIN);
+}
+
+/* Blocks on a queue (NULL: only the timeout) for xTicks ticks. Returns 1 if the
+*  queue woke the task. */
+static uint32_t host_block(void *pv_wait, TickType_t xTicks)
+{
+	host_task_t *p_task = p_host_current;
+
+	if (!p_task || ul_host_isr)
+		host_fatal("blocking call outside a task");
+	p_task->pv_wait = pv_wait;
+	p_task->uc_timed = (xTicks != portMAX_DELAY);
+	p_task->xWake = xHostTick + xTicks;
+	host_switch_out(HOST_BLOCKED);
+	return p_task->pv_wait == pv_wait;
+}
+
+static void host_task_entry(void)
+{
+	host_task_t *p_task = p_host_current;
+
+	p_task->pxCode(p_task->pvParameters);
+	host_fatal("a task returned");
+}
+
+/************************************************************************/
+/*				TASKS                                                   */
+/************************************************************************/
+
+BaseType_t xTaskGenericCreate(TaskFunction_t pxTaskCode, const char * const pcName, const uint16_t usStackDepth,
+		void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask,
+		StackType_t * const puxStackBuffer, const MemoryRegion_t * const xRegions)
+{
+	host_task_t *p_task;
+
+	(void)usStackDepth;
+	(void)puxStackBuffer;
+	(void)xRegions;
+	if (ul_host_tasks >= HOST_TASKS)
+		host_fatal("too many tasks");
+
+	p_task = &host_tasks[ul_host_tasks++];
+	host_rtos_objects++;
+	memset(p_task, 0, sizeof(*p_task));
+	p_task->pxCode = pxTaskCode;
+	p_task->pvParameters = pvParameters;
+	p_task->pcName = pcName;
+	p_task->uxPriority = uxPriority;
+	p_task->uc_state = HOST_READY;
+
+	getcontext(&p_task->ctx);
+	p_task->ctx.uc_stack.ss_sp = malloc(HOST_STACK_SIZE);
+	p_task->ctx.uc_stack.ss_size = HOST_STACK_SIZE;
+	p_task->ctx.uc_link = NULL;
+	makecontext(&p_task->ctx, host_task_entry, 0);
+
+	if (pxCreatedTask)
+		*pxCreatedTask = (TaskHandle_t)p_task;
+	return pdPASS;
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+	if (!xTicksToDelay) {
+		host_switch_out(HOST_READY);
+		return;
+	}
+	host_block(NULL, xTicksToDelay);
+}
+
+void vTaskDelayUntil(TickType_t * const pxPreviousWakeTime, const TickType_t xTimeIncrement)
+{
+	TickType_t xWake = *pxPreviousWakeTime + xTimeIncrement;
+
+	*pxPreviousWakeTime = xWake;
+	if (!host_tick_reached(xWake))
+		host_block(NULL, xWake - xHostTick);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return xHostTick;
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+	return xHostTick;
+}
+
+/************************************************************************/
+/*				QUEUES AND SEMAPHORES                                   */
+/************************************************************************/
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+	host_queue_t *p_queue;
+
+	(void)ucQueueType;
+	host_rtos_objects++;
+	p_queue = calloc(1, sizeof(host_queue_t));
+	p_queue->uxLength = uxQueueLength;
+	p_queue->uxItemSize = uxItemSize;
+	p_queue->puc_items = calloc(uxQueueLength ? uxQueueLength : 1, uxItemSize ? uxItemSize : 1);
+	return (QueueHandle_t)p_queue;
+}
+
+/* Wakes the most urgent task waiting on the queue. */
+static void host_queue_wake(host_queue_t *p_queue)
+{
+	host_task_t *p_best = NULL, *p_task;
+	uint32_t i;
+
+	for (i = 0; i < ul_host_tasks; i++) {
+		p_task = &host_tasks[i];
+		if ((p_task->uc_state == HOST_BLOCKED) && (p_task->pv_wait == p_queue)
+				&& (!p_best || (p_task->uxPriority > p_best->uxPriority)))
+			p_best = p_task;
+	}
+	if (p_best)
+		p_best->uc_state = HOST_READY;
+}
+
+static BaseType_t host_queue_put(host_queue_t *p_queue, const void * const pvItemToQueue)
+{
+	UBaseType_t uxSlot;
+
+	if (p_queue->uxCount >= p_queue->uxLength)
+		return errQUEUE_FULL;
+	uxSlot = (p_queue->uxHead + p_queue->uxCount) % p_queue->uxLength;
+	if (p_queue->uxItemSize)
+		memcpy(&p_queue->puc_items[uxSlot * p_queue->uxItemSize], pvItemToQueue, p_queue->uxItemSize);
+	p_queue->uxCount++;
+	host_queue_wake(p_queue);
+	return pdPASS;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition)
+{
+	host_queue_t *p_queue = (host_queue_t *)xQueue;
+
+	(void)xCopyPosition;
+	while (host_queue_put(p_queue, pvItemToQueue) != pdPASS) {
+		if (!xTicksToWait || !host_block(p_queue, xTicksToWait))
+			return errQUEUE_FULL;
+	}
+	return pdPASS;
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void * const pvItemToQueue, BaseType_t * const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition)
+{
+	(void)xCopyPosition;
+	if (host_queue_put((host_queue_t *)xQueue, pvItemToQueue) != pdPASS)
+		return errQUEUE_FULL;
+	if (pxHigherPriorityTaskWoken)
+		*pxHigherPriorityTaskWoken = pdTRUE;
+	return pdPASS;
+}
+
+BaseType_t xQueueGenericReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait, const BaseType_t xJustPeeking)
+{
+	host_queue_t *p_queue = (host_queue_t *)xQueue;
+	TickType_t xDeadline = xHostTick + xTicksToWait;
+
+	for (;;) {
+		if (p_queue->uxCount) {
+			if (p_queue->uxItemSize && pvBuffer)
+				memcpy(pvBuffer, &p_queue->puc_items[p_queue->uxHead * p_queue->uxItemSize], p_queue->uxItemSize);
+			if (!xJustPeeking) {
+				p_queue->uxHead = (p_queue->uxHead + 1) % p_queue->uxLength;
+				p_queue->uxCount--;
+			}
+			return pdPASS;
+		}
+		if (!xTicksToWait)
+			return errQUEUE_EMPTY;
+		if (xTicksToWait == portMAX_DELAY)
+			host_block(p_queue, portMAX_DELAY);
+		else if (host_tick_reached(xDeadline) || !host_block(p_queue, xDeadline - xHostTick))
+			return p_queue->uxCount ? pdPASS : errQUEUE_EMPTY;
+	}
+}
+
+/************************************************************************/
+/*				SOFTWARE TIMERS                                         */
+/************************************************************************/
+
+TimerHandle_t xTimerCreate(const char * const pcTimerName, const TickType_t xTimerPeriodInTicks, const UBaseType_t uxAutoReload,
+		void * const pvTimerID, TimerCallbackFunction_t pxCallbackFunction)
+{
+	host_timer_t *p_timer;
+
+	(void)pcTimerName;
+	if ((ul_host_timers >= HOST_TIMERS) || !xTimerPeriodInTicks)
+		return NULL;
+	p_timer = &host_timers[ul_host_timers++];
+	host_rtos_objects++;
+	memset(p_timer, 0, sizeof(*p_timer));
+	p_timer->xPeriod = xTimerPeriodInTicks;
+	p_timer->uxAutoReload = uxAutoReload;
+	p_timer->pvTimerID = pvTimerID;
+	p_timer->pxCallback = pxCallbackFunction;
+	return (TimerHandle_t)p_timer;
+}
+
+void *pvTimerGetTimerID(const TimerHandle_t xTimer)
+{
+	return ((host_timer_t *)xTimer)->pvTimerID;
+}
+
+/* The commands act at once rather than through the timer queue. The next
+*  host_timer_failures of them fail, as they would with the queue full. */
+uint32_t host_timer_failures;
+
+BaseType_t xTimerGenericCommand(TimerHandle_t xTimer, const BaseType_t xCommandID, const TickType_t xOptionalValue,
+		BaseType_t * const pxHigherPriorityTaskWoken, const TickType_t xTicksToWait)
+{
+	host_timer_t *p_timer = (host_timer_t *)xTimer;
+
+	(void)xTicksToWait;
+	if (!p_timer)
+		return pdFAIL;
+	if (host_timer_failures) {
+		host_timer_failures--;
+		return pdFAIL;
+	}
+	if (pxHigherPriorityTaskWoken)
+		*pxHigherPriorityTaskWoken = pdFALSE;
+
+	switch (xCommandID) {
+	case tmrCOMMAND_START:
+	case tmrCOMMAND_RESET:
+	case tmrCOMMAND_START_FROM_ISR:
+	case tmrCOMMAND_RESET_FROM_ISR:
+		p_timer->uc_active = 1;
+		p_timer->xExpiry = xHostTick + p_timer->xPeriod;
+		break;
+	case tmrCOMMAND_CHANGE_PERIOD:
+	case tmrCOMMAND_CHANGE_PERIOD_FROM_ISR:
+		if (!xOptionalValue)
+			return pdFAIL;
+		p_timer->xPeriod = xOptionalValue;
+		p_timer->uc_active = 1;
+		p_timer->xExpiry = xHostTick + p_timer->xPeriod;
+		break;
+	case tmrCOMMAND_STOP:
+	case tmrCOMMAND_STOP_FROM_ISR:
+	case tmrCOMMAND_DELETE:
+		p_timer->uc_active = 0;
+		break;
+	default:
+		return pdFAIL;
+	}
+	return pdPASS;
+}
+
+/************************************************************************/
+/*				CRITICAL SECTIONS                                       */
+/*	Nothing can interrupt a task here; the nesting only tells			*/
+/*	host_can_timer() not to let time pass.								*/
+/************************************************************************/
+
+void vPortEnterCritical(void)
+{
+	uxHostCritical++;
+}
+
+void vPortExitCritical(void)
+{
+	uxHostCritical--;
+}
+
+uint32_t ulPortSetInterruptMask(void)
+{
+	uxHostCritical++;
+	return 0;
+}
+
+void vPortClearInterruptMask(uint32_t ulNewMaskValue)
+{
+	(void)ulNewMaskValue;
+	uxHostCritical--;
+}
+
+void vPortYield(void)
+{
+	if (p_host_current && !ul_host_isr)
+		host_switch_out(HOST_READY);
+}
@@ -0,0 +1,938 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		host_sim.c
+	*
+	*	PURPOSE:
+	*	Simulated CAN controllers, CAN bus, TC0 and cycle counter for running the CAN
+	*	modules of src/ on a Linux host, and the loop which moves the simulated time.
+	*
+	*	FILE REFERENCES:	host.h
+	*
+	*	EXTERNAL VARIABLES:		host_can, host_tc0, host_coredebug, host_dwt_ctrl,
+	*							host_bus_stats, host_irq_stats
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES: None.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	250 kbit/s, no bit stuffing, no error frames: a standard frame takes
+	*	47 + 8 * DLC bits and an extended one 67 + 8 * DLC (including the interframe
+	*	space). Producer mailboxes are not simulated. In Time Triggered Mode a
+	*	transmit mailbox is offered from its timemark on, once the bus is idle, and
+	*	aborted (MABT) if it loses arbitration; CAN_TIM counts from the last TIMRST
+	*	and sets TOVF when it wraps.
+	*	Interrupt handlers run only between tasks and take no simulated time.
+	*
+	*	NOTES:
+	*	The registers are plain memory which the firmware reads and writes as it does
+	*	on the target. host_sync() brings them up to date between tasks and handlers:
+	*	a written MCR is acted on and set back to HOST_MCR_IDLE, a changed MMR.MOT
+	*	resets the mailbox, and SR, ECR and TIM are recomputed.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					TC0 channel 1 (TC1_Handler) is simulated as well, and TC_CMR_CPCSTOP
+	*					stops a channel at its RC compare.
+	*
+	*					Time Triggered Mode, TIMRST and TOVF of the CAN timer.
+	*
+	*					can_mailbox_write() syncs its mailbox first, so a mailbox set to TX
+	*					is ready at once, as on the target.
+	*
+	*	DESCRIPTION:
+	*
+	*	host_run_us() repeats: run every handler whose interrupt is pending and
+	*	enabled, start the next frame on an idle bus, run the tasks until they all
+	*	block, then move the time to the next event (end of a frame, a node's frame
+	*	becoming ready, a tick, a TC0 channel 0 or 1 compare).
+	*
+	*	Arbitration compares the identifier bits as they go on the wire. A controller
+	*	offers its transmit mailbox of lowest MMR.PRIOR (then lowest number), a
+	*	simulated node the oldest frame in its queue. At the end of a frame every other
+	*	controller on the bus stores it in its first free matching reception mailbox,
+	*	or overwrites the last matching RX_OVERWRITE one, or loses it.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define HOST_MCR_IDLE			0x1u			// No command written since the last sync.
+#define HOST_CYCLES_PER_US		84
+#define HOST_NODE_QUEUE			256
+#define HOST_IRQ_REPEAT			16				// Handler calls per controller and sync.
+#define HOST_BOFF_RECOVERY_US	( 128UL * 11 * HOST_BIT_US )
+
+#define CAN_MSR_MDLC(n)			( ( ( uint32_t )( n ) << CAN_MSR_MDLC_Pos ) & CAN_MSR_MDLC_Msk )
+#define CAN_MSR_MTIMESTAMP(t)	( ( ( uint32_t )( t ) << CAN_MSR_MTIMESTAMP_Pos ) & CAN_MSR_MTIMESTAMP_Msk )
+#define CAN_ECR_REC(n)			( ( ( uint32_t )( n ) << CAN_ECR_REC_Pos ) & CAN_ECR_REC_Msk )
+#define CAN_ECR_TEC(n)			( ( ( uint32_t )( n ) << CAN_ECR_TEC_Pos ) & CAN_ECR_TEC_Msk )
+
+Can host_can[2];
+Tc host_tc0;
+CoreDebug_Type host_coredebug;
+volatile uint32_t host_dwt_ctrl;
+host_bus_stats_t host_bus_stats[2];
+host_irq_stats_t host_irq_stats[4];
+uint32_t host_failures;
+
+extern void TC0_Handler(void) __attribute__((weak));
+extern void TC1_Handler(void) __attribute__((weak));
+
+typedef struct {
+	uint32_t ul_mot;			/**< MMR.MOT seen at the last sync. */
+	uint8_t uc_tx;				/**< Waiting to send. */
+	uint8_t uc_rtr;				/**< Send a remote frame. */
+	uint8_t uc_dlc;
+	uint8_t uc_wait;			/**< Consumer: remote frame sent, waiting for the data. */
+	uint64_t ull_release;		/**< Time Triggered Mode: not sent before (the timemark). */
+} host_mb_t;
+
+typedef struct {
+	host_frame_t frame;
+	uint64_t ull_at;
+} host_node_frame_t;
+
+typedef struct {
+	uint8_t uc_busy;
+	uint8_t uc_ctrl;			/**< Sender, or HOST_NODE_NONE. */
+	uint8_t uc_node;
+	uint8_t uc_mb;
+	uint64_t ull_end;
+	host_frame_t frame;
+	host_node_frame_t node[HOST_NODES][HOST_NODE_QUEUE];
+	uint16_t us_head[HOST_NODES];
+	uint16_t us_count[HOST_NODES];
+} host_bus_t;
+
+static host_mb_t host_mb[2][CANMB_NUMBER];
+static host_bus_t host_bus[2];
+static uint8_t uc_host_bus_of[2];
+static uint32_t ul_host_flags;
+static uint64_t ull_host_now, ull_host_next_tick;
+static uint32_t ul_host_tec[2], ul_host_rec[2], ul_host_err_hold[2];
+static uint64_t ull_host_boff_at[2];
+static uint64_t ull_host_nvic;
+static uint32_t ul_host_tovf[2];
+static uint64_t ull_host_tim_base[2], ull_host_tim_wraps[2];
+static uint32_t ul_host_tc_running[2], ul_host_tc_pending[2];	// TC0 channels 0 and 1.
+static uint64_t ull_host_tc_next[2];
+static host_frame_hook_t host_frame_hook;
+
+/* Cycle counter. */
+static volatile uint32_t ul_host_cyccnt;
+static uint32_t ul_host_cyc_base;
+static uint64_t ull_host_cyc_tsc;
+
+/************************************************************************/
+/*				TIME AND CYCLE COUNTER                                  */
+/************************************************************************/
+
+uint64_t host_tsc(void)
+{
+	uint32_t ul_lo, ul_hi;
+
+	__asm__ volatile ("rdtsc" : "=a" (ul_lo), "=d" (ul_hi));
+	return ((uint64_t)ul_hi << 32) | ul_lo;
+}
+
+uint64_t host_time_us(void)
+{
+	return ull_host_now;
+}
+
+/* 84 cycles per simulated us. With HOST_CYCLES_HOST the host cycles spent
+*  since the time last moved are added, so that the code between two reads
+*  is measured; the value never goes back. */
+volatile uint32_t *host_cyccnt(void)
+{
+	if (ul_host_flags & HOST_CYCLES_HOST)
+		ul_host_cyccnt = ul_host_cyc_base + (uint32_t)(host_tsc() - ull_host_cyc_tsc);
+	else
+		ul_host_cyccnt = (uint32_t)(ull_host_now * HOST_CYCLES_PER_US);
+	return &ul_host_cyccnt;
+}
+
+static void host_set_time(uint64_t ull_us)
+{
+	uint32_t ul_sim;
+
+	ull_host_now = ull_us;
+	if (ul_host_flags & HOST_CYCLES_HOST) {
+		ul_sim = (uint32_t)(ull_us * HOST_CYCLES_PER_US);
+		ul_host_cyc_base = *host_cyccnt();
+		if ((int32_t)(ul_sim - ul_host_cyc_base) > 0)
+			ul_host_cyc_base = ul_sim;
+		ull_host_cyc_tsc = host_tsc();
+	}
+}
+
+#define HOST_TIM_WRAP_US		( 65536ULL * HOST_BIT_US )
+
+/* CAN_TIM of controller uc_ctrl, which counts from its last TIMRST. */
+static uint16_t host_can_tim(uint8_t uc_ctrl)
+{
+	return (uint16_t)((ull_host_now - ull_host_tim_base[uc_ctrl]) / HOST_BIT_US);
+}
+
+/************************************************************************/
+/*				DRIVER HOOKS (see host.h)                               */
+/************************************************************************/
+
+static uint8_t host_ctrl_of(Can *p_can)
+{
+	return (p_can == &host_can[1]) ? 1 : 0;
+}
+
+void host_can_enable_interrupt(Can *p_can, uint32_t dw_mask)
+{
+	*(volatile uint32_t *)&p_can->CAN_IMR |= dw_mask;
+}
+
+void host_can_disable_interrupt(Can *p_can, uint32_t dw_mask)
+{
+	*(volatile uint32_t *)&p_can->CAN_IMR &= ~dw_mask;
+}
+
+static void host_mb_command(uint8_t uc_ctrl, uint8_t uc_mb, uint32_t ul_mcr);
+static void host_mb_sync(uint8_t uc_ctrl, uint8_t uc_mb);
+
+void host_can_transfer_cmd(Can *p_can, uint8_t uc_mask)
+{
+	uint8_t i;
+
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		if (uc_mask & (1u << i)) {
+			host_mb_sync(host_ctrl_of(p_can), i);
+			host_mb_command(host_ctrl_of(p_can), i, CAN_MCR_MTCR | HOST_MCR_IDLE);
+		}
+	}
+}
+
+void host_can_abort_cmd(Can *p_can, uint8_t uc_mask)
+{
+	uint8_t i;
+
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		if (uc_mask & (1u << i)) {
+			host_mb_sync(host_ctrl_of(p_can), i);
+			host_mb_command(host_ctrl_of(p_can), i, CAN_MCR_MACR | HOST_MCR_IDLE);
+		}
+	}
+}
+
+#undef can_mailbox_write
+
+uint32_t host_can_mailbox_write(Can *p_can, can_mb_conf_t *p_mailbox)
+{
+	host_mb_sync(host_ctrl_of(p_can), (uint8_t)p_mailbox->ul_mb_idx);
+	return can_mailbox_write(p_can, p_mailbox);
+}
+
+/* A task reading the timer in a loop is spinning: let 4 us pass. */
+uint32_t host_can_timer(Can *p_can)
+{
+	if (host_rtos_in_task())
+		host_rtos_spin();
+	return host_can_tim(host_ctrl_of(p_can));
+}
+
+void host_nvic_enable(IRQn_Type irq, uint32_t ul_enable)
+{
+	if (ul_enable)
+		ull_host_nvic |= (1ULL << irq);
+	else
+		ull_host_nvic &= ~(1ULL << irq);
+}
+
+/************************************************************************/
+/*				MAILBOXES                                               */
+/************************************************************************/
+
+static uint32_t host_mb_on_bus(uint8_t uc_ctrl, uint8_t uc_mb)
+{
+	host_bus_t *p_bus = &host_bus[uc_host_bus_of[uc_ctrl]];
+
+	return p_bus->uc_busy && (p_bus->uc_ctrl == uc_ctrl) && (p_bus->uc_mb == uc_mb);
+}
+
+static void host_mb_command(uint8_t uc_ctrl, uint8_t uc_mb, uint32_t ul_mcr)
+{
+	CanMb *p_mb = &host_can[uc_ctrl].CAN_MB[uc_mb];
+	host_mb_t *p_sim = &host_mb[uc_ctrl][uc_mb];
+	volatile uint32_t *p_msr = (volatile uint32_t *)&p_mb->CAN_MSR;
+	uint32_t ul_mot = p_mb->CAN_MMR & CAN_MMR_MOT_Msk;
+
+	/* MCR |= MTCR on the idle value keeps the DLC written before. */
+	if (!(ul_mcr & HOST_MCR_IDLE))
+		p_sim->uc_dlc = (uint8_t)((ul_mcr & CAN_MCR_MDLC_Msk) >> CAN_MCR_MDLC_Pos);
+
+	if (ul_mcr & CAN_MCR_MACR) {
+		if (p_sim->uc_tx && !host_mb_on_bus(uc_ctrl, uc_mb)) {
+			p_sim->uc_tx = 0;
+			if (ul_mot == CAN_MMR_MOT_MB_TX)
+				*p_msr |= CAN_MSR_MABT | CAN_MSR_MRDY;
+		}
+		if (ul_mot == CAN_MMR_MOT_MB_CONSUMER) {
+			p_sim->uc_wait = 0;
+			*p_msr &= ~(CAN_MSR_MRDY | CAN_MSR_MMI);
+		}
+	}
+
+	if (ul_mcr & CAN_MCR_MTCR) {
+		switch (ul_mot) {
+		case CAN_MMR_MOT_MB_TX:
+			*p_msr = CAN_MSR_MDLC(p_sim->uc_dlc);
+			p_sim->uc_tx = 1;
+			p_sim->uc_rtr = (ul_mcr & CAN_MCR_MRTR) ? 1 : 0;
+			p_sim->ull_release = 0;
+			if (host_can[uc_ctrl].CAN_MR & CAN_MR_TTM) {
+				/* The next time the timer equals the timemark. */
+				p_sim->ull_release = ull_host_tim_base[uc_ctrl]
+						+ (ull_host_now - ull_host_tim_base[uc_ctrl]) / HOST_TIM_WRAP_US * HOST_TIM_WRAP_US
+						+ (uint64_t)((p_mb->CAN_MMR & CAN_MMR_MTIMEMARK_Msk) >> CAN_MMR_MTIMEMARK_Pos) * HOST_BIT_US;
+				if (p_sim->ull_release < ull_host_now)
+					p_sim->ull_release += HOST_TIM_WRAP_US;
+			}
+			break;
+		case CAN_MMR_MOT_MB_RX:
+		case CAN_MMR_MOT_MB_RX_OVERWRITE:
+			*p_msr = 0;
+			break;
+		case CAN_MMR_MOT_MB_CONSUMER:
+			*p_msr = 0;
+			p_sim->uc_tx = 1;
+			p_sim->uc_rtr = 1;
+			p_sim->uc_wait = 1;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* Acts on a changed MMR.MOT and a written MCR. */
+static void host_mb_sync(uint8_t uc_ctrl, uint8_t uc_mb)
+{
+	CanMb *p_mb = &host_can[uc_ctrl].CAN_MB[uc_mb];
+	host_mb_t *p_sim = &host_mb[uc_ctrl][uc_mb];
+	uint32_t ul_mot, ul_mcr;
+
+	ul_mot = p_mb->CAN_MMR & CAN_MMR_MOT_Msk;
+	if (ul_mot != p_sim->ul_mot) {
+		p_sim->ul_mot = ul_mot;
+		p_sim->uc_tx = 0;
+		p_sim->uc_wait = 0;
+		*(volatile uint32_t *)&p_mb->CAN_MSR = (ul_mot == CAN_MMR_MOT_MB_TX) ? CAN_MSR_MRDY : 0;
+	}
+
+	ul_mcr = p_mb->CAN_MCR;
+	if (ul_mcr != HOST_MCR_IDLE) {
+		p_mb->CAN_MCR = HOST_MCR_IDLE;
+		host_mb_command(uc_ctrl, uc_mb, ul_mcr);
+	}
+}
+
+/* Brings the registers up to date with what the firmware wrote. */
+static void host_sync(void)
+{
+	Can *p_can;
+	uint32_t ul_sr, ul_tec, ul_rec;
+	uint8_t c, i;
+	TcChannel *p_tc;
+
+	for (c = 0; c < 2; c++) {
+		p_can = &host_can[c];
+
+		for (i = 0; i < CANMB_NUMBER; i++)
+			host_mb_sync(c, i);
+
+		if (p_can->CAN_TCR & CAN_TCR_TIMRST) {
+			p_can->CAN_TCR = 0;
+			ull_host_tim_base[c] = ull_host_now;
+			ull_host_tim_wraps[c] = 0;
+		}
+		if ((ull_host_now - ull_host_tim_base[c]) / HOST_TIM_WRAP_US != ull_host_tim_wraps[c]) {
+			ull_host_tim_wraps[c] = (ull_host_now - ull_host_tim_base[c]) / HOST_TIM_WRAP_US;
+			ul_host_tovf[c] = 1;
+		}
+
+		ul_tec = ul_host_tec[c];
+		ul_rec = ul_host_rec[c];
+		ul_sr = 0;
+		for (i = 0; i < CANMB_NUMBER; i++) {
+			if ((host_mb[c][i].ul_mot != CAN_MMR_MOT_MB_DISABLED) && (p_can->CAN_MB[i].CAN_MSR & CAN_MSR_MRDY))
+				ul_sr |= (1u << i);
+		}
+		if (ul_tec >= 256)
+			ul_sr |= CAN_SR_BOFF;
+		else if ((ul_tec >= 128) || (ul_rec >= 128))
+			ul_sr |= CAN_SR_ERRP;
+		else
+			ul_sr |= CAN_SR_ERRA;
+		if ((ul_tec >= 96) || (ul_rec >= 96))
+			ul_sr |= CAN_SR_WARN;
+		if (p_can->CAN_MR & CAN_MR_CANEN)
+			ul_sr |= CAN_SR_WAKEUP;
+		if (ul_host_tovf[c])
+			ul_sr |= CAN_SR_TOVF;
+		*(volatile uint32_t *)&p_can->CAN_SR = ul_sr;
+		*(volatile uint32_t *)&p_can->CAN_ECR = CAN_ECR_REC(ul_rec > 255 ? 255 : ul_rec)
+				| CAN_ECR_TEC(ul_tec > 255 ? 255 : ul_tec);
+		*(volatile uint32_t *)&p_can->CAN_TIM = host_can_tim(c);
+	}
+
+	/* TC0 channels 0 and 1: CCR, IDR and IER are write-only. */
+	for (c = 0; c < 2; c++) {
+		p_tc = &host_tc0.TC_CHANNEL[c];
+		if (p_tc->TC_CCR) {
+			if (p_tc->TC_CCR & TC_CCR_CLKDIS)
+				ul_host_tc_running[c] = 0;
+			else if (p_tc->TC_CCR & TC_CCR_CLKEN) {
+				ul_host_tc_running[c] = 1;
+				ull_host_tc_next[c] = ull_host_now + (p_tc->TC_RC ? p_tc->TC_RC : 1) / 42;
+			}
+			p_tc->TC_CCR = 0;
+		}
+		if (p_tc->TC_IDR) {
+			*(volatile uint32_t *)&p_tc->TC_IMR &= ~p_tc->TC_IDR;
+			p_tc->TC_IDR = 0;
+		}
+		if (p_tc->TC_IER) {
+			*(volatile uint32_t *)&p_tc->TC_IMR |= p_tc->TC_IER;
+			p_tc->TC_IER = 0;
+		}
+		*(volatile uint32_t *)&p_tc->TC_CV = (ul_host_tc_running[c] && (ull_host_tc_next[c] > ull_host_now))
+				? p_tc->TC_RC - (uint32_t)(ull_host_tc_next[c] - ull_host_now) * 42 : 0;
+	}
+}
+
+/************************************************************************/
+/*				INTERRUPTS                                              */
+/************************************************************************/
+
+static void host_call_irq(uint32_t ul_irq, void (*handler)(void))
+{
+	uint64_t ull_start, ull_cycles;
+
+	host_isr_enter();
+	ull_start = host_tsc();
+	handler();
+	ull_cycles = host_tsc() - ull_start;
+	host_isr_exit();
+
+	host_irq_stats[ul_irq].ul_entries++;
+	host_irq_stats[ul_irq].ull_cycles += ull_cycles;
+	if (ull_cycles > host_irq_stats[ul_irq].ul_max_cycles)
+		host_irq_stats[ul_irq].ul_max_cycles = (uint32_t)ull_cycles;
+	host_irq_stats[ul_irq].ul_hist[(ull_cycles / HOST_HIST_STEP < HOST_HIST_BUCKETS)
+			? ull_cycles / HOST_HIST_STEP : HOST_HIST_BUCKETS]++;
+	host_sync();
+}
+
+/* Upper bound of the handler length (host cycles) not exceeded by ul_permille
+*  thousandths of the entries. */
+uint32_t host_irq_percentile(uint32_t ul_irq, uint32_t ul_permille)
+{
+	host_irq_stats_t *p_stats = &host_irq_stats[ul_irq];
+	uint64_t ull_need = ((uint64_t)p_stats->ul_entries * ul_permille + 999) / 1000, ull_seen = 0;
+	uint32_t i;
+
+	for (i = 0; i < HOST_HIST_BUCKETS; i++) {
+		ull_seen += p_stats->ul_hist[i];
+		if (ull_seen >= ull_need)
+			return (i + 1) * HOST_HIST_STEP;
+	}
+	return p_stats->ul_max_cycles;
+}
+
+static void host_interrupts(void)
+{
+	static void (* const handlers[2])(void) = { CAN0_Handler, CAN1_Handler };
+	static const IRQn_Type irqs[2] = { CAN0_IRQn, CAN1_IRQn };
+	static void (* const tc_handlers[2])(void) = { TC0_Handler, TC1_Handler };
+	static const IRQn_Type tc_irqs[2] = { TC0_IRQn, TC1_IRQn };
+	uint32_t n;
+	uint8_t c;
+
+	host_sync();
+	for (c = 0; c < 2; c++) {
+		for (n = 0; n < HOST_IRQ_REPEAT; n++) {
+			if (!(ull_host_nvic & (1ULL << irqs[c])) || !(host_can[c].CAN_SR & host_can[c].CAN_IMR))
+				break;
+			host_call_irq(c, handlers[c]);
+			ul_host_tovf[c] = 0;				// Cleared by the read of SR.
+			host_sync();
+		}
+	}
+
+	for (c = 0; c < 2; c++) {
+		if (ul_host_tc_pending[c] && tc_handlers[c] && (ull_host_nvic & (1ULL << tc_irqs[c]))
+				&& (host_tc0.TC_CHANNEL[c].TC_IMR & TC_IMR_CPCS)) {
+			ul_host_tc_pending[c] = 0;
+			host_call_irq(HOST_IRQ_TC0 + c, tc_handlers[c]);
+		}
+	}
+}
+
+/************************************************************************/
+/*				BUS                                                     */
+/************************************************************************/
+
+uint32_t host_frame_bits(const host_frame_t *p_frame)
+{
+	uint32_t ul_bits = (p_frame->ul_mid & CAN_MID_MIDE) ? 67 : 47;
+
+	if (!p_frame->uc_rtr)
+		ul_bits += 8 * p_frame->uc_length;
+	return ul_bits;
+}
+
+/* The identifier bits in the order they go on the wire; lower wins. */
+static uint64_t host_arb_key(const host_frame_t *p_frame)
+{
+	uint32_t ul_mid = p_frame->ul_mid;
+
+	if (ul_mid & CAN_MID_MIDE)
+		return ((uint64_t)((ul_mid >> 18) & 0x7FF) << 21) | (1u << 20) | (1u << 19)
+				| ((ul_mid & 0x3FFFF) << 1) | p_frame->uc_rtr;
+	return ((uint64_t)((ul_mid >> 18) & 0x7FF) << 21) | ((uint32_t)p_frame->uc_rtr << 20);
+}
+
+static uint32_t host_ctrl_active(uint8_t uc_ctrl)
+{
+	return (host_can[uc_ctrl].CAN_MR & CAN_MR_CANEN) && (ul_host_tec[uc_ctrl] < 256);
+}
+
+static void host_mb_frame(uint8_t uc_ctrl, uint8_t uc_mb, host_frame_t *p_frame)
+{
+	CanMb *p_mb = &host_can[uc_ctrl].CAN_MB[uc_mb];
+	host_mb_t *p_sim = &host_mb[uc_ctrl][uc_mb];
+
+	p_frame->ul_mid = p_mb->CAN_MID & (CAN_MID_MIDE | 0x1FFFFFFF);
+	p_frame->ul_datal = p_mb->CAN_MDL;
+	p_frame->ul_datah = p_mb->CAN_MDH;
+	p_frame->uc_length = p_sim->uc_dlc > 8 ? 8 : p_sim->uc_dlc;
+	p_frame->uc_rtr = p_sim->uc_rtr;
+}
+
+static void host_bus_start(uint8_t uc_bus)
+{
+	host_bus_t *p_bus = &host_bus[uc_bus];
+	host_frame_t frame, best;
+	uint64_t ull_key, ull_best = ~0ULL;
+	uint32_t ul_prio, ul_best_prio;
+	uint8_t c, i, uc_mb, uc_ctrl = HOST_NODE_NONE, uc_node = HOST_NODE_NONE, uc_best_mb = 0;
+	uint8_t uc_offer[2] = { CANMB_NUMBER, CANMB_NUMBER };
+	host_node_frame_t *p_node;
+	host_mb_t *p_sim;
+
+	if (p_bus->uc_busy)
+		return;
+
+	for (c = 0; c < 2; c++) {
+		if ((uc_host_bus_of[c] != uc_bus) || !host_ctrl_active(c))
+			continue;
+		uc_mb = CANMB_NUMBER;
+		ul_best_prio = 16;
+		for (i = 0; i < CANMB_NUMBER; i++) {
+			ul_prio = (host_can[c].CAN_MB[i].CAN_MMR & CAN_MMR_PRIOR_Msk) >> CAN_MMR_PRIOR_Pos;
+			if (host_mb[c][i].uc_tx && (host_mb[c][i].ull_release <= ull_host_now) && (ul_prio < ul_best_prio)) {
+				ul_best_prio = ul_prio;
+				uc_mb = i;
+			}
+		}
+		if (uc_mb == CANMB_NUMBER)
+			continue;
+		uc_offer[c] = uc_mb;
+		host_mb_frame(c, uc_mb, &frame);
+		ull_key = host_arb_key(&frame);
+		if (ull_key < ull_best) {
+			ull_best = ull_key;
+			best = frame;
+			uc_ctrl = c;
+			uc_best_mb = uc_mb;
+			uc_node = HOST_NODE_NONE;
+		}
+	}
+
+	for (i = 0; i < HOST_NODES; i++) {
+		if (!p_bus->us_count[i])
+			continue;
+		p_node = &p_bus->node[i][p_bus->us_head[i]];
+		if (p_node->ull_at > ull_host_now)
+			continue;
+		ull_key = host_arb_key(&p_node->frame);
+		if (ull_key < ull_best) {
+			ull_best = ull_key;
+			best = p_node->frame;
+			uc_ctrl = HOST_NODE_NONE;
+			uc_node = i;
+		}
+	}
+
+	if (ull_best == ~0ULL)
+		return;
+
+	/* Time Triggered Mode does not retry: a mailbox which lost is aborted. */
+	for (c = 0; c < 2; c++) {
+		if ((uc_offer[c] == CANMB_NUMBER) || ((c == uc_ctrl) && (uc_offer[c] == uc_best_mb))
+				|| !(host_can[c].CAN_MR & CAN_MR_TTM))
+			continue;
+		p_sim = &host_mb[c][uc_offer[c]];
+		p_sim->uc_tx = 0;
+		*(volatile uint32_t *)&host_can[c].CAN_MB[uc_offer[c]].CAN_MSR = CAN_MSR_MABT | CAN_MSR_MRDY
+				| CAN_MSR_MDLC(p_sim->uc_dlc);
+	}
+
+	p_bus->uc_busy = 1;
+	p_bus->uc_ctrl = uc_ctrl;
+	p_bus->uc_node = uc_node;
+	p_bus->uc_mb = uc_best_mb;
+	p_bus->frame = best;
+	p_bus->ull_end = ull_host_now + (uint64_t)host_frame_bits(&best) * HOST_BIT_US;
+}
+
+static uint32_t host_mb_accepts(uint8_t uc_ctrl, uint8_t uc_mb, const host_frame_t *p_frame)
+{
+	CanMb *p_mb = &host_can[uc_ctrl].CAN_MB[uc_mb];
+
+	if ((p_mb->CAN_MID ^ p_frame->ul_mid) & CAN_MID_MIDE)
+		return 0;
+	return !((p_mb->CAN_MID ^ p_frame->ul_mid) & p_mb->CAN_MAM & 0x1FFFFFFF);
+}
+
+static void host_mb_store(uint8_t uc_ctrl, uint8_t uc_mb, const host_frame_t *p_frame, uint32_t ul_mmi)
+{
+	CanMb *p_mb = &host_can[uc_ctrl].CAN_MB[uc_mb];
+	uint32_t ul_fid = 0, ul_bit, n = 0;
+
+	for (ul_bit = 0; ul_bit < 29; ul_bit++) {
+		if (!(p_mb->CAN_MAM & (1u << ul_bit)))
+			ul_fid |= ((p_frame->ul_mid >> ul_bit) & 1u) << n++;
+	}
+	p_mb->CAN_MID = p_frame->ul_mid;
+	*(volatile uint32_t *)&p_mb->CAN_MFID = ul_fid;
+	p_mb->CAN_MDL = p_frame->ul_datal;
+	p_mb->CAN_MDH = p_frame->ul_datah;
+	*(volatile uint32_t *)&p_mb->CAN_MSR = CAN_MSR_MRDY | CAN_MSR_MDLC(p_frame->uc_length)
+			| CAN_MSR_MTIMESTAMP(host_can_tim(uc_ctrl)) | ul_mmi;
+	host_mb[uc_ctrl][uc_mb].uc_wait = 0;
+}
+
+static void host_receive(uint8_t uc_ctrl, const host_frame_t *p_frame)
+{
+	uint32_t ul_mot, ul_matched = 0;
+	uint8_t i, uc_overwrite = CANMB_NUMBER, uc_first = CANMB_NUMBER;
+	CanMb *p_mb;
+
+	if (p_frame->uc_rtr)
+		return;						// No producer mailboxes.
+
+	for (i = 0; i < CANMB_NUMBER; i++) {
+		p_mb = &host_can[uc_ctrl].CAN_MB[i];
+		ul_mot = host_mb[uc_ctrl][i].ul_mot;
+		if (!(((ul_mot == CAN_MMR_MOT_MB_RX) || (ul_mot == CAN_MMR_MOT_MB_RX_OVERWRITE))
+				|| ((ul_mot == CAN_MMR_MOT_MB_CONSUMER) && host_mb[uc_ctrl][i].uc_wait))
+				|| !host_mb_accepts(uc_ctrl, i, p_frame))
+			continue;
+		ul_matched = 1;
+		if (uc_first == CANMB_NUMBER)
+			uc_first = i;
+		if (!(p_mb->CAN_MSR & CAN_MSR_MRDY)) {
+			host_mb_store(uc_ctrl, i, p_frame, 0);
+			return;
+		}
+		if (ul_mot == CAN_MMR_MOT_MB_RX_OVERWRITE)
+			uc_overwrite = i;
+	}
+
+	if (uc_overwrite != CANMB_NUMBER) {
+		host_mb_store(uc_ctrl, uc_overwrite, p_frame, CAN_MSR_MMI);
+		host_bus_stats[uc_host_bus_of[uc_ctrl]].ul_overwritten[uc_ctrl]++;
+	} else if (ul_matched) {
+		*(volatile uint32_t *)&host_can[uc_ctrl].CAN_MB[uc_first].CAN_MSR |= CAN_MSR_MMI;
+		host_bus_stats[uc_host_bus_of[uc_ctrl]].ul_lost[uc_ctrl]++;
+	} else
+		host_bus_stats[uc_host_bus_of[uc_ctrl]].ul_unmatched[uc_ctrl]++;
+}
+
+static void host_bus_end(uint8_t uc_bus)
+{
+	host_bus_t *p_bus = &host_bus[uc_bus];
+	host_frame_t frame = p_bus->frame;
+	CanMb *p_mb;
+	host_mb_t *p_sim;
+	uint8_t c;
+
+	p_bus->uc_busy = 0;
+	host_bus_stats[uc_bus].ul_frames++;
+	host_bus_stats[uc_bus].ull_busy_us += (uint64_t)host_frame_bits(&frame) * HOST_BIT_US;
+
+	if (p_bus->uc_ctrl != HOST_NODE_NONE) {
+		p_mb = &host_can[p_bus->uc_ctrl].CAN_MB[p_bus->uc_mb];
+		p_sim = &host_mb[p_bus->uc_ctrl][p_bus->uc_mb];
+		if (p_sim->uc_tx) {
+			p_sim->uc_tx = 0;
+			if (p_sim->ul_mot == CAN_MMR_MOT_MB_TX)
+				*(volatile uint32_t *)&p_mb->CAN_MSR = CAN_MSR_MRDY | CAN_MSR_MDLC(p_sim->uc_dlc)
+						| CAN_MSR_MTIMESTAMP(host_can_tim(p_bus->uc_ctrl));
+		}
+	} else {
+		p_bus->us_head[p_bus->uc_node] = (p_bus->us_head[p_bus->uc_node] + 1) % HOST_NODE_QUEUE;
+		p_bus->us_count[p_bus->uc_node]--;
+	}
+
+	for (c = 0; c < 2; c++) {
+		if ((uc_host_bus_of[c] == uc_bus) && (c != p_bus->uc_ctrl) && host_ctrl_active(c))
+			host_receive(c, &frame);
+	}
+
+	if (host_frame_hook)
+		host_frame_hook(uc_bus, &frame, p_bus->uc_ctrl, p_bus->uc_node);
+}
+
+/************************************************************************/
+/*				TEST PROGRAM INTERFACE                                  */
+/************************************************************************/
+
+void host_init(uint32_t ul_flags)
+{
+	uint8_t c, i;
+
+	host_rtos_reset();
+	memset(host_can, 0, sizeof(host_can));
+	memset(&host_tc0, 0, sizeof(host_tc0));
+	memset(host_mb, 0, sizeof(host_mb));
+	memset(host_bus, 0, sizeof(host_bus));
+	memset(host_bus_stats, 0, sizeof(host_bus_stats));
+	memset(host_irq_stats, 0, sizeof(host_irq_stats));
+	memset(ul_host_tec, 0, sizeof(ul_host_tec));
+	memset(ul_host_rec, 0, sizeof(ul_host_rec));
+	memset(ul_host_err_hold, 0, sizeof(ul_host_err_hold));
+	memset(ul_host_tovf, 0, sizeof(ul_host_tovf));
+	memset(ull_host_tim_base, 0, sizeof(ull_host_tim_base));
+	memset(ull_host_tim_wraps, 0, sizeof(ull_host_tim_wraps));
+	ul_host_flags = ul_flags;
+	ull_host_nvic = 0;
+	memset(ul_host_tc_running, 0, sizeof(ul_host_tc_running));
+	memset(ul_host_tc_pending, 0, sizeof(ul_host_tc_pending));
+	host_frame_hook = NULL;
+	ull_host_now = 0;
+	ull_host_next_tick = HOST_TICK_US;
+	ull_host_cyc_tsc = host_tsc();
+	ul_host_cyc_base = 0;
+
+	uc_host_bus_of[0] = 0;
+	uc_host_bus_of[1] = (ul_flags & HOST_SEPARATE_BUSES) ? 1 : 0;
+
+	for (c = 0; c < 2; c++) {
+		*(volatile uint32_t *)&host_can[c].CAN_SR = CAN_SR_WAKEUP | CAN_SR_ERRA;	// can_init() waits for WAKEUP.
+		for (i = 0; i < CANMB_NUMBER; i++)
+			host_can[c].CAN_MB[i].CAN_MCR = HOST_MCR_IDLE;
+	}
+}
+
+void host_set_frame_hook(host_frame_hook_t hook)
+{
+	host_frame_hook = hook;
+}
+
+/* Queues a frame from simulated node uc_node, to be sent from ull_at_us on.
+*  Returns 0 if the node's queue is full. */
+uint32_t host_node_send(uint8_t uc_bus, uint8_t uc_node, const host_frame_t *p_frame, uint64_t ull_at_us)
+{
+	host_bus_t *p_bus = &host_bus[uc_bus];
+	host_node_frame_t *p_node;
+
+	if ((uc_node >= HOST_NODES) || (p_bus->us_count[uc_node] >= HOST_NODE_QUEUE)) {
+		host_bus_stats[uc_bus].ul_node_dropped++;
+		return 0;
+	}
+	p_node = &p_bus->node[uc_node][(p_bus->us_head[uc_node] + p_bus->us_count[uc_node]) % HOST_NODE_QUEUE];
+	p_node->frame = *p_frame;
+	p_node->ull_at = (ull_at_us < ull_host_now) ? ull_host_now : ull_at_us;
+	p_bus->us_count[uc_node]++;
+	return 1;
+}
+
+uint32_t host_node_queued(uint8_t uc_bus, uint8_t uc_node)
+{
+	return host_bus[uc_bus].us_count[uc_node];
+}
+
+/* Error counters of a controller. A bus-off controller recovers by itself
+*  after 128 x 11 recessive bits unless ul_hold is set. */
+void host_set_errors(uint8_t uc_ctrl, uint32_t ul_tec, uint32_t ul_rec, uint32_t ul_hold)
+{
+	ul_host_tec[uc_ctrl] = ul_tec;
+	ul_host_rec[uc_ctrl] = ul_rec;
+	ul_host_err_hold[uc_ctrl] = ul_hold;
+	ull_host_boff_at[uc_ctrl] = ull_host_now;
+}
+
+/* Handlers, then the buses, then the tasks until none is ready.
+*  Returns 1 if the most urgent task is spinning. */
+static uint32_t host_settle(void)
+{
+	uint32_t ul_step;
+
+	for (;;) {
+		host_interrupts();
+		host_bus_start(0);
+		host_bus_start(1);
+		ul_step = host_rtos_step();
+		if (ul_step != HOST_RAN)
+			return ul_step == HOST_SPINNING;
+	}
+}
+
+static uint64_t host_next_event(uint64_t ull_end)
+{
+	uint64_t ull_next = ull_end;
+	host_bus_t *p_bus;
+	uint8_t b, i, c;
+	uint64_t ull_at;
+
+	if (ull_host_next_tick < ull_next)
+		ull_next = ull_host_next_tick;
+	for (c = 0; c < 2; c++) {
+		if (ul_host_tc_running[c] && (ull_host_tc_next[c] < ull_next))
+			ull_next = ull_host_tc_next[c];
+	}
+	for (c = 0; c < 2; c++) {
+		if (host_can[c].CAN_IMR & CAN_IMR_TOVF) {
+			ull_at = ull_host_tim_base[c] + (ull_host_tim_wraps[c] + 1) * HOST_TIM_WRAP_US;
+			if (ull_at < ull_next)
+				ull_next = ull_at;
+		}
+		for (i = 0; i < CANMB_NUMBER; i++) {
+			if (host_mb[c][i].uc_tx && (host_mb[c][i].ull_release > ull_host_now)
+					&& (host_mb[c][i].ull_release < ull_next))
+				ull_next = host_mb[c][i].ull_release;
+		}
+	}
+	for (c = 0; c < 2; c++) {
+		if ((ul_host_tec[c] >= 256) && !ul_host_err_hold[c]
+				&& (ull_host_boff_at[c] + HOST_BOFF_RECOVERY_US < ull_next))
+			ull_next = ull_host_boff_at[c] + HOST_BOFF_RECOVERY_US;
+	}
+	for (b = 0; b < 2; b++) {
+		p_bus = &host_bus[b];
+		if (p_bus->uc_busy) {
+			if (p_bus->ull_end < ull_next)
+				ull_next = p_bus->ull_end;
+			continue;
+		}
+		for (i = 0; i < HOST_NODES; i++) {
+			if (!p_bus->us_count[i])
+				continue;
+			ull_at = p_bus->node[i][p_bus->us_head[i]].ull_at;
+			if (ull_at < ull_next)
+				ull_next = ull_at;
+		}
+	}
+	return (ull_next < ull_host_now) ? ull_host_now : ull_next;
+}
+
+void host_run_us(uint64_t ull_us)
+{
+	uint64_t ull_end = ull_host_now + ull_us, ull_next;
+	uint32_t ul_spin;
+	uint32_t ul_rc;
+	uint8_t b, c;
+
+	for (;;) {
+		ul_spin = host_settle();
+		if (ull_host_now >= ull_end)
+			break;
+
+		ull_next = host_next_event(ull_end);
+		if (ul_spin && (ull_next > ull_host_now + HOST_BIT_US))
+			ull_next = ull_host_now + HOST_BIT_US;
+		host_set_time(ull_next);
+		host_rtos_unspin();
+
+		for (b = 0; b < 2; b++) {
+			if (host_bus[b].uc_busy && (host_bus[b].ull_end <= ull_host_now))
+				host_bus_end(b);
+		}
+		for (c = 0; c < 2; c++) {
+			if ((ul_host_tec[c] >= 256) && !ul_host_err_hold[c]
+					&& (ull_host_boff_at[c] + HOST_BOFF_RECOVERY_US <= ull_host_now)) {
+				ul_host_tec[c] = 0;
+				ul_host_rec[c] = 0;
+			}
+		}
+		for (c = 0; c < 2; c++) {
+			if (!ul_host_tc_running[c] || (ull_host_tc_next[c] > ull_host_now))
+				continue;
+			ul_rc = host_tc0.TC_CHANNEL[c].TC_RC / 42;
+			ull_host_tc_next[c] += ul_rc ? ul_rc : 1;
+			ul_host_tc_pending[c] = 1;
+			if (host_tc0.TC_CHANNEL[c].TC_CMR & TC_CMR_CPCSTOP)
+				ul_host_tc_running[c] = 0;		// One-shot: the clock stops on RC compare.
+		}
+		if (ull_host_now >= ull_host_next_tick) {
+			ull_host_next_tick += HOST_TICK_US;
+			host_rtos_tick();
+		}
+	}
+}
+
+int host_done(void)
+{
+	printf("%s\n", host_failures ? "FAILED" : "PASSED");
+	return host_failures ? 1 : 0;
+}
+
+/************************************************************************/
+/*				BOARD STUBS                                             */
+/************************************************************************/
+
+void pio_toggle_pin(uint32_t pin)
+{
+	(void)pin;
+}
+
+uint32_t pmc_enable_periph_clk(uint32_t ul_id)
+{
+	(void)ul_id;
+	return 0;
+}
+
+void sn65hvd234_set_rs(sn65hvd234_ctrl_t *p_component, uint32_t pin_idx)
+{
+	p_component->pio_rs_idx = pin_idx;
+}
+
+void sn65hvd234_set_en(sn65hvd234_ctrl_t *p_component, uint32_t pin_idx)
+{
+	p_component->pio_en_idx = pin_idx;
+}
+
+void sn65hvd234_enable(sn65hvd234_ctrl_t *p_component)
+{
+	(void)p_component;
+}
+
+void sn65hvd234_disable_low_power(sn65hvd234_ctrl_t *p_component)
+{
+	(void)p_component;
+}
+
+signed portBASE_TYPE xSerialPutChar(void *pxPort, signed char cOutChar, TickType_t xBlockTime)
+{
+	(void)pxPort;
+	(void)xBlockTime;
+	return putchar((unsigned char)cOutChar) != EOF;
+}
@@ -0,0 +1,169 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_ack.c
+	*
+	*	PURPOSE:
+	*	Host test of the reply waiters (can_ack_arm(), can_ack_wait()) and of
+	*	command_out(), which is built on them.
+	*
+	*	FILE REFERENCES:	host.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	CAN0 and CAN1 on one bus, as on the bench. Times are simulated, in ticks of
+	*	100 ms.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	A task arms waiters for ACK_OPCODE on CAN0 and a simulated node answers with
+	*	frames carrying it, numbered in ul_datah. The task checks: a reply which
+	*	arrives; no reply (timeout); a reply which comes after its waiter gave up,
+	*	and one given to a waiter which was cancelled, neither of which may complete
+	*	the next waiter; and all waiters in use. Then command_out() through CAN1 and
+	*	CAN0: a call with no waiter free and a round trip; and command_in() with its
+	*	CAN0 mailbox taken and on its own. After each, the mailboxes of the exchange
+	*	(CAN0 MB0 and MB1, CAN1 MB1) must be free again and their interrupts off.
+	*
+ */
+
+#include "host.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+
+#define ACK_OPCODE			0x5A000001
+#define ACK_MID				CAN_MID_MIDvA(HK_REPLY_ID(SUB0_ID0))
+#define ACK_NODE			1
+#define ACK_TIMEOUT			3
+#define ACK_DELAY_US		2000
+
+static volatile uint32_t ul_task_done;
+
+/* The node answers with reply number ul_number ull_us from now. */
+static void ack_reply(uint32_t ul_number, uint64_t ull_us)
+{
+	host_frame_t frame = { ACK_MID, ACK_OPCODE, 0, 8, 0 };
+
+	frame.ul_datah = ul_number;
+	HOST_CHECK(host_node_send(0, ACK_NODE, &frame, host_time_us() + ull_us));
+}
+
+/* The mailboxes of the command exchange free and their interrupts off. */
+static uint32_t ack_command_out_clean(void)
+{
+	uint32_t ul_clean = can_mailbox_claim(CAN0, 0, CAN_OWNER_TEST) && can_mailbox_claim(CAN0, 1, CAN_OWNER_TEST)
+			&& can_mailbox_claim(CAN1, 1, CAN_OWNER_TEST) && !(can_get_interrupt_mask(CAN0) & CAN_IMR_MB0)
+			&& !(can_get_interrupt_mask(CAN1) & CAN_IMR_MB1);
+
+	can_mailbox_release(CAN0, 0, CAN_OWNER_TEST);
+	can_mailbox_release(CAN0, 1, CAN_OWNER_TEST);
+	can_mailbox_release(CAN1, 1, CAN_OWNER_TEST);
+	return ul_clean;
+}
+
+static void ack_task(void *pvParameters)
+{
+	uint32_t ul_handles[CAN_ACK_WAITERS], ul_handle, i;
+	can_frame_t reply;
+	TickType_t xStart;
+
+	(void)pvParameters;
+
+	/* A reply which arrives. */
+	ul_handle = can_ack_arm(CAN_CTRL_0, ACK_OPCODE);
+	HOST_CHECK(ul_handle);
+	ack_reply(1, ACK_DELAY_US);
+	xStart = xTaskGetTickCount();
+	HOST_CHECK(can_ack_wait(ul_handle, ACK_TIMEOUT, &reply) == CAN_CMD_OK);
+	printf("reply:     after %u ticks, number %u\n", xTaskGetTickCount() - xStart, reply.ul_datah);
+	HOST_CHECK((reply.ul_datal == ACK_OPCODE) && (reply.ul_datah == 1));
+	HOST_CHECK(xTaskGetTickCount() == xStart);
+
+	/* None. */
+	ul_handle = can_ack_arm(CAN_CTRL_0, ACK_OPCODE);
+	xStart = xTaskGetTickCount();
+	HOST_CHECK(can_ack_wait(ul_handle, ACK_TIMEOUT, &reply) == CAN_CMD_TIMEOUT);
+	printf("timeout:   after %u ticks\n", xTaskGetTickCount() - xStart);
+	HOST_CHECK(xTaskGetTickCount() - xStart == ACK_TIMEOUT);
+	HOST_CHECK(can_ack_wait(ul_handle, ACK_TIMEOUT, &reply) == CAN_CMD_INVALID);
+
+	/* Reply 2 comes late: the next waiter gets reply 3. */
+	ack_reply(2, 0);
+	vTaskDelay(1);
+	ul_handle = can_ack_arm(CAN_CTRL_0, ACK_OPCODE);
+	ack_reply(3, ACK_DELAY_US);
+	HOST_CHECK(can_ack_wait(ul_handle, ACK_TIMEOUT, &reply) == CAN_CMD_OK);
+	printf("late:      next waiter got number %u\n", reply.ul_datah);
+	HOST_CHECK(reply.ul_datah == 3);
+
+	/* Reply 4 completes a waiter which is then cancelled: the semaphore it
+	*  gave may not complete the waiter armed next in the same slot. */
+	ul_handle = can_ack_arm(CAN_CTRL_0, ACK_OPCODE);
+	ack_reply(4, 0);
+	vTaskDelay(1);
+	can_ack_cancel(ul_handle);
+	HOST_CHECK(can_ack_arm(CAN_CTRL_0, ACK_OPCODE) == ul_handle);
+	HOST_CHECK(can_ack_wait(ul_handle, ACK_TIMEOUT, &reply) == CAN_CMD_TIMEOUT);
+
+	/* All waiters in use. */
+	for (i = 0; i < CAN_ACK_WAITERS; i++) {
+		ul_handles[i] = can_ack_arm(CAN_CTRL_0, ACK_OPCODE + i);
+		HOST_CHECK(ul_handles[i]);
+	}
+	HOST_CHECK(!can_ack_arm(CAN_CTRL_0, ACK_OPCODE));
+	HOST_CHECK(command_out(ACK_TIMEOUT) == CAN_CMD_BUSY);
+	HOST_CHECK(ack_command_out_clean());
+	for (i = 0; i < CAN_ACK_WAITERS; i++)
+		can_ack_cancel(ul_handles[i]);
+	printf("busy:      %u waiters, command_out() BUSY, mailboxes free\n", CAN_ACK_WAITERS);
+
+	/* command_out() over the bus and back. */
+	HOST_CHECK(command_out(ACK_TIMEOUT) == CAN_CMD_OK);
+	HOST_CHECK(ack_command_out_clean());
+	printf("command:   round trip OK, mailboxes free\n");
+
+	/* command_in() with CAN0 MB1 taken: BUSY, CAN1 MB1 not kept. */
+	HOST_CHECK(can_mailbox_claim(CAN0, 1, CAN_OWNER_TEST));
+	HOST_CHECK(command_in() == CAN_CMD_BUSY);
+	HOST_CHECK(can_mailbox_owned(CAN0, 1, CAN_OWNER_TEST));
+	HOST_CHECK(can_mailbox_release(CAN0, 1, CAN_OWNER_TEST));
+	HOST_CHECK(ack_command_out_clean());
+
+	/* command_in() alone: its answer on CAN1 gives the mailboxes back. */
+	HOST_CHECK(command_in() == CAN_CMD_OK);
+	vTaskDelay(1);
+	HOST_CHECK(ack_command_out_clean());
+	printf("answer:    command_in() BUSY and alone, mailboxes free\n");
+
+	ul_task_done = 1;
+	for (;;)
+		vTaskDelay(100);
+}
+
+int main(void)
+{
+	host_init(0);
+	can_initialize();
+	xTaskCreate(ack_task, "ack", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, NULL);
+	host_run_us(30 * HOST_TICK_US);
+
+	HOST_CHECK(ul_task_done);
+	return host_done();
+}
@@ -0,0 +1,273 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_api_cost.c
+	*
+	*	PURPOSE:
+	*	Host microbenchmark of one send_can_command() call: the old one, which
+	*	configured CAN0 MB7 through the shared can0_mailbox and saved and restored it
+	*	around the call, the same with a stack-local descriptor, and the current one
+	*	(TX queue).
+	*
+	*	FILE REFERENCES:	host.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Cycles are host TSC cycles of the x86 build, not SAM3X cycles. The medians
+	*	are compared, the host's own interrupts land in the tail. Each figure includes
+	*	the two TSC reads around the call (about 30 cycles), so the pair alone reads
+	*	higher than what taking it out of the call saves. Every figure which is
+	*	checked against the old call is timed alternately with an old call, so that
+	*	both see the same state of the host. The stack-local call saves a few cycles
+	*	and is only checked not to go the wrong way.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Old and stack-local calls, and old and queued calls, interleaved; the
+	*					checks were flaky when they were timed one after the other.
+	*
+	*					The free-mailbox call is also timed next to an old one and checked.
+	*
+	*	DESCRIPTION:
+	*
+	*	old_send_can_command(), old_save_can_object() and old_restore_can_object()
+	*	are the code of the baseline tree (before the CAN API was made reentrant),
+	*	run against the same simulated registers through the same ASF driver.
+	*	The current path writes a frame into a free mailbox straight from the
+	*	caller's frame when nothing is waiting, without passing through the queue
+	*	pool, and must be cheaper than the old call either way.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define COST_CALLS			20000
+#define COST_ID				CAN_ID(CAN_PRIO_SUB_CMD, SUB0_ID0, CAN_NODE_OBC, CAN_TYPE_CMD)
+
+/************************************************************************/
+/*				BASELINE CODE                                           */
+/************************************************************************/
+
+typedef struct {
+	uint32_t ul_mb_idx;
+	uint8_t uc_obj_type;
+	uint8_t uc_id_ver;
+	uint8_t uc_length;
+	uint8_t uc_tx_prio;
+	uint32_t ul_status;
+	uint32_t ul_id_msk;
+	uint32_t ul_id;
+	uint32_t ul_fid;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+} can_temp_t;
+
+can_mb_conf_t can0_mailbox;
+
+__attribute__((noinline)) void old_save_can_object(can_mb_conf_t *original, can_temp_t *temp)
+{
+	temp->ul_mb_idx		= original->ul_mb_idx;
+	temp->uc_obj_type	= original->uc_obj_type;
+	temp->uc_id_ver		= original->uc_id_ver;
+	temp->uc_length		= original->uc_length;
+	temp->uc_tx_prio	= original->uc_tx_prio;
+	temp->ul_status		= original->ul_status;
+	temp->ul_id_msk		= original->ul_id_msk;
+	temp->ul_id			= original->ul_id;
+	temp->ul_fid		= original->ul_fid;
+	temp->ul_datal		= original->ul_datal;
+	temp->ul_datah		= original->ul_datah;
+}
+
+__attribute__((noinline)) void old_restore_can_object(can_mb_conf_t *original, can_temp_t *temp)
+{
+	original->ul_mb_idx		= temp->ul_mb_idx;
+	original->uc_obj_type	= temp->uc_obj_type;
+	original->uc_id_ver		= temp->uc_id_ver;
+	original->uc_length		= temp->uc_length;
+	original->uc_tx_prio	= temp->uc_tx_prio;
+	original->ul_status		= temp->ul_status;
+	original->ul_id_msk		= temp->ul_id_msk;
+	original->ul_id			= temp->ul_id;
+	original->ul_fid		= temp->ul_fid;
+	original->ul_datal		= temp->ul_datal;
+	original->ul_datah		= temp->ul_datah;
+}
+
+__attribute__((noinline)) uint32_t old_send_can_command(uint32_t low, uint32_t high, uint32_t ID, uint32_t PRIORITY)
+{
+	can_temp_t temp_mailbox;
+
+	(void)PRIORITY;
+	old_save_can_object(&can0_mailbox, &temp_mailbox);
+
+	reset_mailbox_conf(&can0_mailbox);
+	can0_mailbox.ul_mb_idx = 7;
+	can0_mailbox.uc_obj_type = CAN_MB_TX_MODE;
+	can0_mailbox.uc_tx_prio = 9;
+	can0_mailbox.uc_id_ver = 0;
+	can0_mailbox.ul_id_msk = 0;
+	can_mailbox_init(CAN0, &can0_mailbox);
+
+	can0_mailbox.ul_id = CAN_MID_MIDvA(ID);
+	can0_mailbox.ul_datal = low;
+	can0_mailbox.ul_datah = high;
+	can0_mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	can_mailbox_write(CAN0, &can0_mailbox);
+
+	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB7);
+
+	old_restore_can_object(&can0_mailbox, &temp_mailbox);
+	return 1;
+}
+
+/* The same with a stack-local descriptor and no save/restore: the change of
+*  user-004 by itself, before the TX queue. */
+__attribute__((noinline)) uint32_t local_send_can_command(uint32_t low, uint32_t high, uint32_t ID, uint32_t PRIORITY)
+{
+	can_mb_conf_t mailbox;
+
+	(void)PRIORITY;
+	reset_mailbox_conf(&mailbox);
+	mailbox.ul_mb_idx = 7;
+	mailbox.uc_obj_type = CAN_MB_TX_MODE;
+	mailbox.uc_tx_prio = 9;
+	mailbox.uc_id_ver = 0;
+	mailbox.ul_id_msk = 0;
+	can_mailbox_init(CAN0, &mailbox);
+
+	mailbox.ul_id = CAN_MID_MIDvA(ID);
+	mailbox.ul_datal = low;
+	mailbox.ul_datah = high;
+	mailbox.uc_length = MAX_CAN_FRAME_DATA_LEN;
+	can_mailbox_write(CAN0, &mailbox);
+
+	can_global_send_transfer_cmd(CAN0, CAN_TCR_MB7);
+	return 1;
+}
+
+/************************************************************************/
+/*				MEASUREMENT                                             */
+/************************************************************************/
+
+static uint32_t ul_cost[COST_CALLS], ul_cost_local[COST_CALLS];
+
+static int cost_compare(const void *p_a, const void *p_b)
+{
+	uint32_t ul_a = *(const uint32_t *)p_a, ul_b = *(const uint32_t *)p_b;
+
+	return (ul_a > ul_b) - (ul_a < ul_b);
+}
+
+static uint32_t cost_median(uint32_t *p_cost, uint32_t ul_n)
+{
+	qsort(p_cost, ul_n, sizeof(p_cost[0]), cost_compare);
+	return p_cost[ul_n / 2];
+}
+
+int main(void)
+{
+	can_temp_t temp;
+	uint64_t ull_start;
+	uint32_t i, ul_old, ul_old_q, ul_old_m, ul_local, ul_save, ul_queue, ul_mailbox, ul_n;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+
+	/* Old path and the stack-local one, alternately. MB7 is the driver's; the
+	*  old code took it without asking. The transmit mailbox is ready again
+	*  after each call (MRDY is set while the bus is not run), as it was with
+	*  20 calls/s on the target. */
+	for (i = 0; i < COST_CALLS; i++) {
+		*(volatile uint32_t *)&host_can[0].CAN_MB[7].CAN_MSR = CAN_MSR_MRDY;
+		ull_start = host_tsc();
+		old_send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO);
+		ul_cost[i] = (uint32_t)(host_tsc() - ull_start);
+
+		*(volatile uint32_t *)&host_can[0].CAN_MB[7].CAN_MSR = CAN_MSR_MRDY;
+		ull_start = host_tsc();
+		local_send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO);
+		ul_cost_local[i] = (uint32_t)(host_tsc() - ull_start);
+	}
+	ul_old = cost_median(ul_cost, COST_CALLS);
+	ul_local = cost_median(ul_cost_local, COST_CALLS);
+
+	/* The save/restore pair by itself. */
+	for (i = 0; i < COST_CALLS; i++) {
+		ull_start = host_tsc();
+		old_save_can_object(&can0_mailbox, &temp);
+		old_restore_can_object(&can0_mailbox, &temp);
+		ul_cost[i] = (uint32_t)(host_tsc() - ull_start);
+	}
+	ul_save = cost_median(ul_cost, COST_CALLS);
+
+	/* Current path, frame written straight into a free mailbox: the bus runs
+	*  between calls. Each call next to an old one, which goes first so that
+	*  the scheduler's frame is the one left in MB7. */
+	host_run_us(1000);
+	for (i = 0; i < COST_CALLS; i++) {
+		host_run_us(1000);
+		*(volatile uint32_t *)&host_can[0].CAN_MB[7].CAN_MSR = CAN_MSR_MRDY;
+		ull_start = host_tsc();
+		old_send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO);
+		ul_cost_local[i] = (uint32_t)(host_tsc() - ull_start);
+
+		ull_start = host_tsc();
+		HOST_CHECK(send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO));
+		ul_cost[i] = (uint32_t)(host_tsc() - ull_start);
+	}
+	ul_mailbox = cost_median(ul_cost, COST_CALLS);
+	ul_old_m = cost_median(ul_cost_local, COST_CALLS);
+
+	/* Current path, frame queued behind the one in the level's mailbox, each
+	*  call next to an old one. */
+	for (i = 0, ul_n = 0; i < COST_CALLS; i++) {
+		if (can_tx_pending() >= CAN_TX_QUEUE_SIZE - 1)
+			host_run_us(200000);
+		ull_start = host_tsc();
+		HOST_CHECK(send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO));
+		ul_cost[ul_n] = (uint32_t)(host_tsc() - ull_start);
+
+		*(volatile uint32_t *)&host_can[0].CAN_MB[7].CAN_MSR = CAN_MSR_MRDY;
+		ull_start = host_tsc();
+		old_send_can_command(0x01000000, i, COST_ID, COMMAND_PRIO);
+		ul_cost_local[ul_n++] = (uint32_t)(host_tsc() - ull_start);
+	}
+	ul_queue = cost_median(ul_cost, ul_n);
+	ul_old_q = cost_median(ul_cost_local, ul_n);
+
+	/* The old calls write over whatever the scheduler had in MB7; it must still
+	*  drain. */
+	host_run_us(200000);
+	HOST_CHECK(can_tx_pending() == 0);
+
+	printf("old send_can_command():         %4u host cycles/call (median)\n", ul_old);
+	printf("  save + restore alone:         %4u\n", ul_save);
+	printf("  stack-local, no save/restore: %4u (saves %d per call)\n", ul_local, (int)ul_old - (int)ul_local);
+	printf("send_can_command() now, into a free mailbox: %4u (old alongside: %u)\n", ul_mailbox, ul_old_m);
+	printf("send_can_command() now, queued:              %4u (old alongside: %u)\n", ul_queue, ul_old_q);
+
+	HOST_CHECK(ul_local <= ul_old);
+	HOST_CHECK(ul_mailbox < ul_old_m);
+	HOST_CHECK(ul_queue < ul_old_q);
+
+	return host_done();
+}
@@ -0,0 +1,156 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_capture.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the frame capture (can_capture.c): blocks read back in
+	*	order across the chunks of can_capture_read(), the oldest records given up
+	*	and counted when the ring overflows, and a capture file for can_replay.
+	*
+	*	FILE REFERENCES:	host.h, can_capture.h, can_nmt.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails or the capture file cannot be written.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Interrupts only run between tasks here, so no frame lands in the middle of
+	*	a read: the test covers the chunk arithmetic, not the masking itself.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/, which then replays
+	*	host_build/capture.bin with can_replay.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	A simulated node sends CAP_FRAMES heartbeats (can_nmt.c, which registers its
+	*	opcode in can_initialize()) and CAP_UNHANDLED frames with the same ID and an
+	*	opcode nobody registered, each carrying its number in ul_datah. They are read back in blocks of CAP_BLOCK_RECORDS records, which
+	*	is not a multiple of the read chunk, and written to the capture file; the
+	*	numbers must come out in order with nothing lost.
+	*
+	*	Then CAP_OVERFLOW frames are sent with nothing read: the first block must
+	*	report the records overwritten, and the ring must hold the newest frames.
+	*
+ */
+
+#include "host.h"
+#include "can_capture.h"
+#include "can_nmt.h"
+
+#include <stdio.h>
+
+#define CAP_ID				NMT_HEARTBEAT_ID(SUB0_ID1)
+#define CAP_OPCODE_NONE		0xE4000000
+#define CAP_FRAMES			100
+#define CAP_UNHANDLED		20
+#define CAP_OVERFLOW		300
+#define CAP_GAP_US			1000
+#define CAP_BATCH			100
+#define CAP_BLOCK_RECORDS	20
+#define CAP_FILE			"host_build/capture.bin"
+
+static uint8_t uc_block[CAN_CAPTURE_HEADER_SIZE + CAN_CAPTURE_REC_SIZE * CAP_BLOCK_RECORDS];
+static uint8_t uc_full[CAN_CAPTURE_MAX_SIZE];
+
+static uint32_t cap_get32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ul_count frames from a simulated node, from number ul_first on, CAP_BATCH
+*  at a time (the node's queue holds 256). */
+static void cap_send(uint32_t ul_first, uint32_t ul_count, uint32_t ul_opcode)
+{
+	host_frame_t frame = { CAN_MID_MIDvA(CAP_ID), ul_opcode, 0, 8, 0 };
+	uint64_t ull_at;
+	uint32_t i, n;
+
+	for (i = 0; i < ul_count; i += n) {
+		n = (ul_count - i < CAP_BATCH) ? ul_count - i : CAP_BATCH;
+		ull_at = host_time_us() + CAP_GAP_US;
+		for (frame.ul_datah = ul_first + i; frame.ul_datah < ul_first + i + n; frame.ul_datah++, ull_at += CAP_GAP_US)
+			HOST_CHECK(host_node_send(0, 0, &frame, ull_at));
+		host_run_us((n + 1) * CAP_GAP_US);
+	}
+}
+
+/* Checks the records of a block: received frames of CAP_ID carry the numbers
+*  from *p_next on. Returns the number of records. */
+static uint32_t cap_check_block(const uint8_t *puc_block, uint32_t ul_bytes, uint32_t *p_next)
+{
+	const uint8_t *p = puc_block + CAN_CAPTURE_HEADER_SIZE;
+	uint32_t ul_count = puc_block[6] | ((uint32_t)puc_block[7] << 8), i;
+
+	HOST_CHECK(!memcmp(puc_block, CAN_CAPTURE_MAGIC, 4));
+	HOST_CHECK(ul_bytes == CAN_CAPTURE_HEADER_SIZE + ul_count * CAN_CAPTURE_REC_SIZE);
+	for (i = 0; i < ul_count; i++, p += CAN_CAPTURE_REC_SIZE) {
+		if ((p[18] & CAN_CAPTURE_TX) || (cap_get32(p + 4) != CAN_MID_MIDvA(CAP_ID)))
+			continue;
+		HOST_CHECK(cap_get32(p + 12) == *p_next);
+		*p_next = cap_get32(p + 12) + 1;
+	}
+	return ul_count;
+}
+
+int main(void)
+{
+	FILE *f;
+	uint32_t ul_bytes, ul_records = 0, ul_blocks = 0, ul_lost = 0, ul_next = 0, ul_first;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+
+	/* In order, nothing lost. */
+	f = fopen(CAP_FILE, "wb");
+	if (!f) {
+		perror(CAP_FILE);
+		return 1;
+	}
+	can_capture_start();
+	cap_send(0, CAP_FRAMES, NMT_HEARTBEAT);
+	cap_send(CAP_FRAMES, CAP_UNHANDLED, CAP_OPCODE_NONE);
+	HOST_CHECK(can_capture_read(uc_block, CAN_CAPTURE_HEADER_SIZE) == CAN_CAPTURE_HEADER_SIZE);
+	do {
+		ul_bytes = can_capture_read(uc_block, sizeof(uc_block));
+		ul_records += cap_check_block(uc_block, ul_bytes, &ul_next);
+		ul_lost += cap_get32(uc_block + 12);
+		ul_blocks++;
+		HOST_CHECK(fwrite(uc_block, 1, ul_bytes, f) == ul_bytes);
+	} while (ul_bytes > CAN_CAPTURE_HEADER_SIZE);
+	fclose(f);
+	printf("%u records in %u blocks of up to %u, %u lost, %u frames handled\n", ul_records, ul_blocks,
+			CAP_BLOCK_RECORDS, ul_lost, can_nmt_stats.ul_heartbeats);
+	HOST_CHECK(ul_next == CAP_FRAMES + CAP_UNHANDLED);
+	HOST_CHECK(ul_lost == 0);
+	HOST_CHECK(can_nmt_stats.ul_heartbeats == CAP_FRAMES);
+
+	/* Overflow: the newest CAN_CAPTURE_RECORDS stay, the others are counted. */
+	cap_send(0, CAP_OVERFLOW, NMT_HEARTBEAT);
+	ul_bytes = can_capture_read(uc_full, sizeof(uc_full));
+	ul_lost = cap_get32(uc_full + 12);
+	ul_first = CAP_OVERFLOW - CAN_CAPTURE_RECORDS;
+	ul_next = ul_first;
+	ul_records = cap_check_block(uc_full, ul_bytes, &ul_next);
+	printf("overflow: %u records kept, %u lost, first number %u\n", ul_records, ul_lost, ul_first);
+	HOST_CHECK(ul_records == CAN_CAPTURE_RECORDS);
+	HOST_CHECK(ul_lost == CAP_OVERFLOW - CAN_CAPTURE_RECORDS);
+	HOST_CHECK(ul_next == CAP_OVERFLOW);
+	HOST_CHECK(can_capture_read(uc_full, sizeof(uc_full)) == CAN_CAPTURE_HEADER_SIZE);
+	HOST_CHECK(cap_get32(uc_full + 12) == 0);
+	can_capture_stop();
+
+	return host_done();
+}
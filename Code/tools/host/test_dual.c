@@ -0,0 +1,210 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_dual.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the redundant dual bus (can_dual.c): frames per second
+	*	on two buses and on one, per-level order across a bus failure, and the
+	*	duplicate drop of frames received on both buses.
+	*
+	*	FILE REFERENCES:	host.h, can_dual.h, can_err.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Built with CAN_DUAL_BUS_ENABLE=1. Rates are simulated (250 kbit/s on each
+	*	bus, 444 us per 8-byte frame).
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	DUAL_LEVELS TX levels (two with CAN0 as home bus, two with CAN1) are kept
+	*	busy from main. Every frame carries its level and a sequence number, and the
+	*	frame hook checks on both buses that each level's numbers follow each other
+	*	with no gap and no repeat.
+	*
+	*	CAN1 is then taken bus-off and held there: its levels move to CAN0, with any
+	*	frame caught in a CAN1 mailbox. The rate is measured again on the one bus,
+	*	then the queue is drained and CAN1 brought back.
+	*
+	*	Last, a simulated node sends frames on both buses, as a subsystem which
+	*	repeats a frame after a failover would: each must reach the handler once.
+	*
+ */
+
+#include "host.h"
+#include "can_dual.h"
+#include "can_err.h"
+
+#include <stdio.h>
+
+#define DUAL_LEVELS			4
+#define DUAL_LEVEL_FIRST	2					// Levels 2 - 5: homes CAN0, CAN1, CAN0, CAN1.
+#define DUAL_TX_ID			CAN_ID(CAN_PRIO_SUB_CMD, SUB0_ID0, CAN_NODE_OBC, CAN_TYPE_CMD)
+#define DUAL_PENDING		64					// Frames kept queued: far from a full pool on a reclaim.
+#define DUAL_RUN_US			2000000ULL
+#define DUAL_FRAME_US		444
+#define DUAL_OPCODE			0xE6000000
+#define DUAL_RX_FRAMES		50
+
+static uint32_t ul_next_seq[DUAL_LEVELS];		// Next sequence number to queue, per level.
+static uint32_t ul_seen_seq[DUAL_LEVELS];		// Next sequence number expected on a bus.
+static uint32_t ul_order_errors, ul_frames[2], ul_home_frames[2];
+static uint32_t ul_handled;
+
+/************************************************************************/
+/*				TRANSMISSION                                            */
+/************************************************************************/
+
+static void dual_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	uint32_t ul_level;
+
+	(void)uc_node;
+	if ((uc_ctrl == HOST_NODE_NONE) || (p_frame->ul_mid != CAN_MID_MIDvA(DUAL_TX_ID)))
+		return;
+	ul_level = p_frame->ul_datal - DUAL_LEVEL_FIRST;
+	if (ul_level >= DUAL_LEVELS)
+		return;
+	if (p_frame->ul_datah != ul_seen_seq[ul_level])
+		ul_order_errors++;
+	ul_seen_seq[ul_level] = p_frame->ul_datah + 1;
+	ul_frames[uc_bus]++;
+	if (uc_ctrl == CAN_DUAL_HOME(ul_level + DUAL_LEVEL_FIRST))
+		ul_home_frames[uc_bus]++;
+}
+
+/* Keeps DUAL_PENDING frames queued, the levels in turn. */
+static void dual_fill(void)
+{
+	static uint32_t ul_turn;
+	uint32_t ul_level;
+
+	while (can_tx_pending() < DUAL_PENDING) {
+		ul_level = ul_turn++ % DUAL_LEVELS;
+		if (!send_can_command(DUAL_LEVEL_FIRST + ul_level, ul_next_seq[ul_level], DUAL_TX_ID,
+				DUAL_LEVEL_FIRST + ul_level))
+			break;
+		ul_next_seq[ul_level]++;
+	}
+}
+
+/* Frames per second on both buses over ull_us. */
+static uint32_t dual_rate(const char *pc_name, uint64_t ull_us)
+{
+	uint64_t ull_end = host_time_us() + ull_us;
+	uint32_t ul_start = ul_frames[0] + ul_frames[1], ul_rate;
+
+	while (host_time_us() < ull_end) {
+		dual_fill();
+		host_run_us(1000);
+	}
+	ul_rate = (uint32_t)((uint64_t)(ul_frames[0] + ul_frames[1] - ul_start) * 1000000 / ull_us);
+	printf("%-16s %5u frames/s (bus 0: %u frames, bus 1: %u frames so far, %u sent away from home)\n",
+			pc_name, ul_rate, ul_frames[0], ul_frames[1], can_dual_stats.ul_failover);
+	return ul_rate;
+}
+
+/************************************************************************/
+/*				RECEPTION                                               */
+/************************************************************************/
+
+static void dual_handler(const can_frame_t *p_frame)
+{
+	(void)p_frame;
+	ul_handled++;
+}
+
+/* Frame n of the reception test. */
+static void dual_rx_frame(host_frame_t *p_frame, uint32_t n)
+{
+	p_frame->ul_mid = CAN_MID_MIDvA(CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID1, CAN_TYPE_CMD));
+	p_frame->ul_datal = DUAL_OPCODE;
+	p_frame->ul_datah = n;
+	p_frame->uc_length = 8;
+	p_frame->uc_rtr = 0;
+}
+
+int main(void)
+{
+	host_frame_t frame;
+	uint32_t ul_two, ul_one, ul_dups, ul_handled0, ul_failover, i;
+	uint64_t ull_at;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	HOST_CHECK(can_register_handler(CAN_CTRL_0, DUAL_OPCODE, dual_handler));
+	host_set_frame_hook(dual_hook);
+	host_run_us(1000);
+
+	/* Both buses. */
+	ul_two = dual_rate("two buses", DUAL_RUN_US);
+	HOST_CHECK(ul_home_frames[0] == ul_frames[0]);
+	HOST_CHECK(ul_home_frames[1] == ul_frames[1]);
+	HOST_CHECK(ul_frames[1] > 0);
+	HOST_CHECK(can_dual_stats.ul_failover == 0);
+
+	/* CAN1 dies: its levels go to CAN0, in order. */
+	ul_failover = can_dual_stats.ul_failover;
+	host_set_errors(CAN_CTRL_1, 256, 0, 1);
+	dual_rate("failover", 10 * HOST_TICK_US);
+	HOST_CHECK(can_err_state(CAN_CTRL_1) == CAN_ERR_BUS_OFF);
+	ul_one = dual_rate("one bus", DUAL_RUN_US);
+	HOST_CHECK(can_dual_stats.ul_failover > ul_failover);
+	HOST_CHECK(ul_two > 2 * ul_one * 9 / 10);
+	HOST_CHECK(ul_one > 1000000 / DUAL_FRAME_US * 9 / 10);
+
+	/* Drain: every frame of every level out once, in order. */
+	host_run_us(DUAL_PENDING * DUAL_FRAME_US * 2);
+	HOST_CHECK(can_tx_pending() == 0);
+	for (i = 0; i < DUAL_LEVELS; i++)
+		HOST_CHECK(ul_seen_seq[i] == ul_next_seq[i]);
+	HOST_CHECK(ul_order_errors == 0);
+	HOST_CHECK(can_err_stats[CAN_CTRL_1].ul_lost_frames == 0);
+	printf("%u + %u frames, %u out of order, %u lost\n", ul_frames[0], ul_frames[1], ul_order_errors,
+			can_err_stats[CAN_CTRL_1].ul_lost_frames);
+
+	/* CAN1 back. */
+	host_set_errors(CAN_CTRL_1, 0, 0, 0);
+	for (i = 0; (i < 50) && (can_err_state(CAN_CTRL_1) != CAN_ERR_ACTIVE); i++)
+		host_run_us(HOST_TICK_US);
+	HOST_CHECK(can_err_state(CAN_CTRL_1) == CAN_ERR_ACTIVE);
+
+	/* Every frame on both buses, the copy 1 ms after: handled once. Then as
+	*  many frames on CAN1 alone: all handled. */
+	ul_dups = can_dual_stats.ul_duplicates;
+	ul_handled0 = ul_handled;
+	ull_at = host_time_us() + 1000;
+	for (i = 0; i < DUAL_RX_FRAMES; i++) {
+		dual_rx_frame(&frame, i);
+		HOST_CHECK(host_node_send(0, 0, &frame, ull_at + i * 5000));
+		HOST_CHECK(host_node_send(1, 0, &frame, ull_at + i * 5000 + 1000));
+	}
+	host_run_us(DUAL_RX_FRAMES * 5000 + 10000);
+	for (i = 0; i < DUAL_RX_FRAMES; i++) {
+		dual_rx_frame(&frame, DUAL_RX_FRAMES + i);
+		HOST_CHECK(host_node_send(1, 0, &frame, host_time_us() + i * 5000));
+	}
+	host_run_us(DUAL_RX_FRAMES * 5000 + 10000);
+	printf("reception: %u frames handled, %u dropped as copies\n", ul_handled - ul_handled0,
+			can_dual_stats.ul_duplicates - ul_dups);
+	HOST_CHECK(can_dual_stats.ul_duplicates - ul_dups == DUAL_RX_FRAMES);
+	HOST_CHECK(ul_handled - ul_handled0 == 2 * DUAL_RX_FRAMES);
+
+	return host_done();
+}
@@ -0,0 +1,150 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_err_fault.c
+	*
+	*	PURPOSE:
+	*	Host fault-injection test of the CAN error handling (can_err.c): the states it
+	*	follows as the error counters of CAN0 go up and down, and the bus-off recovery.
+	*
+	*	FILE REFERENCES:	host.h, can_err.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The error counters are set by the test (host_set_errors()), the simulated bus
+	*	makes no errors of its own. Times are simulated, in ticks of 100 ms.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					Added the runs with the timer queue full.
+	*
+	*	DESCRIPTION:
+	*
+	*	ACTIVE -> WARNING -> PASSIVE -> WARNING -> ACTIVE, each step checked against
+	*	the time it takes can_err.c to follow it: the way up and PASSIVE -> WARNING
+	*	come from the error interrupt, WARNING -> ACTIVE from the error timer.
+	*	Then a bus-off held for a second (the reset repeats with a growing back-off,
+	*	the frames sent meanwhile wait in the queue and all leave after it), and one
+	*	which ends in WARNING and has to come down to ACTIVE by itself. Last, the
+	*	same with the timer commands failing (timer queue full).
+	*
+ */
+
+#include "host.h"
+#include "can_err.h"
+
+#include <stdio.h>
+
+#define FAULT_ID			CAN_ID(CAN_PRIO_SUB_CMD, SUB0_ID0, CAN_NODE_OBC, CAN_TYPE_CMD)
+#define FAULT_FRAMES		20
+#define FAULT_MAX_TICKS		50
+
+static uint32_t ul_frames_seen;
+
+static void fault_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	(void)uc_bus;
+	(void)uc_node;
+	if ((uc_ctrl == CAN_CTRL_0) && (p_frame->ul_mid == CAN_MID_MIDvA(FAULT_ID)))
+		ul_frames_seen++;
+}
+
+/* Sets the counters, then runs until CAN0 reaches ul_state. Returns the ticks
+*  it took, or FAULT_MAX_TICKS + 1. */
+static uint32_t fault_step(const char *pc_name, uint32_t ul_tec, uint32_t ul_rec, uint32_t ul_hold,
+		uint32_t ul_state)
+{
+	uint32_t ul_ticks = 0;
+
+	host_set_errors(CAN_CTRL_0, ul_tec, ul_rec, ul_hold);
+	host_run_us(10);
+	while ((can_err_state(CAN_CTRL_0) != ul_state) && (ul_ticks <= FAULT_MAX_TICKS)) {
+		host_run_us(HOST_TICK_US);
+		ul_ticks++;
+	}
+	printf("%-30s TEC %3u REC %3u: state %u after %2u ticks\n", pc_name, ul_tec, ul_rec,
+			can_err_state(CAN_CTRL_0), ul_ticks);
+	return ul_ticks;
+}
+
+int main(void)
+{
+	volatile can_err_stats_t *p_stats = &can_err_stats[CAN_CTRL_0];
+	uint32_t ul_resets, ul_seen, i;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_set_frame_hook(fault_hook);
+	host_run_us(1000);
+	HOST_CHECK(can_err_state(CAN_CTRL_0) == CAN_ERR_ACTIVE);
+
+	/* Up and down through the error states. */
+	HOST_CHECK(fault_step("active -> warning", 100, 0, 0, CAN_ERR_WARNING) == 0);
+	HOST_CHECK(fault_step("warning -> passive", 140, 0, 0, CAN_ERR_PASSIVE) == 0);
+	HOST_CHECK(fault_step("passive -> warning", 100, 0, 0, CAN_ERR_WARNING) == 0);
+	HOST_CHECK(fault_step("warning -> active", 20, 0, 0, CAN_ERR_ACTIVE) <= CAN_ERR_POLL_TICKS);
+	HOST_CHECK(fault_step("active -> passive (REC)", 0, 130, 0, CAN_ERR_PASSIVE) == 0);
+	HOST_CHECK(fault_step("passive -> active", 0, 0, 0, CAN_ERR_ACTIVE) <= CAN_ERR_POLL_TICKS);
+	HOST_CHECK((p_stats->ul_warnings == 2) && (p_stats->ul_passive == 2));
+
+	/* Held bus-off: the frames wait, the reset repeats. */
+	ul_seen = ul_frames_seen;
+	HOST_CHECK(fault_step("active -> bus-off (held)", 256, 0, 1, CAN_ERR_BUS_OFF) == 0);
+	for (i = 0; i < FAULT_FRAMES; i++)
+		HOST_CHECK(send_can_command(0x01000000, i, FAULT_ID, COMMAND_PRIO));
+	host_run_us(10 * HOST_TICK_US);
+	printf("held 1 s: %u resets, back-off %u ticks, %u frames sent, %u pending\n", p_stats->ul_resets,
+			p_stats->ul_backoff, ul_frames_seen - ul_seen, can_tx_pending());
+	HOST_CHECK(ul_frames_seen == ul_seen);
+	HOST_CHECK(p_stats->ul_resets >= 3);
+	HOST_CHECK(p_stats->ul_backoff > CAN_ERR_BACKOFF_MIN);
+
+	ul_resets = p_stats->ul_resets;
+	HOST_CHECK(fault_step("bus-off -> active", 0, 0, 0, CAN_ERR_ACTIVE) <= p_stats->ul_backoff + CAN_ERR_CHECK_TICKS);
+	host_run_us(HOST_TICK_US);
+	printf("recovered: %u recoveries, last %u ticks, %u frames sent, %u lost\n", p_stats->ul_recoveries,
+			p_stats->ul_last_recovery, ul_frames_seen - ul_seen, p_stats->ul_lost_frames);
+	HOST_CHECK(p_stats->ul_recoveries == 1);
+	HOST_CHECK(p_stats->ul_resets == ul_resets + 1);
+	HOST_CHECK(ul_frames_seen - ul_seen == FAULT_FRAMES);
+	HOST_CHECK(p_stats->ul_lost_frames == 0);
+
+	/* A bus-off which comes back in WARNING. */
+	host_run_us(CAN_ERR_STABLE_TICKS * HOST_TICK_US);
+	HOST_CHECK(fault_step("active -> bus-off", 256, 0, 1, CAN_ERR_BUS_OFF) == 0);
+	HOST_CHECK(fault_step("bus-off -> warning", 100, 0, 0, CAN_ERR_WARNING) <= CAN_ERR_BACKOFF_MIN + CAN_ERR_CHECK_TICKS);
+	HOST_CHECK(fault_step("warning -> active", 0, 0, 0, CAN_ERR_ACTIVE) <= CAN_ERR_POLL_TICKS);
+	HOST_CHECK(p_stats->ul_recoveries == 2);
+
+	/* The timer queue full when the error interrupt posts: the dispatch task
+	*  posts the command again, the states still come down. */
+	host_run_us(CAN_ERR_STABLE_TICKS * HOST_TICK_US);
+	host_timer_failures = 1;
+	HOST_CHECK(fault_step("active -> warning (queue full)", 100, 0, 0, CAN_ERR_WARNING) == 0);
+	HOST_CHECK(fault_step("warning -> active", 0, 0, 0, CAN_ERR_ACTIVE) <= CAN_ERR_POLL_TICKS);
+	HOST_CHECK(p_stats->ul_timer_retries == 1);
+
+	host_timer_failures = 3;
+	HOST_CHECK(fault_step("active -> bus-off (queue full)", 256, 0, 0, CAN_ERR_BUS_OFF) == 0);
+	HOST_CHECK(fault_step("bus-off -> active", 0, 0, 0, CAN_ERR_ACTIVE) <= CAN_ERR_BACKOFF_MIN + CAN_ERR_CHECK_TICKS + 2);
+	printf("queue full: %u timer commands posted again\n", p_stats->ul_timer_retries);
+	HOST_CHECK(p_stats->ul_timer_retries == 4);
+	HOST_CHECK(p_stats->ul_recoveries == 3);
+	HOST_CHECK(host_timer_failures == 0);
+
+	return host_done();
+}
@@ -0,0 +1,161 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_ext.c
+	*
+	*	PURPOSE:
+	*	Host test of the extended frames: the sequence numbers send_can_ext() puts
+	*	on the bus, and what can_ext_decode() makes of a stream with a frame missing,
+	*	received in CAN0 MB5 next to standard frames.
+	*
+	*	FILE REFERENCES:	host.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	CAN0 and CAN1 on separate buses, so only CAN0 sees the frames.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	Sending: frames to EXT_DST_A and EXT_DST_B, interleaved, must leave CAN0 with
+	*	29-bit IDs numbered 0, 1, 2 for the one and 0 for the other, with all 8 data
+	*	bytes as given.
+	*
+	*	Receiving: node EXT_SRC sends EXT_FRAMES extended frames of type EXT_TYPE,
+	*	numbered from 0 with number EXT_DROPPED left out, each followed by a standard
+	*	frame. The handler of the type must get every extended frame from MB5 with
+	*	its 8 bytes, the opcode handler every standard one from the receive FIFO,
+	*	and exactly one sequence gap must be counted.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+
+#define EXT_DST_A			SUB0_ID0
+#define EXT_DST_B			SUB0_ID1
+#define EXT_SRC				SUB0_ID2
+#define EXT_TYPE			0x42
+#define EXT_FRAMES			6
+#define EXT_DROPPED			3
+#define EXT_GAP_US			1000
+#define EXT_HIGH(n)			( 0xA5C30000 | ( n ) )		// Payload of frame n: no opcode word.
+#define EXT_LOW(n)			( 0x5A3C0000 | ( n ) )
+#define EXT_STD_OPCODE		0x7B5A5A5A
+#define EXT_STD_ID			CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, EXT_SRC, CAN_TYPE_CMD)
+
+static uint32_t ul_sent, ul_sent_mid[8], ul_sent_low[8], ul_sent_high[8];
+static uint8_t uc_sent_length[8];
+static uint32_t ul_ext_rx, ul_ext_seq[EXT_FRAMES], ul_ext_bad, ul_std_rx, ul_std_bad;
+
+/* Frames CAN0 sends. */
+static void ext_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	(void)uc_bus;
+	(void)uc_node;
+	if ((uc_ctrl != CAN_CTRL_0) || (ul_sent >= 8))
+		return;
+	ul_sent_mid[ul_sent] = p_frame->ul_mid;
+	ul_sent_low[ul_sent] = p_frame->ul_datal;
+	ul_sent_high[ul_sent] = p_frame->ul_datah;
+	uc_sent_length[ul_sent] = p_frame->uc_length;
+	ul_sent++;
+}
+
+static void ext_handler(const can_frame_t *p_frame)
+{
+	uint32_t ul_seq = CAN_EXT_SEQ(CAN_MID_TO_EXT_ID(p_frame->ul_id));
+
+	if ((CAN_FRAME_MB(p_frame) != CAN0_EXT_RX_MB) || (p_frame->uc_length != 8)
+			|| (p_frame->ul_datal != EXT_LOW(ul_seq)) || (p_frame->ul_datah != EXT_HIGH(ul_seq)))
+		ul_ext_bad++;
+	if (ul_ext_rx < EXT_FRAMES)
+		ul_ext_seq[ul_ext_rx] = ul_seq;
+	ul_ext_rx++;
+}
+
+static void ext_std_handler(const can_frame_t *p_frame)
+{
+	if ((p_frame->ul_id & CAN_MID_MIDE) || (CAN_FRAME_MB(p_frame) == CAN0_EXT_RX_MB))
+		ul_std_bad++;
+	ul_std_rx++;
+}
+
+int main(void)
+{
+	host_frame_t frame = { 0, 0, 0, 8, 0 };
+	uint32_t ul_id, ul_seq, ul_rx, n, i;
+	static const uint8_t uc_dst[4] = { EXT_DST_A, EXT_DST_B, EXT_DST_A, EXT_DST_A };
+	static const uint8_t uc_seq[4] = { 0, 0, 1, 2 };
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_set_frame_hook(ext_hook);
+	HOST_CHECK(can_register_ext_handler(CAN_CTRL_0, EXT_TYPE, ext_handler));
+	HOST_CHECK(can_register_handler(CAN_CTRL_0, EXT_STD_OPCODE, ext_std_handler));
+	host_run_us(1000);
+
+	/* One sequence per destination. */
+	for (i = 0; i < 4; i++)
+		HOST_CHECK(send_can_ext(CAN_EXT_ID(CAN_PRIO_DATA, uc_dst[i], CAN_NODE_OBC, EXT_TYPE, 0),
+				EXT_LOW(i), EXT_HIGH(i), 8, COMMAND_PRIO));
+	host_run_us(10 * EXT_GAP_US);
+	HOST_CHECK(ul_sent == 4);
+	for (i = 0; (i < 4) && (i < ul_sent); i++) {
+		ul_id = CAN_MID_TO_EXT_ID(ul_sent_mid[i]);
+		printf("sent: dst %u seq %u, %u bytes %08X %08X\n", CAN_EXT_DST(ul_id), CAN_EXT_SEQ(ul_id),
+				uc_sent_length[i], ul_sent_high[i], ul_sent_low[i]);
+		HOST_CHECK(ul_sent_mid[i] & CAN_MID_MIDE);
+		HOST_CHECK((CAN_EXT_DST(ul_id) == uc_dst[i]) && (CAN_EXT_SEQ(ul_id) == uc_seq[i]));
+		HOST_CHECK((CAN_EXT_TYPE(ul_id) == EXT_TYPE) && (CAN_EXT_SRC(ul_id) == CAN_NODE_OBC));
+		HOST_CHECK((uc_sent_length[i] == 8) && (ul_sent_low[i] == EXT_LOW(i)) && (ul_sent_high[i] == EXT_HIGH(i)));
+	}
+
+	/* A stream with one frame missing, standard frames in between. */
+	for (ul_seq = 0, n = 0; n < EXT_FRAMES; ul_seq++) {
+		if (ul_seq == EXT_DROPPED)
+			continue;
+		frame.ul_mid = CAN_MID_EXT(CAN_EXT_ID(CAN_PRIO_DATA, CAN_NODE_OBC, EXT_SRC, EXT_TYPE, ul_seq));
+		frame.ul_datal = EXT_LOW(ul_seq);
+		frame.ul_datah = EXT_HIGH(ul_seq);
+		HOST_CHECK(host_node_send(0, EXT_SRC, &frame, host_time_us() + EXT_GAP_US));
+		frame.ul_mid = CAN_MID_MIDvA(EXT_STD_ID);
+		frame.ul_datal = EXT_STD_OPCODE;
+		frame.ul_datah = ul_seq;
+		HOST_CHECK(host_node_send(0, EXT_SRC, &frame, host_time_us() + EXT_GAP_US));
+		host_run_us(2 * EXT_GAP_US);
+		n++;
+	}
+	host_run_us(HOST_TICK_US);
+
+	printf("received: %u extended (%u gaps), %u standard\n", ul_ext_rx, can_rx_stats.ul_ext_seq_gaps, ul_std_rx);
+	HOST_CHECK(ul_ext_rx == EXT_FRAMES);
+	HOST_CHECK(ul_std_rx == EXT_FRAMES);
+	HOST_CHECK(!ul_ext_bad && !ul_std_bad);
+	HOST_CHECK(can_rx_stats.ul_ext_frames == EXT_FRAMES);
+	HOST_CHECK(can_rx_stats.ul_ext_seq_gaps == 1);
+	for (i = 0, ul_rx = 0; i < EXT_FRAMES; i++, ul_rx++) {
+		if (ul_rx == EXT_DROPPED)
+			ul_rx++;
+		HOST_CHECK(ul_ext_seq[i] == ul_rx);
+	}
+	HOST_CHECK(host_bus_stats[0].ul_lost[0] == 0);
+
+	return host_done();
+}
@@ -0,0 +1,197 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_filter.c
+	*
+	*	PURPOSE:
+	*	Host check of the acceptance filter planner (can_filter.c): its false-accept
+	*	counts against a brute-force count over all 2048 standard IDs, and the plans
+	*	the driver loads into the reception mailboxes.
+	*
+	*	FILE REFERENCES:	host.h, can_filter.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		The CAN0 plans of the driver are checked against their subscription
+	*					lists, and their false accepts are counted and bounded.
+	*
+	*					Added the plans of the CAN0 list without one source node
+	*					(can_filter_plan_except()), as can_guard.c re-plans them.
+	*
+	*	DESCRIPTION:
+	*
+	*	For every plan: each subscribed ID must pass a filter (no false rejects),
+	*	and us_wanted, us_accepted and us_false_accepts must equal the counts taken
+	*	here independently. Checked on the first subscription list of the planner
+	*	(IDs 20 - 25), on random lists, and on the plans can_initialize() loads.
+	*	The CAN0 list without each subsystem source must plan into the two mailboxes
+	*	of its FIFO with none of that source's IDs accepted.
+	*
+ */
+
+#include "host.h"
+#include "can_filter.h"
+#include "can_pdo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FILTER_RANDOM_LISTS		2000
+#define FILTER_MAX_RANGES		6
+
+/* The CAN0 subscriptions of can_func.c: commands and replies, process data. */
+static const can_id_range_t driver_ranges[] = {
+	{ CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID0, 0), CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID5, 3) },
+	{ CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID0, 0), CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID5, 3) },
+};
+static const can_id_range_t driver_pdo_ranges[] = {
+	{ PDO_ID(SUB0_ID0, 0), PDO_ID(SUB0_ID5, CAN_PDO_PER_NODE - 1) },
+};
+
+static uint32_t filter_accepts(const can_filter_plan_t *p_plan, uint32_t ul_id)
+{
+	uint8_t i;
+
+	for (i = 0; i < p_plan->uc_count; i++) {
+		if ((ul_id & p_plan->filters[i].us_mask) == p_plan->filters[i].us_id)
+			return 1;
+	}
+	return 0;
+}
+
+/* Counts the plan's IDs by brute force; p_ranges = NULL skips the wanted set. */
+static void filter_verify(const can_id_range_t *p_ranges, uint32_t ul_count, const can_filter_plan_t *p_plan)
+{
+	uint32_t ul_id, ul_wanted = 0, ul_accepted = 0, ul_false = 0, ul_rejected = 0, i, ul_in;
+
+	for (ul_id = 0; ul_id <= CAN_STD_ID_MASK; ul_id++) {
+		for (i = 0, ul_in = 0; p_ranges && (i < ul_count); i++)
+			ul_in |= (ul_id >= p_ranges[i].us_first) && (ul_id <= p_ranges[i].us_last);
+		ul_wanted += ul_in;
+		if (filter_accepts(p_plan, ul_id)) {
+			ul_accepted++;
+			ul_false += !ul_in;
+		}
+		else
+			ul_rejected += ul_in;
+	}
+
+	HOST_CHECK(ul_accepted == p_plan->us_accepted);
+	if (p_ranges) {
+		HOST_CHECK(ul_rejected == 0);
+		HOST_CHECK(ul_wanted == p_plan->us_wanted);
+		HOST_CHECK(ul_false == p_plan->us_false_accepts);
+	}
+	else
+		HOST_CHECK(p_plan->us_accepted - p_plan->us_false_accepts == p_plan->us_wanted);
+}
+
+static void filter_print(const char *pc_name, const can_filter_plan_t *p_plan)
+{
+	uint8_t i;
+
+	printf("%-18s %u filters: %4u accepted, %4u wanted, %4u false (%u per mille)  ", pc_name,
+			p_plan->uc_count, p_plan->us_accepted, p_plan->us_wanted, p_plan->us_false_accepts,
+			CAN_FILTER_FALSE_RATE(p_plan));
+	for (i = 0; i < p_plan->uc_count; i++)
+		printf(" %03X/%03X", p_plan->filters[i].us_id, p_plan->filters[i].us_mask);
+	printf("\n");
+}
+
+int main(void)
+{
+	static const can_id_range_t first_list[] = { { 20, 25 } };
+	can_id_range_t ranges[FILTER_MAX_RANGES], without[CAN_FILTER_MAX_BLOCKS];
+	can_filter_t except;
+	can_filter_plan_t plan;
+	uint32_t ul_max, ul_count, ul_planned = 0, ul_false_total = 0, n, i;
+	char c_name[24];
+
+	/* The first CAN0 list: 16 accepted for 6 with one mailbox, exact with two. */
+	for (ul_max = 1; ul_max <= 3; ul_max++) {
+		HOST_CHECK(can_filter_plan(first_list, 1, ul_max, &plan));
+		filter_verify(first_list, 1, &plan);
+		snprintf(c_name, sizeof(c_name), "IDs 20-25, max %u", ul_max);
+		filter_print(c_name, &plan);
+		if (ul_max == 1)
+			HOST_CHECK((plan.us_accepted == 16) && (plan.us_false_accepts == 10));
+		else
+			HOST_CHECK(plan.us_false_accepts == 0);
+	}
+
+	/* Random lists of up to six ranges, one to four mailboxes. */
+	srand(8);
+	for (n = 0; n < FILTER_RANDOM_LISTS; n++) {
+		ul_count = 1 + rand() % FILTER_MAX_RANGES;
+		for (i = 0; i < ul_count; i++) {
+			ranges[i].us_first = (uint16_t)(rand() & CAN_STD_ID_MASK);
+			ranges[i].us_last = (uint16_t)(ranges[i].us_first + rand() % 64);
+			if (ranges[i].us_last > CAN_STD_ID_MASK)
+				ranges[i].us_last = CAN_STD_ID_MASK;
+		}
+		if (!can_filter_plan(ranges, ul_count, 1 + rand() % 4, &plan))
+			continue;
+		filter_verify(ranges, ul_count, &plan);
+		ul_planned++;
+		ul_false_total += plan.us_false_accepts;
+	}
+	printf("random lists: %u planned, %.1f false accepts per plan on average\n", ul_planned,
+			(double)ul_false_total / ul_planned);
+	HOST_CHECK(ul_planned > FILTER_RANDOM_LISTS * 9 / 10);
+
+	/* The CAN0 list without one source, as the receive guard plans it. */
+	except.us_mask = (uint16_t)CAN_ID(0, 0, 0x7, 0);
+	for (n = SUB0_ID0; n <= SUB0_ID5; n++) {
+		except.us_id = (uint16_t)CAN_ID(0, 0, n, 0);
+		ul_count = can_filter_subtract(driver_ranges, sizeof(driver_ranges) / sizeof(driver_ranges[0]), &except, 1,
+				without, CAN_FILTER_MAX_BLOCKS);
+		HOST_CHECK(ul_count > 0);
+		HOST_CHECK(!can_filter_plan_except(without, ul_count, &except, 1, 1, &plan));
+		HOST_CHECK(can_filter_plan_except(without, ul_count, &except, 1, 2, &plan));
+		filter_verify(without, ul_count, &plan);
+		snprintf(c_name, sizeof(c_name), "CAN0 without %u", n);
+		filter_print(c_name, &plan);
+		for (i = 0; i <= CAN_STD_ID_MASK; i++)
+			HOST_CHECK((CAN_ID_SRC(i) != n) || !filter_accepts(&plan, i));
+	}
+
+	/* What the driver loads. */
+	host_init(0);
+	can_initialize();
+	filter_verify(driver_ranges, sizeof(driver_ranges) / sizeof(driver_ranges[0]), &can_rx_plan[CAN_CTRL_0]);
+	filter_print("driver CAN0", &can_rx_plan[CAN_CTRL_0]);
+	filter_verify(driver_pdo_ranges, 1, &can_rx_pdo_plan);
+	filter_print("driver CAN0 PDO", &can_rx_pdo_plan);
+	if (can_rx_plan[CAN_CTRL_1].uc_count) {
+		filter_verify(NULL, 0, &can_rx_plan[CAN_CTRL_1]);
+		filter_print("driver CAN1", &can_rx_plan[CAN_CTRL_1]);
+	}
+	printf("driver CAN0 in all: %u wanted, %u false accepts (one filter for both lists: 56)\n",
+			can_rx_plan[CAN_CTRL_0].us_wanted + can_rx_pdo_plan.us_wanted,
+			can_rx_plan[CAN_CTRL_0].us_false_accepts + can_rx_pdo_plan.us_false_accepts);
+	HOST_CHECK(can_rx_plan[CAN_CTRL_0].us_wanted + can_rx_pdo_plan.us_wanted == 72);
+	HOST_CHECK(can_rx_plan[CAN_CTRL_0].us_false_accepts + can_rx_pdo_plan.us_false_accepts <= 24);
+	/* No class 7 (test IDs) and no PDO frame in the FIFO. */
+	for (i = CAN_ID(7, 0, 0, 0); i <= CAN_STD_ID_MASK; i++)
+		HOST_CHECK(!filter_accepts(&can_rx_plan[CAN_CTRL_0], i) && !filter_accepts(&can_rx_pdo_plan, i));
+	HOST_CHECK(!filter_accepts(&can_rx_plan[CAN_CTRL_0], PDO_ID(SUB0_ID0, 0)));
+
+	return host_done();
+}
@@ -0,0 +1,300 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_guard.c
+	*
+	*	PURPOSE:
+	*	Host flood-injection test of the receive guard (can_guard.c): the token bucket
+	*	of a node, the re-plan of the filters without it, a healthy node sharing its
+	*	mailbox, bulk data at the bus rate, the isolation of a mailbox when the
+	*	controller's budget runs out and the cooldowns, and the refill after a silence
+	*	longer than the wrap of the cycle counter.
+	*
+	*	FILE REFERENCES:	host.h, can_guard.h, can_filter.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Times are simulated: 250 kbit/s, 444 us for an 8-byte frame, ticks of 100 ms.
+	*	The cycle counter follows the simulated time (84 cycles per us), so it wraps
+	*	every 2^32 / 84 us = 51.13 s as on the SAM3X.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		A bystander node sends alongside the babbler and must get every frame
+	*					through; the babbler's frames are dropped, not isolated. Added the
+	*					flood of empty frames which goes over CAN_GUARD_CPU_RATE.
+	*
+	*	10/17/2026		A babbler is now filtered out by the controller (host_bus_stats
+	*					ul_unmatched). Added the bulk-data run at the bus rate; the flood which
+	*					isolates a mailbox is now of extended frames from a node the filters
+	*					cannot refuse, and must leave the bystander alone.
+	*
+	*	DESCRIPTION:
+	*
+	*	One node (the babbler) sends housekeeping replies to CAN0 at a fixed rate for
+	*	GUARD_RUN_US, and a second node (the bystander) one every GUARD_BY_GAP_US; its
+	*	ID wins arbitration, so a full bus still lets it on. Both go to the same
+	*	reception FIFO. Below CAN_GUARD_RATE every frame of the babbler must get
+	*	through. Above it the babbler gets at most its bucket, CAN_GUARD_BURST plus
+	*	CAN_GUARD_RATE per second, and is filtered out for a cooldown each time its
+	*	bucket runs dry: most of its frames must be refused by the controller, never
+	*	read by the CPU, and the bystander must get every frame through. The same
+	*	holds for a flood of empty frames.
+	*	The babbler then sends bulk data (class CAN_PRIO_DATA) at GUARD_DATA_RATE, twice
+	*	the rate of a node, which must all get through (the full bus rate is in
+	*	test_transport.c).
+	*	Then node GUARD_EXT_SRC, which only has an extended source, floods empty
+	*	extended test frames, over 5000 a second: the filters cannot refuse it, so the
+	*	extended mailbox must be isolated, the frames the CPU reads must stay within
+	*	the controller's bucket, the bystander must get every frame through, and once
+	*	the flood stops the mailbox and the filters must be back within a cooldown.
+	*	Last, the babbler empties its bucket, stays silent for one wrap of the cycle
+	*	counter plus GUARD_WRAP_EXTRA_US, and sends a full burst, which must all get
+	*	through.
+	*
+ */
+
+#include "host.h"
+#include "can_guard.h"
+#include "can_filter.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define GUARD_RUN_US		5000000ULL
+#define GUARD_STEP_US		10000ULL
+#define GUARD_FRAME_US		444
+#define GUARD_EMPTY_US		188				// 47 bits, no data.
+#define GUARD_FULL_RATE		2252			// 1 s / 444 us.
+#define GUARD_NODE			1				// Sim nodes on bus 0.
+#define GUARD_BY_NODE		2
+#define GUARD_SRC			( HK_NODE_FIRST + 1 )
+#define GUARD_BY_SRC		HK_NODE_FIRST	// Lower source, wins arbitration.
+#define GUARD_EXT_SRC		9				// Extended frames only.
+#define GUARD_HK_MID		CAN_MID_MIDvA(HK_REPLY_ID(GUARD_SRC))
+#define GUARD_DATA_MID		CAN_MID_MIDvA(CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, GUARD_SRC, CAN_TYPE_DATA))
+#define GUARD_EXT_MID		CAN_MID_EXT(CAN_EXT_ID(CAN_PRIO_TEST, CAN_NODE_OBC, GUARD_EXT_SRC, 0, 0))
+#define GUARD_DATA_RATE		2000			// Bulk data, with room left for the bystander, whose class it outranks.
+#define GUARD_BY_GAP_US		20000ULL		// 50 frames/s.
+#define GUARD_QUEUE_MAX		128				// Of the 256 a sim node holds.
+#define GUARD_WRAP_US		51130563ULL		// 2^32 cycles at 84 MHz.
+#define GUARD_WRAP_EXTRA_US	10000ULL		// Aliased refill: 10 frames' worth.
+
+typedef struct {
+	uint32_t ul_offered;
+	uint32_t ul_accepted;		// Charged to the babbler and let through.
+	uint32_t ul_dropped;		// Over the babbler's budget.
+	uint32_t ul_by_sent;
+	uint32_t ul_by_accepted;	// The bystander's frames let through.
+	uint32_t ul_refused;		// Refused by the filters.
+	uint32_t ul_filtered;		// Re-plans which filtered the babbler out.
+	uint32_t ul_isolations;		// Over the controller's budget, each isolated a mailbox.
+	uint32_t ul_releases;
+	uint32_t ul_entries;		// CAN0 handler entries.
+	uint32_t ul_unseen;			// Frames the isolated mailboxes kept from the CPU.
+} guard_result_t;
+
+/* Frames ul_mid of uc_length bytes from the babbler, ull_gap_us apart, for
+*  ull_run_us from now, and with p_by_sent one frame from the bystander every
+*  GUARD_BY_GAP_US. A frame which would find GUARD_QUEUE_MAX frames still
+*  waiting in the babbler (a full bus) is not sent. Returns the frames the
+*  babbler sent, once all of them are on the bus. */
+static uint32_t guard_send(uint64_t ull_run_us, uint64_t ull_gap_us, uint32_t ul_mid, uint8_t uc_length,
+		uint32_t *p_by_sent)
+{
+	host_frame_t reply = { ul_mid, HK_RETURNED, 0, uc_length, 0 };
+	host_frame_t by = { CAN_MID_MIDvA(HK_REPLY_ID(GUARD_BY_SRC)), HK_RETURNED, 0, 8, 0 };
+	uint64_t ull_next = host_time_us(), ull_by_next = host_time_us() + GUARD_BY_GAP_US / 2;
+	uint64_t ull_end = host_time_us() + ull_run_us;
+	uint32_t ul_sent = 0, ul_wait;
+
+	while (host_time_us() < ull_end) {
+		while ((ull_next < host_time_us() + GUARD_STEP_US) && (ull_next < ull_end)) {
+			if (host_node_queued(0, GUARD_NODE) < GUARD_QUEUE_MAX) {
+				reply.ul_datah = ul_sent++;
+				HOST_CHECK(host_node_send(0, GUARD_NODE, &reply, ull_next));
+			}
+			ull_next += ull_gap_us;
+		}
+		while (p_by_sent && (ull_by_next < host_time_us() + GUARD_STEP_US) && (ull_by_next < ull_end)) {
+			by.ul_datah = (*p_by_sent)++;
+			HOST_CHECK(host_node_send(0, GUARD_BY_NODE, &by, ull_by_next));
+			ull_by_next += GUARD_BY_GAP_US;
+		}
+		host_run_us(GUARD_STEP_US);
+	}
+	for (ul_wait = 0; (ul_wait < 2 * GUARD_QUEUE_MAX)
+			&& (host_node_queued(0, GUARD_NODE) || host_node_queued(0, GUARD_BY_NODE)); ul_wait++)
+		host_run_us(GUARD_FRAME_US);
+	host_run_us(GUARD_FRAME_US);
+	return ul_sent;
+}
+
+static void guard_run(uint32_t ul_rate, uint32_t ul_mid, uint8_t uc_length, guard_result_t *p_res)
+{
+	volatile can_guard_stats_t *p_stats = &can_guard_stats[CAN_CTRL_0];
+	uint32_t ul_accepted, ul_dropped, ul_by, ul_filtered, ul_isolations, ul_releases, ul_lost, ul_refused;
+	uint64_t ull_gap = 1000000ULL / ul_rate;
+	uint8_t uc_src = CAN_MID_IS_EXT(ul_mid) ? CAN_EXT_SRC(CAN_MID_TO_EXT_ID(ul_mid)) : CAN_ID_SRC(CAN_MID_TO_ID(ul_mid));
+
+	ul_accepted = p_stats->node[uc_src].ul_frames;
+	ul_dropped = p_stats->node[uc_src].ul_dropped;
+	ul_by = p_stats->node[GUARD_BY_SRC].ul_frames;
+	ul_filtered = p_stats->ul_filtered;
+	ul_isolations = p_stats->ul_isolations;
+	ul_releases = p_stats->ul_releases;
+	ul_lost = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0];
+	ul_refused = host_bus_stats[0].ul_unmatched[CAN_CTRL_0];
+	memset(host_irq_stats, 0, sizeof(host_irq_stats));
+
+	if ((uc_length == 8) && (ul_rate >= GUARD_FULL_RATE))
+		ull_gap = GUARD_FRAME_US;
+	if (!uc_length && (ull_gap < GUARD_EMPTY_US))
+		ull_gap = GUARD_EMPTY_US;
+	p_res->ul_by_sent = 0;
+	p_res->ul_offered = guard_send(GUARD_RUN_US, ull_gap, ul_mid, uc_length, &p_res->ul_by_sent);
+
+	p_res->ul_accepted = p_stats->node[uc_src].ul_frames - ul_accepted;
+	p_res->ul_dropped = p_stats->node[uc_src].ul_dropped - ul_dropped;
+	p_res->ul_by_accepted = p_stats->node[GUARD_BY_SRC].ul_frames - ul_by;
+	p_res->ul_refused = host_bus_stats[0].ul_unmatched[CAN_CTRL_0] - ul_refused;
+	p_res->ul_filtered = p_stats->ul_filtered - ul_filtered;
+	p_res->ul_isolations = p_stats->ul_isolations - ul_isolations;
+	p_res->ul_releases = p_stats->ul_releases - ul_releases;
+	p_res->ul_entries = host_irq_stats[HOST_IRQ_CAN0].ul_entries;
+	p_res->ul_unseen = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0] - ul_lost;
+}
+
+/* Waits for the cooldowns to end; returns the ticks waited. */
+static uint32_t guard_wait_release(void)
+{
+	uint32_t ul_ticks;
+
+	for (ul_ticks = 0; (can_rx_isolated[CAN_CTRL_0] || can_guard_nodes_out[CAN_CTRL_0])
+			&& (ul_ticks <= CAN_GUARD_COOLDOWN_TICKS + 1); ul_ticks++)
+		host_run_us(HOST_TICK_US);
+	return ul_ticks;
+}
+
+static void guard_print(const char *pc_kind, const guard_result_t *p_res, uint32_t ul_secs)
+{
+	printf("%-6s %6u    %6u      %6u     %6u    %4u of %4u   %4u    %5u     %5u      %6u       %6u\n", pc_kind,
+			p_res->ul_offered / ul_secs, p_res->ul_accepted / ul_secs, p_res->ul_dropped / ul_secs,
+			p_res->ul_refused / ul_secs, p_res->ul_by_accepted, p_res->ul_by_sent, p_res->ul_filtered,
+			p_res->ul_isolations, p_res->ul_releases, p_res->ul_entries / ul_secs, p_res->ul_unseen / ul_secs);
+}
+
+/* A babbler the filters can refuse: nothing isolated, the bystander untouched,
+*  every frame accounted for. */
+static void guard_check_filtered(const guard_result_t *p_res, uint32_t ul_rate, uint32_t ul_secs)
+{
+	HOST_CHECK(p_res->ul_accepted + p_res->ul_dropped + p_res->ul_refused == p_res->ul_offered);
+	HOST_CHECK((p_res->ul_isolations == 0) && (p_res->ul_unseen == 0));
+	HOST_CHECK(p_res->ul_by_sent > 0);
+	HOST_CHECK(p_res->ul_by_accepted == p_res->ul_by_sent);
+	if (ul_rate < CAN_GUARD_RATE) {
+		HOST_CHECK(p_res->ul_accepted == p_res->ul_offered);
+		HOST_CHECK((p_res->ul_dropped == 0) && (p_res->ul_filtered == 0));
+	}
+	else {
+		/* Within the bucket; the rest mostly refused before the CPU sees it. */
+		HOST_CHECK(p_res->ul_accepted <= CAN_GUARD_BURST + CAN_GUARD_RATE * ul_secs);
+		HOST_CHECK(p_res->ul_filtered > 0);
+		HOST_CHECK(2 * (p_res->ul_accepted + p_res->ul_dropped) < p_res->ul_offered);
+	}
+	/* One handler entry per frame at most. */
+	HOST_CHECK(p_res->ul_entries <= p_res->ul_accepted + p_res->ul_dropped + p_res->ul_by_sent);
+}
+
+int main(void)
+{
+	static const uint32_t ul_rates[] = { 100, 500, 900, 1500, 2000, GUARD_FULL_RATE };
+	volatile can_guard_node_stats_t *p_node = &can_guard_stats[CAN_CTRL_0].node[GUARD_SRC];
+	guard_result_t res;
+	uint32_t ul_secs = (uint32_t)(GUARD_RUN_US / 1000000), ul_ticks, ul_accepted, ul_dropped, r;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+
+	printf("a babbler and a bystander on CAN0 for %u s (simulated); guard %u frames/s per node (%u of bulk data), "
+			"%u per controller, burst %u, cooldown %u ticks\n", ul_secs, CAN_GUARD_RATE, CAN_GUARD_DATA_RATE,
+			CAN_GUARD_CPU_RATE, CAN_GUARD_BURST, CAN_GUARD_COOLDOWN_TICKS);
+	printf("frames offered/s accepted/s dropped/s refused/s  bystander  re-plans isolations cooldowns "
+			"CAN0 entries/s  unseen/s\n");
+	for (r = 0; r < sizeof(ul_rates) / sizeof(ul_rates[0]); r++) {
+		guard_run(ul_rates[r], GUARD_HK_MID, 8, &res);
+		guard_print("8-byte", &res, ul_secs);
+		guard_check_filtered(&res, ul_rates[r], ul_secs);
+	}
+
+	/* Empty frames back to back: the filters take them as well. */
+	guard_run(GUARD_FULL_RATE * 3, GUARD_HK_MID, 0, &res);
+	guard_print("empty", &res, ul_secs);
+	guard_check_filtered(&res, GUARD_FULL_RATE * 3, ul_secs);
+	HOST_CHECK(guard_wait_release() <= CAN_GUARD_COOLDOWN_TICKS);
+
+	/* Bulk data at twice a node's rate: all of it. */
+	guard_run(GUARD_DATA_RATE, GUARD_DATA_MID, 8, &res);
+	guard_print("data", &res, ul_secs);
+	HOST_CHECK(res.ul_offered > (GUARD_DATA_RATE - 10) * ul_secs);
+	HOST_CHECK((res.ul_accepted == res.ul_offered) && (res.ul_dropped == 0) && (res.ul_refused == 0));
+	HOST_CHECK(res.ul_by_accepted == res.ul_by_sent);
+
+	/* Empty extended frames from a node the filters cannot refuse: more than
+	*  the controller's budget, so its mailbox is isolated. */
+	guard_run(GUARD_FULL_RATE * 3, GUARD_EXT_MID, 0, &res);
+	guard_print("ext", &res, ul_secs);
+	HOST_CHECK(res.ul_isolations > 0);
+	HOST_CHECK(res.ul_unseen > 0);
+	HOST_CHECK(res.ul_filtered == 0);
+	HOST_CHECK(can_guard_stats[CAN_CTRL_0].ul_unfiltered > 0);
+	HOST_CHECK(res.ul_releases <= 2 * (ul_secs * configTICK_RATE_HZ / CAN_GUARD_COOLDOWN_TICKS + 1));
+	/* The frames the CPU reads stay within the controller's bucket, and the
+	*  bystander's mailboxes are not the isolated one. */
+	HOST_CHECK(res.ul_accepted + res.ul_dropped + res.ul_by_accepted
+			<= CAN_GUARD_BURST + CAN_GUARD_CPU_RATE * ul_secs);
+	HOST_CHECK(res.ul_by_accepted == res.ul_by_sent);
+	HOST_CHECK(res.ul_entries <= res.ul_accepted + res.ul_dropped + res.ul_by_accepted + res.ul_isolations);
+
+	/* The flood has stopped: the mailbox and the filters come back within a cooldown. */
+	ul_ticks = guard_wait_release();
+	printf("isolated mailboxes released %u ticks after the flood\n", ul_ticks);
+	HOST_CHECK((can_rx_isolated[CAN_CTRL_0] == 0) && (can_guard_nodes_out[CAN_CTRL_0] == 0));
+	HOST_CHECK(ul_ticks <= CAN_GUARD_COOLDOWN_TICKS);
+	HOST_CHECK(can_rx_plan[CAN_CTRL_0].uc_count == CAN0_RX_MB_COUNT);
+	guard_run(500, GUARD_HK_MID, 8, &res);
+	HOST_CHECK((res.ul_accepted == res.ul_offered) && (res.ul_dropped == 0));
+	HOST_CHECK(res.ul_by_accepted == res.ul_by_sent);
+
+	/* Empty the bucket, stay silent for one wrap of the cycle counter and a bit,
+	*  then send a full burst back to back. */
+	guard_send((CAN_GUARD_BURST + 20) * GUARD_FRAME_US, GUARD_FRAME_US, GUARD_HK_MID, 8, NULL);
+	HOST_CHECK(p_node->ul_dropped > 0);
+	host_run_us(GUARD_WRAP_US + GUARD_WRAP_EXTRA_US);
+	ul_accepted = p_node->ul_frames;
+	ul_dropped = p_node->ul_dropped;
+	HOST_CHECK(guard_send(CAN_GUARD_BURST * GUARD_FRAME_US, GUARD_FRAME_US, GUARD_HK_MID, 8, NULL) == CAN_GUARD_BURST);
+	printf("after %.2f s of silence: %u of a %u-frame burst accepted, %u dropped\n",
+			(GUARD_WRAP_US + GUARD_WRAP_EXTRA_US) / 1e6, p_node->ul_frames - ul_accepted, CAN_GUARD_BURST,
+			p_node->ul_dropped - ul_dropped);
+	HOST_CHECK(p_node->ul_frames - ul_accepted == CAN_GUARD_BURST);
+	HOST_CHECK(p_node->ul_dropped == ul_dropped);
+
+	return host_done();
+}
@@ -0,0 +1,256 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_gw.c
+	*
+	*	PURPOSE:
+	*	Host test of the CAN0 <-> CAN1 gateway (can_gw.c): forwarding latency and the
+	*	highest rate it sustains without loss, with the payload bus idle and with other
+	*	traffic on it.
+	*
+	*	FILE REFERENCES:	host.h, can_gw.h, can_guard.h, can_capture.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Built with CAN_GW_ENABLE (test_gw_DEFS in the Makefile). Times are simulated:
+	*	250 kbit/s on both buses, 444 us for an 8-byte frame, interrupt handlers take
+	*	no simulated time. The latency is therefore the bus part of it (waiting for
+	*	the payload bus and the frame itself), not the handler cycles of the SAM3X.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					Checks the capture record of a forwarded frame.
+	*
+	*	DESCRIPTION:
+	*
+	*	A node on the platform bus (bus 0) sends payload commands at a fixed rate,
+	*	which rule 0 forwards to the payload bus (bus 1). A second node on the payload
+	*	bus sends class 0 frames (which win arbitration over the forwarded ones) at a
+	*	fixed share of the bus. The latency of a frame runs from the end of the frame
+	*	on bus 0 to the end of the forwarded one on bus 1. The commands rotate over
+	*	four source fields, so the receive guard (1000 frames/s per source) does not
+	*	limit them.
+	*	Last, the payload data rule (CAN1 -> CAN0, 50 frames per tick) is offered
+	*	twice its limit.
+	*	The capture record of a forwarded frame, whose data are read back from its
+	*	mailbox, must hold the ID, data and length which went on the payload bus.
+	*
+ */
+
+#include "host.h"
+#include "can_gw.h"
+#include "can_guard.h"
+#include "can_capture.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define GW_RUN_US			5000000ULL
+#define GW_STEP_US			10000ULL
+#define GW_FRAME_US			444
+#define GW_SOURCES			4
+#define GW_FULL_RATE		2252			// 1 s / 444 us.
+#define GW_SEQ_MAX			32768
+
+#define GW_SRC_NODE			1				// Sim node on bus 0.
+#define GW_LOAD_NODE		2				// Sim node on bus 1.
+#define GW_CMD_ID(src)		CAN_ID(CAN_PRIO_PAYLOAD_CMD, 2, ( src ), CAN_TYPE_CMD)
+#define GW_LOAD_ID			CAN_ID(CAN_PRIO_IMMED, 5, 6, CAN_TYPE_CMD)
+#define GW_DATA_ID			CAN_ID(CAN_PRIO_DATA, 2, 3, CAN_TYPE_CMD)
+
+/* End of each source frame on bus 0, by sequence number (high word). */
+static uint64_t ull_sent_at[GW_SEQ_MAX];
+static uint32_t ul_src_sent, ul_fwd, ul_data_fwd;
+static uint64_t ull_lat_sum, ull_lat_min, ull_lat_max;
+
+static void gw_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	uint32_t ul_id = CAN_MID_TO_ID(p_frame->ul_mid);
+	uint64_t ull_lat;
+
+	if ((uc_bus == 0) && (uc_node == GW_SRC_NODE) && (CAN_ID_CLASS(ul_id) == CAN_PRIO_PAYLOAD_CMD)) {
+		ull_sent_at[p_frame->ul_datah % GW_SEQ_MAX] = host_time_us();
+		ul_src_sent++;
+	}
+	else if ((uc_bus == 1) && (uc_ctrl == CAN_CTRL_1) && (CAN_ID_CLASS(ul_id) == CAN_PRIO_PAYLOAD_CMD)) {
+		ull_lat = host_time_us() - ull_sent_at[p_frame->ul_datah % GW_SEQ_MAX];
+		if (!ul_fwd || (ull_lat < ull_lat_min))
+			ull_lat_min = ull_lat;
+		if (ull_lat > ull_lat_max)
+			ull_lat_max = ull_lat;
+		ull_lat_sum += ull_lat;
+		ul_fwd++;
+	}
+	else if ((uc_bus == 0) && (uc_ctrl == CAN_CTRL_0) && (CAN_ID_CLASS(ul_id) == CAN_PRIO_DATA))
+		ul_data_fwd++;
+}
+
+typedef struct {
+	uint32_t ul_offered;		// Frames sent on bus 0.
+	uint32_t ul_forwarded;
+	uint32_t ul_dropped;		// Gateway FIFO full.
+	uint32_t ul_high_water;
+	double d_lat_mean;
+	uint32_t ul_lat_min, ul_lat_max;
+} gw_result_t;
+
+/* ul_rate frames/s from bus 0 (GW_FULL_RATE: back to back) against ul_load
+*  per cent of bus 1 taken by class 0 frames, for GW_RUN_US. */
+static void gw_run(uint32_t ul_rate, uint32_t ul_load, gw_result_t *p_res)
+{
+	host_frame_t cmd = { 0, 0x01000000, 0, 8, 0 }, load = { CAN_MID_MIDvA(GW_LOAD_ID), 0, 0, 8, 0 };
+	uint64_t ull_start, ull_end, ull_next_cmd, ull_next_load, ull_cmd_gap, ull_load_gap;
+	uint32_t ul_seq = 0, ul_dropped, ul_fwd0, ul_sent0;
+
+	host_run_us(200000);					// Drain the last run.
+	ul_dropped = can_gw_stats.dir[CAN_CTRL_1].ul_dropped;
+	can_gw_stats.dir[CAN_CTRL_1].ul_high_water = 0;
+	ul_fwd0 = ul_fwd;
+	ul_sent0 = ul_src_sent;
+	ull_lat_sum = 0;
+	ull_lat_max = 0;
+
+	ull_cmd_gap = (ul_rate >= GW_FULL_RATE) ? GW_FRAME_US : 1000000ULL / ul_rate;
+	ull_load_gap = ul_load ? GW_FRAME_US * 100ULL / ul_load : 0;
+	ull_start = host_time_us();
+	ull_end = ull_start + GW_RUN_US;
+	ull_next_cmd = ull_start;
+	ull_next_load = ull_start;
+
+	while (host_time_us() < ull_end) {
+		/* Queue what is due in the next step. */
+		while ((ull_next_cmd < host_time_us() + GW_STEP_US) && (ull_next_cmd < ull_end)) {
+			cmd.ul_mid = CAN_MID_MIDvA(GW_CMD_ID(1 + ul_seq % GW_SOURCES));
+			cmd.ul_datah = ul_seq++;
+			HOST_CHECK(host_node_send(0, GW_SRC_NODE, &cmd, ull_next_cmd));
+			ull_next_cmd += ull_cmd_gap;
+		}
+		if (ul_load) {
+			while ((ull_next_load < host_time_us() + GW_STEP_US) && (ull_next_load < ull_end)) {
+				HOST_CHECK(host_node_send(1, GW_LOAD_NODE, &load, ull_next_load));
+				ull_next_load += ull_load_gap;
+			}
+		}
+		host_run_us(GW_STEP_US);
+	}
+	host_run_us(200000);
+
+	p_res->ul_offered = ul_src_sent - ul_sent0;
+	p_res->ul_forwarded = ul_fwd - ul_fwd0;
+	p_res->ul_dropped = can_gw_stats.dir[CAN_CTRL_1].ul_dropped - ul_dropped;
+	p_res->ul_high_water = can_gw_stats.dir[CAN_CTRL_1].ul_high_water;
+	p_res->d_lat_mean = p_res->ul_forwarded ? (double)ull_lat_sum / p_res->ul_forwarded : 0;
+	p_res->ul_lat_min = (uint32_t)ull_lat_min;
+	p_res->ul_lat_max = (uint32_t)ull_lat_max;
+}
+
+static uint32_t gw_get32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void gw_print(uint32_t ul_rate, uint32_t ul_load, const gw_result_t *p_res)
+{
+	double d_secs = GW_RUN_US / 1e6;
+
+	printf("%6u    %3u%%   %7.0f    %7.0f   %6u    %2u     %4u %7.0f %6u\n", ul_rate, ul_load,
+			p_res->ul_offered / d_secs, p_res->ul_forwarded / d_secs, p_res->ul_dropped,
+			p_res->ul_high_water, p_res->ul_lat_min, p_res->d_lat_mean, p_res->ul_lat_max);
+}
+
+int main(void)
+{
+	static const uint32_t ul_rates[] = { 100, 500, 1000, 1100, 1500, 1600, 2000, GW_FULL_RATE };
+	static const uint32_t ul_loads[] = { 0, 25, 50 };
+	host_frame_t data = { CAN_MID_MIDvA(GW_DATA_ID), 0, 0, 8, 0 };
+	host_frame_t cmd = { CAN_MID_MIDvA(GW_CMD_ID(1)), 0x01A5C3E1, 0x5A3C1E0F, 6, 0 };
+	static uint8_t uc_block[CAN_CAPTURE_MAX_SIZE];
+	const uint8_t *p_rec;
+	gw_result_t res, best[3];
+	uint32_t ul_best[3], l, r, i, ul_limited, ul_bytes, ul_tx = 0;
+	uint64_t ull_base;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_set_frame_hook(gw_hook);
+	host_run_us(1000);
+
+	printf("offered  bus 1   offered/s  fwd/s    dropped  FIFO   latency us (bus 0 end -> bus 1 end)\n");
+	printf("frames/s  load                                 max    min    mean    max\n");
+	for (l = 0; l < 3; l++) {
+		ul_best[l] = 0;
+		for (r = 0; r < sizeof(ul_rates) / sizeof(ul_rates[0]); r++) {
+			gw_run(ul_rates[r], ul_loads[l], &res);
+			gw_print(ul_rates[r], ul_loads[l], &res);
+			HOST_CHECK(res.ul_forwarded + res.ul_dropped == res.ul_offered);
+			if (!res.ul_dropped && (res.ul_forwarded >= ul_best[l])) {
+				ul_best[l] = res.ul_forwarded;
+				best[l] = res;
+			}
+		}
+	}
+	printf("highest rate forwarded without loss: %.0f frames/s (bus 1 idle), %.0f (25%% load), %.0f (50%% load)\n",
+			ul_best[0] / (GW_RUN_US / 1e6), ul_best[1] / (GW_RUN_US / 1e6), ul_best[2] / (GW_RUN_US / 1e6));
+
+	/* Idle payload bus: every frame, up to a full platform bus, one frame time
+	*  plus at most one more behind the frame ahead. */
+	HOST_CHECK(ul_best[0] >= 2250 * GW_RUN_US / 1000000);
+	HOST_CHECK(best[0].ul_lat_min == GW_FRAME_US);
+	HOST_CHECK(best[0].ul_lat_max <= 2 * GW_FRAME_US);
+	/* With half of the payload bus taken, the rest is what is left. */
+	HOST_CHECK(ul_best[1] >= 1600 * GW_RUN_US / 1000000);
+	HOST_CHECK(ul_best[2] >= 1100 * GW_RUN_US / 1000000);
+	HOST_CHECK(ul_best[2] < 1250 * GW_RUN_US / 1000000);
+
+	/* Payload data, CAN1 -> CAN0: 1000 frames/s offered, the rule lets 50 per
+	*  tick through. */
+	ul_data_fwd = 0;
+	ul_limited = can_gw_stats.rule[1].ul_rate_limited;
+	ull_base = host_time_us();
+	for (i = 0; i < 1000; i++) {
+		data.ul_mid = CAN_MID_MIDvA(CAN_ID(CAN_PRIO_DATA, 2, 3 + i % 2, CAN_TYPE_CMD));
+		HOST_CHECK(host_node_send(1, GW_LOAD_NODE, &data, ull_base + i * 1000ULL));
+		if (host_node_queued(1, GW_LOAD_NODE) > 200)
+			host_run_us(100000);
+	}
+	host_run_us(1200000);
+	printf("payload data rule: 1000 frames/s offered for 1 s, %u forwarded, %u rate-limited\n", ul_data_fwd,
+			can_gw_stats.rule[1].ul_rate_limited - ul_limited);
+	HOST_CHECK((ul_data_fwd >= 450) && (ul_data_fwd <= 550));
+	HOST_CHECK(ul_data_fwd + can_gw_stats.rule[1].ul_rate_limited - ul_limited == 1000);
+
+	/* The capture of a forwarded frame. */
+	host_run_us(200000);
+	can_capture_start();
+	HOST_CHECK(host_node_send(0, GW_SRC_NODE, &cmd, host_time_us()));
+	host_run_us(10000);
+	can_capture_stop();
+	ul_bytes = can_capture_read(uc_block, sizeof(uc_block));
+	for (p_rec = uc_block + CAN_CAPTURE_HEADER_SIZE; p_rec < uc_block + ul_bytes; p_rec += CAN_CAPTURE_REC_SIZE) {
+		if (!(p_rec[18] & CAN_CAPTURE_TX) || !(p_rec[18] & (1u << 3)))
+			continue;
+		printf("forwarded frame captured: id %08X data %08X %08X length %u\n", gw_get32(p_rec + 4),
+				gw_get32(p_rec + 12), gw_get32(p_rec + 8), p_rec[19]);
+		HOST_CHECK(gw_get32(p_rec + 4) == cmd.ul_mid);
+		HOST_CHECK((gw_get32(p_rec + 8) == cmd.ul_datal) && (gw_get32(p_rec + 12) == cmd.ul_datah));
+		HOST_CHECK(p_rec[19] == cmd.uc_length);
+		ul_tx++;
+	}
+	HOST_CHECK(ul_tx == 1);
+
+	return host_done();
+}
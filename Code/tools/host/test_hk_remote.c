@@ -0,0 +1,170 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_hk_remote.c
+	*
+	*	PURPOSE:
+	*	Host test of the remote-frame housekeeping (can_hk.c): a sweep, a node which
+	*	misses one and the age of the data it left behind, and the mailboxes it shares
+	*	with the time-triggered schedule.
+	*
+	*	FILE REFERENCES:	host.h, can_hk.h, can_tt.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	CAN0 and CAN1 on one bus, as on the bench. The simulation has no producer
+	*	mailboxes: the test answers each remote frame from the frame hook, as the
+	*	producer mailbox of the subsystem would.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	The consumer mailboxes are CAN1 MB2 - MB7, the slots of the time-triggered
+	*	schedule: each of the two must refuse to start while the other runs, and
+	*	remote housekeeping while a test program holds one of the mailboxes. The
+	*	schedule must not start while a test program holds CAN1 MB1, and holds it
+	*	while it runs.
+	*	Then a sweep which every node answers, a sweep which HK_SILENT misses (it is
+	*	counted at the next sweep, its data stay readable and grow older) and the
+	*	sweeps of the timer.
+	*
+ */
+
+#include "host.h"
+#include "can_hk.h"
+#include "can_tt.h"
+
+#include <stdio.h>
+
+#define HK_SILENT			( HK_NODE_FIRST + 3 )
+#define HK_ANSWER_US		200					// Producer turnaround after the remote frame.
+#define HK_SWEEP_US			20000
+#define HK_TIMER_TICKS		2
+
+static uint32_t ul_silent, ul_remotes[HK_NODE_FIRST + HK_NODE_COUNT], ul_sweep;
+
+static const can_tt_slot_t hk_tt_slot = { CAN_TT_MARK_US(32768UL), 1, 0, HK_REQUEST_ID(HK_NODE_FIRST), HK_REQUEST, HK_REQUEST };
+
+/* The producer mailboxes of the subsystems: data = node, sweep. */
+static void hk_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	host_frame_t data = { 0, 0, 0, 8, 0 };
+	uint32_t ID;
+
+	(void)uc_node;
+	if ((uc_ctrl != CAN_CTRL_1) || !p_frame->uc_rtr)
+		return;
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++) {
+		if (p_frame->ul_mid != CAN_MID_MIDvA(HK_REMOTE_ID(ID)))
+			continue;
+		ul_remotes[ID]++;
+		if (ul_silent & (1u << ID))
+			continue;
+		data.ul_mid = p_frame->ul_mid;
+		data.ul_datal = ID;
+		data.ul_datah = ul_sweep;
+		HOST_CHECK(host_node_send(uc_bus, (uint8_t)ID, &data, host_time_us() + HK_ANSWER_US));
+	}
+}
+
+/* One sweep; returns the number of nodes whose data are from it. */
+static uint32_t hk_sweep(void)
+{
+	uint32_t ul_low, ul_high, ul_fresh = 0, ID;
+	TickType_t xAge;
+
+	ul_sweep++;
+	HOST_CHECK(hk_remote_sweep());
+	host_run_us(HK_SWEEP_US);
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++) {
+		if (hk_remote_get(ID, &ul_low, &ul_high, &xAge) && (ul_low == ID) && (ul_high == ul_sweep))
+			ul_fresh++;
+	}
+	return ul_fresh;
+}
+
+int main(void)
+{
+	volatile hk_stats_t *p_stats = &hk_stats;
+	uint32_t ul_low, ul_high, ul_sweeps, ID;
+	TickType_t xAge;
+
+	host_init(0);
+	can_initialize();
+	host_set_frame_hook(hk_hook);
+	host_run_us(1000);
+
+	/* Nothing before the start, and not over the schedule or a test program. */
+	HOST_CHECK(!hk_remote_sweep());
+	HOST_CHECK(!hk_remote_get(HK_NODE_FIRST, &ul_low, &ul_high, &xAge));
+	HOST_CHECK(can_mailbox_claim(CAN1, 1, CAN_OWNER_TEST));
+	HOST_CHECK(!can_tt_start(&hk_tt_slot, 1));				// CAN1 MB1 is live.
+	HOST_CHECK(can_mailbox_release(CAN1, 1, CAN_OWNER_TEST));
+	HOST_CHECK(can_tt_start(&hk_tt_slot, 1));
+	HOST_CHECK(!hk_remote_start(0));
+	HOST_CHECK(!can_mailbox_claim(CAN1, 1, CAN_OWNER_TEST));
+	can_tt_stop();
+	HOST_CHECK(can_mailbox_claim(CAN1, HK_REMOTE_MB_FIRST + 1, CAN_OWNER_TEST));
+	HOST_CHECK(!hk_remote_start(0));
+	HOST_CHECK(can_mailbox_release(CAN1, HK_REMOTE_MB_FIRST + 1, CAN_OWNER_TEST));
+	HOST_CHECK(hk_remote_start(0));
+	HOST_CHECK(!can_tt_start(&hk_tt_slot, 1));
+
+	/* Every node answers. */
+	HOST_CHECK(hk_sweep() == HK_NODE_COUNT);
+	printf("sweep 1: %u replies, %u missed\n", p_stats->ul_remote_replies, p_stats->ul_remote_missed);
+	HOST_CHECK(p_stats->ul_remote_replies == HK_NODE_COUNT);
+	HOST_CHECK(p_stats->ul_remote_missed == 0);
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++) {
+		HOST_CHECK(ul_remotes[ID] == 1);
+		HOST_CHECK(hk_remote_get(ID, &ul_low, &ul_high, &xAge) && (xAge == 0));
+	}
+
+	/* One node misses a sweep: its data are those of sweep 1 and age. */
+	host_run_us(3 * HOST_TICK_US);
+	ul_silent = 1u << HK_SILENT;
+	HOST_CHECK(hk_sweep() == HK_NODE_COUNT - 1);
+	HOST_CHECK(p_stats->ul_remote_missed == 0);			// Counted at the next sweep.
+	HOST_CHECK(hk_remote_get(HK_SILENT, &ul_low, &ul_high, &xAge));
+	printf("silent node: data of sweep %u, %u ticks old\n", ul_high, xAge);
+	HOST_CHECK((ul_low == HK_SILENT) && (ul_high == 1));
+	HOST_CHECK(xAge == 3);
+
+	ul_silent = 0;
+	HOST_CHECK(hk_sweep() == HK_NODE_COUNT);
+	printf("sweep 3: %u replies, %u missed\n", p_stats->ul_remote_replies, p_stats->ul_remote_missed);
+	HOST_CHECK(p_stats->ul_remote_missed == 1);
+	HOST_CHECK(p_stats->ul_remote_replies == 3 * HK_NODE_COUNT - 1);
+	HOST_CHECK(hk_remote_get(HK_SILENT, &ul_low, &ul_high, &xAge) && (ul_high == 3) && (xAge == 0));
+
+	/* Sweeps from the timer; the schedule may start once it is stopped. */
+	hk_remote_stop();
+	HOST_CHECK(hk_remote_start(HK_TIMER_TICKS));
+	ul_sweeps = p_stats->ul_remote_sweeps;
+	host_run_us(10 * HK_TIMER_TICKS * HOST_TICK_US);
+	ul_sweeps = p_stats->ul_remote_sweeps - ul_sweeps;
+	printf("timer: %u sweeps in %u ticks\n", ul_sweeps, 10 * HK_TIMER_TICKS);
+	HOST_CHECK(ul_sweeps == 10);
+	HOST_CHECK(p_stats->ul_remote_replies == (3 + ul_sweeps) * HK_NODE_COUNT - 1);
+	hk_remote_stop();
+	HOST_CHECK(!hk_remote_sweep());
+	HOST_CHECK(can_tt_start(&hk_tt_slot, 1));
+	can_tt_stop();
+
+	return host_done();
+}
@@ -0,0 +1,127 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_hk_rtt.c
+	*
+	*	PURPOSE:
+	*	Host test of the housekeeping round-trip statistics (hk_get_rtt()), taken
+	*	from the simulated controller timestamps of a request and its reply.
+	*
+	*	FILE REFERENCES:	host.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	CAN0 and CAN1 on one bus, as on the bench. CAN_TIM counts bit times
+	*	(HOST_BIT_US = CAN_TIMESTAMP_US), so a time stamp is exact to one of them.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	The frame hook answers every housekeeping request to RTT_NODE at the end of
+	*	the request frame plus the delay of the round, so the controller stamps the
+	*	request and the reply rtt_delay[] + the reply frame apart. Three rounds give
+	*	the minimum, maximum and mean; a fourth round answered two ticks late must
+	*	only count in ul_overrange, its data still delivered.
+	*
+ */
+
+#include "host.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+
+#define RTT_NODE			SUB0_ID2
+#define RTT_ROUNDS			3
+#define RTT_LATE_US			( 2 * HOST_TICK_US + 10000 )
+
+static const uint32_t rtt_delay[RTT_ROUNDS] = { 1000, 3000, 2000 };
+static uint32_t ul_round, ul_reply_us;
+
+/* The subsystem: the reply leaves the delay of the round after the request. */
+static void rtt_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	host_frame_t reply = { CAN_MID_MIDvA(HK_REPLY_ID(RTT_NODE)), HK_RETURNED, 0, 8, 0 };
+
+	(void)uc_node;
+	if ((uc_ctrl != CAN_CTRL_0) || (p_frame->ul_mid != CAN_MID_MIDvA(HK_REQUEST_ID(RTT_NODE))))
+		return;
+	reply.ul_datah = ul_round;
+	ul_reply_us = host_frame_bits(&reply) * HOST_BIT_US;
+	HOST_CHECK(host_node_send(uc_bus, RTT_NODE, &reply,
+			host_time_us() + ((ul_round < RTT_ROUNDS) ? rtt_delay[ul_round] : RTT_LATE_US)));
+}
+
+/* One request and its reply; returns the housekeeping data collected. */
+static uint32_t rtt_round(uint64_t ull_run_us)
+{
+	uint32_t ul_low, ul_high = 0xFFFFFFFF;
+
+	HOST_CHECK(request_housekeeping(RTT_NODE));
+	host_run_us(ull_run_us);
+	HOST_CHECK(wait_housekeeping(RTT_NODE, &ul_low, &ul_high, 0));
+	ul_round++;
+	return ul_high;
+}
+
+int main(void)
+{
+	hk_rtt_t rtt;
+	uint32_t ul_min, ul_max, ul_sum = 0, ul_replies, i;
+
+	host_init(0);
+	can_initialize();
+	host_set_frame_hook(rtt_hook);
+	host_run_us(1000);
+	hk_clear_rtt();
+
+	/* Known delays: request to reply is the delay plus the reply frame. */
+	for (i = 0; i < RTT_ROUNDS; i++) {
+		HOST_CHECK(rtt_round(HOST_TICK_US / 2) == i);
+		HOST_CHECK(hk_get_rtt(RTT_NODE, &rtt) && (rtt.ul_count == i + 1));
+		printf("round %u: delay %u us + reply %u us, rtt %u us\n", i, rtt_delay[i], ul_reply_us, rtt.ul_last_us);
+		HOST_CHECK(rtt.ul_last_us == rtt_delay[i] + ul_reply_us);
+		ul_sum += rtt_delay[i] + ul_reply_us;
+	}
+	ul_min = ul_max = rtt_delay[0];
+	for (i = 1; i < RTT_ROUNDS; i++) {
+		ul_min = (rtt_delay[i] < ul_min) ? rtt_delay[i] : ul_min;
+		ul_max = (rtt_delay[i] > ul_max) ? rtt_delay[i] : ul_max;
+	}
+	printf("min %u  max %u  mean %u us\n", rtt.ul_min_us, rtt.ul_max_us, rtt.ul_sum_us / rtt.ul_count);
+	HOST_CHECK(rtt.ul_min_us == ul_min + ul_reply_us);
+	HOST_CHECK(rtt.ul_max_us == ul_max + ul_reply_us);
+	HOST_CHECK(rtt.ul_sum_us == ul_sum);
+	HOST_CHECK(rtt.ul_sum_us / rtt.ul_count == ul_sum / RTT_ROUNDS);
+	HOST_CHECK(rtt.ul_overrange == 0);
+
+	/* Later than one tick: out of range of the CAN timer, only counted. */
+	ul_replies = hk_stats.ul_replies;
+	HOST_CHECK(rtt_round(RTT_LATE_US + HOST_TICK_US) == RTT_ROUNDS);
+	HOST_CHECK(hk_get_rtt(RTT_NODE, &rtt));
+	printf("late reply: %u overrange, %u timed\n", rtt.ul_overrange, rtt.ul_count);
+	HOST_CHECK(rtt.ul_overrange == 1);
+	HOST_CHECK(rtt.ul_count == RTT_ROUNDS);
+	HOST_CHECK(rtt.ul_sum_us == ul_sum);
+	HOST_CHECK(hk_stats.ul_replies == ul_replies + 1);
+
+	/* Cleared. */
+	hk_clear_rtt();
+	HOST_CHECK(hk_get_rtt(RTT_NODE, &rtt) && !rtt.ul_count && !rtt.ul_overrange && !rtt.ul_sum_us);
+
+	return host_done();
+}
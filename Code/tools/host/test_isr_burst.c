@@ -0,0 +1,115 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_isr_burst.c
+	*
+	*	PURPOSE:
+	*	Host benchmark of the CAN handler (can_mailbox_isr() in can_func.c): interrupt
+	*	entries and cycles per frame when 1, 4 or 8 mailboxes are ready at once.
+	*
+	*	FILE REFERENCES:	host.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Cycles are host TSC cycles of the x86 build, not SAM3X cycles.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	CAN1 gets seven more reception mailboxes (MB1 - MB7) with the filter of the
+	*	driver's MB0, so a burst of up to 8 frames lands in 8 mailboxes. The CAN1
+	*	interrupt is held off in the NVIC while the burst is on the bus, as a higher
+	*	priority handler or a critical section would, then let go: one handler entry
+	*	should then take all of them.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BURST_REPEAT		2000
+#define BURST_GAP_US		20000				// Keeps the node under its receive budget.
+
+static void burst_setup(void)
+{
+	can_mb_conf_t mailbox;
+	uint8_t i;
+
+	for (i = 1; i < CANMB_NUMBER; i++) {
+		HOST_CHECK(can_mailbox_claim(CAN1, i, CAN_OWNER_TEST));
+		reset_mailbox_conf(&mailbox);
+		mailbox.ul_mb_idx = i;
+		mailbox.uc_obj_type = CAN_MB_RX_MODE;
+		mailbox.ul_id_msk = CAN_MAM_MIDvA_Msk;
+		mailbox.ul_id = CAN_MID_MIDvA(NODE0_ID);
+		HOST_CHECK(can_mailbox_setup(CAN1, &mailbox, CAN_OWNER_TEST));
+		can_enable_interrupt(CAN1, 1u << i);
+	}
+}
+
+static void burst_run(uint8_t uc_burst)
+{
+	host_frame_t frame = { CAN_MID_MIDvA(NODE0_ID), 0xE6000000, 0, 8, 0 };
+	uint32_t ul_frames, ul_entries, ul_disp, ul_cycles, n;
+	uint8_t i;
+
+	host_run_us(BURST_GAP_US);
+	ul_frames = can_rx_stats.ul_frames;
+	ul_entries = can_rx_stats.ul_isr_entries;
+	ul_cycles = can_rx_stats.ul_isr_cycles;
+	ul_disp = can_rx_stats.ul_dispatched;
+	memset(&host_irq_stats[HOST_IRQ_CAN1], 0, sizeof(host_irq_stats[0]));
+
+	for (n = 0; n < BURST_REPEAT; n++) {
+		NVIC_DisableIRQ(CAN1_IRQn);
+		for (i = 0; i < uc_burst; i++) {
+			frame.ul_datah = i;
+			host_node_send(1, 0, &frame, 0);
+		}
+		host_run_us((uint64_t)uc_burst * host_frame_bits(&frame) * HOST_BIT_US);
+		NVIC_EnableIRQ(CAN1_IRQn);
+		host_run_us(BURST_GAP_US);
+	}
+
+	ul_frames = can_rx_stats.ul_frames - ul_frames;
+	ul_entries = can_rx_stats.ul_isr_entries - ul_entries;
+	ul_cycles = can_rx_stats.ul_isr_cycles - ul_cycles;
+	printf("burst %u: %u frames, %.3f interrupts/frame, %.0f host cycles/frame (99.9%% of entries under %u)\n",
+			uc_burst, ul_frames, (double)ul_entries / ul_frames, (double)ul_cycles / ul_frames,
+			host_irq_percentile(HOST_IRQ_CAN1, 999));
+
+	HOST_CHECK(ul_frames == (uint32_t)uc_burst * BURST_REPEAT);
+	HOST_CHECK(ul_entries == BURST_REPEAT);
+	HOST_CHECK(can_rx_stats.ul_dispatched - ul_disp == ul_frames);
+	HOST_CHECK(host_bus_stats[1].ul_lost[1] == 0);
+}
+
+int main(void)
+{
+	host_init(HOST_SEPARATE_BUSES | HOST_CYCLES_HOST);
+	can_initialize();
+	burst_setup();
+
+	burst_run(1);
+	burst_run(4);
+	burst_run(8);
+
+	return host_done();
+}
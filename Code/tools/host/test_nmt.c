@@ -0,0 +1,292 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_nmt.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the heartbeat service (can_nmt.c): ALIVE with the first
+	*	heartbeat, DEAD at the deadline, ALIVE again with the next heartbeat, the
+	*	listener events of each change, and the housekeeping sweep leaving DEAD
+	*	nodes out of both its requests and its collection.
+	*
+	*	FILE REFERENCES:	host.h, can_nmt.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		The sweeps are collected by a task with collect_housekeeping_all(),
+	*					which must report a node left out of the sweep as not valid without
+	*					waiting for it.
+	*
+	*					request_housekeeping() marks the node for the collection as well; a
+	*					DEAD node is left out of it all the same.
+	*
+	*	DESCRIPTION:
+	*
+	*	The test runs one tick at a time. Nodes SUB0_ID0 - SUB0_ID2 send a heartbeat
+	*	every CAN_NMT_PERIOD_TICKS; SUB0_ID3 - SUB0_ID5 never do and stay UNKNOWN.
+	*	SUB0_ID2 then stops: it must stay ALIVE up to the tick before its deadline,
+	*	CAN_NMT_TIMEOUT_TICKS after its last heartbeat was taken, and be DEAD from
+	*	that tick on, with one DEAD event. A housekeeping sweep must then request
+	*	the five other nodes (the UNKNOWN ones included) and not SUB0_ID2. When
+	*	SUB0_ID2 beats again it is ALIVE, with an event, and swept again.
+	*
+	*	Every node answers the requests which reach it. The sweeps are run by a task,
+	*	request_housekeeping_all() then collect_housekeeping_all(). Before SUB0_ID2
+	*	dies, a request of its own is answered and never waited for, and once it is
+	*	DEAD another is left unanswered. Both mark it for the next collection, which
+	*	must still report it not valid while it is DEAD, neither with the old reply
+	*	nor after waiting out the window.
+	*
+ */
+
+#include "host.h"
+#include "can_nmt.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+
+#define NMT_DYING			SUB0_ID2
+#define NMT_BEATING			( ( 1u << SUB0_ID0 ) | ( 1u << SUB0_ID1 ) | ( 1u << NMT_DYING ) )
+#define NMT_EVENTS			32
+#define NMT_BEAT_US			1000				// Heartbeat sent this far into its tick.
+#define NMT_REPLY_US		300					// Housekeeping reply this long after the request.
+#define NMT_WINDOW			5					// Ticks collect_housekeeping_all() may wait.
+
+typedef struct {
+	uint8_t uc_node;
+	uint8_t uc_state;
+	TickType_t xTick;
+} nmt_event_t;
+
+static nmt_event_t nmt_events[NMT_EVENTS];
+static uint32_t ul_events;
+static uint32_t ul_requests[CAN_NMT_NODES];		// Housekeeping requests seen on the bus, per node.
+static TickType_t xLastBeat[CAN_NMT_NODES];		// Tick at which each node's last heartbeat was taken.
+static TickType_t xPhase;
+static uint32_t ul_silent;						// Nodes which no longer answer housekeeping.
+
+/* Sweep of the housekeeping task. */
+static volatile uint32_t ul_sweep_go;
+static uint32_t ul_sweep_requested, ul_sweep_valid, ul_sweep_count;
+static TickType_t xSweepTicks;
+static hk_result_t sweep_results[HK_NODE_COUNT];
+
+/************************************************************************/
+/*				HOUSEKEEPING                                            */
+/************************************************************************/
+
+/* prvHouseKeepTask2() of housekeep_test2.c, one sweep per ul_sweep_go. */
+static void nmt_hk_task(void *pvParameters)
+{
+	TickType_t xStart;
+
+	(void)pvParameters;
+	for (;;) {
+		vTaskDelay(1);
+		if (!ul_sweep_go)
+			continue;
+		ul_sweep_count++;
+		ul_sweep_requested = request_housekeeping_all();
+		xStart = xTaskGetTickCount();
+		ul_sweep_valid = collect_housekeeping_all(sweep_results, NMT_WINDOW);
+		xSweepTicks = xTaskGetTickCount() - xStart;
+		ul_sweep_go = 0;
+	}
+}
+
+static void nmt_listener(uint8_t uc_node, uint8_t uc_state)
+{
+	if (ul_events < NMT_EVENTS) {
+		nmt_events[ul_events].uc_node = uc_node;
+		nmt_events[ul_events].uc_state = uc_state;
+		nmt_events[ul_events].xTick = xTaskGetTickCount();
+	}
+	ul_events++;
+}
+
+/* Housekeeping requests sent by CAN0, each answered by its node (unless it
+*  is in ul_silent) with the number of requests it has had. */
+static void nmt_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	host_frame_t reply = { 0, HK_RETURNED, 0, 8, 0 };
+	uint32_t ID;
+
+	(void)uc_bus;
+	(void)uc_node;
+	if ((uc_ctrl != CAN_CTRL_0) || (p_frame->ul_datal != HK_REQUEST))
+		return;
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++) {
+		if (p_frame->ul_mid != CAN_MID_MIDvA(HK_REQUEST_ID(ID)))
+			continue;
+		ul_requests[ID]++;
+		if (ul_silent & (1u << ID))
+			continue;
+		reply.ul_mid = CAN_MID_MIDvA(HK_REPLY_ID(ID));
+		reply.ul_datah = ul_requests[ID];
+		HOST_CHECK(host_node_send(0, (uint8_t)ID, &reply, host_time_us() + NMT_REPLY_US));
+	}
+}
+
+/* ul_ticks ticks, the nodes of ul_beating sending their heartbeats. */
+static void nmt_run(uint32_t ul_beating, uint32_t ul_ticks)
+{
+	host_frame_t frame = { 0, NMT_HEARTBEAT, CAN_NMT_ALIVE, 8, 0 };
+	uint32_t ID, i;
+
+	for (i = 0; i < ul_ticks; i++) {
+		if (((xTaskGetTickCount() - xPhase) % CAN_NMT_PERIOD_TICKS) == 0) {
+			for (ID = 0; ID < CAN_NMT_NODES; ID++) {
+				if (!(ul_beating & (1u << ID)))
+					continue;
+				frame.ul_mid = CAN_MID_MIDvA(NMT_HEARTBEAT_ID(ID));
+				HOST_CHECK(host_node_send(0, (uint8_t)ID, &frame, host_time_us() + NMT_BEAT_US));
+				xLastBeat[ID] = xTaskGetTickCount();
+			}
+		}
+		host_run_us(HOST_TICK_US);
+	}
+}
+
+/* One sweep of the housekeeping task: returns the requests queued, with
+*  ul_requests counting the ones which reached the bus. Every node which
+*  was requested must be in the results with its reply. */
+static uint32_t nmt_sweep(void)
+{
+	uint32_t ul_count = ul_sweep_count, i;
+
+	ul_sweep_go = 1;
+	for (i = 0; (i < 4 * NMT_WINDOW) && ul_sweep_go; i++)
+		host_run_us(HOST_TICK_US);
+	HOST_CHECK(!ul_sweep_go && (ul_sweep_count == ul_count + 1));
+	HOST_CHECK(ul_sweep_valid == ul_sweep_requested);
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (sweep_results[i].ul_valid)
+			HOST_CHECK(sweep_results[i].ul_datah == ul_requests[HK_NODE_FIRST + i]);
+	}
+	return ul_sweep_requested;
+}
+
+int main(void)
+{
+	uint32_t ul_before[CAN_NMT_NODES], ul_skipped, ul_count, ID, i;
+	TickType_t xDeadline;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	HOST_CHECK(can_nmt_register_listener(nmt_listener));
+	xTaskCreate(nmt_hk_task, "hk", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 2, NULL);
+	host_set_frame_hook(nmt_hook);
+	host_run_us(1000);
+	xPhase = xTaskGetTickCount();
+
+	for (ID = 0; ID < CAN_NMT_NODES; ID++)
+		HOST_CHECK(can_nmt_state(ID) == CAN_NMT_UNKNOWN);
+
+	/* First heartbeats: ALIVE, one event each. */
+	nmt_run(NMT_BEATING, 2 * CAN_NMT_PERIOD_TICKS);
+	HOST_CHECK(can_nmt_alive_mask() == NMT_BEATING);
+	HOST_CHECK(ul_events == 3);
+	for (i = 0; (i < ul_events) && (i < NMT_EVENTS); i++) {
+		HOST_CHECK(nmt_events[i].uc_state == CAN_NMT_ALIVE);
+		HOST_CHECK(NMT_BEATING & (1u << nmt_events[i].uc_node));
+	}
+	HOST_CHECK(can_nmt_stats.ul_heartbeats == 3 * 2);
+
+	/* Every node swept while all are alive or unknown. */
+	memcpy(ul_before, ul_requests, sizeof(ul_before));
+	ul_skipped = hk_stats.ul_skipped_dead;
+	HOST_CHECK(nmt_sweep() == HK_NODE_COUNT);
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++)
+		HOST_CHECK(ul_requests[ID] == ul_before[ID] + 1);
+	HOST_CHECK(hk_stats.ul_skipped_dead == ul_skipped);
+
+	/* A request of NMT_DYING's own, answered, which nobody waits for. */
+	HOST_CHECK(request_housekeeping(NMT_DYING));
+	host_run_us(HOST_TICK_US);
+
+	/* NMT_DYING stops: ALIVE up to the tick before its deadline, DEAD at it. */
+	xDeadline = xLastBeat[NMT_DYING] + CAN_NMT_TIMEOUT_TICKS;
+	while (xTaskGetTickCount() < xDeadline - 1)
+		nmt_run(NMT_BEATING & ~(1u << NMT_DYING), 1);
+	HOST_CHECK(can_nmt_state(NMT_DYING) == CAN_NMT_ALIVE);
+	HOST_CHECK(ul_events == 3);
+	nmt_run(NMT_BEATING & ~(1u << NMT_DYING), 1);
+	printf("last heartbeat at tick %u, deadline %u: DEAD at tick %u\n", (unsigned)xLastBeat[NMT_DYING],
+			(unsigned)xDeadline, (ul_events > 3) ? (unsigned)nmt_events[3].xTick : 0);
+	HOST_CHECK(can_nmt_state(NMT_DYING) == CAN_NMT_DEAD);
+	HOST_CHECK(ul_events == 4);
+	HOST_CHECK((nmt_events[3].uc_node == NMT_DYING) && (nmt_events[3].uc_state == CAN_NMT_DEAD));
+	HOST_CHECK(nmt_events[3].xTick == xDeadline);
+	HOST_CHECK(can_nmt_alive_mask() == (NMT_BEATING & ~(1u << NMT_DYING)));
+	HOST_CHECK(can_nmt_stats.ul_to_dead == 1);
+
+	/* The sweep leaves the DEAD node out, the UNKNOWN ones in. */
+	memcpy(ul_before, ul_requests, sizeof(ul_before));
+	ul_skipped = hk_stats.ul_skipped_dead;
+	ul_count = nmt_sweep();
+	printf("sweep with node %u DEAD: %u requests, %u skipped\n", NMT_DYING, ul_count,
+			hk_stats.ul_skipped_dead - ul_skipped);
+	HOST_CHECK(ul_count == HK_NODE_COUNT - 1);
+	HOST_CHECK(hk_stats.ul_skipped_dead == ul_skipped + 1);
+	for (ID = HK_NODE_FIRST; ID < HK_NODE_FIRST + HK_NODE_COUNT; ID++)
+		HOST_CHECK(ul_requests[ID] == ul_before[ID] + (ID != NMT_DYING));
+
+	/* Not valid, not the reply to its own request. */
+	printf("collected: %u valid, node %u %s, %u ticks\n", ul_sweep_valid, NMT_DYING,
+			sweep_results[NMT_DYING - HK_NODE_FIRST].ul_valid ? "valid" : "not valid", (unsigned)xSweepTicks);
+	HOST_CHECK(!sweep_results[NMT_DYING - HK_NODE_FIRST].ul_valid);
+	HOST_CHECK(xSweepTicks < NMT_WINDOW);
+
+	/* A request of its own while DEAD, never answered: the next sweep does not
+	*  wait for it. */
+	ul_silent = (1u << NMT_DYING);
+	HOST_CHECK(request_housekeeping(NMT_DYING));
+	ul_count = nmt_sweep();
+	printf("collected with a request to node %u pending: %u valid, %u ticks\n", NMT_DYING, ul_sweep_valid,
+			(unsigned)xSweepTicks);
+	HOST_CHECK(ul_count == HK_NODE_COUNT - 1);
+	HOST_CHECK(!sweep_results[NMT_DYING - HK_NODE_FIRST].ul_valid);
+	HOST_CHECK(xSweepTicks < NMT_WINDOW);
+
+	/* Still DEAD, with no further event, while it stays silent. */
+	nmt_run(NMT_BEATING & ~(1u << NMT_DYING), 2 * CAN_NMT_TIMEOUT_TICKS);
+	HOST_CHECK(can_nmt_state(NMT_DYING) == CAN_NMT_DEAD);
+	HOST_CHECK(ul_events == 4);
+
+	/* It beats again: ALIVE, one event, swept again. */
+	ul_silent = 0;
+	nmt_run(NMT_BEATING, CAN_NMT_PERIOD_TICKS);
+	HOST_CHECK(can_nmt_state(NMT_DYING) == CAN_NMT_ALIVE);
+	HOST_CHECK(ul_events == 5);
+	HOST_CHECK((nmt_events[4].uc_node == NMT_DYING) && (nmt_events[4].uc_state == CAN_NMT_ALIVE));
+	HOST_CHECK(can_nmt_stats.ul_to_alive == 4);
+	HOST_CHECK(can_nmt_alive_mask() == NMT_BEATING);
+	memcpy(ul_before, ul_requests, sizeof(ul_before));
+	HOST_CHECK(nmt_sweep() == HK_NODE_COUNT);
+	HOST_CHECK(ul_requests[NMT_DYING] == ul_before[NMT_DYING] + 1);
+
+	for (ID = SUB0_ID3; ID <= SUB0_ID5; ID++)
+		HOST_CHECK(can_nmt_state(ID) == CAN_NMT_UNKNOWN);
+	HOST_CHECK(can_nmt_stats.ul_invalid == 0);
+	printf("%u heartbeats, %u events (%u to ALIVE, %u to DEAD)\n", can_nmt_stats.ul_heartbeats, ul_events,
+			can_nmt_stats.ul_to_alive, can_nmt_stats.ul_to_dead);
+
+	return host_done();
+}
@@ -0,0 +1,147 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_pdo.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the process-data unpack (can_pdo.c): sign extension,
+	*	scaling and field bounds of every frame of the mapping, against values
+	*	worked out by hand.
+	*
+	*	FILE REFERENCES:	host.h, can_pdo.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The expected values follow the mapping table of can_pdo.c and must be
+	*	changed with it.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	Each case is one frame from a simulated node, through the CAN0 mailboxes and
+	*	the dispatch task, and the signals can_pdo_read_frame() then gives for it.
+	*	The cases take fields to their limits: the most negative and most positive
+	*	two's complement values, -1 (the shift rounds toward minus infinity), a
+	*	field across the ul_datal / ul_datah boundary, and set bits next to every
+	*	field, which must not leak into it.
+	*
+	*	A frame shorter than its mapping and a frame number with no mapping must
+	*	be counted and leave the store as it was.
+	*
+ */
+
+#include "host.h"
+#include "can_pdo.h"
+
+#include <stdio.h>
+
+#define PDO_GAP_US			1000
+
+typedef struct {
+	const char *pc_name;
+	uint8_t uc_node;
+	uint8_t uc_pdo;
+	uint8_t uc_length;
+	uint32_t ul_datal;
+	uint32_t ul_datah;
+	uint8_t uc_count;
+	int32_t l_expected[4];
+} pdo_case_t;
+
+static const pdo_case_t pdo_cases[] = {
+	/* EPS 0: bus mV u16, bus mA s16, battery 0.1 C s12 * 5 >> 3, SOC u7; bits 51 - 63 set. */
+	{ "EPS 0 limits",	SUB0_ID0, 0, 7, 0x8000FFFF, 0xFFFFF800, 4, { 65535, -32768, -1280, 127 } },
+	{ "EPS 0 limits +",	SUB0_ID0, 0, 7, 0x7FFF0000, 0x000007FF, 4, { 0, 32767, 1279, 0 } },
+	{ "EPS 0 minus 1",	SUB0_ID0, 0, 8, 0x00000000, 0x00000FFF, 4, { 0, 0, -1, 0 } },
+	/* EPS 1: four u12 panels * 2, the third across the word boundary. */
+	{ "EPS 1 panels",	SUB0_ID0, 1, 6, 0xBC001FFF, 0xFFFF123A, 4, { 8190, 2, 5496, 582 } },
+	/* COMS 0: RSSI s8, PA u10 * 5 >> 1 - 400, locked u1; bits 19 - 63 set. */
+	{ "COMS 0 limits",	SUB0_ID1, 0, 3, 0xFFFFFF80, 0xFFFFFFFF, 3, { -128, 2157, 1 } },
+	{ "COMS 0 zero",	SUB0_ID1, 0, 3, 0x00000000, 0x00000000, 3, { 0, -400, 0 } },
+	/* Payload 0: two s16 temperatures * 125 >> 5, pressure u24 * 2; bits 56 - 63 set. */
+	{ "PAY 0 limits",	SUB0_ID2, 0, 7, 0x01008000, 0xFFFFFFFF, 3, { -128000, 1000, 33554430 } },
+	{ "PAY 0 minus 1",	SUB0_ID2, 0, 7, 0x7FFFFFFF, 0xFF000000, 3, { -4, 127996, 0 } },
+};
+#define PDO_CASES			( sizeof(pdo_cases) / sizeof(pdo_cases[0]) )
+
+static void pdo_send(uint8_t uc_node, uint8_t uc_pdo, uint8_t uc_length, uint32_t ul_datal, uint32_t ul_datah)
+{
+	host_frame_t frame;
+
+	frame.ul_mid = CAN_MID_MIDvA(PDO_ID(uc_node, uc_pdo));
+	frame.ul_datal = ul_datal;
+	frame.ul_datah = ul_datah;
+	frame.uc_length = uc_length;
+	frame.uc_rtr = 0;
+	HOST_CHECK(host_node_send(0, 0, &frame, host_time_us() + PDO_GAP_US));
+	host_run_us(2 * PDO_GAP_US);
+}
+
+/* Checks the signals of a frame against l_expected. */
+static void pdo_check(const char *pc_name, uint8_t uc_node, uint8_t uc_pdo, uint8_t uc_count, const int32_t *l_expected)
+{
+	int32_t l_values[CAN_PDO_MAP_MAX];
+	TickType_t xAge;
+	uint32_t ul_count, i, ul_bad = 0;
+
+	ul_count = can_pdo_read_frame(uc_node, uc_pdo, l_values, &xAge);
+	HOST_CHECK(ul_count == uc_count);
+	for (i = 0; (i < ul_count) && (i < uc_count); i++) {
+		if (l_values[i] != l_expected[i]) {
+			printf("%s: signal %u is %d, expected %d\n", pc_name, i, l_values[i], l_expected[i]);
+			ul_bad++;
+		}
+	}
+	HOST_CHECK(ul_bad == 0);
+}
+
+int main(void)
+{
+	const pdo_case_t *p_case;
+	uint32_t ul_frames, i;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+	HOST_CHECK(can_pdo_stats.ul_bad_map == 0);
+
+	for (i = 0, p_case = pdo_cases; i < PDO_CASES; i++, p_case++) {
+		ul_frames = can_pdo_stats.ul_frames;
+		pdo_send(p_case->uc_node, p_case->uc_pdo, p_case->uc_length, p_case->ul_datal, p_case->ul_datah);
+		HOST_CHECK(can_pdo_stats.ul_frames == ul_frames + 1);
+		pdo_check(p_case->pc_name, p_case->uc_node, p_case->uc_pdo, p_case->uc_count, p_case->l_expected);
+	}
+	HOST_CHECK(can_pdo_get(PDO_PAY_TEMP_MC(1)) == 127996);
+	HOST_CHECK(can_pdo_get(PDO_SIGNALS) == 0);
+
+	/* Too short for the 7 bytes of EPS 0: counted, the last values stay. */
+	p_case = &pdo_cases[2];		// The last EPS 0 case.
+	pdo_send(SUB0_ID0, 0, 6, 0xFFFFFFFF, 0xFFFFFFFF);
+	HOST_CHECK(can_pdo_stats.ul_bad_length == 1);
+	pdo_check("EPS 0 short", SUB0_ID0, 0, p_case->uc_count, p_case->l_expected);
+
+	/* No mapping for this frame number. */
+	pdo_send(SUB0_ID3, 2, 8, 0xFFFFFFFF, 0xFFFFFFFF);
+	HOST_CHECK(can_pdo_stats.ul_unmapped == 1);
+	HOST_CHECK(can_pdo_stats.ul_frames == PDO_CASES);
+
+	printf("%u frames unpacked, %u short, %u unmapped\n", can_pdo_stats.ul_frames,
+			can_pdo_stats.ul_bad_length, can_pdo_stats.ul_unmapped);
+
+	return host_done();
+}
@@ -0,0 +1,197 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_poll.c
+	*
+	*	PURPOSE:
+	*	Host benchmark of the receive modes of can_poll.c (IRQ, POLL, ADAPTIVE):
+	*	handler entries and handler cycles against the received frame rate.
+	*
+	*	FILE REFERENCES:	host.h, can_poll.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Built with CAN_POLL_ENABLE and without the receive guard (test_poll_DEFS in the
+	*	Makefile): the guard refills from the cycle counter, which here is the host
+	*	TSC and says nothing about the simulated time. Frame times and handler entries
+	*	are simulated (250 kbit/s, 444 us for an 8-byte frame). The cycles are host
+	*	TSC cycles of the x86 build, not SAM3X cycles. The host has no exception entry
+	*	and exit; the modelled column adds POLL_EXC_CYCLES for each entry, the
+	*	Cortex-M3 figure, as though host and SAM3X cycles were equal.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	10/17/2026		Added the modelled exception entry and exit, the entry cost at which
+	*					polling would pay at a full bus, and the check that the default
+	*					CAN_POLL_MODE is the cheaper mode there.
+	*
+	*	10/17/2026		Built with CAN_GUARD_ENABLE=0.
+	*
+	*	DESCRIPTION:
+	*
+	*	A node sends housekeeping replies to CAN0 at a fixed rate, from 0 up to a
+	*	full bus, rotating over the six subsystems. For each mode and rate the CAN0 and TC0 handler entries per second
+	*	and the handler cycles per second are measured over POLL_RUN_US, after
+	*	POLL_SETTLE_US in which ADAPTIVE finds its mode. The cycles of a run are its
+	*	entries times the median cycles per entry, which leaves out the host's own
+	*	interrupts. The modelled cycles add POLL_EXC_CYCLES per entry, and from the
+	*	full bus runs the test works out the cost per entry at which POLL would cost
+	*	no more than IRQ: only above it would polling ever save time.
+	*
+ */
+
+#include "host.h"
+#include "can_poll.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define POLL_RUN_US			2000000ULL
+#define POLL_SETTLE_US		500000ULL
+#define POLL_STEP_US		10000ULL
+#define POLL_FRAME_US		444
+#define POLL_FULL_RATE		2252			// 1 s / 444 us.
+#define POLL_NODE			1
+#define POLL_RATES			9
+#define POLL_EXC_CYCLES		24				// Cortex-M3: 12 to stack and fetch the vector, 12 to return.
+
+typedef struct {
+	uint32_t ul_frames;			// Frames read by the driver, per second.
+	uint32_t ul_lost;			// Frames lost or overwritten in the mailboxes.
+	uint32_t ul_can_entries;	// CAN0 handler entries per second.
+	uint32_t ul_tc_entries;		// TC0 handler entries per second.
+	uint32_t ul_kcycles;		// Host cycles per second in both handlers, thousands.
+	uint32_t ul_model_kcycles;	// The same plus POLL_EXC_CYCLES per entry.
+	uint32_t ul_polling;		// CAN0 was polled at the end of the run.
+} poll_result_t;
+
+static const uint32_t ul_rates[POLL_RATES] = { 0, 100, 200, 300, 500, 1000, 1500, 2000, POLL_FULL_RATE };
+static const char *pc_modes[3] = { "IRQ", "POLL", "ADAPTIVE" };
+
+/* Frames at ul_rate from now until ull_end. */
+static void poll_traffic(uint32_t ul_rate, uint64_t ull_end, uint32_t *p_seq)
+{
+	host_frame_t reply = { 0, HK_RETURNED, 0, 8, 0 };
+	uint64_t ull_gap, ull_next;
+
+	if (!ul_rate) {
+		host_run_us(ull_end - host_time_us());
+		return;
+	}
+	ull_gap = (ul_rate >= POLL_FULL_RATE) ? POLL_FRAME_US : 1000000ULL / ul_rate;
+	ull_next = host_time_us();
+	while (host_time_us() < ull_end) {
+		while ((ull_next < host_time_us() + POLL_STEP_US) && (ull_next < ull_end)) {
+			reply.ul_mid = CAN_MID_MIDvA(HK_REPLY_ID(HK_NODE_FIRST + *p_seq % HK_NODE_COUNT));
+			reply.ul_datah = (*p_seq)++;
+			HOST_CHECK(host_node_send(0, POLL_NODE, &reply, ull_next));
+			ull_next += ull_gap;
+		}
+		host_run_us(POLL_STEP_US);
+	}
+}
+
+static void poll_run(uint32_t ul_mode, uint32_t ul_rate, poll_result_t *p_res)
+{
+	uint32_t ul_seq = 0, ul_rx0, ul_lost0, ul_median_can, ul_median_tc;
+	double d_secs = POLL_RUN_US / 1e6;
+
+	can_poll_set_mode(ul_mode);
+	poll_traffic(ul_rate, host_time_us() + POLL_SETTLE_US, &ul_seq);
+
+	ul_rx0 = can_rx_stats.ul_frames;
+	ul_lost0 = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0];
+	memset(host_irq_stats, 0, sizeof(host_irq_stats));
+	poll_traffic(ul_rate, host_time_us() + POLL_RUN_US, &ul_seq);
+
+	ul_median_can = host_irq_stats[HOST_IRQ_CAN0].ul_entries ? host_irq_percentile(HOST_IRQ_CAN0, 500) : 0;
+	ul_median_tc = host_irq_stats[HOST_IRQ_TC0].ul_entries ? host_irq_percentile(HOST_IRQ_TC0, 500) : 0;
+	p_res->ul_frames = (uint32_t)((can_rx_stats.ul_frames - ul_rx0) / d_secs);
+	p_res->ul_lost = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0] - ul_lost0;
+	p_res->ul_can_entries = (uint32_t)(host_irq_stats[HOST_IRQ_CAN0].ul_entries / d_secs);
+	p_res->ul_tc_entries = (uint32_t)(host_irq_stats[HOST_IRQ_TC0].ul_entries / d_secs);
+	p_res->ul_kcycles = (uint32_t)(((uint64_t)host_irq_stats[HOST_IRQ_CAN0].ul_entries * ul_median_can
+			+ (uint64_t)host_irq_stats[HOST_IRQ_TC0].ul_entries * ul_median_tc) / d_secs / 1000);
+	p_res->ul_model_kcycles = p_res->ul_kcycles
+			+ (p_res->ul_can_entries + p_res->ul_tc_entries) * POLL_EXC_CYCLES / 1000;
+	p_res->ul_polling = can_poll_stats[CAN_CTRL_0].ul_polling;
+
+	/* Let the next run start from an empty bus. */
+	host_run_us(POLL_STEP_US);
+}
+
+int main(void)
+{
+	static poll_result_t res[3][POLL_RATES];
+	poll_result_t *p_irq = &res[CAN_POLL_IRQ][POLL_RATES - 1], *p_poll = &res[CAN_POLL_POLL][POLL_RATES - 1];
+	uint32_t ul_entries, ul_even, m, r;
+
+	host_init(HOST_SEPARATE_BUSES | HOST_CYCLES_HOST);
+	can_initialize();
+	host_run_us(1000);
+
+	printf("CAN0 receive modes, poll period %u us, adaptive: poll from %u frames/s, interrupts below %u\n",
+			CAN_POLL_PERIOD_US, CAN_POLL_ENTER_FRAMES * configTICK_RATE_HZ / CAN_POLL_WINDOW_TICKS,
+			CAN_POLL_EXIT_FRAMES * configTICK_RATE_HZ / CAN_POLL_WINDOW_TICKS);
+	printf("(entries: simulated; cycles: host TSC, median per entry times entries; modelled: plus %u per entry)\n",
+			POLL_EXC_CYCLES);
+	printf("mode       frames/s  lost   CAN0 entries/s  TC0 entries/s  all entries/s  host kcycles/s  modelled\n");
+	for (m = CAN_POLL_IRQ; m <= CAN_POLL_ADAPTIVE; m++) {
+		for (r = 0; r < POLL_RATES; r++) {
+			poll_run(m, ul_rates[r], &res[m][r]);
+			printf("%-9s  %7u  %5u   %10u      %10u      %10u      %8u      %8u%s\n", pc_modes[m],
+					res[m][r].ul_frames, res[m][r].ul_lost, res[m][r].ul_can_entries, res[m][r].ul_tc_entries,
+					res[m][r].ul_can_entries + res[m][r].ul_tc_entries, res[m][r].ul_kcycles, res[m][r].ul_model_kcycles,
+					((m == CAN_POLL_ADAPTIVE) && res[m][r].ul_polling) ? "  (polling)" : "");
+		}
+	}
+
+	for (r = 0; r < POLL_RATES; r++) {
+		/* No mode loses a frame, up to a full bus. */
+		for (m = CAN_POLL_IRQ; m <= CAN_POLL_ADAPTIVE; m++) {
+			HOST_CHECK(res[m][r].ul_lost == 0);
+			HOST_CHECK(res[m][r].ul_frames + 2 >= ((ul_rates[r] < POLL_FULL_RATE) ? ul_rates[r] : 2250));
+		}
+		/* IRQ: one entry per frame at most; POLL: one per period whatever the rate. */
+		HOST_CHECK(res[CAN_POLL_IRQ][r].ul_can_entries <= res[CAN_POLL_IRQ][r].ul_frames + 20);
+		HOST_CHECK(res[CAN_POLL_IRQ][r].ul_tc_entries == 0);
+		HOST_CHECK(res[CAN_POLL_POLL][r].ul_tc_entries + 1 >= 1000000 / CAN_POLL_PERIOD_US);
+		/* ADAPTIVE: interrupts below the exit rate, polling above the enter rate,
+		*  and never more entries than the better of the two. */
+		ul_entries = res[CAN_POLL_ADAPTIVE][r].ul_can_entries + res[CAN_POLL_ADAPTIVE][r].ul_tc_entries;
+		if (ul_rates[r] < CAN_POLL_EXIT_FRAMES * configTICK_RATE_HZ / CAN_POLL_WINDOW_TICKS)
+			HOST_CHECK(!res[CAN_POLL_ADAPTIVE][r].ul_polling && (res[CAN_POLL_ADAPTIVE][r].ul_tc_entries == 0));
+		if (ul_rates[r] > CAN_POLL_ENTER_FRAMES * configTICK_RATE_HZ / CAN_POLL_WINDOW_TICKS)
+			HOST_CHECK(res[CAN_POLL_ADAPTIVE][r].ul_polling);
+		HOST_CHECK(ul_entries <= res[CAN_POLL_IRQ][r].ul_can_entries + 20);
+		HOST_CHECK(ul_entries <= res[CAN_POLL_POLL][r].ul_tc_entries + 20);
+	}
+
+	/* At a full bus POLL saves IRQ entries minus TC0 entries; it pays only if
+	*  each of them costs more than the cycles it spends over IRQ. */
+	ul_even = (p_irq->ul_can_entries > p_poll->ul_tc_entries) && (p_poll->ul_kcycles > p_irq->ul_kcycles)
+			? (p_poll->ul_kcycles - p_irq->ul_kcycles) * 1000 / (p_irq->ul_can_entries - p_poll->ul_tc_entries) : 0;
+	printf("polling pays at a full bus above %u cycles of entry and exit (modelled: %u)\n", ul_even, POLL_EXC_CYCLES);
+	/* The default mode is the cheaper one at a full bus, once the entries are paid for. */
+	if (CAN_POLL_MODE == CAN_POLL_IRQ)
+		HOST_CHECK(p_irq->ul_model_kcycles <= p_poll->ul_model_kcycles);
+	else
+		HOST_CHECK(p_poll->ul_model_kcycles <= p_irq->ul_model_kcycles);
+
+	return host_done();
+}
@@ -0,0 +1,128 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_rx_fifo.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the CAN0 reception FIFO (CAN0_RX_FIFO_DEPTH): the frames
+	*	lost from a burst of housekeeping replies when the CAN0 handler is held off.
+	*
+	*	FILE REFERENCES:	host.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Times are simulated: 250 kbit/s, 444 us for an 8-byte frame, the handler takes
+	*	no simulated time. The Makefile builds this file twice, as test_rx_fifo (the
+	*	depth of can_func.h) and as test_rx_fifo_d1 (CAN0_RX_FIFO_DEPTH=1).
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	A node sends the six housekeeping replies of collect_housekeeping_all() back
+	*	to back. The CAN0 interrupt is disabled in the NVIC when the burst starts, as
+	*	a higher priority handler or a critical section would hold it off, and enabled
+	*	again after a hold-off drawn at random between 0 and a maximum. For each
+	*	maximum the frames lost (no free mailbox, or overwritten in the last mailbox of
+	*	the FIFO) are counted over FIFO_BURSTS bursts. A FIFO of depth n holds n frames,
+	*	so nothing is lost while the hold-off stays below n + 1 frame times.
+	*
+ */
+
+#include "host.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+
+#define FIFO_BURSTS			1000
+#define FIFO_BURST_LEN		HK_NODE_COUNT
+#define FIFO_GAP_US			20000				// Keeps each node under its receive budget.
+#define FIFO_FRAME_US		444
+#define FIFO_NODE			1
+
+static uint32_t ul_seed = 1;
+
+static uint32_t fifo_rand(uint32_t ul_max)
+{
+	ul_seed = ul_seed * 1103515245u + 12345u;
+	return (ul_seed >> 8) % (ul_max + 1);
+}
+
+/* FIFO_BURSTS bursts, each with a hold-off of 0 .. ul_max_us. Returns the frames
+*  lost; *p_bursts is set to the bursts which lost any. */
+static uint32_t fifo_run(uint32_t ul_max_us, uint32_t *p_bursts)
+{
+	host_frame_t reply = { 0, HK_RETURNED, 0, 8, 0 };
+	uint32_t ul_lost = 0, ul_before, ul_rx0, ul_hold, i, j;
+	uint64_t ull_start;
+
+	*p_bursts = 0;
+	ul_rx0 = can_rx_stats.ul_frames;
+	for (i = 0; i < FIFO_BURSTS; i++) {
+		ul_before = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0];
+		ul_hold = fifo_rand(ul_max_us);
+		ull_start = host_time_us();
+		for (j = 0; j < FIFO_BURST_LEN; j++) {
+			reply.ul_mid = CAN_MID_MIDvA(HK_REPLY_ID(HK_NODE_FIRST + j));
+			reply.ul_datah = i;
+			HOST_CHECK(host_node_send(0, FIFO_NODE, &reply, ull_start));
+		}
+		NVIC_DisableIRQ(CAN0_IRQn);
+		host_run_us(ul_hold);
+		NVIC_EnableIRQ(CAN0_IRQn);
+		host_run_us(FIFO_GAP_US);
+
+		ul_before = host_bus_stats[0].ul_lost[CAN_CTRL_0] + host_bus_stats[0].ul_overwritten[CAN_CTRL_0]
+				- ul_before;
+		ul_lost += ul_before;
+		if (ul_before)
+			(*p_bursts)++;
+	}
+	HOST_CHECK(can_rx_stats.ul_frames - ul_rx0 + ul_lost == FIFO_BURSTS * FIFO_BURST_LEN);
+	return ul_lost;
+}
+
+int main(void)
+{
+	static const uint32_t ul_max_us[] = { 0, 400, 800, 1200, 1600, 2000, 3000 };
+	uint32_t ul_lost, ul_bursts, i;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+
+	printf("CAN0_RX_FIFO_DEPTH %u, %u bursts of %u housekeeping replies (simulated, %u us per frame)\n",
+			CAN0_RX_FIFO_DEPTH, FIFO_BURSTS, FIFO_BURST_LEN, FIFO_FRAME_US);
+	printf("hold-off up to   frames lost        bursts with loss\n");
+	for (i = 0; i < sizeof(ul_max_us) / sizeof(ul_max_us[0]); i++) {
+		ul_lost = fifo_run(ul_max_us[i], &ul_bursts);
+		printf("%7u us      %5u (%5.2f%%)      %4u (%5.1f%%)\n", ul_max_us[i], ul_lost,
+				100.0 * ul_lost / (FIFO_BURSTS * FIFO_BURST_LEN), ul_bursts, 100.0 * ul_bursts / FIFO_BURSTS);
+
+		/* Nothing lost while the FIFO holds every frame which ends in the hold-off. */
+		if (ul_max_us[i] < (CAN0_RX_FIFO_DEPTH + 1) * FIFO_FRAME_US)
+			HOST_CHECK(ul_lost == 0);
+		/* Never more than the frames which end in the hold-off, less those held. */
+		if (ul_max_us[i] / FIFO_FRAME_US > CAN0_RX_FIFO_DEPTH)
+			HOST_CHECK(ul_lost <= FIFO_BURSTS * (ul_max_us[i] / FIFO_FRAME_US - CAN0_RX_FIFO_DEPTH));
+		/* And some lost once the hold-off can reach a frame beyond the FIFO. */
+		if (ul_max_us[i] >= (CAN0_RX_FIFO_DEPTH + 2) * FIFO_FRAME_US)
+			HOST_CHECK(ul_lost > 0);
+	}
+
+	return host_done();
+}
@@ -0,0 +1,154 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_stats.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the CAN statistics (can_stats.c): every subscribed ID
+	*	gets its own record, and bus-off events match can_err.c.
+	*
+	*	FILE REFERENCES:	host.h, can_stats.h, can_err.h, can_pdo.h, can_filter.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:	None.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	A simulated node sends each ID of the CAN0 subscriptions STATS_ROUNDS times.
+	*	The snapshot must then hold one RX record per ID with that count and no
+	*	overflow. The same IDs through the 32 direct-mapped slots the table used to
+	*	have are counted here for comparison.
+	*
+	*	Then CAN0 goes bus-off twice, each time recovering within a few ticks: the
+	*	snapshot must count both, as can_err_stats[].ul_bus_off does.
+	*
+ */
+
+#include "host.h"
+#include "can_stats.h"
+#include "can_err.h"
+#include "can_pdo.h"
+#include "can_filter.h"
+
+#include <stdio.h>
+
+#define STATS_ROUNDS		3
+#define STATS_GAP_US		2000
+#define STATS_OLD_SLOTS		32
+
+/* The CAN0 subscriptions of can_func.c. */
+static const can_id_range_t stats_ranges[] = {
+	{ CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID0, 0), CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, SUB0_ID5, 3) },
+	{ CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID0, 0), CAN_ID(CAN_PRIO_HK, CAN_NODE_OBC, SUB0_ID5, 3) },
+	{ PDO_ID(SUB0_ID0, 0), PDO_ID(SUB0_ID5, CAN_PDO_PER_NODE - 1) },
+};
+#define STATS_RANGES		( sizeof(stats_ranges) / sizeof(stats_ranges[0]) )
+
+static uint8_t uc_snap[CAN_STATS_MAX_SIZE];
+
+static uint32_t stats_get32(const uint8_t *p)
+{
+	return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Bus-off events of CAN0 in a snapshot. */
+static uint32_t stats_bus_off(void)
+{
+	HOST_CHECK(can_stats_snapshot(uc_snap, sizeof(uc_snap)) >= CAN_STATS_HEADER_SIZE);
+	return uc_snap[8 + 12] | ((uint32_t)uc_snap[8 + 13] << 8);
+}
+
+int main(void)
+{
+	host_frame_t frame = { 0, 0, 0, 8, 0 };
+	uint32_t ul_ids = 0, ul_records, ul_rx, ul_good = 0, ul_old_taken = 0, ul_old_lost = 0;
+	uint32_t ul_old[STATS_OLD_SLOTS], ul_id, ul_slot, ul_size, r, i, n;
+	uint64_t ull_at;
+	const uint8_t *p;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+	can_stats_clear();
+
+	/* Every subscribed ID, STATS_ROUNDS times. */
+	for (i = 0; i < STATS_OLD_SLOTS; i++)
+		ul_old[i] = 0xFFFFFFFF;
+	ull_at = host_time_us();
+	for (r = 0; r < STATS_ROUNDS; r++) {
+		for (i = 0; i < STATS_RANGES; i++) {
+			for (ul_id = stats_ranges[i].us_first; ul_id <= stats_ranges[i].us_last; ul_id++) {
+				frame.ul_mid = CAN_MID_MIDvA(ul_id);
+				ull_at += STATS_GAP_US;
+				HOST_CHECK(host_node_send(0, 0, &frame, ull_at));
+				if (r)
+					continue;
+				ul_ids++;
+				ul_slot = (ul_id ^ (ul_id >> 5) ^ (ul_id >> 10)) & (STATS_OLD_SLOTS - 1);
+				if (ul_old[ul_slot] == 0xFFFFFFFF) {
+					ul_old[ul_slot] = ul_id;
+					ul_old_taken++;
+				}
+				else
+					ul_old_lost++;
+			}
+		}
+		host_run_us(ull_at - host_time_us() + 10000);
+	}
+
+	ul_size = can_stats_snapshot(uc_snap, sizeof(uc_snap));
+	ul_records = uc_snap[1];
+	ul_rx = 0;
+	for (n = 0, p = uc_snap + CAN_STATS_HEADER_SIZE; n < ul_records; n++, p += 8) {
+		if (stats_get32(p) & CAN_STATS_ID_TX)
+			continue;
+		ul_rx++;
+		if (stats_get32(p + 4) == STATS_ROUNDS)
+			ul_good++;
+	}
+	printf("%u subscribed IDs: %u RX records, %u with all %u frames, %u overflows, snapshot %u bytes\n",
+			ul_ids, ul_rx, ul_good, STATS_ROUNDS, stats_get32(uc_snap + 56), ul_size);
+	printf("32 direct-mapped slots: %u IDs recorded, %u frames of %u IDs only counted as overflow\n",
+			ul_old_taken, ul_old_lost * STATS_ROUNDS, ul_old_lost);
+	HOST_CHECK(ul_ids == 72);
+	HOST_CHECK(ul_rx == ul_ids);
+	HOST_CHECK(ul_good == ul_ids);
+	HOST_CHECK(stats_get32(uc_snap + 56) == 0);
+	HOST_CHECK(ul_size == CAN_STATS_HEADER_SIZE + 8 * ul_records);
+
+	/* Two bus-offs, each over in a few ticks. */
+	HOST_CHECK(stats_bus_off() == 0);
+	for (i = 0; i < 2; i++) {
+		host_set_errors(CAN_CTRL_0, 256, 0, 0);
+		host_run_us(10);
+		HOST_CHECK(can_err_state(CAN_CTRL_0) == CAN_ERR_BUS_OFF);
+		host_set_errors(CAN_CTRL_0, 0, 0, 0);
+		for (n = 0; (n < 20) && (can_err_state(CAN_CTRL_0) != CAN_ERR_ACTIVE); n++)
+			host_run_us(HOST_TICK_US);
+		HOST_CHECK(can_err_state(CAN_CTRL_0) == CAN_ERR_ACTIVE);
+		host_run_us((CAN_ERR_STABLE_TICKS + 1) * HOST_TICK_US);
+	}
+	host_run_us(CAN_STATS_PERIOD * HOST_TICK_US);
+	printf("bus-off events: %u in the snapshot, %u in can_err_stats\n", stats_bus_off(),
+			can_err_stats[CAN_CTRL_0].ul_bus_off);
+	HOST_CHECK(stats_bus_off() == 2);
+	HOST_CHECK(can_err_stats[CAN_CTRL_0].ul_bus_off == 2);
+
+	return host_done();
+}
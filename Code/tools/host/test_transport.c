@@ -0,0 +1,353 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_transport.c
+	*
+	*	PURPOSE:
+	*	Host loopback test of the segmented transport (can_transport.c): goodput and
+	*	reassembly memory for transfers of 1 KB to 64 KB in both directions, and
+	*	sub-tick STmin pacing.
+	*
+	*	FILE REFERENCES:	host.h, can_transport.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Figures are simulated time on the 250 kbit/s bus model (444 us per 8-byte
+	*	frame, no stuffing), so a consecutive frame stream tops out at 6 bytes per
+	*	444 us = 13.5 KB/s.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*					The pacing check also wants a lower priority task to run during the
+	*					gaps and the gap timer (TC1_Handler) to end them.
+	*
+	*					Peer -> OBC runs with STmin = 0 again, now that bulk data has a receive
+	*					budget of its own.
+	*
+	*	DESCRIPTION:
+	*
+	*	The peer, SUB0_ID0, is simulated node 0 on CAN0 and runs the other end of the
+	*	protocol from the frame hook. A test task makes the API calls.
+	*
+	*	OBC -> peer: the peer answers with flow control BS = 0, STmin = 0, so the OBC
+	*	sends the whole transfer as fast as its TX window lets it. Goodput runs from
+	*	the can_tp_send() call to the end of the last consecutive frame.
+	*
+	*	Peer -> OBC: the OBC asks for STmin = 0, so the peer sends back to back at
+	*	the bus rate; the transport frames are class CAN_PRIO_DATA, which the
+	*	receive guard of can_guard.c lets through at that rate. Goodput runs from
+	*	the first frame to can_tp_rx_wait() returning. The receive buffer is exactly
+	*	the transfer length plus a guard area which must stay untouched, and no
+	*	FreeRTOS object may be created while transfers run.
+	*
+	*	Pacing: OBC -> peer with STmin = 0xF5 (500 us), shorter than a tick. The
+	*	sender counts STmin from the end of the previous consecutive frame, so the
+	*	frames should end 444 + 500 us apart. A task below the sender's priority
+	*	polls the CAN timer meanwhile, as a busy background task would; it only gets
+	*	the CPU while the sender sleeps through the gaps, on TC0 channel 1.
+	*
+ */
+
+#include "host.h"
+#include "can_transport.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TP_PEER				SUB0_ID0
+#define TP_NODE				0
+#define TP_FROM_PEER		CAN_ID(CAN_PRIO_DATA, CAN_NODE_OBC, TP_PEER, CAN_TYPE_DATA)
+#define TP_MAX				65536
+#define TP_GUARD			64
+#define TP_TIMEOUT			( 20 * configTICK_RATE_HZ )
+#define TP_BYTE(i)			( ( uint8_t )( ( i ) * 7 + ( ( i ) >> 8 ) ) )
+
+#define TP_JOB_SEND			1
+#define TP_JOB_RECV			2
+
+static uint8_t uc_tx_buf[TP_MAX];
+static uint8_t uc_rx_buf[TP_MAX + TP_GUARD];
+
+/* Job for the test task and its result. */
+static SemaphoreHandle_t xJob;
+static volatile uint32_t ul_job, ul_job_len, ul_job_ret, ul_job_done, ul_job_got;
+static volatile uint64_t ull_job_start, ull_job_end;
+
+/* Background task. */
+static volatile uint32_t ul_bg_polls;
+
+/* Peer side. */
+static uint8_t uc_peer_st;					// STmin the peer asks for when receiving.
+static uint32_t ul_peer_len, ul_peer_pos, ul_peer_errors;
+static uint8_t uc_peer_seq;
+static uint64_t ull_peer_last, ull_peer_prev, ull_peer_min_gap;
+static uint32_t ul_peer_block, ul_peer_bs, ul_peer_gap_us, ul_peer_sending;
+
+/************************************************************************/
+/*				PEER                                                    */
+/************************************************************************/
+
+static void peer_send(uint32_t ul_datal, uint32_t ul_datah, uint64_t ull_at)
+{
+	host_frame_t frame = { CAN_MID_MIDvA(TP_FROM_PEER), ul_datal, ul_datah, 8, 0 };
+
+	HOST_CHECK(host_node_send(0, TP_NODE, &frame, ull_at));
+}
+
+static uint32_t peer_pack(uint32_t ul_pos, uint32_t ul_count)
+{
+	uint32_t ul_word = 0, i;
+
+	for (i = 0; (i < ul_count) && (ul_pos + i < ul_peer_len); i++)
+		ul_word |= (uint32_t)TP_BYTE(ul_pos + i) << (8 * i);
+	return ul_word;
+}
+
+/* Next consecutive frame of a peer -> OBC transfer. */
+static void peer_send_cf(uint64_t ull_at)
+{
+	peer_send(((uint32_t)CAN_TP_CF << 24) | ((uint32_t)uc_peer_seq << 16) | peer_pack(ul_peer_pos, 2),
+			peer_pack(ul_peer_pos + 2, 4), ull_at);
+	ul_peer_pos += CAN_TP_CF_DATA;
+	uc_peer_seq++;
+	ul_peer_block++;
+}
+
+/* Checks data bytes of an OBC -> peer transfer. */
+static void peer_check(uint32_t ul_word, uint32_t ul_count)
+{
+	while (ul_count-- && (ul_peer_pos < ul_peer_len)) {
+		if ((uint8_t)ul_word != TP_BYTE(ul_peer_pos))
+			ul_peer_errors++;
+		ul_word >>= 8;
+		ul_peer_pos++;
+	}
+}
+
+static void peer_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	uint32_t ul_type = p_frame->ul_datal >> 24;
+	uint64_t ull_now = host_time_us();
+
+	if (uc_bus != 0)
+		return;
+
+	/* Our own frame has left: the next consecutive frame of a send, after STmin. */
+	if ((uc_ctrl == HOST_NODE_NONE) && (uc_node == TP_NODE)) {
+		if (ul_peer_sending && (ul_type == CAN_TP_CF) && (ul_peer_pos < ul_peer_len)
+				&& (!ul_peer_bs || (ul_peer_block < ul_peer_bs)))
+			peer_send_cf(ull_now + ul_peer_gap_us);
+		return;
+	}
+	if ((uc_ctrl != CAN_CTRL_0) || (p_frame->ul_mid != CAN_MID_MIDvA(CAN_TP_ID(TP_PEER))))
+		return;
+
+	if (ul_type == CAN_TP_FF) {
+		ul_peer_len = p_frame->ul_datal & CAN_TP_MAX_LENGTH;
+		ul_peer_pos = 0;
+		uc_peer_seq = 1;
+		ull_peer_prev = 0;
+		ull_peer_min_gap = ~0ULL;
+		peer_check(p_frame->ul_datah, CAN_TP_FF_DATA);
+		peer_send(((uint32_t)CAN_TP_FC << 24) | ((uint32_t)CAN_TP_CTS << 16) | uc_peer_st, 0, 0);
+	}
+	else if (ul_type == CAN_TP_CF) {
+		if (((p_frame->ul_datal >> 16) & 0xFF) != uc_peer_seq++)
+			ul_peer_errors++;
+		peer_check(p_frame->ul_datal, 2);
+		peer_check(p_frame->ul_datah, 4);
+		if (ull_peer_prev && (ull_now - ull_peer_prev < ull_peer_min_gap))
+			ull_peer_min_gap = ull_now - ull_peer_prev;
+		ull_peer_prev = ull_now;
+		ull_peer_last = ull_now;
+	}
+	else if ((ul_type == CAN_TP_FC) && ul_peer_sending) {
+		if (((p_frame->ul_datal >> 16) & 0xFF) != CAN_TP_CTS) {
+			ul_peer_errors++;
+			ul_peer_sending = 0;
+			return;
+		}
+		ul_peer_bs = (p_frame->ul_datal >> 8) & 0xFF;
+		ul_peer_gap_us = CAN_TP_ST_US(p_frame->ul_datal & 0xFF);
+		ul_peer_block = 0;
+		if (ul_peer_pos < ul_peer_len)
+			peer_send_cf(0);
+	}
+}
+
+/************************************************************************/
+/*				TEST TASK                                               */
+/************************************************************************/
+
+static void tp_task(void *pvParameters)
+{
+	int32_t l_handle;
+	uint32_t ul_length;
+
+	(void)pvParameters;
+	for (;;) {
+		xSemaphoreTake(xJob, portMAX_DELAY);
+		if (ul_job == TP_JOB_SEND) {
+			ull_job_start = host_time_us();
+			ul_job_ret = can_tp_send(TP_PEER, uc_tx_buf, ul_job_len, CAN_TP_PAYLOAD_PRIO, TP_TIMEOUT);
+		}
+		else {
+			l_handle = can_tp_rx_open(TP_PEER, uc_rx_buf, ul_job_len, 0, 0, CAN_TP_COMS_PRIO);
+			HOST_CHECK(l_handle >= 0);
+			ul_job_done = 1;			// Open: the peer may start.
+			ul_length = 0;
+			ul_job_ret = can_tp_rx_wait(l_handle, &ul_length, TP_TIMEOUT);
+			ull_job_end = host_time_us();
+			ul_job_got = ul_length;
+			can_tp_rx_close(l_handle);
+		}
+		ul_job_done = 2;
+	}
+}
+
+/* Below the test task: runs only while it sleeps. Each poll of the timer
+*  lets 4 us of simulated time pass. */
+static void bg_task(void *pvParameters)
+{
+	(void)pvParameters;
+	for (;;) {
+		(void)can_get_internal_timer_value(CAN0);
+		ul_bg_polls++;
+	}
+}
+
+static void tp_wait(void)
+{
+	uint64_t ull_limit = host_time_us() + 60000000ULL;
+
+	while ((ul_job_done != 2) && (host_time_us() < ull_limit))
+		host_run_us(1000);
+	HOST_CHECK(ul_job_done == 2);
+}
+
+/* OBC -> peer. Returns the goodput in bytes/s. */
+static double tp_send(uint32_t ul_length, uint8_t uc_st)
+{
+	uc_peer_st = uc_st;
+	ul_peer_errors = 0;
+	ul_peer_len = 0;
+	ul_job = TP_JOB_SEND;
+	ul_job_len = ul_length;
+	ul_job_done = 0;
+	xSemaphoreGive(xJob);
+	tp_wait();
+	host_run_us(100000);			// The rest of the queue goes out.
+
+	HOST_CHECK(ul_job_ret == CAN_TP_DONE);
+	HOST_CHECK(ul_peer_len == ul_length);
+	HOST_CHECK(ul_peer_pos == ul_length);
+	HOST_CHECK(ul_peer_errors == 0);
+	return ul_length * 1e6 / (double)(ull_peer_last - ull_job_start);
+}
+
+/* Peer -> OBC. Returns the goodput in bytes/s. */
+static double tp_recv(uint32_t ul_length)
+{
+	uint64_t ull_first;
+	uint32_t i;
+
+	memset(uc_rx_buf, 0xA5, sizeof(uc_rx_buf));
+	ul_job = TP_JOB_RECV;
+	ul_job_len = ul_length;
+	ul_job_done = 0;
+	xSemaphoreGive(xJob);
+	while (ul_job_done != 1)
+		host_run_us(100);
+
+	ul_peer_errors = 0;
+	ul_peer_len = ul_length;
+	ul_peer_pos = CAN_TP_FF_DATA;
+	uc_peer_seq = 1;
+	ul_peer_sending = 1;
+	ull_first = host_time_us();
+	peer_send(((uint32_t)CAN_TP_FF << 24) | ul_length, peer_pack(0, 4), 0);
+	tp_wait();
+	ul_peer_sending = 0;
+
+	HOST_CHECK(ul_job_ret == CAN_TP_DONE);
+	HOST_CHECK(ul_job_got == ul_length);
+	HOST_CHECK(ul_peer_errors == 0);
+	for (i = 0; i < ul_length; i++) {
+		if (uc_rx_buf[i] != TP_BYTE(i))
+			break;
+	}
+	HOST_CHECK(i == ul_length);
+	for (i = ul_length; i < ul_length + TP_GUARD; i++) {
+		if (uc_rx_buf[i] != 0xA5)
+			break;
+	}
+	HOST_CHECK(i == ul_length + TP_GUARD);
+	return ul_length * 1e6 / (double)(ull_job_end - ull_first);
+}
+
+int main(void)
+{
+	static const uint32_t ul_sizes[] = { 1024, 4096, 16384, 65536 };
+	uint32_t ul_objects, ul_tc_entries, i;
+	uint64_t ull_paced_start;
+	double d_tx, d_rx, d_paced;
+
+	for (i = 0; i < TP_MAX; i++)
+		uc_tx_buf[i] = TP_BYTE(i);
+
+	host_init(0);
+	can_initialize();
+	xJob = xSemaphoreCreateBinary();
+	xTaskCreate(tp_task, "tp_test", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+	host_set_frame_hook(peer_hook);
+	host_run_us(1000);
+	ul_objects = host_rtos_objects;
+
+	printf("  bytes   OBC->peer goodput   peer->OBC goodput   reassembly memory\n");
+	for (i = 0; i < sizeof(ul_sizes) / sizeof(ul_sizes[0]); i++) {
+		d_tx = tp_send(ul_sizes[i], 0);
+		d_rx = tp_recv(ul_sizes[i]);
+		printf("  %5u   %7.0f B/s (%3.0f%%)   %7.0f B/s (%3.0f%%)   %u B buffer, 0 B more\n",
+				ul_sizes[i], d_tx, 100.0 * d_tx / (CAN_TP_CF_DATA * 1e6 / 444), d_rx,
+				100.0 * d_rx / (CAN_TP_CF_DATA * 1e6 / 444), ul_sizes[i]);
+		HOST_CHECK(d_tx > 0.95 * CAN_TP_CF_DATA * 1e6 / 444);
+		HOST_CHECK(d_rx > 0.9 * CAN_TP_CF_DATA * 1e6 / 444);
+	}
+	HOST_CHECK(host_rtos_objects == ul_objects);
+	HOST_CHECK(can_tx_stats.ul_dropped == 0);
+
+	/* Sub-tick STmin: 500 us of bus idle after each consecutive frame, where
+	*  a tick (100 ms) used to be waited. */
+	xTaskCreate(bg_task, "tp_bg", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL);
+	ul_bg_polls = 0;
+	ul_tc_entries = host_irq_stats[HOST_IRQ_TC1].ul_entries;
+	ull_paced_start = host_time_us();
+	d_paced = tp_send(4096, 0xF5);
+	ul_tc_entries = host_irq_stats[HOST_IRQ_TC1].ul_entries - ul_tc_entries;
+	printf("STmin 500 us: %.0f B/s, shortest end-to-end spacing of consecutive frames %llu us\n", d_paced,
+			(unsigned long long)ull_peer_min_gap);
+	printf("              %u gap timer interrupts, background task ran %.0f%% of the time\n", ul_tc_entries,
+			100.0 * ul_bg_polls * CAN_TIMESTAMP_US / (double)(host_time_us() - ull_paced_start));
+	HOST_CHECK(ul_tc_entries >= 4096 / CAN_TP_CF_DATA - 1);
+	/* Polling the gaps left it only the frame times, about half. */
+	HOST_CHECK((uint64_t)ul_bg_polls * CAN_TIMESTAMP_US * 10 > (host_time_us() - ull_paced_start) * 9);
+	HOST_CHECK(ull_peer_min_gap >= 444 + 500);
+	HOST_CHECK(ull_peer_min_gap < 444 + 600);
+	HOST_CHECK(d_paced > 0.95 * CAN_TP_CF_DATA * 1e6 / (444 + 600));
+
+	return host_done();
+}
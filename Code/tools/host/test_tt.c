@@ -0,0 +1,291 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_tt.c
+	*
+	*	PURPOSE:
+	*	Host simulation of the housekeeping requests sent by the time-triggered
+	*	schedule (can_tt.c) against the task-driven sweep of prvHouseKeepTask2():
+	*	release jitter of each request and the CPU work per sweep.
+	*
+	*	FILE REFERENCES:	host.h, can_tt.h, can_hk.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	Times are simulated (250 kbit/s, 444 us per 8-byte frame). The CPU work is
+	*	counted, not timed: host cycles of the x86 build do not repeat from run to
+	*	run and say nothing about the SAM3X.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+	*	DESCRIPTION:
+	*
+	*	CAN0 and CAN1 are on buses of their own, each with a simulated node sending
+	*	8-byte frames of the lowest priority at random (about 30% load), and a task
+	*	above the housekeeping task holds the CPU for 0 - TT_HOLD_MAX_US at every
+	*	tick, as other work would.
+	*
+	*	Task-driven: a task at the priority of prvHouseKeepTask2() wakes every 15
+	*	ticks with vTaskDelayUntil() and calls request_housekeeping() for the six
+	*	nodes. The delay of a request runs from its tick to the end of the frame.
+	*
+	*	Time-triggered: the six requests are slots of a CAN1 schedule 32 ms apart,
+	*	every TT_PERIOD cycles, as in housekeep_test2.c. The delay runs from the
+	*	timemark to the end of the frame (can_tt_stats). A task at the same priority
+	*	waits in can_tt_wait_cycle(), as prvHouseKeepTask2() does.
+	*
+	*	The jitter of a request is its largest delay less its smallest; the figure
+	*	printed is the worst of the six. The CPU work of a sweep is the number of
+	*	CAN interrupt entries, task wake-ups and driver calls (request_housekeeping())
+	*	it takes; the simulation is deterministic, so these come out the same on
+	*	every run.
+	*
+ */
+
+#include "host.h"
+#include "can_tt.h"
+#include "can_hk.h"
+
+#include <stdio.h>
+
+#define TT_SWEEPS			40
+#define TT_PERIOD			6					// Cycles per time-triggered sweep.
+#define TT_TASK_TICKS		15					// Ticks per task-driven sweep.
+#define TT_HOLD_MAX_US		30000
+#define TT_BG_MID			CAN_MID_MIDvA(0x7F0)
+#define TT_BG_GAP_US		1500				// Mean gap between background frames.
+#define TT_BG_NODE			0
+#define TT_FRAME_US			444
+#define TT_SLOT(n)			{ CAN_TT_MARK_US(32768UL * ( ( n ) + 1 )), TT_PERIOD, 0, HK_REQUEST_ID(HK_NODE_FIRST + ( n )), HK_REQUEST, HK_REQUEST }
+
+static const can_tt_slot_t tt_schedule[HK_NODE_COUNT] = {
+	TT_SLOT(0), TT_SLOT(1), TT_SLOT(2), TT_SLOT(3), TT_SLOT(4), TT_SLOT(5)
+};
+
+static uint32_t ul_seed = 1;
+static volatile uint32_t ul_task_on, ul_task_sweeps, ul_tt_on;
+static uint32_t ul_task_wakes, ul_task_calls, ul_tt_wakes;
+static uint64_t ull_task_nominal;
+static uint32_t ul_min_delay[HK_NODE_COUNT], ul_max_delay[HK_NODE_COUNT], ul_seen[HK_NODE_COUNT];
+static uint64_t ull_bg_next[2];
+
+static uint32_t tt_rand(uint32_t ul_max)
+{
+	ul_seed = ul_seed * 1103515245u + 12345u;
+	return (ul_seed >> 8) % (ul_max + 1);
+}
+
+/************************************************************************/
+/*				TASKS                                                   */
+/************************************************************************/
+
+/* Above the housekeeping task: busy for a random time after every tick.
+*  Each read of the timer lets 4 us pass. */
+static void tt_hold_task(void *pvParameters)
+{
+	uint64_t ull_until;
+
+	(void)pvParameters;
+	for (;;) {
+		vTaskDelay(1);
+		ull_until = host_time_us() + tt_rand(TT_HOLD_MAX_US);
+		while (host_time_us() < ull_until)
+			(void)can_get_internal_timer_value(CAN0);
+	}
+}
+
+/* prvHouseKeepTask2() without the collection. */
+static void tt_hk_task(void *pvParameters)
+{
+	TickType_t xLastWakeTime = xTaskGetTickCount();
+	uint32_t i;
+
+	(void)pvParameters;
+	for (;;) {
+		vTaskDelayUntil(&xLastWakeTime, TT_TASK_TICKS);
+		if (!ul_task_on)
+			continue;
+		ul_task_wakes++;
+		ull_task_nominal = (uint64_t)xLastWakeTime * HOST_TICK_US;
+		for (i = 0; i < HK_NODE_COUNT; i++) {
+			HOST_CHECK(request_housekeeping(HK_NODE_FIRST + i));
+			ul_task_calls++;
+		}
+		ul_task_sweeps++;
+	}
+}
+
+/* prvHouseKeepTask2() with CAN_TT_ENABLE, without the collection: wakes up
+*  once per cycle of the schedule. */
+static void tt_cycle_task(void *pvParameters)
+{
+	uint32_t ul_cycle;
+
+	(void)pvParameters;
+	for (;;) {
+		if (!can_tt_wait_cycle(TT_TASK_TICKS, &ul_cycle))
+			vTaskDelay(1);					// No schedule yet.
+		else if (ul_tt_on)
+			ul_tt_wakes++;
+	}
+}
+
+/************************************************************************/
+/*				BUS                                                     */
+/************************************************************************/
+
+/* Requests of the task-driven sweep, at the end of each frame. */
+static void tt_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	uint32_t ul_delay, i;
+
+	(void)uc_node;
+	if ((uc_bus != 0) || (uc_ctrl != CAN_CTRL_0) || !ul_task_on)
+		return;
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (p_frame->ul_mid != CAN_MID_MIDvA(HK_REQUEST_ID(HK_NODE_FIRST + i)))
+			continue;
+		ul_delay = (uint32_t)(host_time_us() - ull_task_nominal);
+		if (ul_delay < ul_min_delay[i])
+			ul_min_delay[i] = ul_delay;
+		if (ul_delay > ul_max_delay[i])
+			ul_max_delay[i] = ul_delay;
+		ul_seen[i]++;
+	}
+}
+
+/* Runs ull_us with background frames on both buses. */
+static void tt_run(uint64_t ull_us)
+{
+	host_frame_t bg = { TT_BG_MID, 0, 0, 8, 0 };
+	uint64_t ull_end = host_time_us() + ull_us, ull_step;
+	uint8_t b;
+
+	while (host_time_us() < ull_end) {
+		ull_step = host_time_us() + 50000;
+		for (b = 0; b < 2; b++) {
+			if (ull_bg_next[b] < host_time_us())
+				ull_bg_next[b] = host_time_us();
+			while ((ull_bg_next[b] < ull_step) && (host_node_queued(b, TT_BG_NODE) < 128)) {
+				HOST_CHECK(host_node_send(b, TT_BG_NODE, &bg, ull_bg_next[b]));
+				ull_bg_next[b] += TT_FRAME_US + tt_rand(2 * (TT_BG_GAP_US - TT_FRAME_US));
+			}
+		}
+		host_run_us(50000);
+	}
+}
+
+/* Worst jitter of the six requests, and the smallest and largest delay. */
+static uint32_t tt_jitter(const uint32_t *p_min, const uint32_t *p_max, uint32_t *p_lo, uint32_t *p_hi)
+{
+	uint32_t ul_jitter = 0, i;
+
+	*p_lo = 0xFFFFFFFF;
+	*p_hi = 0;
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		if (p_max[i] - p_min[i] > ul_jitter)
+			ul_jitter = p_max[i] - p_min[i];
+		if (p_min[i] < *p_lo)
+			*p_lo = p_min[i];
+		if (p_max[i] > *p_hi)
+			*p_hi = p_max[i];
+	}
+	return ul_jitter;
+}
+
+/* CAN interrupt entries so far, both controllers. */
+static uint32_t tt_irq_entries(void)
+{
+	return host_irq_stats[HOST_IRQ_CAN0].ul_entries + host_irq_stats[HOST_IRQ_CAN1].ul_entries;
+}
+
+static void tt_print_work(uint32_t ul_irqs, uint32_t ul_wakes, uint32_t ul_calls)
+{
+	printf("  per sweep: %.2f CAN interrupts, %.2f task wake-ups, %.2f driver calls\n",
+			(double)ul_irqs / TT_SWEEPS, (double)ul_wakes / TT_SWEEPS, (double)ul_calls / TT_SWEEPS);
+}
+
+int main(void)
+{
+	uint32_t ul_tt_min[HK_NODE_COUNT], ul_tt_max[HK_NODE_COUNT];
+	uint32_t ul_task_jit, ul_tt_jit, ul_lo, ul_hi, ul_missed = 0, ul_sent = 0, i;
+	uint32_t ul_task_irqs, ul_tt_irqs;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	xTaskCreate(tt_hold_task, "hold", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 4, NULL);
+	xTaskCreate(tt_hk_task, "hk", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 3, NULL);
+	xTaskCreate(tt_cycle_task, "tt", configMINIMAL_STACK_SIZE, NULL, tskIDLE_PRIORITY + 3, NULL);
+	host_set_frame_hook(tt_hook);
+	host_run_us(1000);
+
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		ul_min_delay[i] = 0xFFFFFFFF;
+		ul_max_delay[i] = 0;
+		ul_seen[i] = 0;
+	}
+
+	/* Task-driven sweeps. */
+	ul_task_irqs = tt_irq_entries();
+	ul_task_on = 1;
+	while (ul_task_sweeps < TT_SWEEPS)
+		tt_run(100000);
+	ul_task_on = 0;
+	tt_run(TT_TASK_TICKS * HOST_TICK_US);
+	ul_task_irqs = tt_irq_entries() - ul_task_irqs;
+	for (i = 0; i < HK_NODE_COUNT; i++)
+		HOST_CHECK(ul_seen[i] == TT_SWEEPS);
+	ul_task_jit = tt_jitter(ul_min_delay, ul_max_delay, &ul_lo, &ul_hi);
+	printf("task-driven, %u sweeps:    request delay %5u - %5u us, worst jitter %5u us\n", TT_SWEEPS,
+			ul_lo, ul_hi, ul_task_jit);
+	tt_print_work(ul_task_irqs, ul_task_wakes, ul_task_calls);
+
+	/* Time-triggered sweeps. */
+	ul_tt_irqs = tt_irq_entries();
+	HOST_CHECK(can_tt_start(tt_schedule, HK_NODE_COUNT));
+	ul_tt_on = 1;
+	tt_run((uint64_t)(TT_SWEEPS * TT_PERIOD) * CAN_TT_CYCLE_US);
+	ul_tt_on = 0;
+	can_tt_stop();
+	ul_tt_irqs = tt_irq_entries() - ul_tt_irqs;
+	for (i = 0; i < HK_NODE_COUNT; i++) {
+		ul_tt_min[i] = can_tt_stats.slot[i].ul_min_delay;
+		ul_tt_max[i] = can_tt_stats.slot[i].ul_max_delay;
+		ul_sent += can_tt_stats.slot[i].ul_sent;
+		ul_missed += can_tt_stats.slot[i].ul_missed;
+	}
+	ul_tt_jit = tt_jitter(ul_tt_min, ul_tt_max, &ul_lo, &ul_hi);
+	printf("time-triggered, %u sweeps: request delay %5u - %5u us, worst jitter %5u us\n", TT_SWEEPS,
+			ul_lo, ul_hi, ul_tt_jit);
+	tt_print_work(ul_tt_irqs, ul_tt_wakes, 0);
+	printf("time-triggered: %u requests sent, %u missed\n", ul_sent, ul_missed);
+
+	HOST_CHECK(ul_sent >= TT_SWEEPS * HK_NODE_COUNT);
+	HOST_CHECK(ul_missed == 0);
+	/* A slot waits at most for one frame already on the bus. */
+	HOST_CHECK(ul_lo >= TT_FRAME_US);
+	HOST_CHECK(ul_tt_jit <= TT_FRAME_US);
+	HOST_CHECK(ul_tt_jit < ul_task_jit);
+	/* One cycle interrupt and one wake-up per cycle, no call and no transmit
+	*  interrupt per request; the task makes six of each. */
+	HOST_CHECK(ul_task_calls == TT_SWEEPS * HK_NODE_COUNT);
+	HOST_CHECK(ul_task_irqs == TT_SWEEPS * HK_NODE_COUNT);
+	HOST_CHECK(ul_tt_irqs <= TT_SWEEPS * TT_PERIOD + 1);
+	HOST_CHECK(ul_tt_wakes <= TT_SWEEPS * TT_PERIOD + 1);
+
+	return host_done();
+}
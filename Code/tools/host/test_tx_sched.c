@@ -0,0 +1,151 @@
+/*
+    Author: Keenan Burnett
+
+	***********************************************************************
+	*	FILE NAME:		test_tx_sched.c
+	*
+	*	PURPOSE:
+	*	Host test of the TX scheduler (can_func.c): frames/s it keeps on a 250 kbit/s
+	*	bus, the drops when the queue overflows, the order of the frames, and
+	*	can_tx_reclaim() while a frame is on the bus.
+	*
+	*	FILE REFERENCES:	host.h
+	*
+	*	EXTERNAL VARIABLES:		None.
+	*
+	*	EXTERNAL REFERENCES:	Same a File References.
+	*
+	*	ABORNOMAL TERMINATION CONDITIONS, ERROR AND WARNING MESSAGES:
+	*	Exits with 1 if a check fails.
+	*
+	*	ASSUMPTIONS, CONSTRAINTS, CONDITIONS:
+	*	The simulated bus takes 444 us for an 8-byte standard frame (no stuffing), so
+	*	2252 frames/s is a full bus.
+	*
+	*	NOTES:
+	*	Build and run with  make check  in tools/.
+	*
+	*	REQUIREMENTS/ FUNCTIONAL SPECIFICATION REFERENCES:
+	*	None.
+
+	*	DEVELOPMENT HISTORY:
+	*	10/17/2026		Created.
+	*
+ */
+
+#include "host.h"
+
+#include <stdio.h>
+
+#define TX_RUN_US			5000000ULL
+#define TX_ID				CAN_ID(CAN_PRIO_SUB_CMD, SUB0_ID0, CAN_NODE_OBC, CAN_TYPE_CMD)
+#define TX_ORDER_LEVELS		3
+#define TX_ORDER_FRAMES		50
+#define TX_RECLAIM_OP		0x02000000
+#define TX_RECLAIM_FRAMES	4
+
+static const uint8_t uc_order_prio[TX_ORDER_LEVELS] = { 20, 5, 10 };
+static uint32_t ul_order_next[TX_ORDER_LEVELS], ul_order_errors, ul_order_last_level;
+
+/* High word of the ordering frames: level (15:8) and sequence (7:0). */
+static void tx_order_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	uint32_t ul_level = (p_frame->ul_datah >> 8) & 0xFF, ul_seq = p_frame->ul_datah & 0xFF;
+
+	(void)uc_bus;
+	(void)uc_node;
+	if ((uc_ctrl != CAN_CTRL_0) || (ul_level >= TX_ORDER_LEVELS))
+		return;
+	if (ul_seq != ul_order_next[ul_level]++)
+		ul_order_errors++;
+	if (uc_order_prio[ul_level] < uc_order_prio[ul_order_last_level])
+		ul_order_errors++;						// A more urgent level after a less urgent one.
+	ul_order_last_level = ul_level;
+}
+
+static uint32_t ul_reclaim_seen[TX_RECLAIM_FRAMES];
+
+/* Times each reclaim frame (sequence in the high word) went on the bus. */
+static void tx_reclaim_hook(uint8_t uc_bus, const host_frame_t *p_frame, uint8_t uc_ctrl, uint8_t uc_node)
+{
+	(void)uc_bus;
+	(void)uc_node;
+	if ((uc_ctrl == CAN_CTRL_0) && (p_frame->ul_datal == TX_RECLAIM_OP) && (p_frame->ul_datah < TX_RECLAIM_FRAMES))
+		ul_reclaim_seen[p_frame->ul_datah]++;
+}
+
+int main(void)
+{
+	uint32_t ul_sent, ul_queued, ul_dropped, ul_ok, i, j;
+	uint64_t ull_busy, ull_start;
+
+	host_init(HOST_SEPARATE_BUSES);
+	can_initialize();
+	host_run_us(1000);
+
+	/* Saturation: the queue is topped up every millisecond. */
+	ul_sent = can_tx_stats.ul_sent;
+	ull_busy = host_bus_stats[0].ull_busy_us;
+	ull_start = host_time_us();
+	while (host_time_us() - ull_start < TX_RUN_US) {
+		while (can_tx_pending() < 64)
+			send_can_command(0x01000000, 0, TX_ID, COMMAND_PRIO);
+		host_run_us(1000);
+	}
+	ul_sent = can_tx_stats.ul_sent - ul_sent;
+	ull_busy = host_bus_stats[0].ull_busy_us - ull_busy;
+	printf("saturated: %u frames in %.1f s = %.0f frames/s, bus busy %.2f%%\n", ul_sent, TX_RUN_US / 1e6,
+			ul_sent * 1e6 / TX_RUN_US, 100.0 * ull_busy / TX_RUN_US);
+	HOST_CHECK(ul_sent >= 2250 * TX_RUN_US / 1000000);
+	HOST_CHECK(ull_busy >= TX_RUN_US * 999 / 1000);
+	host_run_us(200000);
+	HOST_CHECK(can_tx_pending() == 0);
+
+	/* Overflow: 400 frames of one level at once. One goes straight into a
+	*  mailbox (one mailbox per level), 256 wait in the queue. */
+	ul_queued = can_tx_stats.ul_queued;
+	ul_dropped = can_tx_stats.ul_dropped;
+	ul_sent = can_tx_stats.ul_sent;
+	for (i = 0, ul_ok = 0; i < 400; i++)
+		ul_ok += send_can_command(0x01000000, i, TX_ID, COMMAND_PRIO) ? 1 : 0;
+	host_run_us(400000);
+	printf("overflow: 400 offered, %u queued, %u dropped, %u sent, high water %u\n",
+			can_tx_stats.ul_queued - ul_queued, can_tx_stats.ul_dropped - ul_dropped,
+			can_tx_stats.ul_sent - ul_sent, can_tx_stats.ul_high_water);
+	HOST_CHECK(ul_ok == CAN_TX_QUEUE_SIZE + 1);
+	HOST_CHECK(can_tx_stats.ul_dropped - ul_dropped == 400 - ul_ok);
+	HOST_CHECK(can_tx_stats.ul_sent - ul_sent == ul_ok);
+	HOST_CHECK(can_tx_stats.ul_high_water == CAN_TX_QUEUE_SIZE);
+
+	/* Order: three levels queued interleaved leave most urgent first, each
+	*  in the order queued. */
+	host_set_frame_hook(tx_order_hook);
+	ul_order_last_level = 1;
+	for (i = 0; i < TX_ORDER_FRAMES; i++) {
+		for (j = 0; j < TX_ORDER_LEVELS; j++)
+			HOST_CHECK(send_can_command(0x01000000, (j << 8) | i, TX_ID, uc_order_prio[j]));
+	}
+	host_run_us(200000);
+	printf("order: %u + %u + %u frames, %u out of order\n", ul_order_next[0], ul_order_next[1],
+			ul_order_next[2], ul_order_errors);
+	for (j = 0; j < TX_ORDER_LEVELS; j++)
+		HOST_CHECK(ul_order_next[j] == TX_ORDER_FRAMES);
+	HOST_CHECK(ul_order_errors == 0);
+
+	/* Reclaim while the first frame is on the bus: it ends as sent, the
+	*  others are aborted in their mailboxes and sent after it, none twice. */
+	host_set_frame_hook(tx_reclaim_hook);
+	ul_sent = can_tx_stats.ul_sent;
+	for (i = 0; i < TX_RECLAIM_FRAMES; i++)
+		HOST_CHECK(send_can_command(TX_RECLAIM_OP, i, TX_ID, (i & 1) ? 10 : 5));
+	host_run_us(200);
+	HOST_CHECK(can_tx_reclaim(CAN_CTRL_0) == 0);
+	host_run_us(20000);
+	printf("reclaim: %u frames sent, seen %u %u %u %u times\n", can_tx_stats.ul_sent - ul_sent,
+			ul_reclaim_seen[0], ul_reclaim_seen[1], ul_reclaim_seen[2], ul_reclaim_seen[3]);
+	HOST_CHECK(can_tx_stats.ul_sent - ul_sent == TX_RECLAIM_FRAMES);
+	for (i = 0; i < TX_RECLAIM_FRAMES; i++)
+		HOST_CHECK(ul_reclaim_seen[i] == 1);
+
+	return host_done();
+}